@@ -1,16 +1,26 @@
 ; Устанавливаем разрядность 32 бита
 bits 32
 
-; Начало секции кода
-section .text
+; Биты элементов таблиц страниц PAE
+%define PG_PRESENT 0x001
+%define PG_WRITE   0x002
+%define PG_LARGE   0x080
+
+; Заголовок Multiboot - в начале образа, по физическому адресу
+section .multiboot
         ; Заголовок Multiboot для загрузки GRUB
         align 4                     ; Выравнивание по 4 байта
         dd 0x1BADB002              ; Магическое число Multiboot
-        dd 0x00                    ; Флаги (0 - нет дополнительных полей)
-        dd - (0x1BADB002 + 0x00)   ; Контрольная сумма (магическое + флаги + сумма = 0)
+        dd 0x02                    ; Флаги (бит 1 - передать карту памяти)
+        dd - (0x1BADB002 + 0x02)   ; Контрольная сумма (магическое + флаги + сумма = 0)
+
+; Загрузочный код работает по физическим адресам, до страничной адресации
+section .boot.text progbits alloc exec nowrite align=16
 
 ; Объявляем точку входа start глобальной
 global start
+; Загрузочные таблицы нужны трамплину прикладных процессоров
+global boot_pdpt
 ; Объявляем внешнюю функцию kmain, которая находится в коде на C
 extern kmain
 
@@ -18,8 +28,86 @@ extern kmain
 start:
   ; Запрещаем прерывания
   cli
+  ; CPUID портит ebx: магическое число и адрес структуры Multiboot - в esi/edi
+  mov esi, eax
+  mov edi, ebx
+
+  ; Без PAE ядро не может перейти в верхнюю половину
+  mov eax, 1
+  cpuid
+  test edx, 1 << 6
+  jz .no_pae
+
+  ; Каталог: нижний гигабайт страницами 2 МБ
+  xor ecx, ecx
+.fill_directory:
+  mov eax, ecx
+  shl eax, 21
+  or eax, PG_PRESENT | PG_WRITE | PG_LARGE
+  mov [boot_pd + ecx * 8], eax
+  mov dword [boot_pd + ecx * 8 + 4], 0
+  inc ecx
+  cmp ecx, 512
+  jb .fill_directory
+
+  ; PDPT: один каталог тождественно (0-1 ГБ) и в верхнюю половину (3-4 ГБ)
+  mov eax, boot_pd + PG_PRESENT
+  mov [boot_pdpt], eax
+  mov [boot_pdpt + 24], eax
+  xor eax, eax
+  mov [boot_pdpt + 4], eax
+  mov [boot_pdpt + 8], eax
+  mov [boot_pdpt + 12], eax
+  mov [boot_pdpt + 16], eax
+  mov [boot_pdpt + 20], eax
+  mov [boot_pdpt + 28], eax
+
+  ; CR4.PAE, CR3, затем CR0.PG
+  mov eax, cr4
+  or eax, 1 << 5
+  mov cr4, eax
+  mov eax, boot_pdpt
+  mov cr3, eax
+  mov eax, cr0
+  or eax, 1 << 31
+  mov cr0, eax
+
+  ; Абсолютный переход в верхнюю половину
+  mov eax, higher_half
+  jmp eax
+
+.no_pae:
+  ; Сообщение в видеопамять: красный фон, белый текст
+  mov esi, no_pae_msg
+  mov edi, 0xB8000
+.print:
+  lodsb
+  test al, al
+  jz .halt
+  mov ah, 0x4F
+  stosw
+  jmp .print
+.halt:
+  hlt
+  jmp .halt
+
+no_pae_msg db "PAE not supported: kernel requires a CPU with PAE", 0
+
+; Загрузочные таблицы страниц (по физическим адресам)
+section .boot.bss nobits alloc write align=4096
+boot_pd:
+  resq 512
+boot_pdpt:
+  resq 4
+
+; Начало секции кода
+section .text
+higher_half:
   ; Устанавливаем указатель стека на выделенную область
   mov esp, stack_space
+  ; Передаем kmain магическое число (eax) и адрес структуры Multiboot (ebx)
+  push edi
+  push esi
   ; Вызываем основную функцию ядра на C
   call kmain
   ; Останавливаем процессор (если kmain вернет управление)
@@ -30,4 +118,4 @@ section .bss
 ; Резервируем 8192 байт (8KB) для стека
 resb 8192
 ; Метка, указывающая на начало стека
-stack_space:
\ No newline at end of file
+stack_space:
@@ -0,0 +1,247 @@
+/**
+ * @file acpi.c
+ * @brief Разбор таблиц ACPI
+ *
+ * RSDP ищется в первом килобайте EBDA и в области BIOS 0xE0000-0xFFFFF.
+ * Таблицы в нижней памяти читаются через прямое отображение, остальные
+ * (обычно у верхней границы памяти до 4 ГБ) отображаются в окно ядра.
+ * Адреса таблиц из RSDT/XSDT запоминаются один раз при инициализации.
+ */
+
+#include "acpi.h"
+#include "../video/video.h"
+#include "../memory/memory.h"
+#include "../memory/vmm.h"
+#include "../lib/compiler.h"
+
+/* Разобранная MADT */
+acpi_madt_info_t acpi_madt;
+
+/* Найденные корневые таблицы */
+static acpi_rsdp_t *rsdp = NULL;
+static acpi_sdt_header_t *root_table = NULL;
+static int root_is_xsdt = 0;
+
+/* Отображенные таблицы из корневой таблицы */
+static acpi_sdt_header_t *acpi_tables[ACPI_MAX_TABLES];
+static uint32_t acpi_table_count = 0;
+
+/**
+ * @brief Проверка контрольной суммы (сумма байт должна быть равна 0)
+ * @param ptr Начало области
+ * @param length Длина области
+ * @return 1 если сумма корректна
+ */
+static int acpi_checksum_ok(const void *ptr, uint32_t length) {
+    const uint8_t *bytes = (const uint8_t*)ptr;
+    uint8_t sum = 0;
+    
+    for (uint32_t i = 0; i < length; i++) {
+        sum += bytes[i];
+    }
+    return sum == 0;
+}
+
+/**
+ * @brief Адрес физической области ACPI в ядре
+ * @param phys Физический адрес
+ * @param length Длина области
+ * @return Указатель или NULL
+ */
+static void* acpi_map(uint32_t phys, uint32_t length) {
+    if (phys + length <= PMM_LOWMEM_END) {
+        return phys_to_virt(phys);
+    }
+    return vmm_map_mmio(phys, length);
+}
+
+/**
+ * @brief Отображение таблицы целиком по ее заголовку
+ * @param phys Физический адрес заголовка
+ * @return Указатель на таблицу или NULL
+ */
+static acpi_sdt_header_t* acpi_map_table(uint32_t phys) {
+    acpi_sdt_header_t *header = (acpi_sdt_header_t*)acpi_map(phys, sizeof(acpi_sdt_header_t));
+    if (!header || header->length <= sizeof(acpi_sdt_header_t)) {
+        return header;
+    }
+    return (acpi_sdt_header_t*)acpi_map(phys, header->length);
+}
+
+/**
+ * @brief Поиск RSDP в области памяти (с шагом 16 байт)
+ * @param start Начало области
+ * @param length Длина области
+ * @return Указатель на RSDP или NULL
+ */
+static acpi_rsdp_t* acpi_scan_rsdp(uint32_t start, uint32_t length) {
+    for (uint32_t addr = start; addr < start + length; addr += 16) {
+        acpi_rsdp_t *candidate = (acpi_rsdp_t*)phys_to_virt(addr);
+        if (memory_compare(candidate->signature, "RSD PTR ", 8) == 0 &&
+            acpi_checksum_ok(candidate, 20)) {
+            return candidate;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Разбор записей таблицы MADT
+ * @param madt Указатель на таблицу
+ */
+static void acpi_parse_madt(acpi_madt_t *madt) {
+    uint8_t *entry = (uint8_t*)madt + sizeof(acpi_madt_t);
+    uint8_t *end = (uint8_t*)madt + madt->header.length;
+    
+    acpi_madt.present = 1;
+    acpi_madt.lapic_address = madt->lapic_address;
+    acpi_madt.flags = madt->flags;
+    
+    while (entry + 2 <= end && entry[1] >= 2) {
+        uint8_t type = entry[0];
+        
+        switch (type) {
+        case MADT_ENTRY_LAPIC:
+            /* processor_id, apic_id, flags (бит 0 - процессор включен) */
+            if ((*(uint32_t*)(entry + 4) & 1) && acpi_madt.cpu_count < ACPI_MAX_CPUS) {
+                acpi_madt.cpu_apic_ids[acpi_madt.cpu_count++] = entry[3];
+            }
+            break;
+        case MADT_ENTRY_IOAPIC:
+            if (acpi_madt.ioapic_count < ACPI_MAX_IOAPICS) {
+                acpi_ioapic_t *ioapic = &acpi_madt.ioapics[acpi_madt.ioapic_count++];
+                ioapic->id = entry[2];
+                ioapic->address = *(uint32_t*)(entry + 4);
+                ioapic->gsi_base = *(uint32_t*)(entry + 8);
+            }
+            break;
+        case MADT_ENTRY_OVERRIDE:
+            if (acpi_madt.override_count < ACPI_MAX_OVERRIDES) {
+                acpi_irq_override_t *iso = &acpi_madt.overrides[acpi_madt.override_count++];
+                iso->source = entry[3];
+                iso->gsi = *(uint32_t*)(entry + 4);
+                iso->flags = *(uint16_t*)(entry + 8);
+            }
+            break;
+        case MADT_ENTRY_LAPIC_OVERRIDE:
+            /* 64-битный адрес; 32-битное ядро использует только младшую часть */
+            if (*(uint32_t*)(entry + 8) == 0) {
+                acpi_madt.lapic_address = *(uint32_t*)(entry + 4);
+            }
+            break;
+        default:
+            break;
+        }
+        
+        entry += entry[1];
+    }
+}
+
+/**
+ * @brief Поиск RSDP и разбор MADT
+ * @return 1 если таблицы ACPI найдены, иначе 0
+ */
+__cold int acpi_init(void) {
+    print_string("ACPI Initialization... ");
+    
+    memory_set(&acpi_madt, 0, sizeof(acpi_madt));
+    
+    /* Сегмент EBDA хранится по адресу 0x40E в области данных BIOS */
+    uint32_t ebda = (uint32_t)(*(uint16_t*)phys_to_virt(0x40E)) << 4;
+    if (ebda) {
+        rsdp = acpi_scan_rsdp(ebda, 1024);
+    }
+    if (!rsdp) {
+        rsdp = acpi_scan_rsdp(0xE0000, 0x20000);
+    }
+    if (!rsdp) {
+        print_string_color("NOT FOUND\n", COLOR_RED, COLOR_BLACK);
+        return 0;
+    }
+    
+    /* XSDT предпочтительнее, если она адресуема 32-битным ядром */
+    if (rsdp->revision >= 2 && rsdp->xsdt_address && (rsdp->xsdt_address >> 32) == 0) {
+        root_table = acpi_map_table((uint32_t)rsdp->xsdt_address);
+        root_is_xsdt = 1;
+    } else {
+        root_table = acpi_map_table(rsdp->rsdt_address);
+        root_is_xsdt = 0;
+    }
+    
+    if (!root_table || !acpi_checksum_ok(root_table, root_table->length)) {
+        print_string_color("BAD CHECKSUM\n", COLOR_RED, COLOR_BLACK);
+        root_table = NULL;
+        return 0;
+    }
+    
+    /* Для XSDT берем младшие 32 бита 64-битного указателя */
+    uint32_t entry_size = root_is_xsdt ? 8 : 4;
+    uint32_t count = (root_table->length - sizeof(acpi_sdt_header_t)) / entry_size;
+    uint8_t *entries = (uint8_t*)root_table + sizeof(acpi_sdt_header_t);
+    for (uint32_t i = 0; i < count && acpi_table_count < ACPI_MAX_TABLES; i++) {
+        uint32_t address = *(uint32_t*)(entries + i * entry_size);
+        if (root_is_xsdt && *(uint32_t*)(entries + i * entry_size + 4) != 0) {
+            continue;
+        }
+        acpi_sdt_header_t *table = acpi_map_table(address);
+        if (table && acpi_checksum_ok(table, table->length)) {
+            acpi_tables[acpi_table_count++] = table;
+        }
+    }
+    
+    acpi_madt_t *madt = (acpi_madt_t*)acpi_find_table("APIC");
+    if (madt) {
+        acpi_parse_madt(madt);
+    }
+    
+    print_string_color("OK\n", COLOR_GREEN, COLOR_BLACK);
+    print_string("  - Revision: ");
+    print_dec(rsdp->revision);
+    print_string(root_is_xsdt ? " (XSDT)\n" : " (RSDT)\n");
+    if (acpi_madt.present) {
+        print_string("  - MADT: ");
+        print_dec(acpi_madt.cpu_count);
+        print_string(" CPU(s), ");
+        print_dec(acpi_madt.ioapic_count);
+        print_string(" I/O APIC(s), ");
+        print_dec(acpi_madt.override_count);
+        print_string(" override(s)\n");
+    }
+    return 1;
+}
+
+/**
+ * @brief Поиск системной таблицы по сигнатуре
+ * @param signature Четырехсимвольная сигнатура (например, "APIC")
+ * @return Указатель на заголовок таблицы или NULL
+ */
+acpi_sdt_header_t* acpi_find_table(const char *signature) {
+    for (uint32_t i = 0; i < acpi_table_count; i++) {
+        if (memory_compare(acpi_tables[i]->signature, signature, 4) == 0) {
+            return acpi_tables[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Перевод ISA IRQ в GSI с учетом переопределений MADT
+ * @param irq Линия ISA IRQ
+ * @param flags Выход: флаги MPS INTI (0 - по умолчанию для шины ISA)
+ * @return Глобальный номер прерывания
+ */
+uint32_t acpi_irq_to_gsi(uint8_t irq, uint16_t *flags) {
+    for (uint32_t i = 0; i < acpi_madt.override_count; i++) {
+        if (acpi_madt.overrides[i].source == irq) {
+            if (flags) {
+                *flags = acpi_madt.overrides[i].flags;
+            }
+            return acpi_madt.overrides[i].gsi;
+        }
+    }
+    
+    if (flags) {
+        *flags = 0;
+    }
+    return irq;
+}
@@ -0,0 +1,130 @@
+/**
+ * @file acpi.h
+ * @brief Разбор таблиц ACPI
+ *
+ * Поиск RSDP, обход RSDT/XSDT и разбор таблицы MADT (APIC),
+ * описывающей процессоры, контроллеры I/O APIC и переопределения
+ * линий ISA-прерываний.
+ */
+
+#ifndef KERNEL_ACPI_H
+#define KERNEL_ACPI_H
+
+#include <stdint.h>
+
+/* Ограничения на количество разобранных записей MADT */
+#define ACPI_MAX_CPUS       16
+#define ACPI_MAX_IOAPICS    4
+#define ACPI_MAX_OVERRIDES  16
+#define ACPI_MAX_TABLES     32
+
+/* Типы записей MADT */
+#define MADT_ENTRY_LAPIC          0
+#define MADT_ENTRY_IOAPIC         1
+#define MADT_ENTRY_OVERRIDE       2
+#define MADT_ENTRY_LAPIC_NMI      4
+#define MADT_ENTRY_LAPIC_OVERRIDE 5
+
+/* Флаги MPS INTI (полярность и режим срабатывания) */
+#define MPS_POLARITY_MASK  0x03
+#define MPS_POLARITY_LOW   0x03
+#define MPS_TRIGGER_MASK   0x0C
+#define MPS_TRIGGER_LEVEL  0x0C
+
+/**
+ * @brief Указатель на корневую системную таблицу (RSDP)
+ */
+typedef struct {
+    char signature[8];        /* "RSD PTR " */
+    uint8_t checksum;         /* Контрольная сумма первых 20 байт */
+    char oem_id[6];
+    uint8_t revision;         /* 0 - ACPI 1.0, 2 - ACPI 2.0+ */
+    uint32_t rsdt_address;    /* Физический адрес RSDT */
+    uint32_t length;          /* Длина структуры (ACPI 2.0+) */
+    uint64_t xsdt_address;    /* Физический адрес XSDT (ACPI 2.0+) */
+    uint8_t ext_checksum;
+    uint8_t reserved[3];
+} __attribute__((packed)) acpi_rsdp_t;
+
+/**
+ * @brief Общий заголовок системных таблиц ACPI
+ */
+typedef struct {
+    char signature[4];
+    uint32_t length;          /* Длина таблицы вместе с заголовком */
+    uint8_t revision;
+    uint8_t checksum;
+    char oem_id[6];
+    char oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} __attribute__((packed)) acpi_sdt_header_t;
+
+/**
+ * @brief Заголовок таблицы MADT
+ */
+typedef struct {
+    acpi_sdt_header_t header;
+    uint32_t lapic_address;   /* Физический адрес локального APIC */
+    uint32_t flags;           /* Бит 0: присутствует пара 8259 */
+} __attribute__((packed)) acpi_madt_t;
+
+/**
+ * @brief Переопределение ISA-прерывания (запись MADT типа 2)
+ */
+typedef struct {
+    uint8_t source;           /* Линия ISA IRQ */
+    uint32_t gsi;             /* Глобальный номер прерывания */
+    uint16_t flags;           /* Флаги MPS INTI */
+} acpi_irq_override_t;
+
+/**
+ * @brief Контроллер I/O APIC (запись MADT типа 1)
+ */
+typedef struct {
+    uint8_t id;
+    uint32_t address;         /* Физический адрес регистров */
+    uint32_t gsi_base;        /* Первый обслуживаемый GSI */
+} acpi_ioapic_t;
+
+/**
+ * @brief Сведения, извлеченные из MADT
+ */
+typedef struct {
+    int present;                                    /* MADT найдена */
+    uint32_t lapic_address;                         /* Адрес локального APIC */
+    uint32_t flags;                                 /* Флаги MADT */
+    uint32_t cpu_count;                             /* Включенные процессоры */
+    uint8_t cpu_apic_ids[ACPI_MAX_CPUS];            /* Их APIC ID */
+    uint32_t ioapic_count;
+    acpi_ioapic_t ioapics[ACPI_MAX_IOAPICS];
+    uint32_t override_count;
+    acpi_irq_override_t overrides[ACPI_MAX_OVERRIDES];
+} acpi_madt_info_t;
+
+/* Разобранная MADT */
+extern acpi_madt_info_t acpi_madt;
+
+/**
+ * @brief Поиск RSDP и разбор MADT
+ * @return 1 если таблицы ACPI найдены, иначе 0
+ */
+int acpi_init(void);
+
+/**
+ * @brief Поиск системной таблицы по сигнатуре
+ * @param signature Четырехсимвольная сигнатура (например, "APIC")
+ * @return Указатель на заголовок таблицы или NULL
+ */
+acpi_sdt_header_t* acpi_find_table(const char *signature);
+
+/**
+ * @brief Перевод ISA IRQ в GSI с учетом переопределений MADT
+ * @param irq Линия ISA IRQ
+ * @param flags Выход: флаги MPS INTI (0 - по умолчанию для шины ISA)
+ * @return Глобальный номер прерывания
+ */
+uint32_t acpi_irq_to_gsi(uint8_t irq, uint16_t *flags);
+
+#endif /* KERNEL_ACPI_H */
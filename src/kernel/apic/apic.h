@@ -0,0 +1,236 @@
+/**
+ * @file apic.h
+ * @brief Драйверы локального APIC и I/O APIC
+ *
+ * Локальный APIC принимает прерывания и подтверждает их записью
+ * в регистр EOI через MMIO. I/O APIC маршрутизирует внешние линии
+ * (GSI) на векторы и процессоры через таблицу перенаправления.
+ */
+
+#ifndef KERNEL_APIC_H
+#define KERNEL_APIC_H
+
+#include <stdint.h>
+#include "../idt/irq.h"
+
+/* Адреса по умолчанию (если MADT их не сообщает) */
+#define LAPIC_DEFAULT_BASE  0xFEE00000
+#define IOAPIC_DEFAULT_BASE 0xFEC00000
+
+/* Размеры областей регистров */
+#define LAPIC_MMIO_SIZE  0x1000
+#define IOAPIC_MMIO_SIZE 0x20
+
+/* Регистры локального APIC (смещения) */
+#define LAPIC_REG_ID        0x020
+#define LAPIC_REG_VERSION   0x030
+#define LAPIC_REG_TPR       0x080
+#define LAPIC_REG_EOI       0x0B0
+#define LAPIC_REG_SVR       0x0F0
+#define LAPIC_REG_ISR       0x100
+#define LAPIC_REG_IRR       0x200
+#define LAPIC_REG_ESR       0x280
+#define LAPIC_REG_ICR_LOW   0x300
+#define LAPIC_REG_ICR_HIGH  0x310
+#define LAPIC_REG_LVT_TIMER 0x320
+#define LAPIC_REG_LVT_LINT0 0x350
+#define LAPIC_REG_LVT_LINT1 0x360
+#define LAPIC_REG_LVT_ERROR 0x370
+#define LAPIC_REG_TIMER_INITIAL 0x380
+#define LAPIC_REG_TIMER_CURRENT 0x390
+#define LAPIC_REG_TIMER_DIVIDE  0x3E0
+
+/* Биты регистров локального APIC */
+#define LAPIC_SVR_ENABLE    0x100
+#define LAPIC_LVT_MASKED    0x10000
+#define MSR_APIC_BASE_ENABLE 0x800
+
+/* Поля ICR (межпроцессорные прерывания) */
+#define LAPIC_ICR_FIXED          0x00000
+#define LAPIC_ICR_INIT           0x00500
+#define LAPIC_ICR_STARTUP        0x00600
+#define LAPIC_ICR_PENDING        0x01000
+#define LAPIC_ICR_LEVEL_ASSERT   0x04000
+#define LAPIC_ICR_LEVEL_TRIGGER  0x08000
+
+/* Режимы LVT таймера */
+#define LAPIC_TIMER_ONESHOT      0x00000
+#define LAPIC_TIMER_PERIODIC     0x20000
+#define LAPIC_TIMER_TSC_DEADLINE 0x40000
+
+/* Делитель частоты шины для таймера (деление на 16) */
+#define LAPIC_TIMER_DIVIDE_16 0x03
+
+/* Вектор ложного прерывания APIC */
+#define APIC_SPURIOUS_VECTOR 0xFF
+
+/* Вектор прерывания LAPIC-таймера */
+#define LAPIC_TIMER_VECTOR 0xF0
+
+/* Регистры I/O APIC */
+#define IOAPIC_REG_SELECT   0x00
+#define IOAPIC_REG_WINDOW   0x10
+#define IOAPIC_REG_ID       0x00
+#define IOAPIC_REG_VERSION  0x01
+#define IOAPIC_REG_REDTBL   0x10
+
+/* Биты записи таблицы перенаправления */
+#define IOAPIC_REDIR_LOW_ACTIVE 0x2000
+#define IOAPIC_REDIR_LEVEL      0x8000
+#define IOAPIC_REDIR_MASKED     0x10000
+
+/**
+ * @brief Поиск и включение APIC
+ *
+ * Использует сведения MADT (acpi_init() должен быть вызван раньше).
+ * При успехе маскирует 8259 и перенаправляет ISA-линии через I/O APIC.
+ *
+ * @return 1 если APIC включен, 0 если остается 8259
+ */
+int apic_init(void);
+
+/**
+ * @brief Проверка, используется ли APIC для доставки прерываний
+ */
+int apic_enabled(void);
+
+/**
+ * @brief Чтение регистра локального APIC
+ * @param reg Смещение регистра
+ */
+uint32_t lapic_read(uint32_t reg);
+
+/**
+ * @brief Запись регистра локального APIC
+ * @param reg Смещение регистра
+ * @param value Значение
+ */
+void lapic_write(uint32_t reg, uint32_t value);
+
+/**
+ * @brief Включение локального APIC текущего процессора
+ */
+void lapic_enable(void);
+
+/**
+ * @brief APIC ID текущего процессора
+ */
+uint8_t lapic_id(void);
+
+/**
+ * @brief Подтверждение прерывания (запись в регистр EOI)
+ */
+void lapic_eoi(void);
+
+/**
+ * @brief Проверка, ожидает ли вектор доставки (бит в IRR)
+ * @param vector Номер вектора
+ */
+int lapic_is_pending(uint8_t vector);
+
+/**
+ * @brief Отправка межпроцессорного прерывания
+ * @param apic_id APIC ID получателя
+ * @param icr Младшее слово ICR (режим доставки, вектор)
+ *
+ * Дожидается, пока локальный APIC примет предыдущее IPI.
+ */
+void lapic_send_ipi(uint8_t apic_id, uint32_t icr);
+
+/**
+ * @brief Инициализация всех I/O APIC из MADT с маскированием всех линий
+ */
+void ioapic_init(void);
+
+/**
+ * @brief Проверка, обслуживается ли GSI одним из I/O APIC
+ * @param gsi Глобальный номер прерывания
+ */
+int ioapic_has_gsi(uint32_t gsi);
+
+/**
+ * @brief Настройка записи перенаправления для GSI
+ * @param gsi Глобальный номер прерывания
+ * @param vector Вектор в IDT
+ * @param dest_apic_id APIC ID процессора-получателя
+ * @param flags Флаги MPS INTI (полярность/режим)
+ */
+void ioapic_route(uint32_t gsi, uint8_t vector, uint8_t dest_apic_id, uint16_t flags);
+
+/**
+ * @brief Смена процессора-получателя GSI
+ * @param gsi Глобальный номер прерывания
+ * @param dest_apic_id APIC ID процессора-получателя
+ */
+void ioapic_set_destination(uint32_t gsi, uint8_t dest_apic_id);
+
+/**
+ * @brief Маскирование GSI
+ * @param gsi Глобальный номер прерывания
+ */
+void ioapic_mask(uint32_t gsi);
+
+/**
+ * @brief Размаскирование GSI
+ * @param gsi Глобальный номер прерывания
+ */
+void ioapic_unmask(uint32_t gsi);
+
+/**
+ * @brief Проверка, замаскирован ли GSI
+ * @param gsi Глобальный номер прерывания
+ */
+int ioapic_is_masked(uint32_t gsi);
+
+/**
+ * @brief Калибровка LAPIC-таймера и его настройка на текущем процессоре
+ *
+ * Предпочитает режим TSC-deadline, если CPUID его сообщает
+ * и TSC откалиброван; иначе используется one-shot режим.
+ *
+ * @return 1 если таймер готов к работе
+ */
+int lapic_timer_init(void);
+
+/**
+ * @brief Настройка LAPIC-таймера на текущем процессоре (после калибровки)
+ */
+void lapic_timer_setup_cpu(void);
+
+/**
+ * @brief Проверка готовности LAPIC-таймера
+ */
+int lapic_timer_available(void);
+
+/**
+ * @brief Проверка, работает ли таймер в режиме TSC-deadline
+ */
+int lapic_timer_tsc_deadline(void);
+
+/**
+ * @brief Взведение таймера текущего процессора на момент времени
+ * @param expires_ns Абсолютное время срабатывания (шкала hrtimer_now_ns)
+ */
+void lapic_timer_arm(uint64_t expires_ns);
+
+/**
+ * @brief Остановка таймера текущего процессора
+ */
+void lapic_timer_disarm(void);
+
+/**
+ * @brief Обработчик прерывания LAPIC-таймера (вектор LAPIC_TIMER_VECTOR)
+ */
+irq_return_t lapic_timer_handler(void *ctx);
+
+/**
+ * @brief Вывод информации о LAPIC-таймере
+ */
+void lapic_timer_dump_info(void);
+
+/**
+ * @brief Вывод информации о состоянии APIC
+ */
+void apic_dump_info(void);
+
+#endif /* KERNEL_APIC_H */
@@ -0,0 +1,167 @@
+/**
+ * @file ioapic.c
+ * @brief Драйвер I/O APIC
+ *
+ * Каждая линия (GSI) описывается 64-битной записью таблицы
+ * перенаправления: вектор, полярность, режим срабатывания,
+ * маска и APIC ID процессора-получателя.
+ */
+
+#include "apic.h"
+#include "../acpi/acpi.h"
+#include "../cpu/cpu.h"
+#include "../memory/vmm.h"
+#include "../lib/compiler.h"
+
+/* Количество записей перенаправления каждого I/O APIC */
+static uint32_t ioapic_entries[ACPI_MAX_IOAPICS];
+
+/* Адреса регистров каждого I/O APIC в окне ядра */
+static uintptr_t ioapic_bases[ACPI_MAX_IOAPICS];
+
+/**
+ * @brief Чтение регистра I/O APIC
+ * @param base Адрес регистров контроллера в окне ядра
+ * @param reg Номер регистра
+ */
+static uint32_t ioapic_read(uintptr_t base, uint32_t reg) {
+    mmio_write32(base + IOAPIC_REG_SELECT, reg);
+    return mmio_read32(base + IOAPIC_REG_WINDOW);
+}
+
+/**
+ * @brief Запись регистра I/O APIC
+ * @param base Адрес регистров контроллера в окне ядра
+ * @param reg Номер регистра
+ * @param value Значение
+ */
+static void ioapic_write(uintptr_t base, uint32_t reg, uint32_t value) {
+    mmio_write32(base + IOAPIC_REG_SELECT, reg);
+    mmio_write32(base + IOAPIC_REG_WINDOW, value);
+}
+
+/**
+ * @brief Поиск контроллера, обслуживающего GSI
+ * @param gsi Глобальный номер прерывания
+ * @param pin Выход: номер входа контроллера
+ * @return Адрес регистров контроллера или 0
+ */
+static uintptr_t ioapic_for_gsi(uint32_t gsi, uint32_t *pin) {
+    for (uint32_t i = 0; i < acpi_madt.ioapic_count; i++) {
+        acpi_ioapic_t *ioapic = &acpi_madt.ioapics[i];
+        if (gsi >= ioapic->gsi_base && gsi < ioapic->gsi_base + ioapic_entries[i]) {
+            *pin = gsi - ioapic->gsi_base;
+            return ioapic_bases[i];
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Проверка, обслуживается ли GSI одним из I/O APIC
+ * @param gsi Глобальный номер прерывания
+ */
+int ioapic_has_gsi(uint32_t gsi) {
+    uint32_t pin;
+    return ioapic_for_gsi(gsi, &pin) != 0;
+}
+
+/**
+ * @brief Инициализация всех I/O APIC из MADT с маскированием всех линий
+ */
+__cold void ioapic_init(void) {
+    for (uint32_t i = 0; i < acpi_madt.ioapic_count; i++) {
+        uintptr_t base = (uintptr_t)vmm_map_mmio(acpi_madt.ioapics[i].address, IOAPIC_MMIO_SIZE);
+        if (!base) {
+            continue;
+        }
+        ioapic_bases[i] = base;
+        ioapic_entries[i] = ((ioapic_read(base, IOAPIC_REG_VERSION) >> 16) & 0xFF) + 1;
+        
+        for (uint32_t pin = 0; pin < ioapic_entries[i]; pin++) {
+            ioapic_write(base, IOAPIC_REG_REDTBL + pin * 2, IOAPIC_REDIR_MASKED);
+            ioapic_write(base, IOAPIC_REG_REDTBL + pin * 2 + 1, 0);
+        }
+    }
+}
+
+/**
+ * @brief Настройка записи перенаправления для GSI
+ * @param gsi Глобальный номер прерывания
+ * @param vector Вектор в IDT
+ * @param dest_apic_id APIC ID процессора-получателя
+ * @param flags Флаги MPS INTI (полярность/режим)
+ *
+ * Запись создается замаскированной; фиксированная доставка,
+ * физический режим адресации получателя.
+ */
+void ioapic_route(uint32_t gsi, uint8_t vector, uint8_t dest_apic_id, uint16_t flags) {
+    uint32_t pin;
+    uintptr_t base = ioapic_for_gsi(gsi, &pin);
+    if (!base) {
+        return;
+    }
+    
+    uint32_t low = vector | IOAPIC_REDIR_MASKED;
+    if ((flags & MPS_POLARITY_MASK) == MPS_POLARITY_LOW) {
+        low |= IOAPIC_REDIR_LOW_ACTIVE;
+    }
+    if ((flags & MPS_TRIGGER_MASK) == MPS_TRIGGER_LEVEL) {
+        low |= IOAPIC_REDIR_LEVEL;
+    }
+    
+    ioapic_write(base, IOAPIC_REG_REDTBL + pin * 2 + 1, (uint32_t)dest_apic_id << 24);
+    ioapic_write(base, IOAPIC_REG_REDTBL + pin * 2, low);
+}
+
+/**
+ * @brief Смена процессора-получателя GSI
+ * @param gsi Глобальный номер прерывания
+ * @param dest_apic_id APIC ID процессора-получателя
+ */
+void ioapic_set_destination(uint32_t gsi, uint8_t dest_apic_id) {
+    uint32_t pin;
+    uintptr_t base = ioapic_for_gsi(gsi, &pin);
+    if (base) {
+        ioapic_write(base, IOAPIC_REG_REDTBL + pin * 2 + 1, (uint32_t)dest_apic_id << 24);
+    }
+}
+
+/**
+ * @brief Маскирование GSI
+ * @param gsi Глобальный номер прерывания
+ */
+void ioapic_mask(uint32_t gsi) {
+    uint32_t pin;
+    uintptr_t base = ioapic_for_gsi(gsi, &pin);
+    if (base) {
+        uint32_t low = ioapic_read(base, IOAPIC_REG_REDTBL + pin * 2);
+        ioapic_write(base, IOAPIC_REG_REDTBL + pin * 2, low | IOAPIC_REDIR_MASKED);
+    }
+}
+
+/**
+ * @brief Размаскирование GSI
+ * @param gsi Глобальный номер прерывания
+ */
+void ioapic_unmask(uint32_t gsi) {
+    uint32_t pin;
+    uintptr_t base = ioapic_for_gsi(gsi, &pin);
+    if (base) {
+        uint32_t low = ioapic_read(base, IOAPIC_REG_REDTBL + pin * 2);
+        ioapic_write(base, IOAPIC_REG_REDTBL + pin * 2, low & ~IOAPIC_REDIR_MASKED);
+    }
+}
+
+/**
+ * @brief Проверка, замаскирован ли GSI
+ * @param gsi Глобальный номер прерывания
+ */
+int ioapic_is_masked(uint32_t gsi) {
+    uint32_t pin;
+    uintptr_t base = ioapic_for_gsi(gsi, &pin);
+    if (!base) {
+        return 1;
+    }
+    return (ioapic_read(base, IOAPIC_REG_REDTBL + pin * 2) & IOAPIC_REDIR_MASKED) != 0;
+}
@@ -0,0 +1,187 @@
+/**
+ * @file lapic.c
+ * @brief Драйвер локального APIC
+ *
+ * Включает локальный APIC, заменяя пару 8259: подтверждение прерываний
+ * выполняется одной записью в MMIO-регистр EOI вместо медленного
+ * обращения к порту ввода-вывода.
+ */
+
+#include "apic.h"
+#include "../acpi/acpi.h"
+#include "../cpu/cpu.h"
+#include "../idt/irq.h"
+#include "../idt/pic.h"
+#include "../memory/vmm.h"
+#include "../video/video.h"
+#include "../lib/compiler.h"
+
+/* Физический адрес регистров локального APIC и их адрес в окне ядра */
+static uintptr_t lapic_phys = LAPIC_DEFAULT_BASE;
+static uintptr_t lapic_base = 0;
+
+/* Флаг использования APIC */
+static int apic_active = 0;
+
+/**
+ * @brief Чтение регистра локального APIC
+ * @param reg Смещение регистра
+ */
+uint32_t lapic_read(uint32_t reg) {
+    return mmio_read32(lapic_base + reg);
+}
+
+/**
+ * @brief Запись регистра локального APIC
+ * @param reg Смещение регистра
+ * @param value Значение
+ */
+void lapic_write(uint32_t reg, uint32_t value) {
+    mmio_write32(lapic_base + reg, value);
+}
+
+/**
+ * @brief Включение локального APIC текущего процессора
+ */
+void lapic_enable(void) {
+    /* Глобальное включение через MSR (на случай, если BIOS его выключил) */
+    uint64_t base_msr = rdmsr(MSR_APIC_BASE);
+    wrmsr(MSR_APIC_BASE, base_msr | MSR_APIC_BASE_ENABLE);
+    
+    /* Принимаем все приоритеты */
+    lapic_write(LAPIC_REG_TPR, 0);
+    
+    /* LINT0 (ExtINT от 8259) больше не нужен, ошибки не сигнализируем */
+    lapic_write(LAPIC_REG_LVT_LINT0, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_REG_LVT_ERROR, LAPIC_LVT_MASKED);
+    
+    /* Сброс регистра ошибок (требуется двойная запись) */
+    lapic_write(LAPIC_REG_ESR, 0);
+    lapic_write(LAPIC_REG_ESR, 0);
+    
+    /* Программное включение и вектор ложных прерываний */
+    lapic_write(LAPIC_REG_SVR, LAPIC_SVR_ENABLE | APIC_SPURIOUS_VECTOR);
+    
+    /* Подтверждаем возможные зависшие прерывания */
+    lapic_write(LAPIC_REG_EOI, 0);
+}
+
+/**
+ * @brief APIC ID текущего процессора
+ */
+uint8_t lapic_id(void) {
+    return lapic_read(LAPIC_REG_ID) >> 24;
+}
+
+/**
+ * @brief Подтверждение прерывания (запись в регистр EOI)
+ */
+void lapic_eoi(void) {
+    lapic_write(LAPIC_REG_EOI, 0);
+}
+
+/**
+ * @brief Проверка, ожидает ли вектор доставки (бит в IRR)
+ * @param vector Номер вектора
+ */
+int lapic_is_pending(uint8_t vector) {
+    uint32_t irr = lapic_read(LAPIC_REG_IRR + (vector / 32) * 0x10);
+    return (irr >> (vector % 32)) & 1;
+}
+
+/**
+ * @brief Отправка межпроцессорного прерывания
+ * @param apic_id APIC ID получателя
+ * @param icr Младшее слово ICR
+ */
+void lapic_send_ipi(uint8_t apic_id, uint32_t icr) {
+    uint32_t flags = cpu_irq_save();
+    
+    while (lapic_read(LAPIC_REG_ICR_LOW) & LAPIC_ICR_PENDING) {
+        __asm__ volatile("pause");
+    }
+    
+    /* Запись младшего слова отправляет IPI */
+    lapic_write(LAPIC_REG_ICR_HIGH, (uint32_t)apic_id << 24);
+    lapic_write(LAPIC_REG_ICR_LOW, icr);
+    
+    while (lapic_read(LAPIC_REG_ICR_LOW) & LAPIC_ICR_PENDING) {
+        __asm__ volatile("pause");
+    }
+    
+    cpu_irq_restore(flags);
+}
+
+/**
+ * @brief Проверка, используется ли APIC для доставки прерываний
+ */
+int apic_enabled(void) {
+    return apic_active;
+}
+
+/**
+ * @brief Поиск и включение APIC
+ * @return 1 если APIC включен, 0 если остается 8259
+ */
+__cold int apic_init(void) {
+    print_string("APIC Initialization... ");
+    
+    if (!cpu_has_edx(CPUID_EDX_APIC) || !cpu_has_edx(CPUID_EDX_MSR) ||
+        !acpi_madt.present || acpi_madt.ioapic_count == 0) {
+        print_string_color("NOT AVAILABLE", COLOR_BROWN, COLOR_BLACK);
+        print_string(" (using 8259 PIC)\n");
+        return 0;
+    }
+    
+    if (acpi_madt.lapic_address) {
+        lapic_phys = acpi_madt.lapic_address;
+    }
+    lapic_base = (uintptr_t)vmm_map_mmio(lapic_phys, LAPIC_MMIO_SIZE);
+    if (!lapic_base) {
+        print_string_color("FAILED\n", COLOR_RED, COLOR_BLACK);
+        return 0;
+    }
+    
+    lapic_enable();
+    
+    /* Все линии 8259 маскируются, внешние прерывания идут через I/O APIC */
+    pic_disable();
+    ioapic_init();
+    
+    /* ISA-линии направляются на те же векторы, что и при 8259,
+     * на загрузочный процессор; размаскирует их irq_unmask() */
+    for (uint8_t irq = 0; irq < IRQ_ISA_COUNT; irq++) {
+        if (irq == PIC_CASCADE_IRQ) {
+            continue;
+        }
+        uint16_t flags;
+        uint32_t gsi = acpi_irq_to_gsi(irq, &flags);
+        ioapic_route(gsi, IRQ_VECTOR(irq), lapic_id(), flags);
+    }
+    
+    apic_active = 1;
+    
+    print_string_color("OK\n", COLOR_GREEN, COLOR_BLACK);
+    apic_dump_info();
+    return 1;
+}
+
+/**
+ * @brief Вывод информации о состоянии APIC
+ */
+void apic_dump_info(void) {
+    print_string("  - Local APIC: 0x");
+    print_hex(lapic_phys);
+    print_string(", ID ");
+    print_dec(lapic_id());
+    print_string(", version ");
+    print_hex(lapic_read(LAPIC_REG_VERSION) & 0xFF);
+    print_string("\n");
+    for (uint32_t i = 0; i < acpi_madt.ioapic_count; i++) {
+        print_string("  - I/O APIC: 0x");
+        print_hex(acpi_madt.ioapics[i].address);
+        print_string(", GSI base ");
+        print_dec(acpi_madt.ioapics[i].gsi_base);
+        print_string("\n");
+    }
+}
@@ -0,0 +1,179 @@
+/**
+ * @file lapic_timer.c
+ * @brief Драйвер таймера локального APIC
+ *
+ * У каждого процессора свой LAPIC-таймер, поэтому он служит
+ * источником событий hrtimer на своем процессоре. Частота таймера
+ * калибруется при загрузке по каналу 2 PIT. В режиме TSC-deadline
+ * таймер взводится абсолютным значением TSC, что избавляет от
+ * пересчета интервалов и округления; иначе используется one-shot
+ * со счетчиком по частоте шины.
+ */
+
+#include "apic.h"
+#include "../cpu/cpu.h"
+#include "../cpu/tsc.h"
+#include "../drivers/pit.h"
+#include "../idt/irq.h"
+#include "../lib/math64.h"
+#include "../time/hrtimer.h"
+#include "../video/video.h"
+
+/* Частота счетчика LAPIC-таймера после делителя (кГц) */
+static uint32_t lapic_timer_khz = 0;
+
+/* Режим TSC-deadline выбран */
+static int use_tsc_deadline = 0;
+
+/* Таймер откалиброван и готов */
+static int timer_ready = 0;
+
+/* Количество прерываний таймера на каждом процессоре */
+static uint32_t timer_interrupts[MAX_CPUS];
+
+/**
+ * @brief Калибровка частоты счетчика LAPIC-таймера
+ *
+ * Таймер запускается в one-shot режиме с максимальным счетчиком
+ * (LVT замаскирован) на время PIT_CALIBRATE_MS по каналу 2 PIT.
+ */
+static void lapic_timer_calibrate(void) {
+    lapic_write(LAPIC_REG_TIMER_DIVIDE, LAPIC_TIMER_DIVIDE_16);
+    lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_LVT_MASKED | LAPIC_TIMER_ONESHOT | LAPIC_TIMER_VECTOR);
+    
+    uint32_t flags = cpu_irq_save();
+    pit_ch2_start(PIT_CALIBRATE_COUNTS);
+    lapic_write(LAPIC_REG_TIMER_INITIAL, 0xFFFFFFFF);
+    while (!pit_ch2_expired());
+    uint32_t elapsed = 0xFFFFFFFF - lapic_read(LAPIC_REG_TIMER_CURRENT);
+    lapic_write(LAPIC_REG_TIMER_INITIAL, 0);
+    cpu_irq_restore(flags);
+    
+    lapic_timer_khz = elapsed / PIT_CALIBRATE_MS;
+}
+
+/**
+ * @brief Настройка LAPIC-таймера на текущем процессоре (после калибровки)
+ */
+void lapic_timer_setup_cpu(void) {
+    if (use_tsc_deadline) {
+        lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_TIMER_TSC_DEADLINE | LAPIC_TIMER_VECTOR);
+        /* Запись LVT должна стать видимой до первой записи MSR дедлайна */
+        __asm__ volatile("mfence" : : : "memory");
+        wrmsr(MSR_TSC_DEADLINE, 0);
+    } else {
+        lapic_write(LAPIC_REG_TIMER_DIVIDE, LAPIC_TIMER_DIVIDE_16);
+        lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_TIMER_ONESHOT | LAPIC_TIMER_VECTOR);
+        lapic_write(LAPIC_REG_TIMER_INITIAL, 0);
+    }
+}
+
+/**
+ * @brief Калибровка LAPIC-таймера и его настройка на текущем процессоре
+ * @return 1 если таймер готов к работе
+ */
+int lapic_timer_init(void) {
+    print_string("LAPIC Timer Initialization... ");
+    
+    if (!apic_enabled() || !tsc_available()) {
+        print_string_color("NOT AVAILABLE\n", COLOR_BROWN, COLOR_BLACK);
+        return 0;
+    }
+    
+    lapic_timer_calibrate();
+    if (lapic_timer_khz == 0) {
+        print_string_color("FAILED\n", COLOR_RED, COLOR_BLACK);
+        return 0;
+    }
+    
+    use_tsc_deadline = cpu_has_ecx(CPUID_ECX_TSC_DEADLINE);
+    
+    request_vector(LAPIC_TIMER_VECTOR, lapic_timer_handler, NULL);
+    lapic_timer_setup_cpu();
+    timer_ready = 1;
+    
+    print_string_color("OK\n", COLOR_GREEN, COLOR_BLACK);
+    lapic_timer_dump_info();
+    return 1;
+}
+
+/**
+ * @brief Проверка готовности LAPIC-таймера
+ */
+int lapic_timer_available(void) {
+    return timer_ready;
+}
+
+/**
+ * @brief Проверка, работает ли таймер в режиме TSC-deadline
+ */
+int lapic_timer_tsc_deadline(void) {
+    return use_tsc_deadline;
+}
+
+/**
+ * @brief Взведение таймера текущего процессора на момент времени
+ * @param expires_ns Абсолютное время срабатывания (шкала hrtimer_now_ns)
+ *
+ * Шкала hrtimer может строиться не на TSC (например, на HPET),
+ * поэтому дедлайн пересчитывается через интервал от текущего момента.
+ * Прошедший дедлайн приводит к немедленному прерыванию.
+ */
+void lapic_timer_arm(uint64_t expires_ns) {
+    uint64_t now = hrtimer_now_ns();
+    uint64_t delta = expires_ns > now ? expires_ns - now : 0;
+    
+    if (use_tsc_deadline) {
+        wrmsr(MSR_TSC_DEADLINE, rdtsc() + tsc_ns_to_cycles(delta));
+        return;
+    }
+    
+    uint64_t count = mul_div_u64(delta, lapic_timer_khz, 1000000);
+    
+    /* Слишком далекий дедлайн: таймер сработает раньше,
+     * и hrtimer перевзведет его на оставшееся время */
+    if (count > 0xFFFFFFFF) {
+        count = 0xFFFFFFFF;
+    }
+    if (count == 0) {
+        count = 1;
+    }
+    lapic_write(LAPIC_REG_TIMER_INITIAL, (uint32_t)count);
+}
+
+/**
+ * @brief Остановка таймера текущего процессора
+ */
+void lapic_timer_disarm(void) {
+    if (use_tsc_deadline) {
+        wrmsr(MSR_TSC_DEADLINE, 0);
+    } else {
+        lapic_write(LAPIC_REG_TIMER_INITIAL, 0);
+    }
+}
+
+/**
+ * @brief C-обработчик прерывания LAPIC-таймера
+ */
+irq_return_t lapic_timer_handler(void *ctx) {
+    (void)ctx;
+    timer_interrupts[cpu_current()]++;
+    hrtimer_interrupt();
+    return IRQ_HANDLED;
+}
+
+/**
+ * @brief Вывод информации о LAPIC-таймере
+ */
+void lapic_timer_dump_info(void) {
+    print_string("  - Mode: ");
+    print_string(use_tsc_deadline ? "TSC-deadline\n" : "one-shot\n");
+    print_string("  - Frequency: ");
+    print_dec(lapic_timer_khz);
+    print_string(" kHz (bus / 16)\n");
+    print_string("  - Interrupts (CPU ");
+    print_dec(cpu_current());
+    print_string("): ");
+    print_dec(timer_interrupts[cpu_current()]);
+    print_string("\n");
+}
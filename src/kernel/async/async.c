@@ -0,0 +1,235 @@
+/**
+ * @file async.c
+ * @brief Исполнитель асинхронных задач
+ *
+ * Очередь готовых задач защищена блокировкой очереди ожидания
+ * исполнителя; ее же использует поток исполнителя, чтобы спать,
+ * пока задач нет. Шаг задачи выполняется без блокировки, поэтому
+ * пробуждение во время шага только отмечается в задаче, и после
+ * шага она сразу возвращается в очередь.
+ */
+
+#include "async.h"
+#include "../sched/sched.h"
+#include "../video/video.h"
+
+async_executor_t async_idle_executor = ASYNC_EXECUTOR_INIT("idle", 1);
+
+/**
+ * @brief Добавление задачи в конец очереди (под блокировкой)
+ */
+static void async_push(async_executor_t *exec, async_task_t *task) {
+    task->state = ASYNC_TASK_QUEUED;
+    task->next = NULL;
+    if (exec->tail) {
+        exec->tail->next = task;
+    } else {
+        exec->head = task;
+    }
+    exec->tail = task;
+}
+
+/**
+ * @brief Извлечение задачи из начала очереди (под блокировкой)
+ */
+static async_task_t* async_pop(async_executor_t *exec) {
+    async_task_t *task = exec->head;
+    if (task) {
+        exec->head = task->next;
+        if (!exec->head) {
+            exec->tail = NULL;
+        }
+        task->next = NULL;
+    }
+    return task;
+}
+
+/**
+ * @brief Оповещение того, кто разбирает очередь (под блокировкой)
+ * @return 1 если нужно разбудить простаивающий процессор
+ */
+static int async_notify(async_executor_t *exec) {
+    wake_up_locked(&exec->wq, NULL, 1);
+    return exec->from_idle;
+}
+
+/**
+ * @brief Подготовка исполнителя
+ */
+void async_executor_init(async_executor_t *exec, const char *name, int from_idle) {
+    exec->name = name;
+    wait_queue_init(&exec->wq);
+    exec->head = NULL;
+    exec->tail = NULL;
+    exec->polling = 0;
+    exec->from_idle = from_idle;
+    exec->spawned = 0;
+    exec->finished = 0;
+    exec->polls = 0;
+    exec->wakeups = 0;
+}
+
+/**
+ * @brief Запуск задачи
+ */
+int async_spawn(async_executor_t *exec, async_task_t *task, async_fn_t fn,
+                async_future_t *finished) {
+    uint32_t flags = spin_lock_irqsave(&exec->wq.lock);
+    
+    if (task->state != ASYNC_TASK_NEW && task->state != ASYNC_TASK_FINISHED) {
+        spin_unlock_irqrestore(&exec->wq.lock, flags);
+        return -1;
+    }
+    
+    task->fn = fn;
+    task->executor = exec;
+    task->finished = finished;
+    task->resume = 0;
+    task->woken = 0;
+    async_push(exec, task);
+    exec->spawned++;
+    int kick = async_notify(exec);
+    
+    spin_unlock_irqrestore(&exec->wq.lock, flags);
+    if (kick) {
+        sched_wake_idle();
+    }
+    return 0;
+}
+
+/**
+ * @brief Возврат ожидающей задачи в очередь исполнителя
+ */
+void async_wake(async_task_t *task) {
+    async_executor_t *exec = task->executor;
+    int kick = 0;
+    uint32_t flags = spin_lock_irqsave(&exec->wq.lock);
+    
+    if (task->state == ASYNC_TASK_WAITING) {
+        async_push(exec, task);
+        exec->wakeups++;
+        kick = async_notify(exec);
+    } else if (task->state == ASYNC_TASK_RUNNING) {
+        task->woken = 1;
+    }
+    
+    spin_unlock_irqrestore(&exec->wq.lock, flags);
+    if (kick) {
+        sched_wake_idle();
+    }
+}
+
+/**
+ * @brief Выполнение готовых задач
+ */
+uint32_t async_run(async_executor_t *exec, uint32_t budget) {
+    if (!__sync_bool_compare_and_swap(&exec->polling, 0, 1)) {
+        return 0;
+    }
+    
+    uint32_t steps = 0;
+    while (steps < budget) {
+        uint32_t flags = spin_lock_irqsave(&exec->wq.lock);
+        async_task_t *task = async_pop(exec);
+        if (!task) {
+            spin_unlock_irqrestore(&exec->wq.lock, flags);
+            break;
+        }
+        task->state = ASYNC_TASK_RUNNING;
+        task->woken = 0;
+        spin_unlock_irqrestore(&exec->wq.lock, flags);
+        
+        int status = task->fn(task);
+        steps++;
+        
+        async_future_t *finished = NULL;
+        flags = spin_lock_irqsave(&exec->wq.lock);
+        exec->polls++;
+        if (status == ASYNC_DONE) {
+            /* После смены состояния задача принадлежит владельцу */
+            finished = task->finished;
+            task->state = ASYNC_TASK_FINISHED;
+            exec->finished++;
+        } else if (task->woken) {
+            async_push(exec, task);
+        } else {
+            task->state = ASYNC_TASK_WAITING;
+        }
+        spin_unlock_irqrestore(&exec->wq.lock, flags);
+        
+        if (finished) {
+            async_future_complete(finished, 0);
+        }
+    }
+    
+    exec->polling = 0;
+    return steps;
+}
+
+/**
+ * @brief Поток исполнителя
+ */
+void async_executor_thread(void *arg) {
+    async_executor_t *exec = (async_executor_t*)arg;
+    
+    while (1) {
+        if (async_run(exec, ASYNC_IDLE_BUDGET) == ASYNC_IDLE_BUDGET) {
+            /* Очередь не кончилась - даем поработать другим потокам */
+            sched_yield();
+            continue;
+        }
+        wait_event(&exec->wq, exec->head != NULL);
+    }
+}
+
+/**
+ * @brief Проверка будущего с подпиской задачи на его завершение
+ *
+ * Подписка и повторная проверка упорядочены xchg, как и завершение
+ * с чтением подписчика: либо задача увидит результат, либо
+ * завершающий увидит задачу. Если случится и то и другое, задача
+ * получит лишнее пробуждение и просто перепроверит свою точку ожидания.
+ */
+int async_future_poll(async_future_t *future, async_task_t *task) {
+    if (future->done) {
+        return 1;
+    }
+    
+    (void)__sync_lock_test_and_set(&future->waiter, task);
+    if (future->done) {
+        __sync_bool_compare_and_swap(&future->waiter, task, NULL);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Завершение будущего
+ */
+void async_future_complete(async_future_t *future, int32_t result) {
+    future->result = result;
+    __asm__ volatile("" : : : "memory");
+    future->done = 1;
+    
+    async_task_t *waiter = __sync_lock_test_and_set(&future->waiter, NULL);
+    if (waiter) {
+        async_wake(waiter);
+    }
+}
+
+/**
+ * @brief Вывод статистики исполнителя
+ */
+void async_dump_stats(async_executor_t *exec) {
+    print_string("Async executor '");
+    print_string(exec->name);
+    print_string("': spawned ");
+    print_dec(exec->spawned);
+    print_string(", finished ");
+    print_dec(exec->finished);
+    print_string(", polls ");
+    print_dec(exec->polls);
+    print_string(", wakeups ");
+    print_dec(exec->wakeups);
+    print_string("\n");
+}
@@ -0,0 +1,246 @@
+/**
+ * @file async.h
+ * @brief Бесстековые сопрограммы и исполнитель асинхронных задач
+ *
+ * Задача - функция, которую исполнитель вызывает заново при каждом
+ * продвижении. Точка продолжения хранится в задаче номером строки,
+ * а макросы ASYNC_* превращают тело функции в switch по этому номеру,
+ * так что задача выглядит как последовательный код с точками ожидания,
+ * но не имеет своего стека: незавершенная операция стоит несколько
+ * десятков байт (задача + будущее) вместо стека потока.
+ *
+ * Локальные переменные между точками ожидания не сохраняются -
+ * состояние держат в структуре, в которую встроена задача. В одной
+ * строке может быть только одна точка ожидания, а внутри тела нельзя
+ * использовать собственный switch, охватывающий точку ожидания.
+ *
+ *     typedef struct { async_task_t task; async_future_t io; int n; } op_t;
+ *
+ *     static int op_fn(async_task_t *task) {
+ *         op_t *op = (op_t*)task;
+ *         ASYNC_BEGIN(task);
+ *         for (op->n = 0; op->n < 4; op->n++) {
+ *             start_io(&op->io);
+ *             ASYNC_AWAIT(task, &op->io);
+ *         }
+ *         ASYNC_END(task);
+ *     }
+ *
+ * Будущее завершается откуда угодно, включая обработчики прерываний;
+ * ожидающая задача возвращается в очередь своего исполнителя.
+ * Исполнитель разбирается из цикла простоя (async_idle_executor)
+ * или собственным потоком (async_executor_thread). Задачи выполняются
+ * в контексте исполнителя и не должны блокироваться.
+ */
+
+#ifndef KERNEL_ASYNC_H
+#define KERNEL_ASYNC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../sync/waitqueue.h"
+
+/* Результат шага задачи */
+#define ASYNC_PENDING 0   /* Задача ждет и продолжит позже */
+#define ASYNC_DONE    1   /* Задача завершена */
+
+/* Задач за один проход исполнителя из простоя */
+#define ASYNC_IDLE_BUDGET 32
+
+/**
+ * @brief Состояние задачи
+ */
+typedef enum {
+    ASYNC_TASK_NEW,       /* Создана, еще не запускалась */
+    ASYNC_TASK_QUEUED,    /* В очереди исполнителя */
+    ASYNC_TASK_RUNNING,   /* Выполняется шаг */
+    ASYNC_TASK_WAITING,   /* Ждет пробуждения */
+    ASYNC_TASK_FINISHED   /* Завершена */
+} async_task_state_t;
+
+typedef struct async_task async_task_t;
+typedef struct async_executor async_executor_t;
+
+/**
+ * @brief Шаг задачи
+ * @return ASYNC_PENDING или ASYNC_DONE
+ */
+typedef int (*async_fn_t)(async_task_t *task);
+
+/**
+ * @brief Будущее: результат операции, который появится позже
+ */
+typedef struct {
+    volatile uint32_t done;           /* Результат готов */
+    int32_t result;                   /* Значение результата */
+    async_task_t * volatile waiter;   /* Задача, ожидающая результата */
+} async_future_t;
+
+/**
+ * @brief Задача
+ */
+struct async_task {
+    async_fn_t fn;                    /* Шаг задачи */
+    async_executor_t *executor;       /* Исполнитель задачи */
+    async_task_t *next;               /* Следующая в очереди исполнителя */
+    async_future_t *finished;         /* Завершить по окончании (или NULL) */
+    uint16_t resume;                  /* Точка продолжения (строка) */
+    volatile uint8_t state;           /* async_task_state_t */
+    volatile uint8_t woken;           /* Пробуждена во время шага */
+};
+
+/**
+ * @brief Исполнитель задач
+ */
+struct async_executor {
+    const char *name;
+    wait_queue_t wq;                  /* Блокировка очереди и сон потока */
+    async_task_t *head;               /* Готовые задачи */
+    async_task_t *tail;
+    volatile uint32_t polling;        /* Очередь разбирает один процессор */
+    int from_idle;                    /* Разбирается из цикла простоя */
+    uint32_t spawned;                 /* Запущено задач */
+    uint32_t finished;                /* Завершено задач */
+    uint32_t polls;                   /* Выполнено шагов */
+    uint32_t wakeups;                 /* Пробуждений ожидающих задач */
+};
+
+/* Статический инициализатор */
+#define ASYNC_EXECUTOR_INIT(exec_name, idle) \
+    { exec_name, WAIT_QUEUE_INIT, NULL, NULL, 0, idle, 0, 0, 0, 0 }
+
+/* Исполнитель цикла простоя */
+extern async_executor_t async_idle_executor;
+
+/**
+ * @brief Начало тела задачи
+ */
+#define ASYNC_BEGIN(task) switch ((task)->resume) { case 0:
+
+/**
+ * @brief Конец тела задачи
+ */
+#define ASYNC_END(task) } (task)->resume = 0; return ASYNC_DONE
+
+/**
+ * @brief Ожидание завершения будущего
+ *
+ * Если результат еще не готов, задача уступает исполнитель и
+ * продолжит с этой точки, когда будущее завершится.
+ */
+#define ASYNC_AWAIT(task, future)                       \
+    do {                                                \
+        (task)->resume = __LINE__;                      \
+        __attribute__((fallthrough));                   \
+        case __LINE__:                                  \
+        if (!async_future_poll((future), (task))) {     \
+            return ASYNC_PENDING;                       \
+        }                                               \
+    } while (0)
+
+/**
+ * @brief Уступить исполнитель другим задачам
+ */
+#define ASYNC_YIELD(task)                               \
+    do {                                                \
+        (task)->resume = __LINE__;                      \
+        async_wake(task);                               \
+        return ASYNC_PENDING;                           \
+        case __LINE__:;                                 \
+    } while (0)
+
+/**
+ * @brief Подготовка исполнителя
+ * @param exec Исполнитель
+ * @param name Имя для статистики
+ * @param from_idle 1 - исполнитель разбирается из цикла простоя
+ */
+void async_executor_init(async_executor_t *exec, const char *name, int from_idle);
+
+/**
+ * @brief Выполнение готовых задач
+ * @param exec Исполнитель
+ * @param budget Максимум шагов
+ * @return Количество выполненных шагов
+ *
+ * Если очередь уже разбирает другой процессор, ничего не делает.
+ */
+uint32_t async_run(async_executor_t *exec, uint32_t budget);
+
+/**
+ * @brief Есть ли готовые задачи у исполнителя простоя
+ *
+ * Проверяется в простое перед hlt с запрещенными прерываниями.
+ */
+static inline int async_idle_pending(void) {
+    return async_idle_executor.head != NULL;
+}
+
+/**
+ * @brief Поток исполнителя (аргумент - async_executor_t*)
+ *
+ * Разбирает очередь и спит в очереди ожидания исполнителя,
+ * пока задач нет. Запускается через kthread_create().
+ */
+void async_executor_thread(void *arg);
+
+/**
+ * @brief Запуск задачи
+ * @param exec Исполнитель
+ * @param task Задача (память - у вызывающего)
+ * @param fn Шаг задачи
+ * @param finished Будущее, завершаемое по окончании (или NULL)
+ * @return 0 при успехе, -1 если задача еще не завершена
+ */
+int async_spawn(async_executor_t *exec, async_task_t *task, async_fn_t fn,
+                async_future_t *finished);
+
+/**
+ * @brief Возврат ожидающей задачи в очередь исполнителя
+ *
+ * Можно вызывать из обработчиков прерываний и с любого процессора.
+ */
+void async_wake(async_task_t *task);
+
+/**
+ * @brief Подготовка будущего к новой операции
+ */
+static inline void async_future_init(async_future_t *future) {
+    future->done = 0;
+    future->result = 0;
+    future->waiter = NULL;
+}
+
+/**
+ * @brief Готов ли результат
+ */
+static inline int async_future_done(const async_future_t *future) {
+    return future->done;
+}
+
+/**
+ * @brief Проверка будущего с подпиской задачи на его завершение
+ * @return 1 если результат готов
+ */
+int async_future_poll(async_future_t *future, async_task_t *task);
+
+/**
+ * @brief Завершение будущего
+ * @param future Будущее
+ * @param result Результат операции
+ *
+ * Можно вызывать из обработчиков прерываний.
+ */
+void async_future_complete(async_future_t *future, int32_t result);
+
+/**
+ * @brief Вывод статистики исполнителя
+ */
+void async_dump_stats(async_executor_t *exec);
+
+/**
+ * @brief Проверка исполнителя и стоимости задач (async_test.c)
+ */
+void run_async_tests(void);
+
+#endif /* KERNEL_ASYNC_H */
@@ -0,0 +1,213 @@
+/**
+ * @file async_test.c
+ * @brief Проверка исполнителя: тысяча одновременных операций
+ *
+ * Модель устройства - периодический hrtimer, который в прерывании
+ * завершает все поданные к этому моменту запросы. Каждая задача
+ * несколько раз подает запрос и ждет его будущего, так что
+ * одновременно в полете оказываются все задачи сразу. Прогон
+ * выполняется на исполнителе простоя и на исполнителе с потоком.
+ */
+
+#include "async.h"
+#include "../memory/memory.h"
+#include "../sched/sched.h"
+#include "../sync/spinlock.h"
+#include "../time/hrtimer.h"
+#include "../lib/math64.h"
+#include "../video/video.h"
+#include <stddef.h>
+
+/* Одновременных задач и запросов на задачу */
+#define ASYNC_TEST_TASKS  1000
+#define ASYNC_TEST_ROUNDS 4
+
+/* Очередь запросов устройства (степень двойки, не меньше числа задач) */
+#define ASYNC_TEST_RING 1024
+
+/* Период обработки запросов устройством */
+#define ASYNC_TEST_PERIOD_NS (100 * NSEC_PER_USEC)
+
+/* Предельное время прогона */
+#define ASYNC_TEST_TIMEOUT_NS (5ULL * NSEC_PER_SEC)
+
+/**
+ * @brief Операция: задача и будущее ее текущего запроса
+ */
+typedef struct {
+    async_task_t task;
+    async_future_t io;
+    uint32_t round;
+} async_test_op_t;
+
+static async_future_t *device_ring[ASYNC_TEST_RING];
+static uint32_t device_head;
+static uint32_t device_tail;
+static spinlock_t device_lock = SPINLOCK_INIT;
+static hrtimer_t device_timer;
+static volatile int device_running;
+static volatile uint32_t device_completed;
+
+static volatile uint32_t test_done;
+
+/* Исполнитель с собственным потоком (поток создается один раз) */
+static async_executor_t test_executor;
+static int test_executor_started;
+
+/**
+ * @brief Подача запроса устройству
+ */
+static void async_test_submit(async_future_t *io) {
+    async_future_init(io);
+    
+    uint32_t flags = spin_lock_irqsave(&device_lock);
+    device_ring[device_head % ASYNC_TEST_RING] = io;
+    device_head++;
+    spin_unlock_irqrestore(&device_lock, flags);
+}
+
+/**
+ * @brief Прерывание устройства: завершение поданных запросов
+ */
+static void async_test_device_fn(hrtimer_t *timer, void *ctx) {
+    (void)ctx;
+    
+    spin_lock(&device_lock);
+    while (device_tail != device_head) {
+        async_future_t *io = device_ring[device_tail % ASYNC_TEST_RING];
+        device_tail++;
+        device_completed++;
+        async_future_complete(io, 0);
+    }
+    spin_unlock(&device_lock);
+    
+    if (device_running) {
+        uint64_t next = timer->expires_ns + ASYNC_TEST_PERIOD_NS;
+        uint64_t now = hrtimer_now_ns();
+        hrtimer_start_abs(timer, next > now ? next : now + ASYNC_TEST_PERIOD_NS);
+    }
+}
+
+/**
+ * @brief Шаг операции: ASYNC_TEST_ROUNDS запросов подряд
+ */
+static int async_test_op_fn(async_task_t *task) {
+    async_test_op_t *op = (async_test_op_t*)task;
+    
+    ASYNC_BEGIN(task);
+    
+    for (op->round = 0; op->round < ASYNC_TEST_ROUNDS; op->round++) {
+        async_test_submit(&op->io);
+        ASYNC_AWAIT(task, &op->io);
+    }
+    __sync_fetch_and_add(&test_done, 1);
+    
+    ASYNC_END(task);
+}
+
+/**
+ * @brief Прогон на одном исполнителе
+ */
+static void async_test_run(async_executor_t *exec) {
+    print_string("\n=== Executor '");
+    print_string(exec->name);
+    print_string("' ===\n");
+    
+    async_test_op_t *ops = (async_test_op_t*)kmalloc_flags(ASYNC_TEST_TASKS * sizeof(async_test_op_t),
+                                                              KMALLOC_TAG(HEAP_TAG_TEST));
+    if (!ops) {
+        print_string_color("  Out of memory\n", COLOR_RED, COLOR_BLACK);
+        return;
+    }
+    memory_set(ops, 0, ASYNC_TEST_TASKS * sizeof(async_test_op_t));
+    
+    /* Запросы, оставшиеся от прогона с таймаутом, отбрасываются */
+    uint32_t flags = spin_lock_irqsave(&device_lock);
+    device_head = 0;
+    device_tail = 0;
+    spin_unlock_irqrestore(&device_lock, flags);
+    
+    test_done = 0;
+    device_completed = 0;
+    device_running = 1;
+    hrtimer_start(&device_timer, ASYNC_TEST_PERIOD_NS);
+    
+    uint32_t polls_before = exec->polls;
+    uint64_t start = hrtimer_now_ns();
+    for (uint32_t i = 0; i < ASYNC_TEST_TASKS; i++) {
+        async_spawn(exec, &ops[i].task, async_test_op_fn, NULL);
+    }
+    
+    /* Поток спит - исполнитель простоя получает процессор */
+    while (test_done < ASYNC_TEST_TASKS && hrtimer_now_ns() - start < ASYNC_TEST_TIMEOUT_NS) {
+        sched_sleep_ns(NSEC_PER_MSEC);
+    }
+    uint64_t elapsed = hrtimer_now_ns() - start;
+    
+    device_running = 0;
+    hrtimer_cancel(&device_timer);
+    
+    print_string("  Tasks: ");
+    print_dec(test_done);
+    print_string(" / ");
+    print_dec(ASYNC_TEST_TASKS);
+    if (test_done == ASYNC_TEST_TASKS) {
+        print_string_color(" OK\n", COLOR_GREEN, COLOR_BLACK);
+    } else {
+        print_string_color(" TIMEOUT\n", COLOR_RED, COLOR_BLACK);
+    }
+    print_string("  Requests completed in IRQ: ");
+    print_dec(device_completed);
+    print_string(", task steps: ");
+    print_dec(exec->polls - polls_before);
+    print_string("\n  Elapsed: ");
+    print_dec((uint32_t)div_u64(elapsed, NSEC_PER_USEC));
+    print_string(" us\n");
+    
+    /* Незавершенные задачи еще в очередях - память не освобождаем */
+    if (test_done == ASYNC_TEST_TASKS) {
+        kfree(ops);
+    }
+}
+
+/**
+ * @brief Проверка исполнителя и стоимости задач
+ */
+void run_async_tests(void) {
+    print_string("\n=== Async Executor Tests ===\n");
+    
+    print_string("Per operation: ");
+    print_dec(sizeof(async_test_op_t));
+    print_string(" bytes (task ");
+    print_dec(sizeof(async_task_t));
+    print_string(", future ");
+    print_dec(sizeof(async_future_t));
+    print_string("), kernel thread stack: ");
+    print_dec(KTHREAD_STACK_SIZE);
+    print_string(" bytes\n");
+    
+    if (!sched_running() || !hrtimer_available()) {
+        print_string_color("Scheduler or hrtimer not available, skipping\n", COLOR_RED, COLOR_BLACK);
+        return;
+    }
+    
+    hrtimer_setup(&device_timer, async_test_device_fn, NULL);
+    
+    async_test_run(&async_idle_executor);
+    
+    if (!test_executor_started) {
+        async_executor_init(&test_executor, "thread", 0);
+        test_executor_started = kthread_create(async_executor_thread, &test_executor) != NULL;
+    }
+    if (test_executor_started) {
+        async_test_run(&test_executor);
+    }
+    
+    print_string("\n");
+    async_dump_stats(&async_idle_executor);
+    if (test_executor_started) {
+        async_dump_stats(&test_executor);
+    }
+    
+    print_string_color("\nAsync executor tests completed!\n", COLOR_GREEN, COLOR_BLACK);
+}
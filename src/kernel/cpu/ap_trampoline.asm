@@ -0,0 +1,95 @@
+;;
+;; @file ap_trampoline.asm
+;; @brief Точка входа прикладных процессоров (AP)
+;;
+;; После STARTUP IPI процессор начинает работу в реальном режиме
+;; по адресу вектор * 4 КБ. smp_init() копирует этот код по адресу
+;; AP_TRAMPOLINE_BASE и заполняет параметры в его конце. Код
+;; переходит в защищенный режим на временной GDT с теми же
+;; селекторами, что и у ядра, включает страничную адресацию PAE на
+;; загрузочных таблицах (трамплин в них отображен тождественно, ядро -
+;; в верхнюю половину), устанавливает стек процессора и вызывает
+;; C-функцию входа, которая загружает GDT и таблицы страниц ядра.
+;;
+;; Все абсолютные адреса считаются относительно AP_TRAMPOLINE_BASE,
+;; а не адреса, по которому код скомпонован.
+;;
+
+; Должно совпадать с AP_TRAMPOLINE_BASE в smp.h
+%define AP_TRAMPOLINE_BASE 0x8000
+
+; Адрес метки в скопированном коде
+%define TRAMPOLINE_ADDR(label) (AP_TRAMPOLINE_BASE + ((label) - ap_trampoline_start))
+
+global ap_trampoline_start   ; Начало копируемого кода
+global ap_trampoline_params  ; Параметры: вершина стека, точка входа, CR3
+global ap_trampoline_end     ; Конец копируемого кода
+
+section .text
+
+[bits 16]
+ap_trampoline_start:
+    cli
+    cld
+    xor ax, ax
+    mov ds, ax
+    lgdt [TRAMPOLINE_ADDR(ap_gdt_ptr)]
+
+    ; Включаем защищенный режим
+    mov eax, cr0
+    or eax, 1
+    mov cr0, eax
+
+    ; Дальний переход загружает 32-битный селектор кода
+    jmp dword 0x08:TRAMPOLINE_ADDR(ap_protected_entry)
+
+[bits 32]
+ap_protected_entry:
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    mov ss, ax
+    mov fs, ax
+    mov gs, ax
+
+    ; Страничная адресация PAE на загрузочных таблицах
+    mov eax, cr4
+    or eax, 1 << 5                                        ; CR4.PAE
+    mov cr4, eax
+    mov eax, [TRAMPOLINE_ADDR(ap_trampoline_params) + 8]  ; CR3
+    mov cr3, eax
+    mov eax, cr0
+    or eax, 1 << 31                                       ; CR0.PG
+    mov cr0, eax
+
+    mov esp, [TRAMPOLINE_ADDR(ap_trampoline_params)]      ; Вершина стека
+    mov eax, [TRAMPOLINE_ADDR(ap_trampoline_params) + 4]  ; Точка входа
+    call eax
+
+    ; Точка входа не возвращает управление
+.halt:
+    cli
+    hlt
+    jmp .halt
+
+;
+; Временная GDT: null, код 0x08 и данные 0x10 (плоские, 4 ГБ)
+;
+align 8
+ap_gdt:
+    dq 0
+    dq 0x00CF9A000000FFFF
+    dq 0x00CF92000000FFFF
+ap_gdt_ptr:
+    dw ap_gdt_ptr - ap_gdt - 1
+    dd TRAMPOLINE_ADDR(ap_gdt)
+
+;
+; Параметры запуска (заполняет smp_init перед каждым AP)
+;
+align 4
+ap_trampoline_params:
+    dd 0        ; Вершина стека
+    dd 0        ; Точка входа (void (*)(void))
+    dd 0        ; Физический адрес загрузочной PDPT
+ap_trampoline_end:
@@ -0,0 +1,206 @@
+/**
+ * @file cpu.c
+ * @brief Определение возможностей процессора
+ *
+ * Собирает информацию о загрузочном процессоре через CPUID:
+ * производителя, семейство и модель, флаги возможностей и параметры
+ * кэша последнего уровня.
+ */
+
+#include "cpu.h"
+#include "percpu.h"
+#include "../video/video.h"
+#include "../lib/compiler.h"
+
+/* Информация о загрузочном процессоре */
+cpu_info_t cpu_info;
+
+/* Ассоциативность по коду CPUID.80000006h (0 - неизвестна) */
+static const uint32_t amd_cache_ways[16] = {
+    0, 1, 2, 0, 4, 0, 8, 0, 16, 0, 32, 48, 64, 96, 128, CPU_LLC_FULLY_ASSOC
+};
+
+/* Код 80000006h: параметры кэша описывает лист 8000001Dh */
+#define AMD_CACHE_WAYS_TOPOEXT 9
+
+/**
+ * @brief Поиск кэша последнего уровня в листе детерминированных параметров
+ * @param leaf 4 (Intel) или 8000001Dh (AMD): подлист на кэш, формат общий
+ */
+static void cpu_scan_cache_leaf(uint32_t leaf) {
+    uint32_t eax, ebx, ecx, edx;
+    
+    for (uint32_t i = 0; i < 16; i++) {
+        cpuid(leaf, i, &eax, &ebx, &ecx, &edx);
+        uint32_t type = eax & 0x1F;
+        if (type == 0) {
+            break;
+        }
+        uint32_t level = (eax >> 5) & 0x07;
+        if (type == 2 || level < cpu_info.llc_level) {
+            continue;   /* Кэш команд или уровень ниже найденного */
+        }
+        uint32_t ways = ((ebx >> 22) & 0x3FF) + 1;
+        cpu_info.llc_level = level;
+        cpu_info.llc_ways = (eax & (1 << 9)) ? CPU_LLC_FULLY_ASSOC : ways;
+        cpu_info.llc_line = (ebx & 0xFFF) + 1;
+        cpu_info.llc_size = ways * (((ebx >> 12) & 0x3FF) + 1) *
+                            cpu_info.llc_line * (ecx + 1);
+    }
+}
+
+/**
+ * @brief Параметры кэша последнего уровня
+ *
+ * Intel описывает кэши листом 4 (подлист на кэш), AMD - листом
+ * 80000006h (L2 в ECX, L3 в EDX). Берется кэш данных или общий
+ * кэш самого высокого уровня. Код ассоциативности 9 (Zen) отсылает
+ * к листу 8000001Dh; прочие неизвестные коды дают llc_ways = 0,
+ * и раскраска кадров не включается.
+ */
+static void cpu_detect_llc(void) {
+    uint32_t eax, ebx, ecx, edx;
+    
+    if (cpu_info.max_leaf >= 4) {
+        cpu_scan_cache_leaf(4);
+    }
+    if (cpu_info.llc_level || cpu_info.max_ext_leaf < 0x80000006) {
+        return;
+    }
+    
+    cpuid(0x80000006, 0, &eax, &ebx, &ecx, &edx);
+    uint32_t code;
+    if (edx >> 18) {
+        code = (edx >> 12) & 0x0F;
+        cpu_info.llc_level = 3;
+        cpu_info.llc_size = (edx >> 18) * 512 * 1024;
+        cpu_info.llc_line = edx & 0xFF;
+    } else if (ecx >> 16) {
+        code = (ecx >> 12) & 0x0F;
+        cpu_info.llc_level = 2;
+        cpu_info.llc_size = (ecx >> 16) * 1024;
+        cpu_info.llc_line = ecx & 0xFF;
+    } else {
+        return;
+    }
+    cpu_info.llc_ways = amd_cache_ways[code];
+    
+    if (code == AMD_CACHE_WAYS_TOPOEXT && cpu_info.max_ext_leaf >= 0x8000001D) {
+        /* Лист 8000001Dh перезаписывает параметры, если описывает кэш
+         * того же или более высокого уровня */
+        cpu_scan_cache_leaf(0x8000001D);
+    }
+}
+
+/**
+ * @brief Определение возможностей процессора через CPUID
+ */
+__cold void cpu_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+    
+    print_string("CPU Initialization... ");
+    
+    /* Лист 0: максимальный лист и строка производителя */
+    cpuid(0, 0, &eax, &ebx, &ecx, &edx);
+    cpu_info.max_leaf = eax;
+    *(uint32_t*)&cpu_info.vendor[0] = ebx;
+    *(uint32_t*)&cpu_info.vendor[4] = edx;
+    *(uint32_t*)&cpu_info.vendor[8] = ecx;
+    cpu_info.vendor[12] = '\0';
+    
+    /* Лист 1: сигнатура и флаги возможностей */
+    if (cpu_info.max_leaf >= 1) {
+        cpuid(1, 0, &eax, &ebx, &ecx, &edx);
+        cpu_info.family = (eax >> 8) & 0x0F;
+        cpu_info.model = (eax >> 4) & 0x0F;
+        if (cpu_info.family == 0x0F) {
+            cpu_info.family += (eax >> 20) & 0xFF;
+        }
+        if (cpu_info.family >= 0x06) {
+            cpu_info.model |= ((eax >> 16) & 0x0F) << 4;
+        }
+        cpu_info.features_edx = edx;
+        cpu_info.features_ecx = ecx;
+        cpu_info.apic_id = ebx >> 24;
+    }
+    
+    /* Расширенные листы */
+    cpuid(0x80000000, 0, &eax, &ebx, &ecx, &edx);
+    cpu_info.max_ext_leaf = eax;
+    if (cpu_info.max_ext_leaf >= 0x80000001) {
+        cpuid(0x80000001, 0, &eax, &ebx, &ecx, &edx);
+        cpu_info.ext_edx = edx;
+    }
+    if (cpu_info.max_ext_leaf >= 0x80000007) {
+        cpuid(0x80000007, 0, &eax, &ebx, &ecx, &edx);
+        cpu_info.apm_edx = edx;
+    }
+    cpu_detect_llc();
+    
+    cpu_enable_sse();
+    
+    print_string_color("OK\n", COLOR_GREEN, COLOR_BLACK);
+    print_string("  - Vendor: ");
+    print_string(cpu_info.vendor);
+    print_string("\n  - Family/Model: ");
+    print_hex(cpu_info.family);
+    print_string("/");
+    print_hex(cpu_info.model);
+    print_string("\n");
+    if (cpu_info.llc_level) {
+        print_string("  - LLC: L");
+        print_dec(cpu_info.llc_level);
+        print_string(", ");
+        print_dec(cpu_info.llc_size >> 10);
+        print_string(" KB, ");
+        if (cpu_info.llc_ways == CPU_LLC_FULLY_ASSOC) {
+            print_string("fully associative, ");
+        } else if (cpu_info.llc_ways) {
+            print_dec(cpu_info.llc_ways);
+            print_string("-way, ");
+        } else {
+            print_string("unknown associativity, ");
+        }
+        print_dec(cpu_info.llc_line);
+        print_string(" B lines\n");
+    }
+}
+
+/**
+ * @brief Разрешение инструкций SSE на текущем процессоре
+ */
+void cpu_enable_sse(void) {
+    if (!cpu_has_edx(CPUID_EDX_SSE) || !cpu_has_edx(CPUID_EDX_FXSR)) {
+        return;
+    }
+    write_cr0((read_cr0() & ~CR0_EM) | CR0_MP);
+    write_cr4(read_cr4() | CR4_OSFXSR | CR4_OSXMMEXCPT);
+}
+
+/**
+ * @brief Номер текущего процессора (0..MAX_CPUS-1)
+ *
+ * Логический номер читается из данных процессора через %gs
+ * (см. percpu.h), без обращения к регистрам локального APIC.
+ */
+uint32_t cpu_current(void) {
+    return this_cpu_read(id);
+}
+
+/**
+ * @brief Проверка бита возможностей CPUID.01h:EDX
+ * @param bit Маска CPUID_EDX_*
+ * @return 1 если возможность поддерживается
+ */
+int cpu_has_edx(uint32_t bit) {
+    return (cpu_info.features_edx & bit) != 0;
+}
+
+/**
+ * @brief Проверка бита возможностей CPUID.01h:ECX
+ * @param bit Маска CPUID_ECX_*
+ * @return 1 если возможность поддерживается
+ */
+int cpu_has_ecx(uint32_t bit) {
+    return (cpu_info.features_ecx & bit) != 0;
+}
@@ -0,0 +1,275 @@
+/**
+ * @file cpu.h
+ * @brief Низкоуровневые операции процессора x86
+ *
+ * Обертки над CPUID, MSR, TSC, управлением флагом прерываний
+ * и доступом к регистрам устройств, отображенным в память (MMIO).
+ */
+
+#ifndef KERNEL_CPU_H
+#define KERNEL_CPU_H
+
+#include <stdint.h>
+
+/* Биты CPUID.01h:EDX */
+#define CPUID_EDX_PSE   (1 << 3)   /* Страницы 4 МБ */
+#define CPUID_EDX_TSC   (1 << 4)   /* Счетчик меток времени */
+#define CPUID_EDX_MSR   (1 << 5)   /* Инструкции RDMSR/WRMSR */
+#define CPUID_EDX_PAE   (1 << 6)   /* Физические адреса больше 32 бит */
+#define CPUID_EDX_APIC  (1 << 9)   /* Встроенный локальный APIC */
+#define CPUID_EDX_MTRR  (1 << 12)  /* Регистры типов памяти */
+#define CPUID_EDX_PGE   (1 << 13)  /* Глобальные страницы */
+#define CPUID_EDX_PAT   (1 << 16)  /* Таблица атрибутов страниц */
+#define CPUID_EDX_FXSR  (1 << 24)  /* FXSAVE/FXRSTOR */
+#define CPUID_EDX_SSE   (1 << 25)  /* Регистры XMM */
+
+/* Биты CPUID.01h:ECX */
+#define CPUID_ECX_X2APIC       (1 << 21)
+#define CPUID_ECX_TSC_DEADLINE (1 << 24)
+
+/* Биты CPUID.80000001h:EDX */
+#define CPUID_EXT_EDX_NX (1 << 20)  /* Запрет исполнения (бит 63 элемента PAE) */
+
+/* Биты CPUID.80000007h:EDX */
+#define CPUID_APM_INVARIANT_TSC (1 << 8)   /* TSC не зависит от P/C-состояний */
+
+/* Значение llc_ways для полностью ассоциативного кэша */
+#define CPU_LLC_FULLY_ASSOC 0xFFFFFFFF
+
+/* Максимальное количество процессоров, поддерживаемое ядром */
+#define MAX_CPUS 16
+
+/* Регистр флагов */
+#define EFLAGS_IF (1 << 9)         /* Флаг разрешения прерываний */
+
+/* Управляющие регистры */
+#define CR0_MP  (1 << 1)           /* WAIT учитывает флаг TS */
+#define CR0_EM  (1 << 2)           /* Эмуляция FPU (запрещает SSE) */
+#define CR0_WP  (1 << 16)          /* Защита записи и для ядра */
+#define CR0_PG  (1u << 31)         /* Страничная адресация */
+#define CR4_PSE (1 << 4)           /* Страницы 4 МБ */
+#define CR4_PAE (1 << 5)           /* Трехуровневые таблицы PAE */
+#define CR4_PGE (1 << 7)           /* Глобальные страницы */
+#define CR4_OSFXSR     (1 << 9)    /* Инструкции SSE разрешены */
+#define CR4_OSXMMEXCPT (1 << 10)   /* Исключения SIMD через #XM */
+
+/* Модельно-специфичные регистры */
+#define MSR_APIC_BASE 0x1B
+#define MSR_TSC_DEADLINE 0x6E0
+#define MSR_EFER 0xC0000080
+#define EFER_NXE (1 << 11)         /* Бит запрета исполнения в таблицах */
+
+/**
+ * @brief Информация о процессоре, собранная через CPUID
+ */
+typedef struct {
+    char vendor[13];          /* Строка производителя */
+    uint32_t max_leaf;        /* Максимальный базовый лист CPUID */
+    uint32_t max_ext_leaf;    /* Максимальный расширенный лист CPUID */
+    uint32_t family;          /* Семейство */
+    uint32_t model;           /* Модель */
+    uint32_t features_edx;    /* CPUID.01h:EDX */
+    uint32_t features_ecx;    /* CPUID.01h:ECX */
+    uint32_t ext_edx;         /* CPUID.80000001h:EDX */
+    uint32_t apm_edx;         /* CPUID.80000007h:EDX */
+    uint32_t apic_id;         /* Начальный APIC ID загрузочного процессора */
+    uint32_t llc_level;       /* Уровень кэша последнего уровня (0 - неизвестен) */
+    uint32_t llc_size;        /* Его размер в байтах */
+    uint32_t llc_ways;        /* Ассоциативность (0 - неизвестна) */
+    uint32_t llc_line;        /* Размер строки в байтах */
+} cpu_info_t;
+
+/* Информация о загрузочном процессоре */
+extern cpu_info_t cpu_info;
+
+/**
+ * @brief Выполнение инструкции CPUID
+ * @param leaf Номер листа (EAX)
+ * @param subleaf Номер подлиста (ECX)
+ */
+static inline void cpuid(uint32_t leaf, uint32_t subleaf,
+                         uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx) {
+    __asm__ volatile("cpuid"
+                     : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+                     : "a"(leaf), "c"(subleaf));
+}
+
+/**
+ * @brief Чтение модельно-специфичного регистра
+ * @param msr Номер MSR
+ * @return 64-битное значение регистра
+ */
+static inline uint64_t rdmsr(uint32_t msr) {
+    uint32_t lo, hi;
+    __asm__ volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/**
+ * @brief Запись модельно-специфичного регистра
+ * @param msr Номер MSR
+ * @param value 64-битное значение
+ */
+static inline void wrmsr(uint32_t msr, uint64_t value) {
+    __asm__ volatile("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+/**
+ * @brief Чтение счетчика меток времени (TSC)
+ * @return Количество тактов с момента сброса
+ */
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/**
+ * @brief Чтение управляющих регистров
+ */
+static inline uint32_t read_cr0(void) {
+    uint32_t value;
+    __asm__ volatile("mov %%cr0, %0" : "=r"(value));
+    return value;
+}
+
+static inline uint32_t read_cr2(void) {
+    uint32_t value;
+    __asm__ volatile("mov %%cr2, %0" : "=r"(value));
+    return value;
+}
+
+static inline uint32_t read_cr3(void) {
+    uint32_t value;
+    __asm__ volatile("mov %%cr3, %0" : "=r"(value));
+    return value;
+}
+
+static inline uint32_t read_cr4(void) {
+    uint32_t value;
+    __asm__ volatile("mov %%cr4, %0" : "=r"(value));
+    return value;
+}
+
+/**
+ * @brief Запись управляющих регистров
+ *
+ * Запись в CR3 сбрасывает TLB (кроме глобальных страниц),
+ * поэтому она служит и барьером для компилятора.
+ */
+static inline void write_cr0(uint32_t value) {
+    __asm__ volatile("mov %0, %%cr0" : : "r"(value) : "memory");
+}
+
+static inline void write_cr3(uint32_t value) {
+    __asm__ volatile("mov %0, %%cr3" : : "r"(value) : "memory");
+}
+
+static inline void write_cr4(uint32_t value) {
+    __asm__ volatile("mov %0, %%cr4" : : "r"(value) : "memory");
+}
+
+/**
+ * @brief Сброс элемента TLB для одной страницы
+ * @param addr Виртуальный адрес внутри страницы
+ */
+static inline void invlpg(uint32_t addr) {
+    __asm__ volatile("invlpg (%0)" : : "r"(addr) : "memory");
+}
+
+/**
+ * @brief Начало участка с запрещенными прерываниями (idt/irq_profile.c)
+ * @param file Файл, где прерывания запрещены
+ * @param line Строка
+ */
+void irqoff_begin(const char *file, uint32_t line);
+
+/**
+ * @brief Конец участка с запрещенными прерываниями
+ */
+void irqoff_end(void);
+
+/**
+ * @brief Запрет прерываний с сохранением предыдущего состояния
+ * @param file Место вызова (подставляется макросом cpu_irq_save)
+ * @param line Строка места вызова
+ * @return Значение EFLAGS до запрета
+ *
+ * Если прерывания были разрешены, начинается учитываемый участок.
+ */
+static inline uint32_t cpu_irq_save_at(const char *file, uint32_t line) {
+    uint32_t flags;
+    __asm__ volatile("pushf; pop %0; cli" : "=r"(flags) : : "memory");
+    if (flags & EFLAGS_IF) {
+        irqoff_begin(file, line);
+    }
+    return flags;
+}
+
+/**
+ * @brief Запрет прерываний с сохранением предыдущего состояния
+ * @return Значение EFLAGS до запрета
+ */
+#define cpu_irq_save() cpu_irq_save_at(__FILE__, __LINE__)
+
+/**
+ * @brief Восстановление состояния прерываний
+ * @param flags Значение, возвращенное cpu_irq_save()
+ */
+static inline void cpu_irq_restore(uint32_t flags) {
+    if (flags & EFLAGS_IF) {
+        irqoff_end();
+        __asm__ volatile("sti" : : : "memory");
+    }
+}
+
+/**
+ * @brief Чтение 32-битного регистра устройства, отображенного в память
+ * @param addr Адрес регистра
+ */
+static inline uint32_t mmio_read32(uintptr_t addr) {
+    return *(volatile uint32_t*)addr;
+}
+
+/**
+ * @brief Запись 32-битного регистра устройства, отображенного в память
+ * @param addr Адрес регистра
+ * @param value Значение
+ */
+static inline void mmio_write32(uintptr_t addr, uint32_t value) {
+    *(volatile uint32_t*)addr = value;
+}
+
+/**
+ * @brief Определение возможностей процессора через CPUID
+ */
+void cpu_init(void);
+
+/**
+ * @brief Разрешение инструкций SSE на текущем процессоре
+ *
+ * Состояние XMM не сохраняется при переключении потоков: регистры
+ * использует только ядро, с запрещенными прерываниями (video/fb.c).
+ */
+void cpu_enable_sse(void);
+
+/**
+ * @brief Номер текущего процессора (0..MAX_CPUS-1)
+ */
+uint32_t cpu_current(void);
+
+/**
+ * @brief Проверка бита возможностей CPUID.01h:EDX
+ * @param bit Маска CPUID_EDX_*
+ * @return 1 если возможность поддерживается
+ */
+int cpu_has_edx(uint32_t bit);
+
+/**
+ * @brief Проверка бита возможностей CPUID.01h:ECX
+ * @param bit Маска CPUID_ECX_*
+ * @return 1 если возможность поддерживается
+ */
+int cpu_has_ecx(uint32_t bit);
+
+#endif /* KERNEL_CPU_H */
@@ -0,0 +1,93 @@
+/**
+ * @file gdt.c
+ * @brief Глобальная таблица дескрипторов (GDT)
+ *
+ * До появления собственной таблицы ядро работало на GDT загрузчика.
+ * Собственная таблица нужна для сегментов данных процессоров:
+ * база каждого указывает на cpu_locals[cpu].
+ */
+
+#include "gdt.h"
+#include "percpu.h"
+
+/**
+ * @brief Дескриптор сегмента
+ */
+typedef struct {
+    uint16_t limit_low;
+    uint16_t base_low;
+    uint8_t base_mid;
+    uint8_t access;
+    uint8_t granularity;        /* Старшие биты лимита и флаги */
+    uint8_t base_high;
+} __attribute__((packed)) gdt_entry_t;
+
+/**
+ * @brief Операнд инструкции LGDT
+ */
+typedef struct {
+    uint16_t limit;
+    uint32_t base;
+} __attribute__((packed)) gdt_ptr_t;
+
+/* Байты доступа: присутствует, DPL 0, код (чтение) или данные (запись) */
+#define GDT_ACCESS_CODE 0x9A
+#define GDT_ACCESS_DATA 0x92
+
+/* Флаги: гранулярность 4 КБ и 32-битный сегмент */
+#define GDT_FLAGS_4K_32 0xC0
+#define GDT_FLAGS_32    0x40
+
+static gdt_entry_t gdt[GDT_ENTRIES];
+static gdt_ptr_t gdt_ptr;
+
+/**
+ * @brief Заполнение дескриптора
+ */
+static void gdt_set_entry(uint32_t n, uint32_t base, uint32_t limit, uint8_t access, uint8_t flags) {
+    gdt[n].limit_low = limit & 0xFFFF;
+    gdt[n].base_low = base & 0xFFFF;
+    gdt[n].base_mid = (base >> 16) & 0xFF;
+    gdt[n].access = access;
+    gdt[n].granularity = ((limit >> 16) & 0x0F) | flags;
+    gdt[n].base_high = (base >> 24) & 0xFF;
+}
+
+/**
+ * @brief Заполнение GDT
+ */
+void gdt_init(void) {
+    gdt_set_entry(0, 0, 0, 0, 0);
+    gdt_set_entry(GDT_KERNEL_CODE >> 3, 0, 0xFFFFF, GDT_ACCESS_CODE, GDT_FLAGS_4K_32);
+    gdt_set_entry(GDT_KERNEL_DATA >> 3, 0, 0xFFFFF, GDT_ACCESS_DATA, GDT_FLAGS_4K_32);
+    
+    /* Сегменты процессоров с байтовой гранулярностью: выход
+     * за пределы cpu_local_t дает #GP, а не чужие данные */
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        gdt_set_entry(GDT_PERCPU_FIRST + cpu, (uint32_t)&cpu_locals[cpu],
+                      sizeof(cpu_local_t) - 1, GDT_ACCESS_DATA, GDT_FLAGS_32);
+    }
+    
+    gdt_ptr.limit = sizeof(gdt) - 1;
+    gdt_ptr.base = (uint32_t)gdt;
+}
+
+/**
+ * @brief Загрузка GDT на текущем процессоре
+ */
+void gdt_load(uint32_t cpu) {
+    uint16_t percpu_selector = GDT_PERCPU_SELECTOR(cpu);
+    
+    __asm__ volatile("lgdt %0\n\t"
+                     "ljmp %1, $1f\n"
+                     "1:\n\t"
+                     "movw %2, %%ax\n\t"
+                     "movw %%ax, %%ds\n\t"
+                     "movw %%ax, %%es\n\t"
+                     "movw %%ax, %%ss\n\t"
+                     "movw %%ax, %%fs\n\t"
+                     "movw %3, %%gs"
+                     :
+                     : "m"(gdt_ptr), "i"(GDT_KERNEL_CODE), "i"(GDT_KERNEL_DATA), "r"(percpu_selector)
+                     : "eax", "memory");
+}
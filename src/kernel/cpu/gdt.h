@@ -0,0 +1,41 @@
+/**
+ * @file gdt.h
+ * @brief Глобальная таблица дескрипторов (GDT)
+ *
+ * Плоские сегменты кода и данных ядра (те же селекторы, что
+ * оставляет загрузчик) и по одному сегменту данных на процессор
+ * для адресации его cpu_local_t через %gs.
+ */
+
+#ifndef KERNEL_GDT_H
+#define KERNEL_GDT_H
+
+#include <stdint.h>
+#include "cpu.h"
+
+/* Селекторы ядра */
+#define GDT_KERNEL_CODE 0x08
+#define GDT_KERNEL_DATA 0x10
+
+/* Первый дескриптор данных процессоров и селектор процессора */
+#define GDT_PERCPU_FIRST 3
+#define GDT_PERCPU_SELECTOR(cpu) ((GDT_PERCPU_FIRST + (cpu)) << 3)
+
+/* Количество дескрипторов */
+#define GDT_ENTRIES (GDT_PERCPU_FIRST + MAX_CPUS)
+
+/**
+ * @brief Заполнение GDT
+ */
+void gdt_init(void);
+
+/**
+ * @brief Загрузка GDT на текущем процессоре
+ * @param cpu Логический номер процессора (выбирает сегмент %gs)
+ *
+ * Перезагружает CS дальним переходом, остальные сегментные
+ * регистры - селектором данных ядра.
+ */
+void gdt_load(uint32_t cpu);
+
+#endif /* KERNEL_GDT_H */
@@ -0,0 +1,27 @@
+/**
+ * @file percpu.c
+ * @brief Данные процессоров
+ */
+
+#include "percpu.h"
+#include "gdt.h"
+#include "../lib/compiler.h"
+
+/* Данные всех процессоров */
+cpu_local_t cpu_locals[MAX_CPUS];
+
+/**
+ * @brief Подготовка данных процессоров и GDT загрузочного процессора
+ */
+__cold void percpu_init(void) {
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        cpu_locals[cpu].self = &cpu_locals[cpu];
+        cpu_locals[cpu].id = cpu;
+    }
+    
+    /* Загрузочный процессор всегда имеет номер 0 */
+    cpu_locals[0].online = 1;
+    
+    gdt_init();
+    gdt_load(0);
+}
@@ -0,0 +1,83 @@
+/**
+ * @file percpu.h
+ * @brief Данные процессора, адресуемые через сегмент %gs
+ *
+ * У каждого процессора свой дескриптор в GDT, база которого указывает
+ * на его cpu_local_t; селектор загружен в %gs. Поэтому номер текущего
+ * процессора и его данные читаются одной инструкцией, без обращения
+ * к локальному APIC и без таблиц соответствия APIC ID.
+ */
+
+#ifndef KERNEL_PERCPU_H
+#define KERNEL_PERCPU_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "cpu.h"
+
+/**
+ * @brief Данные процессора
+ *
+ * Поля, доступные через this_cpu_read()/this_cpu_write(),
+ * должны иметь размер 32 бита. Структура занимает отдельную
+ * строку кэша, чтобы записи разных процессоров не мешали друг другу.
+ */
+typedef struct cpu_local {
+    struct cpu_local *self;     /* Адрес этой структуры (%gs:0) */
+    uint32_t id;                /* Логический номер процессора */
+    uint32_t apic_id;           /* APIC ID */
+    uint32_t stack_top;         /* Вершина стека (0 - стек boot.asm) */
+    volatile uint32_t online;   /* Процессор запущен */
+    uint32_t boot_us;           /* Время запуска AP в микросекундах */
+    uint32_t node;              /* Узел NUMA (memory/numa.h) */
+} __attribute__((aligned(64))) cpu_local_t;
+
+/* Данные всех процессоров */
+extern cpu_local_t cpu_locals[MAX_CPUS];
+
+/**
+ * @brief Чтение 32-битного поля данных текущего процессора
+ * @param field Имя поля cpu_local_t
+ */
+#define this_cpu_read(field) ({                                         \
+    __typeof__(((cpu_local_t*)0)->field) __val;                         \
+    __asm__ volatile("movl %%gs:%c1, %0"                                \
+                     : "=r"(__val)                                      \
+                     : "i"(offsetof(cpu_local_t, field)));              \
+    __val;                                                              \
+})
+
+/**
+ * @brief Запись 32-битного поля данных текущего процессора
+ * @param field Имя поля cpu_local_t
+ * @param value Новое значение
+ */
+#define this_cpu_write(field, value)                                    \
+    __asm__ volatile("movl %0, %%gs:%c1"                                \
+                     :                                                  \
+                     : "ri"((uint32_t)(value)),                         \
+                       "i"(offsetof(cpu_local_t, field))                \
+                     : "memory")
+
+/**
+ * @brief Указатель на данные текущего процессора
+ */
+#define this_cpu_ptr() this_cpu_read(self)
+
+/**
+ * @brief Подготовка данных процессоров и GDT загрузочного процессора
+ *
+ * Вызывается первой в kmain(): до нее %gs не указывает на данные
+ * процессора, и cpu_current() использовать нельзя.
+ */
+void percpu_init(void);
+
+/**
+ * @brief Данные процессора по логическому номеру
+ * @param cpu Номер процессора
+ */
+static inline cpu_local_t* cpu_local(uint32_t cpu) {
+    return &cpu_locals[cpu];
+}
+
+#endif /* KERNEL_PERCPU_H */
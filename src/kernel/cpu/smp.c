@@ -0,0 +1,232 @@
+/**
+ * @file smp.c
+ * @brief Запуск прикладных процессоров (SMP)
+ *
+ * Процессоры запускаются по одному: трамплин и его параметры общие.
+ * Загрузочный процессор посылает INIT, ждет 10 мс, затем дважды
+ * STARTUP с паузой 200 мкс (рекомендация Intel SDM) и ждет, пока AP
+ * не отметится в своих данных. Время от INIT до этой отметки
+ * выводится в отчете.
+ */
+
+#include "smp.h"
+#include "cpu.h"
+#include "gdt.h"
+#include "percpu.h"
+#include "tsc.h"
+#include "../acpi/acpi.h"
+#include "../apic/apic.h"
+#include "../drivers/pit.h"
+#include "../idt/idt.h"
+#include "../lib/math64.h"
+#include "../memory/memory.h"
+#include "../memory/numa.h"
+#include "../memory/vmm.h"
+#include "../sched/sched.h"
+#include "../time/hrtimer.h"
+#include "../video/video.h"
+#include "../lib/compiler.h"
+
+/* Трамплин (ap_trampoline.asm) */
+extern uint8_t ap_trampoline_start[];
+extern uint8_t ap_trampoline_params[];
+extern uint8_t ap_trampoline_end[];
+
+/* Загрузочные таблицы страниц (boot.asm): отображают трамплин тождественно */
+extern uint64_t boot_pdpt[];
+
+/**
+ * @brief Параметры трамплина (конец ap_trampoline.asm)
+ */
+typedef struct {
+    uint32_t stack_top;
+    uint32_t entry;
+    uint32_t cr3;             /* Физический адрес загрузочной PDPT */
+} __attribute__((packed)) ap_trampoline_params_t;
+
+/* Процессор, который запускается сейчас */
+static cpu_local_t * volatile smp_booting = 0;
+
+/* Количество запущенных процессоров */
+static uint32_t cpus_online = 1;
+
+/**
+ * @brief Активное ожидание в микросекундах
+ *
+ * Прерывания на AP не направлены, а таймеры загрузочного процессора
+ * могут быть еще не откалиброваны, поэтому ожидание - по TSC
+ * или, без него, по PIT.
+ */
+static void smp_delay_us(uint32_t us) {
+    if (tsc_available()) {
+        uint64_t end = rdtsc() + tsc_ns_to_cycles((uint64_t)us * NSEC_PER_USEC);
+        while (rdtsc() < end) {
+            __asm__ volatile("pause");
+        }
+    } else {
+        pit_sleep_us(us);
+    }
+}
+
+/**
+ * @brief Цикл простоя прикладного процессора
+ */
+static void smp_ap_idle(void) __attribute__((noreturn));
+static void smp_ap_idle(void) {
+    while (1) {
+        __asm__ volatile("sti; hlt");
+    }
+}
+
+/**
+ * @brief C-точка входа прикладного процессора
+ *
+ * Вызывается трамплином на стеке из PMM с запрещенными прерываниями
+ * на загрузочных таблицах страниц; vmm_init_ap() переводит процессор
+ * на таблицы ядра.
+ */
+static void smp_ap_entry(void) {
+    cpu_local_t *cpu = smp_booting;
+    
+    /* GDT ядра и сегмент %gs этого процессора */
+    gdt_load(cpu->id);
+    idt_load_cpu();
+    vmm_init_ap();
+    cpu_enable_sse();
+    
+    lapic_enable();
+    if (lapic_timer_available()) {
+        lapic_timer_setup_cpu();
+    }
+    
+    /* Отметка видна загрузочному процессору после всех записей выше */
+    __asm__ volatile("" : : : "memory");
+    this_cpu_write(online, 1);
+    
+    /* Тик планировщика на AP дает только собственный LAPIC-таймер */
+    if (sched_running() && lapic_timer_available()) {
+        sched_ap_start();
+    }
+    smp_ap_idle();
+}
+
+/**
+ * @brief Запуск одного прикладного процессора
+ * @param cpu Данные процессора (id и apic_id заполнены)
+ * @return 1 если процессор отметился в отведенное время
+ */
+static int smp_boot_ap(cpu_local_t *cpu) {
+    uint32_t stack = pmm_alloc_pages(SMP_AP_STACK_PAGES);
+    if (!stack) {
+        return 0;
+    }
+    cpu->stack_top = (uint32_t)phys_to_virt(stack) + SMP_AP_STACK_PAGES * PAGE_SIZE;
+    
+    ap_trampoline_params_t *params = (ap_trampoline_params_t*)phys_to_virt(AP_TRAMPOLINE_BASE +
+        (ap_trampoline_params - ap_trampoline_start));
+    params->stack_top = cpu->stack_top;
+    params->entry = (uint32_t)smp_ap_entry;
+    params->cr3 = (uint32_t)boot_pdpt;
+    smp_booting = cpu;
+    
+    uint64_t start = hrtimer_now_ns();
+    
+    /* INIT, затем два STARTUP с вектором - номером страницы трамплина */
+    lapic_send_ipi(cpu->apic_id, LAPIC_ICR_INIT | LAPIC_ICR_LEVEL_ASSERT);
+    smp_delay_us(10000);
+    
+    for (int attempt = 0; attempt < 2 && !cpu->online; attempt++) {
+        lapic_send_ipi(cpu->apic_id, LAPIC_ICR_STARTUP | (AP_TRAMPOLINE_BASE >> 12));
+        smp_delay_us(200);
+    }
+    
+    for (uint32_t waited = 0; !cpu->online && waited < SMP_AP_BOOT_TIMEOUT_MS * 10; waited++) {
+        smp_delay_us(100);
+    }
+    
+    if (!cpu->online) {
+        /* Стек не освобождаем: процессор может проснуться позже */
+        return 0;
+    }
+    
+    cpu->boot_us = (uint32_t)div_u64(hrtimer_now_ns() - start, NSEC_PER_USEC);
+    return 1;
+}
+
+/**
+ * @brief Запуск всех прикладных процессоров
+ */
+__cold void smp_init(void) {
+    print_string("SMP Initialization... ");
+    
+    cpu_locals[0].apic_id = apic_enabled() ? lapic_id() : cpu_info.apic_id;
+    cpu_locals[0].node = numa_node_of_apic(cpu_locals[0].apic_id);
+    
+    if (!apic_enabled() || acpi_madt.cpu_count < 2) {
+        print_string_color("NOT AVAILABLE", COLOR_BROWN, COLOR_BLACK);
+        print_string(" (single CPU)\n");
+        return;
+    }
+    
+    /* Трамплин лежит в нижнем мегабайте, который PMM не выдает */
+    memory_copy(phys_to_virt(AP_TRAMPOLINE_BASE), ap_trampoline_start,
+                ap_trampoline_end - ap_trampoline_start);
+    
+    uint32_t next_id = 1;
+    uint32_t failed = 0;
+    
+    for (uint32_t i = 0; i < acpi_madt.cpu_count && next_id < MAX_CPUS; i++) {
+        uint8_t apic_id = acpi_madt.cpu_apic_ids[i];
+        if (apic_id == cpu_locals[0].apic_id) {
+            continue;
+        }
+        
+        cpu_local_t *cpu = &cpu_locals[next_id];
+        cpu->apic_id = apic_id;
+        cpu->node = numa_node_of_apic(apic_id);
+        
+        if (smp_boot_ap(cpu)) {
+            next_id++;
+            cpus_online++;
+        } else {
+            failed++;
+        }
+    }
+    smp_booting = 0;
+    
+    print_string_color("OK\n", COLOR_GREEN, COLOR_BLACK);
+    print_string("  - CPUs online: ");
+    print_dec(cpus_online);
+    print_string(" of ");
+    print_dec(acpi_madt.cpu_count);
+    print_string("\n");
+    
+    for (uint32_t cpu = 1; cpu < cpus_online; cpu++) {
+        print_string("  - CPU ");
+        print_dec(cpu);
+        print_string(" (APIC ID ");
+        print_dec(cpu_locals[cpu].apic_id);
+        print_string("): online in ");
+        print_dec(cpu_locals[cpu].boot_us);
+        print_string(" us\n");
+    }
+    if (failed) {
+        print_string_color("  - Failed to start: ", COLOR_RED, COLOR_BLACK);
+        print_dec(failed);
+        print_string("\n");
+    }
+}
+
+/**
+ * @brief Количество запущенных процессоров
+ */
+uint32_t smp_cpu_count(void) {
+    return cpus_online;
+}
+
+/**
+ * @brief Проверка, запущен ли процессор
+ */
+int smp_cpu_online(uint32_t cpu) {
+    return cpu < MAX_CPUS && cpu_locals[cpu].online;
+}
@@ -0,0 +1,44 @@
+/**
+ * @file smp.h
+ * @brief Запуск прикладных процессоров (SMP)
+ *
+ * Процессоры из MADT запускаются последовательностью INIT-SIPI-SIPI
+ * через код-трамплин в нижнем мегабайте (ap_trampoline.asm).
+ * Каждый AP получает стек из PMM, свой сегмент %gs и уходит
+ * в цикл простоя.
+ */
+
+#ifndef KERNEL_SMP_H
+#define KERNEL_SMP_H
+
+#include <stdint.h>
+
+/* Физический адрес трамплина (вектор SIPI = адрес / 4 КБ) */
+#define AP_TRAMPOLINE_BASE 0x8000
+
+/* Размер стека прикладного процессора в страницах */
+#define SMP_AP_STACK_PAGES 4
+
+/* Сколько ждать запуска одного AP (мс) */
+#define SMP_AP_BOOT_TIMEOUT_MS 100
+
+/**
+ * @brief Запуск всех прикладных процессоров
+ *
+ * Вызывается после apic_init() и pmm_init(). Без APIC
+ * или при одном процессоре в MADT ничего не делает.
+ */
+void smp_init(void);
+
+/**
+ * @brief Количество запущенных процессоров (включая загрузочный)
+ */
+uint32_t smp_cpu_count(void);
+
+/**
+ * @brief Проверка, запущен ли процессор
+ * @param cpu Логический номер процессора
+ */
+int smp_cpu_online(uint32_t cpu);
+
+#endif /* KERNEL_SMP_H */
@@ -0,0 +1,84 @@
+/**
+ * @file tsc.c
+ * @brief Калибровка и использование счетчика меток времени (TSC)
+ */
+
+#include "tsc.h"
+#include "cpu.h"
+#include "../lib/math64.h"
+#include "../drivers/pit.h"
+#include "../video/video.h"
+#include "../lib/compiler.h"
+
+/* Частота TSC в кГц (0 - не откалиброван) */
+uint32_t tsc_khz = 0;
+
+/* Значение TSC в момент калибровки (начало отсчета tsc_now_ns) */
+static uint64_t tsc_base = 0;
+
+/**
+ * @brief Калибровка частоты TSC
+ *
+ * Измеряет количество тактов TSC за PIT_CALIBRATE_MS миллисекунд,
+ * отсчитанных каналом 2 PIT в режиме опроса.
+ */
+__cold void tsc_init(void) {
+    print_string("TSC Calibration... ");
+    
+    if (!cpu_has_edx(CPUID_EDX_TSC)) {
+        print_string_color("NOT AVAILABLE\n", COLOR_BROWN, COLOR_BLACK);
+        return;
+    }
+    
+    uint32_t flags = cpu_irq_save();
+    pit_ch2_start(PIT_CALIBRATE_COUNTS);
+    uint64_t start = rdtsc();
+    while (!pit_ch2_expired());
+    uint64_t end = rdtsc();
+    cpu_irq_restore(flags);
+    
+    tsc_khz = (uint32_t)div_u64(end - start, PIT_CALIBRATE_MS);
+    tsc_base = end;
+    
+    print_string_color("OK\n", COLOR_GREEN, COLOR_BLACK);
+    print_string("  - Frequency: ");
+    print_dec(tsc_khz / 1000);
+    print_string(tsc_is_invariant() ? " MHz, invariant\n" : " MHz\n");
+}
+
+/**
+ * @brief Проверка, откалиброван ли TSC
+ */
+int tsc_available(void) {
+    return tsc_khz != 0;
+}
+
+/**
+ * @brief Перевод тактов TSC в наносекунды
+ * @param cycles Количество тактов
+ */
+uint64_t tsc_cycles_to_ns(uint64_t cycles) {
+    return mul_div_u64(cycles, 1000000, tsc_khz);
+}
+
+/**
+ * @brief Перевод наносекунд в такты TSC
+ * @param ns Количество наносекунд
+ */
+uint64_t tsc_ns_to_cycles(uint64_t ns) {
+    return mul_div_u64(ns, tsc_khz, 1000000);
+}
+
+/**
+ * @brief Время с момента калибровки TSC в наносекундах
+ */
+uint64_t tsc_now_ns(void) {
+    return tsc_cycles_to_ns(rdtsc() - tsc_base);
+}
+
+/**
+ * @brief Проверка инвариантности TSC
+ */
+int tsc_is_invariant(void) {
+    return (cpu_info.apm_edx & CPUID_APM_INVARIANT_TSC) != 0;
+}
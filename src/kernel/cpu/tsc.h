@@ -0,0 +1,54 @@
+/**
+ * @file tsc.h
+ * @brief Счетчик меток времени (TSC)
+ *
+ * Частота TSC калибруется при загрузке по каналу 2 PIT,
+ * после чего TSC служит источником времени с наносекундной
+ * дискретностью (если он инвариантен) и отсчитывает дедлайны
+ * LAPIC-таймера в режиме TSC-deadline.
+ */
+
+#ifndef KERNEL_TSC_H
+#define KERNEL_TSC_H
+
+#include <stdint.h>
+
+/* Частота TSC в кГц (0 - не откалиброван) */
+extern uint32_t tsc_khz;
+
+/**
+ * @brief Калибровка частоты TSC
+ */
+void tsc_init(void);
+
+/**
+ * @brief Проверка, откалиброван ли TSC
+ */
+int tsc_available(void);
+
+/**
+ * @brief Перевод тактов TSC в наносекунды
+ * @param cycles Количество тактов
+ */
+uint64_t tsc_cycles_to_ns(uint64_t cycles);
+
+/**
+ * @brief Перевод наносекунд в такты TSC
+ * @param ns Количество наносекунд
+ */
+uint64_t tsc_ns_to_cycles(uint64_t ns);
+
+/**
+ * @brief Время с момента калибровки TSC в наносекундах
+ */
+uint64_t tsc_now_ns(void);
+
+/**
+ * @brief Проверка инвариантности TSC
+ *
+ * Инвариантный TSC тикает с постоянной частотой во всех
+ * P- и C-состояниях и пригоден как основной источник времени.
+ */
+int tsc_is_invariant(void);
+
+#endif /* KERNEL_TSC_H */
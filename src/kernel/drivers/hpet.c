@@ -0,0 +1,362 @@
+/**
+ * @file hpet.c
+ * @brief Реализация драйвера HPET
+ *
+ * Главный счетчик HPET тактируется от стабильного генератора
+ * (обычно 14.318 МГц) и не зависит от частоты и состояний процессора,
+ * поэтому служит источником времени, когда TSC не инвариантен.
+ * Чтение счетчика - обычное чтение памяти, без портового
+ * защелкивания, которого требует PIT.
+ *
+ * Компаратор таймера 0 используется как однократный источник событий:
+ * в него записывается абсолютное значение главного счетчика,
+ * а прерывание доставляется через I/O APIC.
+ */
+
+#include "hpet.h"
+#include "../acpi/acpi.h"
+#include "../apic/apic.h"
+#include "../cpu/cpu.h"
+#include "../lib/math64.h"
+#include "../memory/vmm.h"
+#include "../sync/spinlock.h"
+#include "../video/video.h"
+#include "../lib/compiler.h"
+#include <stddef.h>
+
+/**
+ * @brief Таблица ACPI "HPET"
+ */
+typedef struct {
+    acpi_sdt_header_t header;
+    uint32_t block_id;        /* Идентификатор блока таймеров */
+    uint8_t address_space;    /* 0 - системная память */
+    uint8_t register_width;
+    uint8_t register_offset;
+    uint8_t reserved;
+    uint64_t address;         /* Физический адрес регистров */
+    uint8_t hpet_number;
+    uint16_t min_tick;        /* Минимальный период в периодическом режиме */
+    uint8_t page_protection;
+} __attribute__((packed)) acpi_hpet_t;
+
+/* Адрес регистров в окне ядра (0 - HPET не найден) */
+static uintptr_t hpet_base = 0;
+
+/* Период главного счетчика в фемтосекундах */
+static uint32_t hpet_period = 0;
+
+/* Количество таймеров (компараторов) */
+static uint32_t hpet_timers = 0;
+
+/* Главный счетчик 64-битный */
+static int hpet_counter_64 = 0;
+
+/* Расширение 32-битного счетчика до 64 бит (общее для всех процессоров) */
+static uint32_t counter_high = 0;
+static uint32_t counter_last = 0;
+static spinlock_t counter_lock = SPINLOCK_INIT;
+
+/* Источник событий: GSI компаратора и обработчик */
+static uint32_t event_gsi = 0;
+static void (*event_handler)(void) = NULL;
+static int event_ready = 0;
+
+/* Статистика источника событий */
+static uint32_t event_interrupts = 0;
+static uint32_t event_late_arms = 0;
+
+/**
+ * @brief Чтение 32-битного регистра HPET
+ * @param reg Смещение регистра
+ */
+static uint32_t hpet_read(uint32_t reg) {
+    return mmio_read32(hpet_base + reg);
+}
+
+/**
+ * @brief Запись 32-битного регистра HPET
+ * @param reg Смещение регистра
+ * @param value Значение
+ */
+static void hpet_write(uint32_t reg, uint32_t value) {
+    mmio_write32(hpet_base + reg, value);
+}
+
+/**
+ * @brief Поиск и включение HPET
+ * @return 1 если HPET найден и запущен
+ */
+__cold int hpet_init(void) {
+    print_string("HPET Initialization... ");
+    
+    acpi_hpet_t *table = (acpi_hpet_t*)acpi_find_table("HPET");
+    if (!table || table->address_space != 0 || (table->address >> 32) != 0) {
+        print_string_color("NOT FOUND\n", COLOR_BROWN, COLOR_BLACK);
+        return 0;
+    }
+    
+    hpet_base = (uintptr_t)vmm_map_mmio(table->address, HPET_MMIO_SIZE);
+    if (!hpet_base) {
+        print_string_color("FAILED\n", COLOR_RED, COLOR_BLACK);
+        return 0;
+    }
+    uint32_t caps = hpet_read(HPET_REG_CAPABILITIES);
+    hpet_period = hpet_read(HPET_REG_CAPABILITIES + 4);
+    
+    /* Спецификация ограничивает период 100 нс */
+    if (hpet_period == 0 || hpet_period > 100000000) {
+        hpet_base = 0;
+        print_string_color("FAILED\n", COLOR_RED, COLOR_BLACK);
+        return 0;
+    }
+    
+    hpet_timers = ((caps >> 8) & 0x1F) + 1;
+    hpet_counter_64 = (caps & HPET_CAP_COUNTER_64) != 0;
+    
+    /* Останавливаем счетчик, отключаем все компараторы,
+     * сбрасываем счетчик и запускаем его без legacy-маршрутизации
+     * (IRQ0 остается за PIT) */
+    hpet_write(HPET_REG_CONFIG, 0);
+    for (uint32_t i = 0; i < hpet_timers; i++) {
+        uint32_t config = hpet_read(HPET_REG_TIMER_CONFIG(i));
+        hpet_write(HPET_REG_TIMER_CONFIG(i), config & ~(HPET_TIMER_ENABLE | HPET_TIMER_FSB));
+    }
+    hpet_write(HPET_REG_COUNTER, 0);
+    hpet_write(HPET_REG_COUNTER + 4, 0);
+    hpet_write(HPET_REG_CONFIG, HPET_CONFIG_ENABLE);
+    
+    print_string_color("OK\n", COLOR_GREEN, COLOR_BLACK);
+    print_string("  - Base: ");
+    print_hex((uint32_t)table->address);
+    print_string("\n  - Frequency: ");
+    print_dec((uint32_t)div_u64(1000000000000ULL, hpet_period));
+    print_string(" kHz, ");
+    print_dec(hpet_timers);
+    print_string(hpet_counter_64 ? " timers, 64-bit\n" : " timers, 32-bit\n");
+    return 1;
+}
+
+/**
+ * @brief Проверка наличия HPET
+ */
+int hpet_available(void) {
+    return hpet_base != 0;
+}
+
+/**
+ * @brief Чтение главного счетчика
+ *
+ * 64-битный счетчик читается двумя 32-битными обращениями:
+ * старшая половина перечитывается, чтобы не склеить половины
+ * по разные стороны переноса. 32-битный счетчик расширяется
+ * программно по факту переполнения (период - около 5 минут,
+ * поэтому счетчик должен читаться хотя бы раз за это время).
+ * Переполнением считается только шаг назад больше половины
+ * диапазона; меньший шаг назад не уменьшает результат.
+ */
+uint64_t hpet_read_counter(void) {
+    if (hpet_counter_64) {
+        uint32_t high, low;
+        do {
+            high = hpet_read(HPET_REG_COUNTER + 4);
+            low = hpet_read(HPET_REG_COUNTER);
+        } while (high != hpet_read(HPET_REG_COUNTER + 4));
+        return ((uint64_t)high << 32) | low;
+    }
+    
+    uint32_t flags = spin_lock_irqsave(&counter_lock);
+    uint32_t low = hpet_read(HPET_REG_COUNTER);
+    if (low < counter_last) {
+        if (counter_last - low > 0x80000000U) {
+            counter_high++;
+            counter_last = low;
+        }
+    } else {
+        counter_last = low;
+    }
+    uint64_t value = ((uint64_t)counter_high << 32) | counter_last;
+    spin_unlock_irqrestore(&counter_lock, flags);
+    return value;
+}
+
+/**
+ * @brief Период главного счетчика в фемтосекундах
+ */
+uint32_t hpet_period_fs(void) {
+    return hpet_period;
+}
+
+/**
+ * @brief Выбор GSI для компаратора по маске допустимых линий
+ * @param route_cap Маска Tn_INT_ROUTE_CAP
+ * @return GSI или -1, если подходящей линии нет
+ *
+ * Предпочитаются линии выше ISA-диапазона, чтобы не делить
+ * линию с устройствами ISA.
+ */
+static int hpet_pick_gsi(uint32_t route_cap) {
+    int fallback = -1;
+    
+    for (int gsi = 31; gsi >= 0; gsi--) {
+        if (!(route_cap & (1U << gsi)) || !ioapic_has_gsi(gsi)) {
+            continue;
+        }
+        if (gsi >= 16) {
+            return gsi;
+        }
+        /* Линии 0, 2 и 8 заняты PIT и RTC (в том числе через переопределения) */
+        if (gsi != 0 && gsi != 2 && gsi != 8 && fallback < 0) {
+            fallback = gsi;
+        }
+    }
+    return fallback;
+}
+
+/**
+ * @brief Настройка компаратора как однократного источника событий
+ * @param handler Функция, вызываемая при срабатывании
+ * @return 1 если источник событий готов
+ */
+int hpet_event_init(void (*handler)(void)) {
+    if (!hpet_base || !apic_enabled()) {
+        return 0;
+    }
+    
+    uint32_t route_cap = hpet_read(HPET_REG_TIMER_CONFIG(0) + 4);
+    int gsi = hpet_pick_gsi(route_cap);
+    if (gsi < 0) {
+        return 0;
+    }
+    
+    event_gsi = gsi;
+    event_handler = handler;
+    
+    request_vector(HPET_VECTOR, hpet_event_handler, NULL);
+    /* Фронт, активный высокий уровень - режим срабатывания компаратора ниже */
+    ioapic_route(event_gsi, HPET_VECTOR, lapic_id(), 0);
+    
+    uint32_t config = hpet_read(HPET_REG_TIMER_CONFIG(0));
+    config &= ~(HPET_TIMER_LEVEL | HPET_TIMER_PERIODIC | HPET_TIMER_ROUTE_MASK | HPET_TIMER_FSB);
+    config |= (event_gsi << HPET_TIMER_ROUTE_SHIFT) | HPET_TIMER_ENABLE;
+    if (!hpet_counter_64) {
+        config |= HPET_TIMER_32BIT;
+    }
+    hpet_write(HPET_REG_TIMER_CONFIG(0), config);
+    
+    /* Компаратор на максимальное значение: без взведения не срабатывает */
+    hpet_write(HPET_REG_TIMER_COMPARATOR(0), 0xFFFFFFFF);
+    hpet_write(HPET_REG_TIMER_COMPARATOR(0) + 4, 0xFFFFFFFF);
+    
+    ioapic_unmask(event_gsi);
+    event_ready = 1;
+    return 1;
+}
+
+/**
+ * @brief Проверка готовности источника событий
+ */
+int hpet_event_available(void) {
+    return event_ready;
+}
+
+/**
+ * @brief Запись значения компаратора таймера 0
+ * @param value Абсолютное значение главного счетчика
+ */
+static void hpet_write_comparator(uint64_t value) {
+    hpet_write(HPET_REG_TIMER_COMPARATOR(0), (uint32_t)value);
+    if (hpet_counter_64) {
+        hpet_write(HPET_REG_TIMER_COMPARATOR(0) + 4, (uint32_t)(value >> 32));
+    }
+}
+
+/**
+ * @brief Взведение компаратора через заданное количество наносекунд
+ * @param delta_ns Интервал до срабатывания
+ *
+ * Компаратор срабатывает по равенству, поэтому значение, которое
+ * счетчик успел обогнать во время записи, вызвало бы прерывание
+ * лишь после полного оборота. После записи счетчик перечитывается,
+ * и при опоздании компаратор переставляется с увеличенным запасом.
+ */
+void hpet_event_arm(uint64_t delta_ns) {
+    uint64_t delta = mul_div_u64(delta_ns, 1000000, hpet_period);
+    uint32_t margin = HPET_MIN_DELTA;
+    
+    if (!hpet_counter_64 && delta > 0x7FFFFFFF) {
+        /* 32-битный компаратор: сработает раньше, hrtimer перевзведет */
+        delta = 0x7FFFFFFF;
+    }
+    
+    uint32_t flags = cpu_irq_save();
+    for (;;) {
+        if (delta < margin) {
+            delta = margin;
+        }
+        uint64_t target = hpet_read_counter() + delta;
+        hpet_write_comparator(target);
+        
+        uint64_t now = hpet_read_counter();
+        if (hpet_counter_64 ? now < target : (int32_t)((uint32_t)target - (uint32_t)now) > 0) {
+            break;
+        }
+        event_late_arms++;
+        margin *= 2;
+        delta = 0;
+    }
+    cpu_irq_restore(flags);
+}
+
+/**
+ * @brief Отключение компаратора
+ *
+ * Компаратор отодвигается на максимально далекое значение,
+ * линия прерывания остается настроенной.
+ */
+void hpet_event_disarm(void) {
+    if (hpet_counter_64) {
+        hpet_write_comparator(0xFFFFFFFFFFFFFFFFULL);
+    } else {
+        hpet_write_comparator(hpet_read_counter() - 1);
+    }
+}
+
+/**
+ * @brief Обработчик прерывания компаратора HPET (вектор HPET_VECTOR)
+ */
+irq_return_t hpet_event_handler(void *ctx) {
+    (void)ctx;
+    event_interrupts++;
+    if (event_handler) {
+        event_handler();
+    }
+    return IRQ_HANDLED;
+}
+
+/**
+ * @brief Вывод информации о HPET
+ */
+void hpet_dump_info(void) {
+    print_string("HPET Info:\n");
+    if (!hpet_base) {
+        print_string("  - Not available\n");
+        return;
+    }
+    print_string("  - Period: ");
+    print_dec(hpet_period);
+    print_string(" fs\n  - Counter: ");
+    print_dec((uint32_t)hpet_read_counter());
+    print_string("\n  - Event source: ");
+    if (event_ready) {
+        print_string("timer 0, GSI ");
+        print_dec(event_gsi);
+        print_string(", interrupts ");
+        print_dec(event_interrupts);
+        print_string(", late arms ");
+        print_dec(event_late_arms);
+        print_string("\n");
+    } else {
+        print_string("not used\n");
+    }
+}
@@ -0,0 +1,106 @@
+/**
+ * @file hpet.h
+ * @brief Драйвер таймера событий высокой точности (HPET)
+ *
+ * HPET находится по таблице ACPI "HPET" и доступен через MMIO:
+ * главный счетчик читается одной-двумя операциями чтения памяти
+ * (без защелкивания через порты, как у PIT), а компараторы таймеров
+ * используются как однократные источники событий.
+ */
+
+#ifndef KERNEL_HPET_H
+#define KERNEL_HPET_H
+
+#include <stdint.h>
+#include "../idt/irq.h"
+
+/* Размер области регистров */
+#define HPET_MMIO_SIZE 0x400
+
+/* Регистры HPET (смещения) */
+#define HPET_REG_CAPABILITIES  0x000
+#define HPET_REG_CONFIG        0x010
+#define HPET_REG_INT_STATUS    0x020
+#define HPET_REG_COUNTER       0x0F0
+#define HPET_REG_TIMER_CONFIG(n)     (0x100 + 0x20 * (n))
+#define HPET_REG_TIMER_COMPARATOR(n) (0x108 + 0x20 * (n))
+
+/* Биты общих регистров */
+#define HPET_CAP_COUNTER_64    (1 << 13)
+#define HPET_CONFIG_ENABLE     0x01
+#define HPET_CONFIG_LEGACY     0x02
+
+/* Биты регистра настройки таймера */
+#define HPET_TIMER_LEVEL       (1 << 1)
+#define HPET_TIMER_ENABLE      (1 << 2)
+#define HPET_TIMER_PERIODIC    (1 << 3)
+#define HPET_TIMER_32BIT       (1 << 8)
+#define HPET_TIMER_ROUTE_SHIFT 9
+#define HPET_TIMER_ROUTE_MASK  (0x1F << HPET_TIMER_ROUTE_SHIFT)
+#define HPET_TIMER_FSB         (1 << 14)
+
+/* Вектор прерывания компаратора HPET */
+#define HPET_VECTOR 0xEE
+
+/* Минимальный запас при взведении компаратора (такты HPET) */
+#define HPET_MIN_DELTA 64
+
+/**
+ * @brief Поиск и включение HPET
+ * @return 1 если HPET найден и запущен
+ */
+int hpet_init(void);
+
+/**
+ * @brief Проверка наличия HPET
+ */
+int hpet_available(void);
+
+/**
+ * @brief Чтение главного счетчика
+ * @return Значение 64-битного (или расширенного 32-битного) счетчика
+ */
+uint64_t hpet_read_counter(void);
+
+/**
+ * @brief Период главного счетчика в фемтосекундах
+ */
+uint32_t hpet_period_fs(void);
+
+/**
+ * @brief Настройка компаратора как однократного источника событий
+ *
+ * Требует APIC: линия компаратора направляется через I/O APIC.
+ *
+ * @param handler Функция, вызываемая при срабатывании (в контексте прерывания)
+ * @return 1 если источник событий готов
+ */
+int hpet_event_init(void (*handler)(void));
+
+/**
+ * @brief Проверка готовности источника событий
+ */
+int hpet_event_available(void);
+
+/**
+ * @brief Взведение компаратора через заданное количество наносекунд
+ * @param delta_ns Интервал до срабатывания
+ */
+void hpet_event_arm(uint64_t delta_ns);
+
+/**
+ * @brief Отключение компаратора
+ */
+void hpet_event_disarm(void);
+
+/**
+ * @brief Обработчик прерывания компаратора HPET (вектор HPET_VECTOR)
+ */
+irq_return_t hpet_event_handler(void *ctx);
+
+/**
+ * @brief Вывод информации о HPET
+ */
+void hpet_dump_info(void);
+
+#endif /* KERNEL_HPET_H */
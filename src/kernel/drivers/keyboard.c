@@ -7,27 +7,71 @@
  * - Backspace
  * - Shift + символы
  * - Caps Lock
+ *
+ * Обработчик прерывания только забирает скан-код из контроллера
+ * в кольцевой буфер; трансляция, светодиоды и буфер символов
+ * обрабатываются в отложенной работе (softirq) с разрешенными
+ * прерываниями.
  */
 
 #include "keyboard.h"
 #include "../video/video.h"
 #include "../idt/idt.h"
+#include "../idt/irq.h"
+#include "../idt/softirq.h"
+#include "../cpu/cpu.h"
 #include "../memory/memory.h"
+#include "../sync/waitqueue.h"
+#include "../async/async.h"
+#include "../lib/compiler.h"
 
 /* Порт данных клавиатуры */
 #define KEYBOARD_DATA_PORT 0x60
 /* Порт статуса клавиатуры */
 #define KEYBOARD_STATUS_PORT 0x64
+/* Размер кольца скан-кодов (степень двойки) */
+#define KEYBOARD_SCANCODE_RING 32
 
 /* Буфер для хранения нажатых клавиш */
 static char keyboard_buffer[256];
 /* Текущая позиция в буфере */
 static unsigned int buffer_position = 0;
+/* Ожидающие ввода; блокировка очереди защищает и буфер:
+ * пишет отложенная работа, читает поток */
+static wait_queue_t keyboard_wq = WAIT_QUEUE_INIT;
 /* Флаг нажатия Shift */
 static int shift_pressed = 0;
 /* Флаг состояния Caps Lock */
 static int caps_lock = 0;
 
+/* Скан-коды, принятые в прерывании и ожидающие трансляции
+ * (один писатель - прерывание, один читатель - отложенная работа) */
+static volatile uint8_t scancode_ring[KEYBOARD_SCANCODE_RING];
+static volatile uint32_t scancode_head = 0;
+static volatile uint32_t scancode_tail = 0;
+
+/* Отложенная трансляция скан-кодов */
+static softirq_work_t keyboard_work;
+static void keyboard_process_scancodes(void *ctx);
+
+/**
+ * Состояние асинхронной установки светодиодов
+ *
+ * Задача живет все время работы: ждет запроса, отправляет команду
+ * и маску и после каждого байта ждет подтверждения, которое
+ * завершает будущее из обработчика прерывания.
+ */
+static struct {
+    async_task_t task;
+    async_future_t request;      /* Запрошена новая маска */
+    async_future_t reply;        /* Ответ клавиатуры на отправленный байт */
+    volatile uint8_t wanted;     /* Последняя запрошенная маска */
+    volatile uint8_t awaiting;   /* Ответ ожидается в прерывании */
+    uint8_t value;               /* Отправляемая маска */
+    uint8_t byte;                /* 0 - команда, 1 - маска */
+    uint8_t retries;             /* Повторы текущего байта */
+} leds;
+
 /**
  * Основная карта символов (без модификаторов)
  * Индекс - скан-код, значение - ASCII символ
@@ -59,34 +103,71 @@ static const char keyboard_map_shift[128] = {
 };
 
 /**
- * Управление светодиодами клавиатуры
- * @param leds Битовая маска светодиодов (LED_CAPS_LOCK, LED_NUM_LOCK, LED_SCROLL_LOCK)
+ * Шаг задачи установки светодиодов
  */
-static void keyboard_set_leds(uint8_t leds) {
-    // Ждем, пока клавиатура будет готова принять команду
-    while (read_port(KEYBOARD_STATUS_PORT) & 0x02);
-    write_port(KEYBOARD_DATA_PORT, KEYBOARD_CMD_SET_LEDS);
+static int keyboard_leds_task(async_task_t *task) {
+    ASYNC_BEGIN(task);
+    
+    while (1) {
+        ASYNC_AWAIT(task, &leds.request);
+        
+        /* Сброс до чтения маски: запрос, пришедший после, не потеряется */
+        async_future_init(&leds.request);
+        __sync_synchronize();
+        leds.value = leds.wanted;
+        
+        leds.retries = 0;
+        for (leds.byte = 0; leds.byte < 2; ) {
+            /* Буфер контроллера освобождается за микросекунды */
+            while (read_port(KEYBOARD_STATUS_PORT) & 0x02) {
+                ASYNC_YIELD(task);
+            }
+            
+            async_future_init(&leds.reply);
+            leds.awaiting = 1;
+            write_port(KEYBOARD_DATA_PORT, leds.byte ? leds.value : KEYBOARD_CMD_SET_LEDS);
+            ASYNC_AWAIT(task, &leds.reply);
+            
+            if (leds.reply.result == KEYBOARD_REPLY_RESEND &&
+                leds.retries++ < KEYBOARD_CMD_RETRIES) {
+                continue;
+            }
+            leds.byte++;
+            leds.retries = 0;
+        }
+    }
     
-    // Ждем подтверждения
-    while (read_port(KEYBOARD_STATUS_PORT) & 0x02);
-    write_port(KEYBOARD_DATA_PORT, leds);
+    ASYNC_END(task);
+}
+
+/**
+ * Управление светодиодами клавиатуры
+ * @param leds_mask Битовая маска светодиодов (LED_CAPS_LOCK, LED_NUM_LOCK, LED_SCROLL_LOCK)
+ *
+ * Не ждет клавиатуру: маску отправляет асинхронная задача,
+ * несколько быстрых запросов сливаются в последний.
+ */
+static void keyboard_set_leds(uint8_t leds_mask) {
+    leds.wanted = leds_mask;
+    async_future_complete(&leds.request, 0);
 }
 
 /**
  * Инициализация клавиатуры
- * Размаскировка прерывания клавиатуры в PIC
+ * Размаскировка прерывания клавиатуры в контроллере прерываний
  */
-void keyboard_init(void) {
+__cold void keyboard_init(void) {
     print_string("Keyboard Initialization... ");  // Добавлено: статусное сообщение
     
-    unsigned char mask = read_port(0x21) & 0xFD;
-    write_port(0x21, mask);
-
+    softirq_work_init(&keyboard_work, keyboard_process_scancodes, NULL);
+    request_irq(IRQ_KEYBOARD, keyboard_handler_main, NULL);
+    async_spawn(&async_idle_executor, &leds.task, keyboard_leds_task, NULL);
+    
     // Инициализация светодиодов
     keyboard_set_leds(0);  // Все светодиоды выключены
     
     /* Упрощенная проверка - если маска изменилась */
-    if ((read_port(0x21) & 0x02) == 0) {
+    if (!irq_is_masked(IRQ_KEYBOARD)) {
         print_string_color("OK\n", COLOR_GREEN, COLOR_BLACK);  // Добавлено: успешный статус
     } else {
         print_string_color("FAILED\n", COLOR_RED, COLOR_BLACK);  // Добавлено: статус ошибки
@@ -94,16 +175,30 @@ void keyboard_init(void) {
 }
 
 /**
- * Обработчик прерывания клавиатуры
+ * Добавление символа в буфер клавиатуры и пробуждение читателя
+ * При заполненном буфере символ теряется
+ */
+static void keyboard_buffer_put(char c) {
+    uint32_t flags = spin_lock_irqsave(&keyboard_wq.lock);
+    if (buffer_position < sizeof(keyboard_buffer) - 1) {
+        keyboard_buffer[buffer_position++] = c;
+    }
+    wake_up_locked(&keyboard_wq, NULL, WAKE_ALL);
+    spin_unlock_irqrestore(&keyboard_wq.lock, flags);
+}
+
+/**
+ * Трансляция накопленных скан-кодов (отложенная работа)
  * 
- * Читает скан-код нажатой клавиши, обрабатывает модификаторы
- * (Shift, Caps Lock) и помещает символ в буфер
+ * Обрабатывает модификаторы (Shift, Caps Lock) и помещает
+ * символы в буфер. Выполняется с разрешенными прерываниями.
  */
-void keyboard_handler_main(void) {
-    unsigned char status = read_port(KEYBOARD_STATUS_PORT);
+static void keyboard_process_scancodes(void *ctx) {
+    (void)ctx;
     
-    if (status & 0x01) {
-        unsigned char keycode = read_port(KEYBOARD_DATA_PORT);
+    while (scancode_tail != scancode_head) {
+        unsigned char keycode = scancode_ring[scancode_tail % KEYBOARD_SCANCODE_RING];
+        scancode_tail++;
         
         // Обработка модификаторов
         if (keycode == KEY_SHIFT_LEFT || keycode == KEY_SHIFT_RIGHT || 
@@ -118,32 +213,59 @@ void keyboard_handler_main(void) {
         }
         // Обработка пробела
         else if (keycode == KEY_SPACE && !(keycode & KEY_RELEASED)) {
-            if (buffer_position < sizeof(keyboard_buffer) - 1) {
-                keyboard_buffer[buffer_position++] = ' ';
-            }
+            keyboard_buffer_put(' ');
         }
         // Обработка обычных клавиш
         else if (!(keycode & KEY_RELEASED) && keycode < 128) {
             if (keycode == KEY_TAB) {
                 // Вставляем 4 пробела
                 for (int i = 0; i < 4; i++) {
-                    if (buffer_position < sizeof(keyboard_buffer) - 1) {
-                        keyboard_buffer[buffer_position++] = ' ';
-                    }
+                    keyboard_buffer_put(' ');
                 }
             } else {
                 char c = shift_pressed || caps_lock ? 
                        keyboard_map_shift[keycode] : 
                        keyboard_map[keycode];
                 
-                if (c != 0 && buffer_position < sizeof(keyboard_buffer) - 1) {
-                    keyboard_buffer[buffer_position++] = c;
+                if (c != 0) {
+                    keyboard_buffer_put(c);
                 }
             }
         }
     }
+}
+
+/**
+ * Обработчик прерывания клавиатуры
+ * 
+ * Забирает скан-код из контроллера и ставит его трансляцию
+ * в очередь отложенной работы
+ */
+irq_return_t keyboard_handler_main(void *ctx) {
+    (void)ctx;
+    unsigned char status = read_port(KEYBOARD_STATUS_PORT);
+    
+    if (!(status & 0x01)) {
+        return IRQ_NONE;
+    }
+    
+    uint8_t keycode = read_port(KEYBOARD_DATA_PORT);
     
-    write_port(0x20, 0x20);
+    /* Ответ на команду светодиодов - не скан-код */
+    if (leds.awaiting && (keycode == KEYBOARD_REPLY_ACK || keycode == KEYBOARD_REPLY_RESEND)) {
+        leds.awaiting = 0;
+        async_future_complete(&leds.reply, keycode);
+        return IRQ_HANDLED;
+    }
+    
+    /* При переполнении кольца скан-код теряется */
+    if (scancode_head - scancode_tail < KEYBOARD_SCANCODE_RING) {
+        scancode_ring[scancode_head % KEYBOARD_SCANCODE_RING] = keycode;
+        scancode_head++;
+    }
+    
+    softirq_queue(&keyboard_work);
+    return IRQ_HANDLED;
 }
 
 /**
@@ -151,17 +273,21 @@ void keyboard_handler_main(void) {
  * @return Символ или 0, если буфер пуст
  */
 char keyboard_read(void) {
+    char key = 0;
+    
+    /* Отложенная трансляция может дописывать буфер на любом процессоре */
+    uint32_t flags = spin_lock_irqsave(&keyboard_wq.lock);
     if (buffer_position > 0) {
         /* Извлечение символа из начала буфера */
-        char key = keyboard_buffer[0];
+        key = keyboard_buffer[0];
         /* Сдвиг буфера */
         for (unsigned int i = 1; i < buffer_position; i++) {
             keyboard_buffer[i-1] = keyboard_buffer[i];
         }
         buffer_position--;
-        return key;
     }
-    return 0;
+    spin_unlock_irqrestore(&keyboard_wq.lock, flags);
+    return key;
 }
 
 /**
@@ -172,7 +298,7 @@ char keyboard_read(void) {
  */
 char* read_line(unsigned int max_length) {
     /* Выделяем динамический буфер */
-    char* buffer = (char*)kmalloc(max_length);
+    char* buffer = (char*)kmalloc_flags(max_length, KMALLOC_TAG(HEAP_TAG_DRIVERS));
     if (!buffer) {
         return NULL; /* Не удалось выделить память */
     }
@@ -196,31 +322,20 @@ char* read_line(unsigned int max_length) {
                 return buffer;  /* Возвращаем указатель на динамический буфер */
             } 
             else if (input == '\b') {
+                /* Стирание и курсор - под блокировкой видеовывода */
                 if (pos > 0) {
                     pos--;
-                    if (cursor_pos >= 2) {
-                        cursor_pos -= 2;
-                        VIDEO_MEMORY[cursor_pos] = ' ';
-                        VIDEO_MEMORY[cursor_pos + 1] = 0x07;
-                    } else {
-                        cursor_pos = 0;
-                    }
+                    print_string("\b");
                 }
-                update_cursor(cursor_pos / 2);
             }
             else if (pos < max_length - 1) {
                 buffer[pos++] = input;
                 char str[2] = {input, '\0'};
                 print_string(str);
-                if (cursor_pos >= SCREEN_SIZE){
-                    cursor_pos = SCREEN_SIZE - 2;
-                }
-                update_cursor(cursor_pos / 2);
             }
         } else {
-            /* Если нет ввода, используем hlt для экономии энергии */
-            /* Процессор будет пробужден прерыванием от клавиатуры */
-            __asm__ volatile("hlt");
+            /* Нет ввода - спим, пока отложенная работа не добавит символ */
+            wait_event(&keyboard_wq, buffer_position > 0);
         }
     }
 }
\ No newline at end of file
@@ -7,6 +7,7 @@
  */
 
 #include "../video/video.h"
+#include "../idt/irq.h"
 
 #ifndef KERNEL_KEYBOARD_H
 #define KERNEL_KEYBOARD_H
@@ -24,6 +25,13 @@
 /* Команды клавиатуры */
 #define KEYBOARD_CMD_SET_LEDS 0xED
 
+/* Ответы клавиатуры на команду */
+#define KEYBOARD_REPLY_ACK    0xFA
+#define KEYBOARD_REPLY_RESEND 0xFE
+
+/* Повторов байта команды по запросу RESEND */
+#define KEYBOARD_CMD_RETRIES 3
+
 /* Маски светодиодов */
 #define LED_CAPS_LOCK   0x04
 #define LED_NUM_LOCK    0x02
@@ -38,8 +46,9 @@ void keyboard_init(void);
 /**
  * Основной обработчик прерывания клавиатуры
  * Вызывается при каждом нажатии/отпускании клавиши
+ * (регистрируется через request_irq)
  */
-void keyboard_handler_main(void);
+irq_return_t keyboard_handler_main(void *ctx);
 
 /**
  * Чтение символа из буфера клавиатуры
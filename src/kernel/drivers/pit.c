@@ -6,12 +6,21 @@
  * - Генерацию системных прерываний с заданной частотой
  * - Подсчет системных тиков
  * - Функции задержки и измерения времени
+ * - Tickless-простой с one-shot программированием (режим 0 PIT или hrtimer)
  * - Основу для многозадачности
  */
 
 #include "pit.h"
 #include "../video/video.h"
 #include "../idt/idt.h"
+#include "../idt/irq.h"
+#include "../idt/softirq.h"
+#include "../cpu/cpu.h"
+#include "../lib/math64.h"
+#include "../time/hrtimer.h"
+#include "../sched/sched.h"
+#include "../async/async.h"
+#include "../lib/compiler.h"
 
 /* Глобальная переменная для подсчета тиков */
 uint32_t system_ticks = 0;
@@ -19,19 +28,78 @@ uint32_t system_ticks = 0;
 /* Текущая частота системного таймера */
 static uint32_t current_frequency = SYSTEM_TIMER_FREQUENCY;
 
+/* Текущий делитель (длина тика в счетах PIT) */
+static uint16_t current_divisor = PIT_DIVISOR;
+
+/* Флаг tickless-режима */
+static int tickless_enabled = PIT_TICKLESS_DEFAULT;
+
+/* Количество тиков, покрываемых взведенным one-shot (0 - периодический режим) */
+static volatile uint32_t oneshot_ticks = 0;
+
+/* Начальное значение счетчика взведенного one-shot */
+static uint16_t oneshot_count = 0;
+
+/* Накопленный остаток времени меньше одного тика (в счетах PIT) */
+static uint32_t pending_counts = 0;
+
+/* Статистика tickless-режима */
+static pit_tickless_stats_t tickless_stats;
+
+/* Таймер дедлайна простоя на hrtimer */
+static hrtimer_t idle_timer;
+static volatile int idle_timer_fired = 0;
+
 /**
- * @brief Настройка делителя PIT
- * @param divisor Делитель частоты
+ * @brief Программирование канала 0 PIT
+ * @param mode Режим работы (PIT_CMD_MODE*)
+ * @param count Начальное значение счетчика
  */
-static void pit_set_divisor(uint16_t divisor) {
+static void pit_program(uint8_t mode, uint16_t count) {
     /* Отправляем команду на PIT */
-    write_port(PIT_COMMAND_PORT, PIT_CMD_CHANNEL0 | PIT_CMD_ACCESS_LOHI | PIT_CMD_MODE3);
+    write_port(PIT_COMMAND_PORT, PIT_CMD_CHANNEL0 | PIT_CMD_ACCESS_LOHI | mode);
     
-    /* Отправляем делитель (младший байт) */
-    write_port(PIT_CHANNEL0_PORT, divisor & 0xFF);
+    /* Отправляем счетчик (младший байт) */
+    write_port(PIT_CHANNEL0_PORT, count & 0xFF);
     
-    /* Отправляем делитель (старший байт) */
-    write_port(PIT_CHANNEL0_PORT, (divisor >> 8) & 0xFF);
+    /* Отправляем счетчик (старший байт) */
+    write_port(PIT_CHANNEL0_PORT, (count >> 8) & 0xFF);
+}
+
+/**
+ * @brief Настройка делителя PIT
+ * @param divisor Делитель частоты
+ *
+ * Используется режим 2 (генератор частоты): в отличие от меандра (режим 3)
+ * счетчик убывает на 1 за такт, и по его значению можно узнать,
+ * какая часть текущего тика уже прошла.
+ */
+static void pit_set_divisor(uint16_t divisor) {
+    pit_program(PIT_CMD_MODE2, divisor);
+    current_divisor = divisor;
+}
+
+/**
+ * @brief Чтение текущего значения счетчика канала 0
+ * @return Значение счетчика
+ */
+static uint16_t pit_read_count(void) {
+    write_port(PIT_COMMAND_PORT, PIT_CMD_CHANNEL0 | PIT_CMD_LATCH);
+    uint8_t lo = read_port(PIT_CHANNEL0_PORT);
+    uint8_t hi = read_port(PIT_CHANNEL0_PORT);
+    return ((uint16_t)hi << 8) | lo;
+}
+
+/**
+ * @brief Учет опоздания пробуждения
+ * @param lateness Опоздание относительно дедлайна (счеты PIT)
+ */
+static void pit_record_lateness(uint32_t lateness) {
+    tickless_stats.oneshot_wakeups++;
+    tickless_stats.lateness_total += lateness;
+    if (lateness > tickless_stats.lateness_max) {
+        tickless_stats.lateness_max = lateness;
+    }
 }
 
 /**
@@ -39,7 +107,7 @@ static void pit_set_divisor(uint16_t divisor) {
  * 
  * Настраивает PIT на генерацию прерываний с частотой SYSTEM_TIMER_FREQUENCY Гц
  */
-void pit_init(void) {
+__cold void pit_init(void) {
     print_string("PIT Initialization... ");
     
     /* Сбрасываем счетчик тиков */
@@ -48,9 +116,8 @@ void pit_init(void) {
     /* Настраиваем PIT на желаемую частоту */
     pit_set_divisor(PIT_DIVISOR);
     
-    /* Размаскировываем прерывание IRQ0 (PIT) в PIC */
-    uint8_t mask = read_port(0x21) & 0xFE; /* Очищаем бит 0 */
-    write_port(0x21, mask);
+    /* Регистрируем обработчик IRQ0 (линия размаскируется) */
+    request_irq(IRQ_TIMER, pit_handler, NULL);
     
     print_string_color("OK\n", COLOR_GREEN, COLOR_BLACK);
     print_string("  - Frequency: ");
@@ -65,14 +132,34 @@ void pit_init(void) {
  * @brief Обработчик прерывания системного таймера
  * 
  * Вызывается при каждом тике таймера. Увеличивает счетчик тиков
- * и может использоваться для планирования задач.
+ * и отсчитывает квант текущего потока (само переключение выполняется
+ * на выходе из прерывания).
  */
-void pit_handler(void) {
-    /* Увеличиваем счетчик тиков */
-    system_ticks++;
+irq_return_t pit_handler(void *ctx) {
+    (void)ctx;
+    
+    if (oneshot_ticks) {
+        /* Сработал one-shot простоя: в режиме 0 счетчик после нуля
+         * продолжает убывать с 0xFFFF, так что его значение - это
+         * опоздание пробуждения относительно дедлайна */
+        uint16_t lateness = (uint16_t)(0x10000 - pit_read_count());
+        
+        system_ticks += oneshot_ticks;
+        pending_counts += lateness;
+        if (pending_counts >= current_divisor) {
+            pending_counts -= current_divisor;
+            system_ticks++;
+        }
+        tickless_stats.ticks_saved += oneshot_ticks - 1;
+        pit_record_lateness(lateness);
+        oneshot_ticks = 0;
+    } else {
+        /* Увеличиваем счетчик тиков */
+        system_ticks++;
+    }
     
-    /* Отправляем EOI (End of Interrupt) в PIC */
-    write_port(0x20, 0x20);
+    sched_tick();
+    return IRQ_HANDLED;
 }
 
 /**
@@ -88,13 +175,28 @@ uint32_t pit_get_ticks(void) {
  * @param ms Количество миллисекунд для задержки
  */
 void pit_sleep_ms(uint32_t ms) {
-    uint32_t target_ticks = system_ticks + (ms * current_frequency / 1000);
+    /* При наличии hrtimer задержка не привязана к тикам */
+    if (hrtimer_available()) {
+        hrtimer_sleep_ns((uint64_t)ms * NSEC_PER_MSEC);
+        return;
+    }
     
-    /* Ждем, пока не достигнем целевого количества тиков */
-    while (system_ticks < target_ticks) {
-        /* Используем инструкцию hlt для экономии энергии */
-        __asm__ volatile("hlt");
+    pit_sleep_ticks(ms * current_frequency / 1000);
+}
+
+/**
+ * @brief Задержка на указанное количество микросекунд
+ * @param us Количество микросекунд для задержки
+ */
+void pit_sleep_us(uint32_t us) {
+    if (hrtimer_available()) {
+        hrtimer_sleep_ns((uint64_t)us * NSEC_PER_USEC);
+        return;
     }
+    
+    /* Без hrtimer округляем вверх до целого тика */
+    uint32_t ticks = (uint32_t)div_u64((uint64_t)us * current_frequency + 999999, 1000000);
+    pit_sleep_ticks(ticks ? ticks : 1);
 }
 
 /**
@@ -106,8 +208,13 @@ void pit_sleep_ticks(uint32_t ticks) {
     
     /* Ждем, пока не достигнем целевого количества тиков */
     while (system_ticks < target_ticks) {
-        /* Используем инструкцию hlt для экономии энергии */
-        __asm__ volatile("hlt");
+        if (sched_can_block()) {
+            /* Поток засыпает, процессор достается другим */
+            sched_sleep_ns((uint64_t)(target_ticks - system_ticks) * PIT_TICK_NS(current_frequency));
+        } else {
+            /* Простаиваем до дедлайна без лишних тиков */
+            pit_idle_until(target_ticks);
+        }
     }
 }
 
@@ -132,10 +239,13 @@ void pit_set_frequency(uint32_t frequency) {
     uint16_t divisor = PIT_FREQUENCY / frequency;
     
     /* Настраиваем PIT */
+    __asm__ volatile("cli");
     pit_set_divisor(divisor);
+    pending_counts = 0;
     
     /* Обновляем текущую частоту */
     current_frequency = frequency;
+    __asm__ volatile("sti");
 }
 
 /**
@@ -146,6 +256,286 @@ uint32_t pit_get_frequency(void) {
     return current_frequency;
 }
 
+/**
+ * @brief Включение или отключение tickless-режима простоя
+ * @param enabled 1 - программировать one-shot на время простоя, 0 - периодические тики
+ */
+void pit_set_tickless(int enabled) {
+    tickless_enabled = enabled ? 1 : 0;
+}
+
+/**
+ * @brief Проверка, включен ли tickless-режим
+ * @return 1 если включен, иначе 0
+ */
+int pit_tickless_enabled(void) {
+    return tickless_enabled;
+}
+
+/**
+ * @brief Простой процессора до ближайшего прерывания
+ */
+void pit_idle(void) {
+    pit_idle_until(PIT_IDLE_NO_DEADLINE);
+}
+
+/**
+ * @brief Учет времени, прошедшего в простое без периодических тиков
+ * @param progress Время от последнего тика до пробуждения (счеты PIT)
+ */
+static void pit_account_idle(uint32_t progress) {
+    uint32_t elapsed = progress / current_divisor;
+    
+    pending_counts += progress % current_divisor;
+    if (pending_counts >= current_divisor) {
+        pending_counts -= current_divisor;
+        elapsed++;
+    }
+    
+    system_ticks += elapsed;
+    tickless_stats.ticks_saved += elapsed;
+}
+
+/**
+ * @brief Простой на one-shot канала 0 PIT (режим 0)
+ * @param ticks Длительность простоя в тиках (>= 2)
+ * @param partial Часть текущего тика, уже прошедшая (счеты PIT)
+ *
+ * 16-битный счетчик ограничивает интервал ~55 мс.
+ */
+static void pit_idle_oneshot(uint32_t ticks, uint32_t partial) {
+    oneshot_count = (uint16_t)(ticks * current_divisor - partial);
+    oneshot_ticks = ticks;
+    tickless_stats.idle_entries++;
+    pit_program(PIT_CMD_MODE0, oneshot_count);
+    
+    /* sti и hlt атомарны: прерывание не проскочит между ними */
+    __asm__ volatile("sti; hlt; cli");
+    
+    if (oneshot_ticks) {
+        uint16_t remaining = pit_read_count();
+        
+        if (remaining == 0 || remaining > oneshot_count) {
+            /* One-shot уже истек, IRQ0 ждет доставки - даем ему отработать */
+            __asm__ volatile("sti; nop; cli");
+        } else {
+            /* Разбудило чужое прерывание: учитываем прошедшее время */
+            pit_account_idle(partial + (oneshot_count - remaining));
+            tickless_stats.early_wakeups++;
+            oneshot_ticks = 0;
+        }
+    }
+}
+
+/**
+ * @brief Обработчик дедлайна простоя на hrtimer
+ */
+static void pit_idle_timer_fn(hrtimer_t *timer, void *ctx) {
+    (void)timer;
+    (void)ctx;
+    idle_timer_fired = 1;
+}
+
+/**
+ * @brief Простой на hrtimer с остановленным IRQ0
+ * @param ticks Длительность простоя в тиках
+ * @param partial Часть текущего тика, уже прошедшая (счеты PIT)
+ *
+ * Дедлайн взводится на LAPIC-таймере или компараторе HPET.
+ * Интервал не ограничен 16-битным счетчиком PIT; время простоя
+ * восстанавливается по источнику времени hrtimer.
+ */
+static void pit_idle_hrtimer(uint32_t ticks, uint32_t partial) {
+    if (ticks > PIT_IDLE_MAX_TICKS) {
+        ticks = PIT_IDLE_MAX_TICKS;
+    }
+    
+    uint64_t start = hrtimer_now_ns();
+    uint64_t partial_ns = mul_div_u64(partial, NSEC_PER_SEC, PIT_FREQUENCY);
+    uint64_t deadline = start + (uint64_t)ticks * PIT_TICK_NS(current_frequency) - partial_ns;
+    
+    irq_mask(IRQ_TIMER);
+    idle_timer_fired = 0;
+    hrtimer_setup(&idle_timer, pit_idle_timer_fn, NULL);
+    hrtimer_start_abs(&idle_timer, deadline);
+    tickless_stats.idle_entries++;
+    
+    __asm__ volatile("sti; hlt; cli");
+    
+    hrtimer_cancel(&idle_timer);
+    uint64_t now = hrtimer_now_ns();
+    
+    if (idle_timer_fired) {
+        pit_record_lateness((uint32_t)mul_div_u64(now - deadline, PIT_FREQUENCY, NSEC_PER_SEC));
+    } else {
+        tickless_stats.early_wakeups++;
+    }
+    pit_account_idle(partial + (uint32_t)mul_div_u64(now - start, PIT_FREQUENCY, NSEC_PER_SEC));
+}
+
+/**
+ * @brief Вход в простой до указанного тика (вытеснение запрещено)
+ * @param target_ticks Значение system_ticks, к которому нужно проснуться
+ *
+ * Вместо периодических тиков на время простоя взводится один one-shot
+ * до дедлайна, выровненный по сетке тиков: hrtimer (LAPIC-таймер
+ * или HPET), если он есть, иначе режим 0 канала 0 PIT. Без дедлайна
+ * простой нарезается на максимально длинные куски. При пробуждении
+ * другим прерыванием прошедшее время добавляется к system_ticks,
+ * после чего восстанавливается периодический режим. Если в очереди
+ * есть отложенная работа или готовые асинхронные задачи, процессор
+ * выполняет их вместо простоя.
+ */
+static void pit_idle_enter(uint32_t target_ticks) {
+    __asm__ volatile("cli");
+    
+    /* Вместо простоя выполняем отложенную работу, оставшуюся
+     * после прохода, прерванного по бюджету */
+    if (softirq_pending()) {
+        __asm__ volatile("sti");
+        softirq_run();
+        return;
+    }
+    
+    /* Так же - с готовыми асинхронными задачами */
+    if (async_idle_pending()) {
+        __asm__ volatile("sti");
+        async_run(&async_idle_executor, ASYNC_IDLE_BUDGET);
+        return;
+    }
+    
+    /* Есть готовые потоки: переключение на них выполнит
+     * sched_preempt_enable() сразу после выхода отсюда */
+    if (sched_need_resched()) {
+        __asm__ volatile("sti");
+        return;
+    }
+    
+    if (!tickless_enabled) {
+        __asm__ volatile("sti; hlt");
+        return;
+    }
+    
+    uint32_t now = system_ticks;
+    if (target_ticks <= now) {
+        __asm__ volatile("sti");
+        return;
+    }
+    
+    uint32_t ticks = target_ticks - now;
+    int use_hrtimer = hrtimer_available();
+    
+    if (!use_hrtimer) {
+        uint32_t max_ticks = 0xFFFF / current_divisor;
+        if (ticks > max_ticks) {
+            ticks = max_ticks;
+        }
+    }
+    
+    /* One-shot на один тик ничего не экономит, а уже поднятый
+     * периодический тик нельзя спутать с истечением one-shot */
+    if (ticks < 2 || irq_is_pending(IRQ_TIMER)) {
+        __asm__ volatile("sti; hlt");
+        return;
+    }
+    
+    /* Часть текущего тика, уже прошедшая с последнего прерывания */
+    uint32_t partial = current_divisor - pit_read_count();
+    
+    if (use_hrtimer) {
+        pit_idle_hrtimer(ticks, partial);
+    } else {
+        pit_idle_oneshot(ticks, partial);
+    }
+    
+    /* Возвращаемся к периодическим тикам */
+    pit_set_divisor(current_divisor);
+    if (use_hrtimer) {
+        irq_unmask(IRQ_TIMER);
+    }
+    __asm__ volatile("sti");
+}
+
+/**
+ * @brief Простой процессора не дольше, чем до указанного тика
+ * @param target_ticks Значение system_ticks, к которому нужно проснуться
+ *
+ * Пока таймер перепрограммирован на простой, поток не вытесняется:
+ * иначе другой поток остался бы без периодических тиков. Если есть
+ * готовые потоки, вместо простоя процессор отдается им.
+ */
+void pit_idle_until(uint32_t target_ticks) {
+    /* PIT принадлежит загрузочному процессору: остальные ждут
+     * своего тика или IPI */
+    if (cpu_current() != 0) {
+        sched_idle_cpu();
+        return;
+    }
+    
+    /* Без hrtimer спящие потоки будит тик - не проспать его */
+    uint32_t wakeup = sched_next_wakeup_tick();
+    if (wakeup < target_ticks) {
+        target_ticks = wakeup;
+    }
+    
+    sched_preempt_disable();
+    pit_idle_enter(target_ticks);
+    sched_preempt_enable();
+}
+
+/**
+ * @brief Монотонный счетчик времени в счетах PIT
+ * @return Количество счетов PIT с момента загрузки
+ *
+ * Складывается из тиков и защелкнутого значения счетчика канала 0.
+ * Если счетчик уже перезагрузился, а IRQ0 еще не обработан,
+ * недостающий тик добавляется вручную. Требует трех обращений
+ * к портам, поэтому заметно дороже чтения TSC или HPET.
+ */
+uint64_t pit_read_counter(void) {
+    uint32_t flags = cpu_irq_save();
+    uint32_t ticks = system_ticks;
+    uint16_t count = pit_read_count();
+    
+    if (!oneshot_ticks && irq_is_pending(IRQ_TIMER)) {
+        ticks++;
+    }
+    uint64_t value = (uint64_t)ticks * current_divisor + pending_counts + (current_divisor - count);
+    
+    cpu_irq_restore(flags);
+    return value;
+}
+
+/**
+ * @brief Запуск однократного отсчета на канале 2 (без прерываний)
+ * @param counts Длительность в счетах PIT
+ */
+void pit_ch2_start(uint16_t counts) {
+    /* Ворота канала 2 открыты, динамик отключен */
+    write_port(PIT_GATE_PORT, (read_port(PIT_GATE_PORT) & ~0x02) | 0x01);
+    
+    write_port(PIT_COMMAND_PORT, PIT_CMD_CHANNEL2 | PIT_CMD_ACCESS_LOHI | PIT_CMD_MODE0);
+    write_port(PIT_CHANNEL2_PORT, counts & 0xFF);
+    write_port(PIT_CHANNEL2_PORT, (counts >> 8) & 0xFF);
+}
+
+/**
+ * @brief Проверка окончания отсчета канала 2
+ * @return Ненулевое значение, если отсчет завершен
+ */
+int pit_ch2_expired(void) {
+    /* Бит 5 порта 0x61 отражает выход OUT2 */
+    return read_port(PIT_GATE_PORT) & 0x20;
+}
+
+/**
+ * @brief Получение статистики tickless-режима
+ * @return Указатель на счетчики (только для чтения)
+ */
+const pit_tickless_stats_t* pit_get_tickless_stats(void) {
+    return &tickless_stats;
+}
+
 /**
  * @brief Вывод информации о состоянии PIT
  */
@@ -160,4 +550,22 @@ void pit_dump_info(void) {
     print_string("  - Time since boot: ");
     print_dec(pit_get_time_ms());
     print_string(" ms\n");
+    print_string("  - Tickless idle: ");
+    print_string(tickless_enabled ? "on\n" : "off\n");
+    print_string("  - Idle one-shots: ");
+    print_dec(tickless_stats.idle_entries);
+    print_string(" (expired: ");
+    print_dec(tickless_stats.oneshot_wakeups);
+    print_string(", early: ");
+    print_dec(tickless_stats.early_wakeups);
+    print_string(")\n");
+    print_string("  - Ticks saved: ");
+    print_dec(tickless_stats.ticks_saved);
+    print_string("\n");
+    print_string("  - Wake-up lateness avg/max: ");
+    print_dec(tickless_stats.oneshot_wakeups ?
+              PIT_COUNTS_TO_US(tickless_stats.lateness_total / tickless_stats.oneshot_wakeups) : 0);
+    print_string("/");
+    print_dec(PIT_COUNTS_TO_US(tickless_stats.lateness_max));
+    print_string(" us\n");
 } 
\ No newline at end of file
@@ -11,14 +11,21 @@
 #define PIT_H
 
 #include <stdint.h>
+#include "../idt/irq.h"
 
 /* Порты PIT */
 #define PIT_COMMAND_PORT 0x43
 #define PIT_CHANNEL0_PORT 0x40
+#define PIT_CHANNEL2_PORT 0x42
+#define PIT_GATE_PORT 0x61        /* Управление воротами канала 2 (порт системы) */
 
 /* Команды PIT */
 #define PIT_CMD_CHANNEL0 0x00
+#define PIT_CMD_CHANNEL2 0x80
+#define PIT_CMD_LATCH 0x00       /* Защелкнуть текущее значение счетчика */
 #define PIT_CMD_ACCESS_LOHI 0x30
+#define PIT_CMD_MODE0 0x00       /* Прерывание по достижении нуля (one-shot) */
+#define PIT_CMD_MODE2 0x04       /* Генератор частоты (периодический) */
 #define PIT_CMD_MODE3 0x06
 
 /* Частота PIT (в Гц) */
@@ -30,6 +37,37 @@
 /* Максимальное значение счетчика для заданной частоты */
 #define PIT_DIVISOR (PIT_FREQUENCY / SYSTEM_TIMER_FREQUENCY)
 
+/* Tickless-режим простоя включен по умолчанию */
+#define PIT_TICKLESS_DEFAULT 1
+
+/* Дедлайн простоя "не ограничен" - спим до ближайшего внешнего события */
+#define PIT_IDLE_NO_DEADLINE 0xFFFFFFFF
+
+/* Длительность калибровочного интервала по каналу 2 (мс) */
+#define PIT_CALIBRATE_MS 20
+#define PIT_CALIBRATE_COUNTS (PIT_FREQUENCY * PIT_CALIBRATE_MS / 1000)
+
+/* Длительность тика в наносекундах */
+#define PIT_TICK_NS(frequency) (1000000000 / (frequency))
+
+/* Предел tickless-простоя без дедлайна при простое на hrtimer (тики) */
+#define PIT_IDLE_MAX_TICKS 100
+
+/* Перевод счетов PIT (~838 нс) в микросекунды */
+#define PIT_COUNTS_TO_US(counts) ((counts) * 838 / 1000)
+
+/**
+ * @brief Статистика tickless-режима
+ */
+typedef struct {
+    uint32_t idle_entries;    /* Входов в простой с one-shot таймером */
+    uint32_t oneshot_wakeups; /* Пробуждений по истечении one-shot */
+    uint32_t early_wakeups;   /* Пробуждений другим прерыванием до дедлайна */
+    uint32_t ticks_saved;     /* Тиков, учтенных без прерывания */
+    uint32_t lateness_total;  /* Суммарное опоздание пробуждения (счеты PIT) */
+    uint32_t lateness_max;    /* Максимальное опоздание пробуждения (счеты PIT) */
+} pit_tickless_stats_t;
+
 /* Глобальная переменная для подсчета тиков */
 extern uint32_t system_ticks;
 
@@ -45,8 +83,9 @@ void pit_init(void);
  * 
  * Вызывается при каждом тике таймера. Увеличивает счетчик тиков
  * и может использоваться для планирования задач.
+ * Регистрируется на IRQ0 через request_irq().
  */
-void pit_handler(void);
+irq_return_t pit_handler(void *ctx);
 
 /**
  * @brief Получение количества системных тиков
@@ -60,6 +99,15 @@ uint32_t pit_get_ticks(void);
  */
 void pit_sleep_ms(uint32_t ms);
 
+/**
+ * @brief Задержка на указанное количество микросекунд
+ * @param us Количество микросекунд для задержки
+ *
+ * При наличии hrtimer (LAPIC-таймер или HPET) задержка имеет микросекундное
+ * разрешение, иначе округляется вверх до тиков PIT.
+ */
+void pit_sleep_us(uint32_t us);
+
 /**
  * @brief Задержка на указанное количество тиков
  * @param ticks Количество тиков для задержки
@@ -84,6 +132,60 @@ void pit_set_frequency(uint32_t frequency);
  */
 uint32_t pit_get_frequency(void);
 
+/**
+ * @brief Включение или отключение tickless-режима простоя
+ * @param enabled 1 - программировать one-shot на время простоя, 0 - периодические тики
+ */
+void pit_set_tickless(int enabled);
+
+/**
+ * @brief Проверка, включен ли tickless-режим
+ * @return 1 если включен, иначе 0
+ */
+int pit_tickless_enabled(void);
+
+/**
+ * @brief Простой процессора до ближайшего прерывания
+ *
+ * Замена голому hlt: в tickless-режиме на время простоя
+ * PIT переводится в one-shot, и пропущенные тики не генерируются.
+ */
+void pit_idle(void);
+
+/**
+ * @brief Простой процессора не дольше, чем до указанного тика
+ * @param target_ticks Значение system_ticks, к которому нужно проснуться
+ */
+void pit_idle_until(uint32_t target_ticks);
+
+/**
+ * @brief Получение статистики tickless-режима
+ * @return Указатель на счетчики (только для чтения)
+ */
+const pit_tickless_stats_t* pit_get_tickless_stats(void);
+
+/**
+ * @brief Монотонный счетчик времени в счетах PIT
+ * @return Количество счетов PIT с момента загрузки
+ *
+ * Используется как источник времени последней очереди.
+ */
+uint64_t pit_read_counter(void);
+
+/**
+ * @brief Запуск однократного отсчета на канале 2 (без прерываний)
+ * @param counts Длительность в счетах PIT
+ *
+ * Используется для калибровки TSC и LAPIC-таймера при загрузке.
+ */
+void pit_ch2_start(uint16_t counts);
+
+/**
+ * @brief Проверка окончания отсчета канала 2
+ * @return Ненулевое значение, если отсчет завершен
+ */
+int pit_ch2_expired(void);
+
 /**
  * @brief Вывод информации о состоянии PIT
  */
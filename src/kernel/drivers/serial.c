@@ -0,0 +1,74 @@
+/**
+ * @file serial.c
+ * @brief Драйвер последовательного порта (UART 16550, COM1)
+ *
+ * Передача ведется опросом регистра состояния линии, без прерываний:
+ * драйвер должен работать с самого раннего этапа загрузки и из
+ * любого контекста, включая обработчики прерываний.
+ */
+
+#include "serial.h"
+#include "../idt/idt.h"
+#include "../lib/compiler.h"
+
+/* Порт инициализирован и прошел проверку */
+static int serial_ready = 0;
+
+/**
+ * @brief Инициализация COM1 (115200, 8N1, без прерываний)
+ * @return 1 если порт отвечает (проверка в режиме петли)
+ */
+__cold int serial_init(void) {
+    uint16_t divisor = SERIAL_BAUD_BASE / SERIAL_BAUD;
+    
+    write_port(SERIAL_COM1 + SERIAL_INT_ENABLE, 0x00);          /* Без прерываний */
+    write_port(SERIAL_COM1 + SERIAL_LINE_CTRL, SERIAL_LCR_DLAB);
+    write_port(SERIAL_COM1 + SERIAL_DATA, divisor & 0xFF);
+    write_port(SERIAL_COM1 + SERIAL_INT_ENABLE, divisor >> 8);
+    write_port(SERIAL_COM1 + SERIAL_LINE_CTRL, SERIAL_LCR_8N1);
+    write_port(SERIAL_COM1 + SERIAL_FIFO_CTRL, 0xC7);           /* FIFO, очистка, порог 14 байт */
+    
+    /* Проверка в режиме петли: отправленный байт должен вернуться */
+    write_port(SERIAL_COM1 + SERIAL_MODEM_CTRL, 0x1E);
+    write_port(SERIAL_COM1 + SERIAL_DATA, 0xAE);
+    if (read_port(SERIAL_COM1 + SERIAL_DATA) != 0xAE) {
+        return 0;
+    }
+    
+    /* Обычный режим: DTR, RTS, OUT2 */
+    write_port(SERIAL_COM1 + SERIAL_MODEM_CTRL, 0x0B);
+    serial_ready = 1;
+    return 1;
+}
+
+/**
+ * @brief Проверка готовности порта
+ */
+int serial_available(void) {
+    return serial_ready;
+}
+
+/**
+ * @brief Отправка символа (с ожиданием готовности передатчика)
+ * @param c Символ ('\n' дополняется '\r')
+ */
+void serial_write_char(char c) {
+    if (!serial_ready) {
+        return;
+    }
+    if (c == '\n') {
+        serial_write_char('\r');
+    }
+    while (!(read_port(SERIAL_COM1 + SERIAL_LINE_STATUS) & SERIAL_LSR_TX_EMPTY));
+    write_port(SERIAL_COM1 + SERIAL_DATA, c);
+}
+
+/**
+ * @brief Отправка строки
+ * @param str Строка
+ */
+void serial_write_string(const char *str) {
+    while (*str) {
+        serial_write_char(*str++);
+    }
+}
@@ -0,0 +1,57 @@
+/**
+ * @file serial.h
+ * @brief Драйвер последовательного порта (UART 16550, COM1)
+ *
+ * Используется для отладочного вывода: консольный вывод дублируется
+ * в COM1, откуда его можно забрать с помощью QEMU (-serial stdio).
+ */
+
+#ifndef KERNEL_SERIAL_H
+#define KERNEL_SERIAL_H
+
+#include <stdint.h>
+
+/* Базовый порт COM1 */
+#define SERIAL_COM1 0x3F8
+
+/* Регистры UART (смещения от базового порта) */
+#define SERIAL_DATA        0   /* Данные / младший байт делителя (DLAB=1) */
+#define SERIAL_INT_ENABLE  1   /* Разрешение прерываний / старший байт делителя */
+#define SERIAL_FIFO_CTRL   2
+#define SERIAL_LINE_CTRL   3
+#define SERIAL_MODEM_CTRL  4
+#define SERIAL_LINE_STATUS 5
+
+/* Биты регистров */
+#define SERIAL_LCR_8N1       0x03
+#define SERIAL_LCR_DLAB      0x80
+#define SERIAL_LSR_TX_EMPTY  0x20
+
+/* Скорость обмена */
+#define SERIAL_BAUD      115200
+#define SERIAL_BAUD_BASE 115200
+
+/**
+ * @brief Инициализация COM1 (115200, 8N1, без прерываний)
+ * @return 1 если порт отвечает (проверка в режиме петли)
+ */
+int serial_init(void);
+
+/**
+ * @brief Проверка готовности порта
+ */
+int serial_available(void);
+
+/**
+ * @brief Отправка символа (с ожиданием готовности передатчика)
+ * @param c Символ ('\n' дополняется '\r')
+ */
+void serial_write_char(char c);
+
+/**
+ * @brief Отправка строки
+ * @param str Строка
+ */
+void serial_write_string(const char *str);
+
+#endif /* KERNEL_SERIAL_H */
@@ -7,6 +7,10 @@
 
 #include "pit.h"
 #include "../video/video.h"
+#include "../time/hrtimer.h"
+#include "../lib/math64.h"
+#include "../idt/softirq.h"
+#include "../cpu/cpu.h"
 
 /**
  * @brief Тест базовых функций таймера
@@ -132,6 +136,184 @@ void test_timer_performance(void) {
     print_string("Performance test passed!\n");
 }
 
+/**
+ * @brief Тест tickless-режима простоя
+ */
+void test_timer_tickless(void) {
+    print_string("\n=== Tickless Idle Test ===\n");
+    
+    const pit_tickless_stats_t *stats = pit_get_tickless_stats();
+    uint32_t saved_before = stats->ticks_saved;
+    uint32_t entries_before = stats->idle_entries;
+    
+    /* Одна секунда простоя в tickless-режиме */
+    pit_set_tickless(1);
+    uint32_t start_time = pit_get_time_ms();
+    pit_sleep_ms(1000);
+    uint32_t tickless_time = pit_get_time_ms() - start_time;
+    
+    /* Та же секунда с периодическими тиками */
+    pit_set_tickless(0);
+    start_time = pit_get_time_ms();
+    pit_sleep_ms(1000);
+    uint32_t periodic_time = pit_get_time_ms() - start_time;
+    pit_set_tickless(PIT_TICKLESS_DEFAULT);
+    
+    print_string("1 second tickless: ");
+    print_dec(tickless_time);
+    print_string(" ms, periodic: ");
+    print_dec(periodic_time);
+    print_string(" ms\n");
+    print_string("One-shots armed: ");
+    print_dec(stats->idle_entries - entries_before);
+    print_string(", ticks saved: ");
+    print_dec(stats->ticks_saved - saved_before);
+    print_string("\n");
+    
+    pit_dump_info();
+}
+
+/**
+ * @brief Тест субмиллисекундных задержек на hrtimer
+ */
+void test_timer_hrtimer(void) {
+    print_string("\n=== High-Resolution Timer Test ===\n");
+    
+    if (!hrtimer_available()) {
+        print_string("hrtimer not available, skipping\n");
+        return;
+    }
+    
+    uint32_t delays[] = {50, 100, 250, 500, 2000}; /* микросекунды */
+    int num_delays = sizeof(delays) / sizeof(delays[0]);
+    
+    for (int i = 0; i < num_delays; i++) {
+        uint64_t start = hrtimer_now_ns();
+        pit_sleep_us(delays[i]);
+        uint64_t actual = hrtimer_now_ns() - start;
+        
+        print_string("Requested: ");
+        print_dec(delays[i]);
+        print_string(" us, Actual: ");
+        print_dec((uint32_t)div_u64(actual, NSEC_PER_USEC));
+        print_string(" us\n");
+    }
+    
+    hrtimer_dump_info();
+}
+
+/* Вызовы дополнительного обработчика IRQ0 */
+static volatile uint32_t chained_calls = 0;
+
+/**
+ * @brief Дополнительный обработчик IRQ0: не признает прерывание своим
+ */
+static irq_return_t test_chained_handler(void *ctx) {
+    (void)ctx;
+    chained_calls++;
+    return IRQ_NONE;
+}
+
+/**
+ * @brief Тест диспетчера прерываний: цепочка обработчиков на IRQ0
+ */
+void test_timer_irq_dispatch(void) {
+    print_string("\n=== IRQ Dispatch Test ===\n");
+    
+    irq_stats_t stats;
+    int was_tickless = pit_tickless_enabled();
+    
+    /* Периодические тики, чтобы IRQ0 приходил на каждом тике */
+    pit_set_tickless(0);
+    chained_calls = 0;
+    irq_get_stats(IRQ_VECTOR(IRQ_TIMER), &stats);
+    uint32_t start_count = stats.count;
+    uint32_t start_unhandled = stats.unhandled;
+    
+    request_irq(IRQ_TIMER, test_chained_handler, NULL);
+    pit_sleep_ticks(20);
+    free_irq(IRQ_TIMER, test_chained_handler, NULL);
+    
+    irq_get_stats(IRQ_VECTOR(IRQ_TIMER), &stats);
+    uint32_t delivered = stats.count - start_count;
+    print_string("IRQ0 delivered: ");
+    print_dec(delivered);
+    print_string(", chained handler calls: ");
+    print_dec(chained_calls);
+    print_string("\n");
+    
+    /* pit_handler признает каждый тик, поэтому необработанных быть не должно */
+    if (chained_calls > 0 && chained_calls <= delivered && stats.unhandled == start_unhandled) {
+        print_string_color("Shared line chaining OK\n", COLOR_GREEN, COLOR_BLACK);
+    } else {
+        print_string_color("Shared line chaining FAILED\n", COLOR_RED, COLOR_BLACK);
+    }
+    
+    pit_set_tickless(was_tickless);
+    irq_dump_stats();
+}
+
+/* Отложенная работа теста и ее результаты */
+static softirq_work_t test_work;
+static volatile uint32_t deferred_runs = 0;
+static volatile uint32_t deferred_irq_off = 0;
+
+/**
+ * @brief Отложенная работа: проверяет, что прерывания разрешены
+ */
+static void test_deferred_fn(void *ctx) {
+    (void)ctx;
+    uint32_t flags = cpu_irq_save();
+    cpu_irq_restore(flags);
+    if (!(flags & EFLAGS_IF)) {
+        deferred_irq_off++;
+    }
+    deferred_runs++;
+}
+
+/**
+ * @brief Дополнительный обработчик IRQ0: откладывает работу
+ */
+static irq_return_t test_deferring_handler(void *ctx) {
+    (void)ctx;
+    softirq_queue(&test_work);
+    return IRQ_NONE;
+}
+
+/**
+ * @brief Тест отложенной обработки: работа из IRQ0 выполняется
+ * с разрешенными прерываниями
+ */
+void test_timer_softirq(void) {
+    print_string("\n=== Softirq Test ===\n");
+    
+    int was_tickless = pit_tickless_enabled();
+    pit_set_tickless(0);
+    
+    softirq_work_init(&test_work, test_deferred_fn, NULL);
+    deferred_runs = 0;
+    deferred_irq_off = 0;
+    
+    request_irq(IRQ_TIMER, test_deferring_handler, NULL);
+    pit_sleep_ticks(20);
+    free_irq(IRQ_TIMER, test_deferring_handler, NULL);
+    
+    print_string("Deferred runs: ");
+    print_dec(deferred_runs);
+    print_string(", with interrupts disabled: ");
+    print_dec(deferred_irq_off);
+    print_string("\n");
+    
+    if (deferred_runs > 0 && deferred_irq_off == 0) {
+        print_string_color("Deferred work OK\n", COLOR_GREEN, COLOR_BLACK);
+    } else {
+        print_string_color("Deferred work FAILED\n", COLOR_RED, COLOR_BLACK);
+    }
+    
+    pit_set_tickless(was_tickless);
+    softirq_dump_stats();
+}
+
 /**
  * @brief Запуск всех тестов таймера
  */
@@ -142,6 +324,10 @@ void run_timer_tests(void) {
     test_timer_frequency();
     test_timer_accuracy();
     test_timer_performance();
+    test_timer_tickless();
+    test_timer_hrtimer();
+    test_timer_irq_dispatch();
+    test_timer_softirq();
     
     print_string("\n✅ Timer Tests Completed!\n");
 } 
\ No newline at end of file
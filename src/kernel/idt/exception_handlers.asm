@@ -73,9 +73,7 @@ common_isr_stub:
     
     mov ax, 0x10 ; Загружаем селектор сегмента данных ядра (0x10)
     mov ds, ax
-    mov es, ax
-    mov fs, ax
-    mov gs, ax
+    mov es, ax   ; %gs не трогаем: он указывает на данные процессора
     
     ; Передаем указатель на стек (где теперь лежат регистры) в C-функцию
     push esp
@@ -85,8 +83,6 @@ common_isr_stub:
     pop eax     ; Восстанавливаем исходный сегмент данных
     mov ds, ax
     mov es, ax
-    mov fs, ax
-    mov gs, ax
     
     popa        ; Восстанавливаем все регистры общего назначения
     add esp, 8  ; Очищаем стек от кода ошибки и номера прерывания
@@ -5,6 +5,8 @@
 
 #include "exceptions.h"
 #include "../video/video.h"
+#include "../cpu/cpu.h"
+#include "../memory/vmm.h"
 
 // Сообщения для каждого типа исключений
 const char *exception_messages[] = {
@@ -45,11 +47,17 @@ const char *exception_messages[] = {
 /**
  * @brief Основной обработчик исключений, вызываемый из ассемблерных заглушек.
  * 
- * Выводит на экран информацию об исключении и останавливает систему.
+ * Page Fault в ленивой области разрешается выделением страницы,
+ * и команда повторяется. Остальные исключения выводятся на экран
+ * и останавливают систему.
  * @param regs Сохраненные регистры.
  */
 void exception_handler(registers_t *regs)
 {
+    if (regs->int_no == 14 && vmm_handle_fault(read_cr2(), regs->err_code) == 0) {
+        return;
+    }
+    
     // Установка красного цвета для сообщения об ошибке
     set_color(COLOR_RED, COLOR_BLACK);
     
@@ -64,6 +72,15 @@ void exception_handler(registers_t *regs)
     print_string(" (");
     print_dec(regs->int_no);
     print_string(")\n");
+    
+    // Для Page Fault - адрес обращения и причина
+    if (regs->int_no == 14) {
+        print_string("Address: ");
+        print_hex(read_cr2());
+        print_string(", error code: ");
+        print_hex(regs->err_code);
+        print_string("\n");
+    }
     print_string("System Halted!\n");
 
     // Остановка системы
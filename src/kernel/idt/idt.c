@@ -3,13 +3,16 @@
  * @brief Реализация таблицы дескрипторов прерываний (IDT)
  *
  * Содержит инициализацию IDT и настройку контроллера прерываний (PIC).
- * Обрабатывает аппаратные прерывания, включая прерывания клавиатуры.
+ * Внешние прерывания передаются общему диспетчеру (irq_dispatch.c).
  */
 
 #include "idt.h"
 #include <stdint.h>
 #include "../video/video.h"
 #include "exceptions.h" // Подключаем заголовок с обработчиками
+#include "pic.h"
+#include "irq.h"
+#include "../lib/compiler.h"
 
 /* Объявление внешних ассемблерных обработчиков-заглушек */
 extern void isr0();
@@ -45,9 +48,6 @@ extern void isr29();
 extern void isr30();
 extern void isr31();
 
-/* Объявление обработчика прерывания PIT */
-extern void pit_handler_asm();
-
 /* Глобальная таблица IDT */
 struct IDT_entry IDT[IDT_SIZE];
 
@@ -63,11 +63,11 @@ void idt_set_gate(int n, unsigned long handler) {
  * @brief Инициализация IDT и PIC
  * 
  * Функция выполняет:
- * 1. Настройку дескриптора прерывания клавиатуры (IRQ1)
+ * 1. Установку заглушек исключений и внешних прерываний
  * 2. Переназначение векторов прерываний в PIC
  * 3. Загрузку IDT с помощью lidt
  */
-void idt_init(void)
+__cold void idt_init(void)
 {
     print_string("IDT Initialization... ");  // Добавлено: статусное сообщение
     
@@ -105,33 +105,14 @@ void idt_init(void)
     idt_set_gate(30, (unsigned long)isr30);
     idt_set_gate(31, (unsigned long)isr31);
 
-    /* 1. Настройка обработчика клавиатуры (IRQ1 -> INT 0x21) */
-    idt_set_gate(0x21, (unsigned long)keyboard_handler);
-
-    /* Настройка обработчика системного таймера (IRQ0 -> INT 0x20) */
-    idt_set_gate(0x20, (unsigned long)pit_handler_asm);
-
-    /* 2. Перенастройка PIC (Programmable Interrupt Controller) */
-    
-    /* ICW1 - начало инициализации */
-    write_port(0x20, 0x11);  // Основной PIC
-    write_port(0xA0, 0x11);  // Вторичный PIC
-
-    /* ICW2 - переназначение базовых векторов */
-    write_port(0x21, 0x20);  // Основные прерывания начиная с 0x20
-    write_port(0xA1, 0x28);  // Вторичные прерывания начиная с 0x28
+    /* 1. Заглушки внешних прерываний (векторы 32-255) ведут в общий
+     * диспетчер; драйверы регистрируют обработчики через request_irq() */
+    irq_init();
 
-    /* ICW3 - настройка каскадирования */
-    write_port(0x21, 0x00);  // Нет ведомого PIC на линии IRQ2
-    write_port(0xA1, 0x00);  // Не используется
-
-    /* ICW4 - дополнительная информация */
-    write_port(0x21, 0x01);  // Режим 8086/88
-    write_port(0xA1, 0x01);  // Режим 8086/88
-
-    /* Маскирование всех прерываний */
-    write_port(0x21, 0xff);  // Основной PIC
-    write_port(0xA1, 0xff);  // Вторичный PIC
+    /* 2. Перенастройка PIC (Programmable Interrupt Controller)
+     * Все линии остаются замаскированными; если позже будет включен
+     * APIC, 8259 будет замаскирован полностью (см. apic_init()) */
+    pic_remap(IRQ_VECTOR(0), IRQ_VECTOR(8));
 
     /* 3. Загрузка IDT */
     unsigned long idt_address;
@@ -146,6 +127,21 @@ void idt_init(void)
     print_string_color("OK\n", COLOR_GREEN, COLOR_BLACK);  // Добавлено: успешный статус
 }
 
+/**
+ * @brief Загрузка IDT на текущем процессоре (без sti)
+ *
+ * Вызывается прикладными процессорами: таблица общая для всех.
+ */
+void idt_load_cpu(void) {
+    unsigned long idt_address = (unsigned long)IDT;
+    unsigned long idt_ptr[2];
+    idt_ptr[0] = (sizeof(struct IDT_entry) * IDT_SIZE) - 1;
+    idt_ptr[0] |= (idt_address & 0xFFFF) << 16;
+    idt_ptr[1] = idt_address >> 16;
+    
+    __asm__ volatile("lidt (%0)" : : "r"(idt_ptr) : "memory");
+}
+
 /**
  * @brief Считывает байт из указанного порта ввода-вывода
  * 
@@ -42,15 +42,22 @@ extern struct IDT_entry IDT[IDT_SIZE];
 void idt_init(void);
 
 /**
- * @brief Загружает IDT (ассемблерная функция)
- * @param idt_ptr Указатель на структуру для команды LIDT
+ * @brief Устанавливает шлюз прерывания в IDT
+ * @param n Номер вектора
+ * @param handler Адрес обработчика
  */
-extern void load_idt(unsigned long *idt_ptr);
+void idt_set_gate(int n, unsigned long handler);
+
+/**
+ * @brief Загрузка IDT на текущем процессоре (без разрешения прерываний)
+ */
+void idt_load_cpu(void);
 
 /**
- * @brief Обработчик прерываний клавиатуры (ассемблерная функция)
+ * @brief Загружает IDT (ассемблерная функция)
+ * @param idt_ptr Указатель на структуру для команды LIDT
  */
-extern void keyboard_handler(void);
+extern void load_idt(unsigned long *idt_ptr);
 
 /**
  * @brief Записывает байт в порт ввода-вывода
@@ -72,4 +79,28 @@ static inline void write_port(unsigned short port, unsigned char data) {
  */
 uint8_t read_port(uint16_t port);
 
+/**
+ * @brief Запись и чтение 16- и 32-битных портов ввода-вывода
+ * @param port Номер порта
+ */
+static inline void write_port16(uint16_t port, uint16_t data) {
+    __asm__ volatile("outw %0, %1" : : "a"(data), "Nd"(port));
+}
+
+static inline uint16_t read_port16(uint16_t port) {
+    uint16_t result;
+    __asm__ volatile("inw %1, %0" : "=a"(result) : "Nd"(port));
+    return result;
+}
+
+static inline void write_port32(uint16_t port, uint32_t data) {
+    __asm__ volatile("outl %0, %1" : : "a"(data), "Nd"(port));
+}
+
+static inline uint32_t read_port32(uint16_t port) {
+    uint32_t result;
+    __asm__ volatile("inl %1, %0" : "=a"(result) : "Nd"(port));
+    return result;
+}
+
 #endif /* KERNEL_IDT_H */
\ No newline at end of file
@@ -2,18 +2,14 @@
 ;; @file idt_load.asm
 ;; @brief Ассемблерные функции для работы с IDT
 ;; 
-;; Содержит низкоуровневые функции для загрузки IDT
-;; и обработки прерываний клавиатуры.
+;; Содержит низкоуровневую функцию загрузки IDT.
+;; Точки входа внешних прерываний находятся в irq_stubs.asm.
 ;;
 
 [bits 32]   ; Указываем, что код должен компилироваться в 32-битном режиме
 
 ; Экспортируем символы для использования в C-коде
 global load_idt          ; Функция загрузки IDT
-global keyboard_handler  ; Обработчик прерываний клавиатуры
-
-; Импортируем C-функцию обработки клавиатуры
-extern keyboard_handler_main
 
 ;;
 ;; @brief Загружает IDT и включает прерывания
@@ -24,15 +20,3 @@ load_idt:
     lidt [edx]          ; Загружаем IDT
     sti                 ; Разрешаем прерывания (Set Interrupt Flag)
     ret                 ; Возврат из функции
-
-;;
-;; @brief Обработчик прерывания клавиатуры
-;; 
-;; Сохраняет регистры, вызывает C-обработчик, затем восстанавливает регистры
-;; и возвращает управление через iretd
-;;
-keyboard_handler:
-    pushad              ; Сохраняем все основные регистры общего назначения
-    call keyboard_handler_main  ; Вызываем C-обработчик
-    popad               ; Восстанавливаем регистры
-    iretd               ; Возврат из прерывания (32-битная версия iret)
\ No newline at end of file
@@ -0,0 +1,85 @@
+/**
+ * @file irq.c
+ * @brief Управление линиями аппаратных прерываний
+ *
+ * Выбирает контроллер прерываний: I/O APIC + локальный APIC
+ * (EOI через MMIO) или, при их отсутствии, пару 8259.
+ */
+
+#include "irq.h"
+#include <stddef.h>
+#include "pic.h"
+#include "../apic/apic.h"
+#include "../acpi/acpi.h"
+
+/**
+ * @brief Размаскирование линии IRQ
+ * @param irq Номер линии ISA
+ */
+void irq_unmask(uint8_t irq) {
+    if (apic_enabled()) {
+        ioapic_unmask(acpi_irq_to_gsi(irq, NULL));
+    } else {
+        pic_unmask(irq);
+    }
+}
+
+/**
+ * @brief Маскирование линии IRQ
+ * @param irq Номер линии ISA
+ */
+void irq_mask(uint8_t irq) {
+    if (apic_enabled()) {
+        ioapic_mask(acpi_irq_to_gsi(irq, NULL));
+    } else {
+        pic_mask(irq);
+    }
+}
+
+/**
+ * @brief Проверка, замаскирована ли линия IRQ
+ * @param irq Номер линии ISA
+ */
+int irq_is_masked(uint8_t irq) {
+    if (apic_enabled()) {
+        return ioapic_is_masked(acpi_irq_to_gsi(irq, NULL));
+    }
+    return pic_is_masked(irq);
+}
+
+/**
+ * @brief Проверка, ожидает ли линия IRQ доставки процессору
+ * @param irq Номер линии ISA
+ */
+int irq_is_pending(uint8_t irq) {
+    if (apic_enabled()) {
+        return lapic_is_pending(IRQ_VECTOR(irq));
+    }
+    return pic_is_pending(irq);
+}
+
+/**
+ * @brief Подтверждение обработки прерывания (EOI)
+ * @param irq Номер линии ISA
+ */
+void irq_eoi(uint8_t irq) {
+    if (apic_enabled()) {
+        lapic_eoi();
+    } else {
+        pic_send_eoi(irq);
+    }
+}
+
+/**
+ * @brief Направление линии IRQ на указанный процессор
+ * @param irq Номер линии ISA
+ * @param apic_id APIC ID процессора-получателя
+ * @return 0 при успехе, -1 если APIC недоступен
+ */
+int irq_set_affinity(uint8_t irq, uint8_t apic_id) {
+    if (!apic_enabled()) {
+        return -1;
+    }
+    ioapic_set_destination(acpi_irq_to_gsi(irq, NULL), apic_id);
+    return 0;
+}
@@ -0,0 +1,170 @@
+/**
+ * @file irq.h
+ * @brief Управление линиями аппаратных прерываний
+ *
+ * Единый интерфейс маскирования и подтверждения IRQ, который
+ * работает через I/O APIC + локальный APIC, если они доступны,
+ * и через пару 8259 в противном случае.
+ *
+ * Все внешние векторы (32-255) входят через сгенерированные заглушки
+ * в общий диспетчер, который вызывает цепочку зарегистрированных
+ * обработчиков, посылает EOI и ведет статистику по векторам.
+ */
+
+#ifndef KERNEL_IRQ_H
+#define KERNEL_IRQ_H
+
+#include <stdint.h>
+#include "irq_profile.h"
+
+/* Векторы внешних прерываний начинаются сразу за исключениями */
+#define IRQ_BASE_VECTOR 0x20
+#define IRQ_VECTOR(irq) (IRQ_BASE_VECTOR + (irq))
+
+/* Количество линий ISA */
+#define IRQ_ISA_COUNT 16
+
+/* Количество векторов внешних прерываний (32-255) */
+#define IRQ_VECTOR_COUNT (256 - IRQ_BASE_VECTOR)
+
+/* Стандартные линии ISA */
+#define IRQ_TIMER    0
+#define IRQ_KEYBOARD 1
+
+/* Линии, на которых 8259 выдает ложные прерывания */
+#define IRQ_SPURIOUS_MASTER 7
+#define IRQ_SPURIOUS_SLAVE  15
+
+/* Размер пула обработчиков (на все векторы) */
+#define IRQ_MAX_ACTIONS 64
+
+/**
+ * @brief Результат обработчика прерывания
+ *
+ * На разделяемой линии каждый обработчик проверяет свое устройство
+ * и возвращает IRQ_NONE, если прерывание не его.
+ */
+typedef enum {
+    IRQ_NONE = 0,             /* Прерывание не от этого устройства */
+    IRQ_HANDLED = 1           /* Прерывание обработано */
+} irq_return_t;
+
+/**
+ * @brief Обработчик прерывания
+ *
+ * Вызывается с запрещенными прерываниями; EOI посылает диспетчер.
+ * Все, что может подождать, переносится в softirq (softirq.h).
+ */
+typedef irq_return_t (*irq_handler_t)(void *ctx);
+
+/**
+ * @brief Статистика вектора
+ */
+typedef struct {
+    uint32_t count;           /* Обработанных прерываний */
+    uint32_t unhandled;       /* Ни один обработчик не признал прерывание */
+    uint32_t spurious;        /* Ложных прерываний */
+    uint64_t cycles_total;    /* Такты TSC в обработчиках */
+    uint32_t cycles_min;      /* Минимум тактов за одно прерывание */
+    uint32_t cycles_max;      /* Максимум тактов за одно прерывание */
+    uint32_t hist[IRQ_HIST_BUCKETS]; /* log2-гистограмма длительностей */
+} irq_stats_t;
+
+/**
+ * @brief Размаскирование линии IRQ
+ * @param irq Номер линии ISA
+ */
+void irq_unmask(uint8_t irq);
+
+/**
+ * @brief Маскирование линии IRQ
+ * @param irq Номер линии ISA
+ */
+void irq_mask(uint8_t irq);
+
+/**
+ * @brief Проверка, замаскирована ли линия IRQ
+ * @param irq Номер линии ISA
+ */
+int irq_is_masked(uint8_t irq);
+
+/**
+ * @brief Проверка, ожидает ли линия IRQ доставки процессору
+ * @param irq Номер линии ISA
+ */
+int irq_is_pending(uint8_t irq);
+
+/**
+ * @brief Подтверждение обработки прерывания (EOI)
+ * @param irq Номер линии ISA
+ */
+void irq_eoi(uint8_t irq);
+
+/**
+ * @brief Направление линии IRQ на указанный процессор
+ * @param irq Номер линии ISA
+ * @param apic_id APIC ID процессора-получателя
+ * @return 0 при успехе, -1 если APIC недоступен
+ */
+int irq_set_affinity(uint8_t irq, uint8_t apic_id);
+
+/**
+ * @brief Установка шлюзов IDT для всех внешних векторов
+ *
+ * Вызывается из idt_init(); до регистрации обработчиков
+ * прерывание на любом векторе учитывается как необработанное.
+ */
+void irq_init(void);
+
+/**
+ * @brief Регистрация обработчика линии ISA
+ * @param irq Номер линии ISA
+ * @param handler Обработчик
+ * @param ctx Аргумент обработчика
+ * @return 0 при успехе, -1 если пул обработчиков исчерпан
+ *
+ * Обработчики одной линии образуют цепочку и вызываются по порядку
+ * регистрации. Первый обработчик размаскирует линию.
+ */
+int request_irq(uint8_t irq, irq_handler_t handler, void *ctx);
+
+/**
+ * @brief Регистрация обработчика вектора, не связанного с линией ISA
+ * @param vector Номер вектора (LAPIC-таймер, HPET, IPI)
+ * @param handler Обработчик
+ * @param ctx Аргумент обработчика
+ * @return 0 при успехе, -1 если пул исчерпан или вектор недопустим
+ *
+ * EOI для таких векторов посылается локальному APIC.
+ */
+int request_vector(uint8_t vector, irq_handler_t handler, void *ctx);
+
+/**
+ * @brief Удаление обработчика линии ISA
+ * @param irq Номер линии ISA
+ * @param handler Обработчик
+ * @param ctx Аргумент, с которым он регистрировался
+ *
+ * Линия маскируется, когда цепочка становится пустой.
+ */
+void free_irq(uint8_t irq, irq_handler_t handler, void *ctx);
+
+/**
+ * @brief Диспетчер внешних прерываний (вызывается из заглушек)
+ * @param vector Номер вектора
+ */
+void irq_dispatch(uint32_t vector);
+
+/**
+ * @brief Статистика вектора, сложенная по всем процессорам
+ * @param vector Номер вектора
+ * @param stats Выход: сумма счетчиков (нули для векторов исключений)
+ */
+void irq_get_stats(uint8_t vector, irq_stats_t *stats);
+
+/**
+ * @brief Вывод статистики по векторам, на которых были прерывания
+ */
+void irq_dump_stats(void);
+
+#endif /* KERNEL_IRQ_H */
@@ -0,0 +1,319 @@
+/**
+ * @file irq_dispatch.c
+ * @brief Диспетчер внешних прерываний
+ *
+ * Каждому вектору 32-255 соответствует цепочка обработчиков.
+ * Обработчики берутся из статического пула: драйверы регистрируются
+ * раньше, чем появляется куча ядра. Цепочки обходятся на каждом
+ * прерывании любого процессора, а меняются редко, поэтому защищены
+ * блокировкой читателей-писателей: диспетчер берет ее на чтение,
+ * регистрация и удаление - на запись с запрещенными прерываниями.
+ *
+ * После EOI диспетчер запускает отложенную работу (softirq.c)
+ * с разрешенными прерываниями, а затем дает планировщику
+ * вытеснить прерванный поток.
+ */
+
+#include "irq.h"
+#include "idt.h"
+#include "pic.h"
+#include "softirq.h"
+#include "../apic/apic.h"
+#include "../cpu/cpu.h"
+#include "../lib/math64.h"
+#include "../memory/memory.h"
+#include "../sched/sched.h"
+#include "../sync/rwlock.h"
+#include "../video/video.h"
+#include "../lib/compiler.h"
+#include <stddef.h>
+
+/**
+ * @brief Зарегистрированный обработчик
+ */
+typedef struct irq_action {
+    irq_handler_t handler;
+    void *ctx;
+    struct irq_action *next;  /* Следующий обработчик того же вектора */
+} irq_action_t;
+
+/* Таблица адресов заглушек (irq_stubs.asm) */
+extern uint32_t irq_stub_table[IRQ_VECTOR_COUNT];
+
+/* Пул обработчиков и список свободных элементов */
+static irq_action_t action_pool[IRQ_MAX_ACTIONS];
+static irq_action_t *free_actions = NULL;
+
+/* Цепочки обработчиков по векторам */
+static irq_action_t *vector_actions[IRQ_VECTOR_COUNT];
+
+/* Блокировка цепочек и пула */
+static rwlock_t actions_lock = RWLOCK_INIT;
+
+/* Статистика по векторам: у каждого процессора своя, векторы LAPIC
+ * приходят на все процессоры сразу */
+static irq_stats_t vector_stats[MAX_CPUS][IRQ_VECTOR_COUNT];
+
+/**
+ * @brief Установка шлюзов IDT для всех внешних векторов
+ */
+void irq_init(void) {
+    for (uint32_t i = 0; i < IRQ_MAX_ACTIONS; i++) {
+        action_pool[i].next = free_actions;
+        free_actions = &action_pool[i];
+    }
+    
+    for (uint32_t i = 0; i < IRQ_VECTOR_COUNT; i++) {
+        idt_set_gate(IRQ_BASE_VECTOR + i, irq_stub_table[i]);
+    }
+    
+    irq_profile_init();
+}
+
+/**
+ * @brief Добавление обработчика в конец цепочки вектора
+ * @return 1 если цепочка была пуста, 0 если нет, -1 при ошибке
+ */
+static int irq_add_action(uint8_t vector, irq_handler_t handler, void *ctx) {
+    if (vector < IRQ_BASE_VECTOR || !handler) {
+        return -1;
+    }
+    
+    uint32_t flags = write_lock_irqsave(&actions_lock);
+    
+    irq_action_t *action = free_actions;
+    if (!action) {
+        write_unlock_irqrestore(&actions_lock, flags);
+        return -1;
+    }
+    free_actions = action->next;
+    
+    action->handler = handler;
+    action->ctx = ctx;
+    action->next = NULL;
+    
+    irq_action_t **link = &vector_actions[vector - IRQ_BASE_VECTOR];
+    int was_empty = (*link == NULL);
+    while (*link) {
+        link = &(*link)->next;
+    }
+    *link = action;
+    
+    write_unlock_irqrestore(&actions_lock, flags);
+    return was_empty;
+}
+
+/**
+ * @brief Регистрация обработчика линии ISA
+ * @param irq Номер линии ISA
+ * @param handler Обработчик
+ * @param ctx Аргумент обработчика
+ * @return 0 при успехе, -1 если пул обработчиков исчерпан
+ */
+int request_irq(uint8_t irq, irq_handler_t handler, void *ctx) {
+    if (irq >= IRQ_ISA_COUNT) {
+        return -1;
+    }
+    
+    int first = irq_add_action(IRQ_VECTOR(irq), handler, ctx);
+    if (first < 0) {
+        return -1;
+    }
+    if (first) {
+        irq_unmask(irq);
+    }
+    return 0;
+}
+
+/**
+ * @brief Регистрация обработчика вектора, не связанного с линией ISA
+ * @param vector Номер вектора
+ * @param handler Обработчик
+ * @param ctx Аргумент обработчика
+ * @return 0 при успехе, -1 если пул исчерпан или вектор недопустим
+ */
+int request_vector(uint8_t vector, irq_handler_t handler, void *ctx) {
+    if (vector < IRQ_VECTOR(IRQ_ISA_COUNT)) {
+        return -1;
+    }
+    return irq_add_action(vector, handler, ctx) < 0 ? -1 : 0;
+}
+
+/**
+ * @brief Удаление обработчика линии ISA
+ * @param irq Номер линии ISA
+ * @param handler Обработчик
+ * @param ctx Аргумент, с которым он регистрировался
+ */
+void free_irq(uint8_t irq, irq_handler_t handler, void *ctx) {
+    if (irq >= IRQ_ISA_COUNT) {
+        return;
+    }
+    
+    uint32_t flags = write_lock_irqsave(&actions_lock);
+    
+    irq_action_t **link = &vector_actions[IRQ_VECTOR(irq) - IRQ_BASE_VECTOR];
+    while (*link) {
+        irq_action_t *action = *link;
+        if (action->handler == handler && action->ctx == ctx) {
+            *link = action->next;
+            action->next = free_actions;
+            free_actions = action;
+            break;
+        }
+        link = &action->next;
+    }
+    
+    if (!vector_actions[IRQ_VECTOR(irq) - IRQ_BASE_VECTOR]) {
+        irq_mask(irq);
+    }
+    
+    write_unlock_irqrestore(&actions_lock, flags);
+}
+
+/**
+ * @brief Проверка на ложное прерывание
+ * @param vector Номер вектора
+ * @return 1 если прерывание ложное (обработчики не вызываются)
+ *
+ * Ложный IRQ15 приходит с ведомого 8259, а ведущий при этом
+ * выставил ISR для каскадной линии - ему EOI все же нужен.
+ */
+static int irq_check_spurious(uint32_t vector) {
+    if (vector == APIC_SPURIOUS_VECTOR && apic_enabled()) {
+        return 1;
+    }
+    if (apic_enabled()) {
+        return 0;
+    }
+    
+    if (vector == IRQ_VECTOR(IRQ_SPURIOUS_MASTER) && !pic_is_in_service(IRQ_SPURIOUS_MASTER)) {
+        return 1;
+    }
+    if (vector == IRQ_VECTOR(IRQ_SPURIOUS_SLAVE) && !pic_is_in_service(IRQ_SPURIOUS_SLAVE)) {
+        pic_send_eoi(PIC_CASCADE_IRQ);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Диспетчер внешних прерываний (вызывается из заглушек)
+ * @param vector Номер вектора
+ */
+__hot void irq_dispatch(uint32_t vector) {
+    irq_stats_t *stats = &vector_stats[cpu_current()][vector - IRQ_BASE_VECTOR];
+    int profile = irq_profile_enabled();
+    
+    /* Вход через шлюз прерывания запрещает прерывания */
+    irqoff_begin(IRQOFF_SITE_IRQ, vector);
+    
+    if (irq_check_spurious(vector)) {
+        stats->spurious++;
+        irqoff_end();
+        return;
+    }
+    
+    uint64_t start = profile ? rdtsc() : 0;
+    int handled = IRQ_NONE;
+    
+    read_lock(&actions_lock);
+    for (irq_action_t *action = vector_actions[vector - IRQ_BASE_VECTOR]; action; action = action->next) {
+        handled |= action->handler(action->ctx);
+    }
+    read_unlock(&actions_lock);
+    
+    if (vector < IRQ_VECTOR(IRQ_ISA_COUNT)) {
+        irq_eoi(vector - IRQ_BASE_VECTOR);
+    } else if (apic_enabled()) {
+        lapic_eoi();
+    }
+    
+    stats->count++;
+    if (handled == IRQ_NONE) {
+        stats->unhandled++;
+    }
+    if (profile) {
+        uint32_t cycles = (uint32_t)(rdtsc() - start);
+        stats->cycles_total += cycles;
+        if (cycles < stats->cycles_min || stats->count == 1) {
+            stats->cycles_min = cycles;
+        }
+        if (cycles > stats->cycles_max) {
+            stats->cycles_max = cycles;
+        }
+        irq_hist_add(stats->hist, cycles);
+    }
+    
+    /* Отложенная работа - уже после EOI и вне учета времени вектора */
+    softirq_irq_exit();
+    
+    /* Квант истек или проснулся поток: переключаемся прямо здесь,
+     * вытесненный поток выйдет из прерывания, когда вернется */
+    sched_irq_exit();
+    irqoff_end();
+}
+
+/**
+ * @brief Статистика вектора, сложенная по всем процессорам
+ * @param vector Номер вектора
+ * @param stats Выход: сумма счетчиков
+ */
+void irq_get_stats(uint8_t vector, irq_stats_t *stats) {
+    memory_set(stats, 0, sizeof(*stats));
+    if (vector < IRQ_BASE_VECTOR) {
+        return;
+    }
+    
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        const irq_stats_t *cpu_stats = &vector_stats[cpu][vector - IRQ_BASE_VECTOR];
+        if (cpu_stats->count &&
+            (cpu_stats->cycles_min < stats->cycles_min || !stats->count)) {
+            stats->cycles_min = cpu_stats->cycles_min;
+        }
+        if (cpu_stats->cycles_max > stats->cycles_max) {
+            stats->cycles_max = cpu_stats->cycles_max;
+        }
+        stats->count += cpu_stats->count;
+        stats->unhandled += cpu_stats->unhandled;
+        stats->spurious += cpu_stats->spurious;
+        stats->cycles_total += cpu_stats->cycles_total;
+        for (uint32_t i = 0; i < IRQ_HIST_BUCKETS; i++) {
+            stats->hist[i] += cpu_stats->hist[i];
+        }
+    }
+}
+
+/**
+ * @brief Вывод статистики по векторам, на которых были прерывания
+ */
+void irq_dump_stats(void) {
+    print_string("IRQ Statistics (vector: count, unhandled, spurious, min/avg/max/p99 cycles):\n");
+    
+    for (uint32_t i = 0; i < IRQ_VECTOR_COUNT; i++) {
+        irq_stats_t sum;
+        irq_stats_t *stats = &sum;
+        irq_get_stats(IRQ_BASE_VECTOR + i, stats);
+        if (!stats->count && !stats->spurious) {
+            continue;
+        }
+        
+        print_string("  - ");
+        print_hex(IRQ_BASE_VECTOR + i);
+        print_string(": ");
+        print_dec(stats->count);
+        print_string(", ");
+        print_dec(stats->unhandled);
+        print_string(", ");
+        print_dec(stats->spurious);
+        print_string(", ");
+        print_dec(stats->cycles_min);
+        print_string("/");
+        print_dec(stats->count ? (uint32_t)div_u64(stats->cycles_total, stats->count) : 0);
+        print_string("/");
+        print_dec(stats->cycles_max);
+        print_string("/");
+        irq_print_cycles(irq_hist_percentile(stats->hist, stats->count, 99));
+        print_string("\n");
+    }
+}
@@ -0,0 +1,285 @@
+/**
+ * @file irq_profile.c
+ * @brief Профилирование прерываний
+ *
+ * Участок с запрещенными прерываниями начинается в cpu_irq_save()
+ * (если прерывания были разрешены) или на входе в диспетчер
+ * прерываний и заканчивается в cpu_irq_restore() или на выходе
+ * из диспетчера. Для каждого процессора хранятся log2-гистограмма
+ * длительностей и несколько самых длинных участков с местом,
+ * где прерывания были запрещены.
+ *
+ * Не учитываются участки, где флаг IF сбрасывается напрямую
+ * инструкцией cli (простой в pit_idle_until, заглушки исключений).
+ */
+
+#include "irq_profile.h"
+#include "irq.h"
+#include "../cpu/cpu.h"
+#include "../cpu/tsc.h"
+#include "../lib/math64.h"
+#include "../video/video.h"
+#include <stddef.h>
+
+/**
+ * @brief Учет участков без прерываний на процессоре
+ */
+typedef struct {
+    uint64_t start;           /* TSC начала открытого участка (0 - нет) */
+    const char *file;         /* Место открытого участка */
+    uint32_t line;
+    uint32_t count;           /* Завершенных участков */
+    uint32_t hist[IRQ_HIST_BUCKETS];
+    uint32_t worst_count;
+    irqoff_section_t worst[IRQOFF_WORST_COUNT];
+} irqoff_cpu_t;
+
+/* Данные всех процессоров */
+static irqoff_cpu_t irqoff_cpus[MAX_CPUS];
+
+/* Профилировщик включен (TSC есть) */
+static int profile_enabled = 0;
+
+/**
+ * @brief Включение профилировщика (если есть TSC)
+ */
+void irq_profile_init(void) {
+    profile_enabled = cpu_has_edx(CPUID_EDX_TSC);
+}
+
+/**
+ * @brief Проверка, собирает ли профилировщик данные
+ */
+int irq_profile_enabled(void) {
+    return profile_enabled;
+}
+
+/**
+ * @brief Номер корзины log2-гистограммы для значения
+ */
+static uint32_t irq_hist_bucket(uint32_t cycles) {
+    if (cycles == 0) {
+        return 0;
+    }
+    return 31 - __builtin_clz(cycles);
+}
+
+/**
+ * @brief Добавление значения в log2-гистограмму
+ * @param hist Гистограмма из IRQ_HIST_BUCKETS корзин
+ * @param cycles Значение в тактах
+ */
+void irq_hist_add(uint32_t *hist, uint32_t cycles) {
+    hist[irq_hist_bucket(cycles)]++;
+}
+
+/**
+ * @brief Оценка процентиля по log2-гистограмме
+ * @param hist Гистограмма
+ * @param count Количество значений в ней
+ * @param percent Процентиль (например, 99)
+ * @return Верхняя граница корзины, содержащей процентиль
+ */
+uint32_t irq_hist_percentile(const uint32_t *hist, uint32_t count, uint32_t percent) {
+    if (count == 0) {
+        return 0;
+    }
+    
+    /* Номер значения (с единицы), попадающего в процентиль */
+    uint32_t rank = (uint32_t)div_u64((uint64_t)count * percent + 99, 100);
+    uint32_t seen = 0;
+    
+    for (uint32_t i = 0; i < IRQ_HIST_BUCKETS; i++) {
+        seen += hist[i];
+        if (seen >= rank) {
+            return i == 31 ? 0xFFFFFFFF : (2U << i) - 1;
+        }
+    }
+    return 0xFFFFFFFF;
+}
+
+/**
+ * @brief Начало участка с запрещенными прерываниями
+ * @param file Файл, где прерывания запрещены
+ * @param line Строка
+ */
+void irqoff_begin(const char *file, uint32_t line) {
+    if (!profile_enabled) {
+        return;
+    }
+    
+    irqoff_cpu_t *cpu = &irqoff_cpus[cpu_current()];
+    cpu->file = file;
+    cpu->line = line;
+    cpu->start = rdtsc();
+}
+
+/**
+ * @brief Запоминание участка среди самых длинных
+ */
+static void irqoff_record_worst(irqoff_cpu_t *cpu, uint32_t cycles) {
+    uint32_t n = cpu->worst_count;
+    
+    if (n == IRQOFF_WORST_COUNT && cycles <= cpu->worst[n - 1].cycles) {
+        return;
+    }
+    if (n < IRQOFF_WORST_COUNT) {
+        n = ++cpu->worst_count;
+    }
+    
+    /* Вставка в массив, упорядоченный по убыванию */
+    uint32_t i = n - 1;
+    while (i > 0 && cpu->worst[i - 1].cycles < cycles) {
+        cpu->worst[i] = cpu->worst[i - 1];
+        i--;
+    }
+    cpu->worst[i].cycles = cycles;
+    cpu->worst[i].file = cpu->file;
+    cpu->worst[i].line = cpu->line;
+}
+
+/**
+ * @brief Конец участка с запрещенными прерываниями
+ */
+void irqoff_end(void) {
+    if (!profile_enabled) {
+        return;
+    }
+    
+    irqoff_cpu_t *cpu = &irqoff_cpus[cpu_current()];
+    if (!cpu->start) {
+        return;
+    }
+    
+    uint32_t cycles = (uint32_t)(rdtsc() - cpu->start);
+    cpu->start = 0;
+    cpu->count++;
+    irq_hist_add(cpu->hist, cycles);
+    irqoff_record_worst(cpu, cycles);
+}
+
+/**
+ * @brief Сброс статистики участков с запрещенными прерываниями
+ */
+void irqoff_reset(void) {
+    uint32_t flags = cpu_irq_save();
+    irqoff_cpu_t *cpu = &irqoff_cpus[cpu_current()];
+    
+    cpu->count = 0;
+    cpu->worst_count = 0;
+    for (uint32_t i = 0; i < IRQ_HIST_BUCKETS; i++) {
+        cpu->hist[i] = 0;
+    }
+    cpu_irq_restore(flags);
+}
+
+/**
+ * @brief Самые длинные участки текущего процессора
+ * @param count Выход: количество записей
+ * @return Массив, упорядоченный по убыванию длительности
+ */
+const irqoff_section_t* irqoff_worst(uint32_t *count) {
+    irqoff_cpu_t *cpu = &irqoff_cpus[cpu_current()];
+    *count = cpu->worst_count;
+    return cpu->worst;
+}
+
+/**
+ * @brief Вывод числа тактов без знака
+ */
+void irq_print_cycles(uint32_t cycles) {
+    char buffer[11];
+    int i = 10;
+    buffer[i] = '\0';
+    do {
+        buffer[--i] = '0' + cycles % 10;
+        cycles /= 10;
+    } while (cycles);
+    print_string(&buffer[i]);
+}
+
+/**
+ * @brief Вывод длительности в микросекундах (если TSC откалиброван)
+ */
+static void irq_profile_print_us(uint32_t cycles) {
+    if (tsc_available()) {
+        print_string(" (");
+        print_dec((uint32_t)div_u64(tsc_cycles_to_ns(cycles), 1000));
+        print_string(" us)");
+    }
+}
+
+/**
+ * @brief Вывод непустых корзин гистограммы
+ */
+static void irq_profile_print_hist(const uint32_t *hist) {
+    for (uint32_t i = 0; i < IRQ_HIST_BUCKETS; i++) {
+        if (!hist[i]) {
+            continue;
+        }
+        print_string("      < ");
+        irq_print_cycles(i == 31 ? 0xFFFFFFFF : (2U << i));
+        print_string(": ");
+        print_dec(hist[i]);
+        print_string("\n");
+    }
+}
+
+/**
+ * @brief Вывод гистограмм обработчиков и участков без прерываний
+ */
+void irq_profile_dump(void) {
+    if (!profile_enabled) {
+        print_string("IRQ profiler: TSC not available\n");
+        return;
+    }
+    
+    print_string("IRQ Handler Durations (cycles):\n");
+    for (uint32_t vector = IRQ_BASE_VECTOR; vector < 256; vector++) {
+        irq_stats_t sum;
+        const irq_stats_t *stats = &sum;
+        irq_get_stats(vector, &sum);
+        if (!stats->count) {
+            continue;
+        }
+        
+        print_string("  - Vector ");
+        print_hex(vector);
+        print_string(": count ");
+        print_dec(stats->count);
+        print_string(", min ");
+        print_dec(stats->cycles_min);
+        print_string(", avg ");
+        print_dec((uint32_t)div_u64(stats->cycles_total, stats->count));
+        print_string(", max ");
+        print_dec(stats->cycles_max);
+        irq_profile_print_us(stats->cycles_max);
+        print_string(", p99 ");
+        irq_print_cycles(irq_hist_percentile(stats->hist, stats->count, 99));
+        print_string("\n");
+        irq_profile_print_hist(stats->hist);
+    }
+    
+    irqoff_cpu_t *cpu = &irqoff_cpus[cpu_current()];
+    print_string("Interrupts-Off Sections (CPU ");
+    print_dec(cpu_current());
+    print_string("): ");
+    print_dec(cpu->count);
+    print_string(", p99 ");
+    irq_print_cycles(irq_hist_percentile(cpu->hist, cpu->count, 99));
+    print_string(" cycles\n");
+    irq_profile_print_hist(cpu->hist);
+    
+    print_string("  Longest:\n");
+    for (uint32_t i = 0; i < cpu->worst_count; i++) {
+        print_string("    ");
+        print_dec(cpu->worst[i].cycles);
+        print_string(" cycles");
+        irq_profile_print_us(cpu->worst[i].cycles);
+        print_string(" at ");
+        print_string(cpu->worst[i].file);
+        print_string(":");
+        print_dec(cpu->worst[i].line);
+        print_string("\n");
+    }
+}
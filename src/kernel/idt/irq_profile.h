@@ -0,0 +1,82 @@
+/**
+ * @file irq_profile.h
+ * @brief Профилирование прерываний
+ *
+ * Гистограммы длительности обработчиков по векторам и учет участков
+ * с запрещенными прерываниями с точностью до места в исходном коде.
+ * Время измеряется по TSC; на запись уходит пара rdtsc и несколько
+ * сравнений, поэтому профилировщик включен всегда.
+ */
+
+#ifndef KERNEL_IRQ_PROFILE_H
+#define KERNEL_IRQ_PROFILE_H
+
+#include <stdint.h>
+
+/* Корзины log2-гистограммы: корзина i - от 2^i до 2^(i+1)-1 тактов */
+#define IRQ_HIST_BUCKETS 32
+
+/* Количество запоминаемых самых длинных участков без прерываний */
+#define IRQOFF_WORST_COUNT 8
+
+/* Место участка с запрещенными прерываниями для жестких прерываний */
+#define IRQOFF_SITE_IRQ "irq vector"
+
+/**
+ * @brief Участок с запрещенными прерываниями
+ */
+typedef struct {
+    uint32_t cycles;          /* Длительность в тактах TSC */
+    const char *file;         /* Файл, где прерывания запрещены */
+    uint32_t line;            /* Строка (для жестких прерываний - вектор) */
+} irqoff_section_t;
+
+/**
+ * @brief Включение профилировщика (если есть TSC)
+ */
+void irq_profile_init(void);
+
+/**
+ * @brief Проверка, собирает ли профилировщик данные
+ */
+int irq_profile_enabled(void);
+
+/**
+ * @brief Добавление значения в log2-гистограмму
+ * @param hist Гистограмма из IRQ_HIST_BUCKETS корзин
+ * @param cycles Значение в тактах
+ */
+void irq_hist_add(uint32_t *hist, uint32_t cycles);
+
+/**
+ * @brief Оценка процентиля по log2-гистограмме
+ * @param hist Гистограмма
+ * @param count Количество значений в ней
+ * @param percent Процентиль (например, 99)
+ * @return Верхняя граница корзины, содержащей процентиль
+ */
+uint32_t irq_hist_percentile(const uint32_t *hist, uint32_t count, uint32_t percent);
+
+/**
+ * @brief Вывод числа тактов без знака (граница последней корзины - 0xFFFFFFFF)
+ */
+void irq_print_cycles(uint32_t cycles);
+
+/**
+ * @brief Сброс статистики участков с запрещенными прерываниями
+ */
+void irqoff_reset(void);
+
+/**
+ * @brief Самые длинные участки текущего процессора
+ * @param count Выход: количество записей
+ * @return Массив, упорядоченный по убыванию длительности
+ */
+const irqoff_section_t* irqoff_worst(uint32_t *count);
+
+/**
+ * @brief Вывод гистограмм обработчиков и участков без прерываний
+ */
+void irq_profile_dump(void);
+
+#endif /* KERNEL_IRQ_PROFILE_H */
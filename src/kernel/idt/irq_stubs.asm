@@ -0,0 +1,56 @@
+;;
+;; @file irq_stubs.asm
+;; @brief Точки входа внешних прерываний (векторы 32-255)
+;;
+;; Для каждого вектора генерируется заглушка, которая кладет в стек
+;; номер вектора и переходит в общий обработчик. Общий обработчик
+;; сохраняет регистры и вызывает C-диспетчер irq_dispatch(vector).
+;;
+
+[bits 32]
+
+global irq_stub_table    ; Таблица адресов заглушек (для idt_init)
+
+extern irq_dispatch
+
+; Первый вектор внешних прерываний и количество векторов
+%define IRQ_FIRST_VECTOR 32
+%define IRQ_STUB_COUNT   224
+
+;
+; Заглушки: push vector; jmp irq_common_stub
+;
+%assign vec IRQ_FIRST_VECTOR
+%rep IRQ_STUB_COUNT
+irq_stub_%+vec:
+    push dword vec
+    jmp irq_common_stub
+%assign vec vec+1
+%endrep
+
+;;
+;; @brief Общий обработчик внешних прерываний
+;;
+;; Стек на входе: номер вектора, затем кадр прерывания (EIP, CS, EFLAGS).
+;; После pushad номер вектора находится по смещению 32.
+;;
+irq_common_stub:
+    pushad                  ; Сохраняем регистры общего назначения
+    push dword [esp + 32]   ; Аргумент: номер вектора
+    call irq_dispatch
+    add esp, 4
+    popad                   ; Восстанавливаем регистры
+    add esp, 4              ; Убираем номер вектора
+    iretd
+
+section .data
+
+;
+; Таблица адресов заглушек, индекс - (вектор - IRQ_FIRST_VECTOR)
+;
+irq_stub_table:
+%assign vec IRQ_FIRST_VECTOR
+%rep IRQ_STUB_COUNT
+    dd irq_stub_%+vec
+%assign vec vec+1
+%endrep
@@ -0,0 +1,118 @@
+/**
+ * @file pic.c
+ * @brief Драйвер пары контроллеров прерываний 8259 (PIC)
+ */
+
+#include "pic.h"
+#include "idt.h"
+
+/**
+ * @brief Переназначение векторов и маскирование всех линий
+ * @param master_vector Базовый вектор ведущего контроллера
+ * @param slave_vector Базовый вектор ведомого контроллера
+ */
+void pic_remap(uint8_t master_vector, uint8_t slave_vector) {
+    /* ICW1 - начало инициализации */
+    write_port(PIC1_COMMAND, 0x11);  // Основной PIC
+    write_port(PIC2_COMMAND, 0x11);  // Вторичный PIC
+
+    /* ICW2 - переназначение базовых векторов */
+    write_port(PIC1_DATA, master_vector);
+    write_port(PIC2_DATA, slave_vector);
+
+    /* ICW3 - настройка каскадирования */
+    write_port(PIC1_DATA, 1 << PIC_CASCADE_IRQ);  // Ведомый PIC на линии IRQ2
+    write_port(PIC2_DATA, PIC_CASCADE_IRQ);       // Идентификатор ведомого
+
+    /* ICW4 - дополнительная информация */
+    write_port(PIC1_DATA, 0x01);  // Режим 8086/88
+    write_port(PIC2_DATA, 0x01);  // Режим 8086/88
+
+    /* Маскирование всех прерываний, кроме каскада */
+    write_port(PIC1_DATA, (uint8_t)~(1 << PIC_CASCADE_IRQ));
+    write_port(PIC2_DATA, 0xff);
+}
+
+/**
+ * @brief Маскирование всех линий обоих контроллеров
+ */
+void pic_disable(void) {
+    write_port(PIC1_DATA, 0xff);
+    write_port(PIC2_DATA, 0xff);
+}
+
+/**
+ * @brief Размаскирование линии IRQ
+ * @param irq Номер линии (0-15)
+ */
+void pic_unmask(uint8_t irq) {
+    if (irq < 8) {
+        write_port(PIC1_DATA, read_port(PIC1_DATA) & ~(1 << irq));
+    } else {
+        write_port(PIC2_DATA, read_port(PIC2_DATA) & ~(1 << (irq - 8)));
+    }
+}
+
+/**
+ * @brief Маскирование линии IRQ
+ * @param irq Номер линии (0-15)
+ */
+void pic_mask(uint8_t irq) {
+    if (irq < 8) {
+        write_port(PIC1_DATA, read_port(PIC1_DATA) | (1 << irq));
+    } else {
+        write_port(PIC2_DATA, read_port(PIC2_DATA) | (1 << (irq - 8)));
+    }
+}
+
+/**
+ * @brief Проверка, замаскирована ли линия
+ * @param irq Номер линии (0-15)
+ * @return Ненулевое значение, если линия замаскирована
+ */
+int pic_is_masked(uint8_t irq) {
+    if (irq < 8) {
+        return read_port(PIC1_DATA) & (1 << irq);
+    }
+    return read_port(PIC2_DATA) & (1 << (irq - 8));
+}
+
+/**
+ * @brief Проверка, ожидает ли линия обслуживания (бит в IRR)
+ * @param irq Номер линии (0-15)
+ */
+int pic_is_pending(uint8_t irq) {
+    if (irq < 8) {
+        write_port(PIC1_COMMAND, PIC_READ_IRR);
+        return read_port(PIC1_COMMAND) & (1 << irq);
+    }
+    write_port(PIC2_COMMAND, PIC_READ_IRR);
+    return read_port(PIC2_COMMAND) & (1 << (irq - 8));
+}
+
+/**
+ * @brief Проверка, обслуживается ли линия (бит в ISR)
+ * @param irq Номер линии (0-15)
+ *
+ * По биту ISR отличаются ложные IRQ7/IRQ15: 8259 выдает их
+ * вектор, когда запрос пропал до подтверждения, не выставляя ISR.
+ */
+int pic_is_in_service(uint8_t irq) {
+    if (irq < 8) {
+        write_port(PIC1_COMMAND, PIC_READ_ISR);
+        return read_port(PIC1_COMMAND) & (1 << irq);
+    }
+    write_port(PIC2_COMMAND, PIC_READ_ISR);
+    return read_port(PIC2_COMMAND) & (1 << (irq - 8));
+}
+
+/**
+ * @brief Отправка EOI для линии
+ * @param irq Номер линии (0-15)
+ */
+void pic_send_eoi(uint8_t irq) {
+    if (irq >= 8) {
+        write_port(PIC2_COMMAND, PIC_EOI);
+    }
+    write_port(PIC1_COMMAND, PIC_EOI);
+}
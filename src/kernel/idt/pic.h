@@ -0,0 +1,77 @@
+/**
+ * @file pic.h
+ * @brief Драйвер пары контроллеров прерываний 8259 (PIC)
+ *
+ * Используется, когда APIC недоступен, а также для
+ * маскирования 8259 при переходе на APIC.
+ */
+
+#ifndef KERNEL_PIC_H
+#define KERNEL_PIC_H
+
+#include <stdint.h>
+
+/* Порты команд и данных */
+#define PIC1_COMMAND 0x20
+#define PIC1_DATA    0x21
+#define PIC2_COMMAND 0xA0
+#define PIC2_DATA    0xA1
+
+/* Команды */
+#define PIC_EOI      0x20  /* Конец прерывания */
+#define PIC_READ_IRR 0x0A  /* OCW3: чтение регистра запросов */
+#define PIC_READ_ISR 0x0B  /* OCW3: чтение регистра обслуживаемых */
+
+/* Линия каскада ведомого контроллера */
+#define PIC_CASCADE_IRQ 2
+
+/**
+ * @brief Переназначение векторов и маскирование всех линий
+ * @param master_vector Базовый вектор ведущего контроллера
+ * @param slave_vector Базовый вектор ведомого контроллера
+ */
+void pic_remap(uint8_t master_vector, uint8_t slave_vector);
+
+/**
+ * @brief Маскирование всех линий обоих контроллеров
+ */
+void pic_disable(void);
+
+/**
+ * @brief Размаскирование линии IRQ
+ * @param irq Номер линии (0-15)
+ */
+void pic_unmask(uint8_t irq);
+
+/**
+ * @brief Маскирование линии IRQ
+ * @param irq Номер линии (0-15)
+ */
+void pic_mask(uint8_t irq);
+
+/**
+ * @brief Проверка, замаскирована ли линия
+ * @param irq Номер линии (0-15)
+ * @return Ненулевое значение, если линия замаскирована
+ */
+int pic_is_masked(uint8_t irq);
+
+/**
+ * @brief Проверка, ожидает ли линия обслуживания (бит в IRR)
+ * @param irq Номер линии (0-15)
+ */
+int pic_is_pending(uint8_t irq);
+
+/**
+ * @brief Проверка, обслуживается ли линия (бит в ISR)
+ * @param irq Номер линии (0-15)
+ */
+int pic_is_in_service(uint8_t irq);
+
+/**
+ * @brief Отправка EOI для линии
+ * @param irq Номер линии (0-15)
+ */
+void pic_send_eoi(uint8_t irq);
+
+#endif /* KERNEL_PIC_H */
@@ -0,0 +1,215 @@
+/**
+ * @file softirq.c
+ * @brief Отложенная обработка прерываний (нижние половины)
+ *
+ * У каждого процессора своя FIFO-очередь элементов работы.
+ * Очередь меняется только с запрещенными прерываниями, а элементы
+ * выполняются с разрешенными: пришедшее в это время прерывание
+ * лишь добавляет работу, которую доделает текущий проход.
+ */
+
+#include "softirq.h"
+#include "irq.h"
+#include "../cpu/cpu.h"
+#include "../cpu/tsc.h"
+#include "../lib/math64.h"
+#include "../sched/sched.h"
+#include "../video/video.h"
+#include <stddef.h>
+
+/**
+ * @brief Очередь отложенной работы процессора
+ */
+typedef struct {
+    softirq_work_t *head;
+    softirq_work_t *tail;
+    int running;              /* Идет проход по очереди */
+    softirq_stats_t stats;
+} softirq_base_t;
+
+/* Очереди всех процессоров */
+static softirq_base_t softirq_bases[MAX_CPUS];
+
+/**
+ * @brief Подготовка элемента работы
+ * @param work Элемент
+ * @param fn Функция
+ * @param ctx Аргумент функции
+ */
+void softirq_work_init(softirq_work_t *work, softirq_fn_t fn, void *ctx) {
+    work->fn = fn;
+    work->ctx = ctx;
+    work->next = NULL;
+    work->pending = 0;
+    work->runs = 0;
+}
+
+/**
+ * @brief Постановка элемента в очередь текущего процессора
+ * @param work Элемент
+ * @return 1 если элемент поставлен, 0 если уже стоял в очереди
+ */
+int softirq_queue(softirq_work_t *work) {
+    uint32_t flags = cpu_irq_save();
+    
+    if (work->pending) {
+        cpu_irq_restore(flags);
+        return 0;
+    }
+    
+    softirq_base_t *base = &softirq_bases[cpu_current()];
+    work->pending = 1;
+    work->next = NULL;
+    if (base->tail) {
+        base->tail->next = work;
+    } else {
+        base->head = work;
+    }
+    base->tail = work;
+    base->stats.queued++;
+    
+    cpu_irq_restore(flags);
+    return 1;
+}
+
+/**
+ * @brief Проверка наличия отложенной работы на текущем процессоре
+ */
+int softirq_pending(void) {
+    return softirq_bases[cpu_current()].head != NULL;
+}
+
+/**
+ * @brief Проход по очереди текущего процессора
+ * @param from_idle Проход запущен из простоя
+ *
+ * Вызывается с запрещенными прерываниями. Проход останавливается,
+ * когда исчерпан бюджет элементов или времени; остаток очереди
+ * выполнит следующий выход из прерывания или простой.
+ */
+static void softirq_process(int from_idle) {
+    softirq_base_t *base = &softirq_bases[cpu_current()];
+    
+    if (base->running || !base->head) {
+        return;
+    }
+    base->running = 1;
+    base->stats.passes++;
+    
+    /* Поток не вытесняется посреди прохода: очередь принадлежит процессору */
+    sched_preempt_disable();
+    if (from_idle) {
+        base->stats.idle_passes++;
+    }
+    
+    int use_tsc = tsc_available();
+    uint64_t deadline = use_tsc ? rdtsc() + tsc_ns_to_cycles(SOFTIRQ_BUDGET_US * 1000ULL) : 0;
+    uint32_t items = 0;
+    
+    while (base->head) {
+        if (items >= SOFTIRQ_BUDGET_ITEMS || (use_tsc && rdtsc() > deadline)) {
+            base->stats.budget_exceeded++;
+            break;
+        }
+        
+        softirq_work_t *work = base->head;
+        base->head = work->next;
+        if (!base->head) {
+            base->tail = NULL;
+        }
+        work->next = NULL;
+        work->pending = 0;
+        work->runs++;
+        
+        uint64_t start = use_tsc ? rdtsc() : 0;
+        irqoff_end();
+        __asm__ volatile("sti" : : : "memory");
+        work->fn(work->ctx);
+        __asm__ volatile("cli" : : : "memory");
+        irqoff_begin(__FILE__, __LINE__);
+        
+        if (use_tsc) {
+            uint32_t cycles = (uint32_t)(rdtsc() - start);
+            base->stats.cycles_total += cycles;
+            if (cycles > base->stats.cycles_max) {
+                base->stats.cycles_max = cycles;
+            }
+        }
+        base->stats.executed++;
+        items++;
+    }
+    
+    base->running = 0;
+    sched_preempt_enable();
+}
+
+/**
+ * @brief Выполнение отложенной работы в пределах бюджета
+ */
+void softirq_run(void) {
+    uint32_t flags = cpu_irq_save();
+    softirq_process(1);
+    cpu_irq_restore(flags);
+}
+
+/**
+ * @brief Выполнение отложенной работы при выходе из прерывания
+ */
+void softirq_irq_exit(void) {
+    softirq_process(0);
+}
+
+/**
+ * @brief Статистика текущего процессора
+ */
+const softirq_stats_t* softirq_get_stats(void) {
+    return &softirq_bases[cpu_current()].stats;
+}
+
+/**
+ * @brief Перевод тактов в микросекунды для вывода
+ */
+static uint32_t softirq_cycles_to_us(uint64_t cycles) {
+    if (!tsc_available()) {
+        return 0;
+    }
+    return (uint32_t)div_u64(tsc_cycles_to_ns(cycles), 1000);
+}
+
+/**
+ * @brief Вывод времени в жестком и отложенном контекстах
+ */
+void softirq_dump_stats(void) {
+    softirq_stats_t *stats = &softirq_bases[cpu_current()].stats;
+    uint64_t hard_cycles = 0;
+    uint32_t hard_count = 0;
+    
+    for (uint32_t vector = IRQ_BASE_VECTOR; vector < 256; vector++) {
+        irq_stats_t irq;
+        irq_get_stats(vector, &irq);
+        hard_cycles += irq.cycles_total;
+        hard_count += irq.count;
+    }
+    
+    print_string("Softirq Info (CPU ");
+    print_dec(cpu_current());
+    print_string("):\n  - Queued/executed: ");
+    print_dec(stats->queued);
+    print_string("/");
+    print_dec(stats->executed);
+    print_string("\n  - Passes: ");
+    print_dec(stats->passes);
+    print_string(" (from idle ");
+    print_dec(stats->idle_passes);
+    print_string(", over budget ");
+    print_dec(stats->budget_exceeded);
+    print_string(")\n  - Hard IRQ time: ");
+    print_dec(softirq_cycles_to_us(hard_cycles));
+    print_string(" us in ");
+    print_dec(hard_count);
+    print_string(" interrupts\n  - Deferred time: ");
+    print_dec(softirq_cycles_to_us(stats->cycles_total));
+    print_string(" us, max ");
+    print_dec(stats->cycles_max);
+    print_string(" cycles per item\n");
+}
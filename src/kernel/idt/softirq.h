@@ -0,0 +1,108 @@
+/**
+ * @file softirq.h
+ * @brief Отложенная обработка прерываний (нижние половины)
+ *
+ * Обработчик прерывания выполняет только неотложную часть работы
+ * (подтверждение устройства, чтение данных) и ставит элемент работы
+ * в очередь текущего процессора. Очередь разбирается с разрешенными
+ * прерываниями при выходе из прерывания или в простое, порциями,
+ * ограниченными бюджетом.
+ */
+
+#ifndef KERNEL_SOFTIRQ_H
+#define KERNEL_SOFTIRQ_H
+
+#include <stdint.h>
+
+/* Бюджет одного прохода: элементов и микросекунд */
+#define SOFTIRQ_BUDGET_ITEMS 16
+#define SOFTIRQ_BUDGET_US    2000
+
+typedef struct softirq_work softirq_work_t;
+
+/**
+ * @brief Функция отложенной работы
+ *
+ * Выполняется с разрешенными прерываниями; может снова поставить
+ * свой элемент в очередь.
+ */
+typedef void (*softirq_fn_t)(void *ctx);
+
+/**
+ * @brief Элемент отложенной работы
+ *
+ * Элемент не может стоять в очереди дважды: повторная постановка
+ * до выполнения ничего не делает, поэтому обработчик должен
+ * забирать все накопившиеся данные за один вызов.
+ */
+struct softirq_work {
+    softirq_fn_t fn;
+    void *ctx;
+    struct softirq_work *next;
+    volatile uint8_t pending; /* Элемент стоит в очереди */
+    uint32_t runs;            /* Количество выполнений */
+};
+
+/**
+ * @brief Статистика отложенной обработки процессора
+ */
+typedef struct {
+    uint32_t queued;          /* Постановок в очередь */
+    uint32_t executed;        /* Выполненных элементов */
+    uint32_t passes;          /* Проходов по очереди */
+    uint32_t budget_exceeded; /* Проходов, прерванных по бюджету */
+    uint32_t idle_passes;     /* Проходов из простоя */
+    uint64_t cycles_total;    /* Такты TSC в отложенной работе */
+    uint32_t cycles_max;      /* Максимум тактов за один элемент */
+} softirq_stats_t;
+
+/**
+ * @brief Подготовка элемента работы
+ * @param work Элемент
+ * @param fn Функция
+ * @param ctx Аргумент функции
+ */
+void softirq_work_init(softirq_work_t *work, softirq_fn_t fn, void *ctx);
+
+/**
+ * @brief Постановка элемента в очередь текущего процессора
+ * @param work Элемент
+ * @return 1 если элемент поставлен, 0 если уже стоял в очереди
+ *
+ * Может вызываться из обработчика прерывания и из обычного кода.
+ */
+int softirq_queue(softirq_work_t *work);
+
+/**
+ * @brief Проверка наличия отложенной работы на текущем процессоре
+ */
+int softirq_pending(void);
+
+/**
+ * @brief Выполнение отложенной работы в пределах бюджета
+ *
+ * Вызывается с разрешенными прерываниями из простоя и других
+ * мест, где процессор может заняться отложенной работой.
+ */
+void softirq_run(void);
+
+/**
+ * @brief Выполнение отложенной работы при выходе из прерывания
+ *
+ * Вызывается диспетчером после EOI с запрещенными прерываниями.
+ * Во вложенном прерывании (во время прохода по очереди) ничего
+ * не делает: очередь дорабатывает внешний проход.
+ */
+void softirq_irq_exit(void);
+
+/**
+ * @brief Статистика текущего процессора
+ */
+const softirq_stats_t* softirq_get_stats(void);
+
+/**
+ * @brief Вывод времени в жестком и отложенном контекстах
+ */
+void softirq_dump_stats(void);
+
+#endif /* KERNEL_SOFTIRQ_H */
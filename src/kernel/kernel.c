@@ -4,34 +4,157 @@
  */
 
 #include "video/video.h"
+#include "video/fb.h"
 #include "idt/idt.h"
 #include "drivers/keyboard.h"
 #include "drivers/pit.h"
 #include "memory/memory.h"
+#include "memory/vmm.h"
+#include "memory/memmap.h"
+#include "memory/pat.h"
+#include "memory/numa.h"
+#include "memory/heapprof.h"
+#include "cpu/cpu.h"
+#include "cpu/percpu.h"
+#include "cpu/smp.h"
+#include "acpi/acpi.h"
+#include "apic/apic.h"
+#include "cpu/tsc.h"
+#include "drivers/hpet.h"
+#include "drivers/serial.h"
+#include "idt/irq.h"
+#include "idt/softirq.h"
+#include "time/clocksource.h"
+#include "time/hrtimer.h"
+#include "sched/sched.h"
+#include "sync/spinlock.h"
+#include "async/async.h"
 
 /* Внешние символы для определения размера ядра */
 extern uint32_t _kernel_start;
 extern uint32_t _kernel_end;
 
+/**
+ * @brief Обработка команды временного псевдо-терминала
+ * @param cmd Введенная строка
+ */
+static void handle_command(const char *cmd) {
+    if (!memory_compare(cmd, "irqstat", sizeof("irqstat"))) {
+        /* Гистограммы прерываний (полный вывод - в COM1) */
+        irq_profile_dump();
+        softirq_dump_stats();
+    } else if (!memory_compare(cmd, "irqstat reset", sizeof("irqstat reset"))) {
+        irqoff_reset();
+    } else if (!memory_compare(cmd, "ps", sizeof("ps"))) {
+        sched_dump_info();
+    } else if (!memory_compare(cmd, "lockstat", sizeof("lockstat"))) {
+        lockstat_dump();
+    } else if (!memory_compare(cmd, "lockstat on", sizeof("lockstat on"))) {
+        /* Сбор статистики блокировок стоит пары rdtsc на захват */
+        if (lockstat_enable() < 0) {
+            print_string("TSC not available\n");
+        }
+    } else if (!memory_compare(cmd, "lockstat off", sizeof("lockstat off"))) {
+        lockstat_disable();
+    } else if (!memory_compare(cmd, "lockstat reset", sizeof("lockstat reset"))) {
+        lockstat_reset();
+    } else if (!memory_compare(cmd, "async", sizeof("async"))) {
+        async_dump_stats(&async_idle_executor);
+    } else if (!memory_compare(cmd, "pmm", sizeof("pmm"))) {
+        pmm_dump_info();
+    } else if (!memory_compare(cmd, "pmm colour on", sizeof("pmm colour on"))) {
+        /* Действует на кадры, выделяемые после включения */
+        pmm_set_colouring(1);
+        if (!physical_memory_manager.colouring) {
+            print_string("Cache geometry unknown\n");
+        }
+    } else if (!memory_compare(cmd, "pmm colour off", sizeof("pmm colour off"))) {
+        pmm_set_colouring(0);
+    } else if (!memory_compare(cmd, "heap", sizeof("heap"))) {
+        heap_dump_info();
+    } else if (!memory_compare(cmd, "heapprof", sizeof("heapprof"))) {
+        /* Места выделения - в COM1 */
+        heapprof_dump();
+    } else if (!memory_compare(cmd, "heapprof on", sizeof("heapprof on"))) {
+        heapprof_enable(1);
+    } else if (!memory_compare(cmd, "heapprof sample", sizeof("heapprof sample"))) {
+        heapprof_enable(HEAPPROF_SAMPLE_RATE);
+    } else if (!memory_compare(cmd, "heapprof off", sizeof("heapprof off"))) {
+        heapprof_disable();
+    } else if (!memory_compare(cmd, "numa", sizeof("numa"))) {
+        numa_dump_info();
+    } else if (!memory_compare(cmd, "vm", sizeof("vm"))) {
+        vmm_dump_info();
+    } else if (!memory_compare(cmd, "fb", sizeof("fb"))) {
+        fb_dump_info();
+    } else if (cmd[0]) {
+        print_string("Unknown command\n");
+    }
+}
+
 /**
  * @brief Точка входа в ядро операционной системы
+ * @param magic Значение eax от загрузчика Multiboot
+ * @param mbi Физический адрес структуры Multiboot
  */
-void kmain(void) 
+void kmain(uint32_t magic, uint32_t mbi) 
 {
+    /* GDT ядра и данные процессора в %gs - до всего остального */
+    percpu_init();
+    
     /* Инициализация видео-подсистемы */
     clear_screen();
+    serial_init();      // Дублирование вывода в COM1
 
+    cpu_init();         // Определение возможностей процессора
     idt_init();         // Настройка таблицы прерываний
+    
+    /* Инициализация менеджера памяти по карте загрузчика */
+    memmap_init(magic, mbi);
+    pmm_init((uint32_t)&_kernel_end);
+    
+    /* Таблицы страниц ядра вместо загрузочных: до драйверов, которые
+     * отображают свои регистры в окно ядра; PAT и MTRR - до них */
+    pat_init();
+    vmm_init();
+    
+    /* Куча ядра: 64 МБ адресов, физические страницы - по первому обращению */
+    uint32_t heap_size = 64 * 1024 * 1024;
+    uint32_t heap_start = (uint32_t)vmm_alloc(heap_size, VMM_WRITE | VMM_GLOBAL, "heap");
+    if (!heap_start) {
+        /* Без окна ядра - 1MB нижней памяти от PMM
+         * (сразу за ядром лежат битовое поле и база кадров) */
+        heap_size = 1024 * 1024;
+        uint32_t heap_phys = pmm_alloc_pages(heap_size / PAGE_SIZE);
+        heap_start = heap_phys ? (uint32_t)phys_to_virt(heap_phys) : 0;
+    }
+    if (heap_start) {
+        heap_init(heap_start, heap_size);
+    } else {
+        /* Без кучи kmalloc() возвращает NULL */
+        print_string("Heap Initialization... ");
+        print_string_color("FAILED\n", COLOR_RED, COLOR_BLACK);
+        print_string("  - No memory for the heap\n");
+    }
+    
+    /* Графическая консоль: текстовый экран переносится на нее */
+    fb_init();
+    
+    acpi_init();        // Поиск таблиц ACPI (MADT)
+    numa_init();        // Узлы памяти по SRAT и SLIT
+    apic_init();        // Переход на APIC, если он доступен
     keyboard_init();    // Инициализация драйвера клавиатуры
     pit_init();         // Инициализация системного таймера
+    tsc_init();         // Калибровка TSC по PIT
+    hpet_init();        // Поиск HPET по таблице ACPI
+    clocksource_init(); // Выбор источника времени
+    hrtimer_init();     // LAPIC-таймер (или HPET) для hrtimer
     
-    /* Инициализация менеджера памяти */
-    pmm_init((uint32_t)&_kernel_end);
+    /* kmain становится потоком "main", появляется поток простоя */
+    sched_init();
     
-    /* Инициализация кучи ядра (начинаем после ядра) */
-    uint32_t heap_start = align_up((uint32_t)&_kernel_end + 1024 * 1024, PAGE_SIZE); /* 1MB после ядра */
-    uint32_t heap_size = 1024 * 1024; /* 1MB для кучи */
-    heap_init(heap_start, heap_size);
+    /* Запуск остальных процессоров из MADT */
+    smp_init();
     
     /* Вывод информации о ядре */
     const char *kernel_name = "\ncodename speedster\n";
@@ -48,6 +171,28 @@ void kmain(void)
     /* Запуск тестов системного таймера */
     //run_timer_tests();
 
+    /* Сравнение источников времени (PIT, HPET, TSC) */
+    //run_clock_bench();
+
+    /* Стоимость переключения контекста */
+    //run_sched_bench();
+    //run_sched_scaling_bench();
+
+    /* Взаимное исключение и стоимость блокировок */
+    //run_sync_tests();
+    
+    /* Асинхронные задачи и их стоимость */
+    //run_async_tests();
+    
+    /* Промахи TLB и сброс отображений */
+    //run_vmm_bench();
+    
+    /* Конфликтные промахи кэша с раскраской кадров и без */
+    //run_pmm_bench();
+    
+    /* Вывод и прокрутка консоли на кадровом буфере */
+    //run_fb_bench();
+    
     /**
      * @brief Основной цикл ядра с временным псевдо-терминалом
      * 
@@ -70,8 +215,8 @@ void kmain(void)
         char* user_input = read_line(128);
         
         if (user_input) {
-            /* Здесь должен быть обработчик команд (временный) */
-            /* В финальной версии будет переключение контекста */
+            /* Временный обработчик команд */
+            handle_command(user_input);
             
             /* Освобождаем память, выделенную для ввода */
             kfree(user_input);
@@ -80,9 +225,9 @@ void kmain(void)
             pit_sleep_ms(100);
         }
         
-        /* Используем hlt для экономии энергии, когда ядру нечего делать */
-        /* В будущем здесь будет планировщик задач */
-        __asm__ volatile("hlt");
+        /* Простаиваем до следующего события без лишних тиков таймера,
+         * уступая процессор готовым потокам */
+        pit_idle();
     }
     
     /* Ядро никогда не должно достигать этой точки */
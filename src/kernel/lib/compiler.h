@@ -0,0 +1,21 @@
+/**
+ * @file compiler.h
+ * @brief Атрибуты размещения кода
+ *
+ * Горячие функции (путь прерывания, переключение потоков, выделение
+ * памяти) собираются в .text.hot в начале секции кода, код
+ * инициализации - в .text.cold в конце. Горячий код занимает
+ * несколько соседних строк кэша и страниц, а однократно выполняемый
+ * не разбавляет его.
+ */
+
+#ifndef KERNEL_COMPILER_H
+#define KERNEL_COMPILER_H
+
+/* Часто выполняемая функция */
+#define __hot  __attribute__((hot, section(".text.hot")))
+
+/* Код инициализации и редких ошибок */
+#define __cold __attribute__((cold, section(".text.cold")))
+
+#endif /* KERNEL_COMPILER_H */
@@ -0,0 +1,64 @@
+/**
+ * @file math64.h
+ * @brief 64-битная арифметика без libgcc
+ *
+ * Ядро линкуется без libgcc, поэтому деление uint64_t напрямую
+ * (вызов __udivdi3) недоступно. Деление выполняется двумя
+ * инструкциями divl, как в do_div() ядра Linux.
+ */
+
+#ifndef KERNEL_MATH64_H
+#define KERNEL_MATH64_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief Деление 64-битного числа на 32-битное
+ * @param dividend Делимое
+ * @param divisor Делитель (не 0)
+ * @param remainder Выход: остаток (может быть NULL)
+ * @return Частное
+ */
+static inline uint64_t div_u64_rem(uint64_t dividend, uint32_t divisor, uint32_t *remainder) {
+    uint32_t high = (uint32_t)(dividend >> 32);
+    uint32_t low = (uint32_t)dividend;
+    uint32_t quot_high = 0;
+    uint32_t quot_low, rem;
+    
+    if (high >= divisor) {
+        quot_high = high / divisor;
+        high %= divisor;
+    }
+    __asm__("divl %4" : "=a"(quot_low), "=d"(rem) : "a"(low), "d"(high), "rm"(divisor));
+    
+    if (remainder) {
+        *remainder = rem;
+    }
+    return ((uint64_t)quot_high << 32) | quot_low;
+}
+
+/**
+ * @brief Деление 64-битного числа на 32-битное
+ * @param dividend Делимое
+ * @param divisor Делитель (не 0)
+ * @return Частное
+ */
+static inline uint64_t div_u64(uint64_t dividend, uint32_t divisor) {
+    return div_u64_rem(dividend, divisor, NULL);
+}
+
+/**
+ * @brief Вычисление value * mul / div без переполнения промежуточного результата
+ * @param value Исходное значение
+ * @param mul Множитель
+ * @param div Делитель (не 0)
+ * @return Результат масштабирования
+ */
+static inline uint64_t mul_div_u64(uint64_t value, uint32_t mul, uint32_t div) {
+    uint32_t rem;
+    uint64_t quot = div_u64_rem(value, div, &rem);
+    return quot * mul + div_u64((uint64_t)rem * mul, div);
+}
+
+#endif /* KERNEL_MATH64_H */
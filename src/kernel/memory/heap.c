@@ -4,23 +4,66 @@
  * 
  * Реализация кучи ядра с поддержкой функций kmalloc(), kfree() и krealloc()
  * Использует связанный список блоков для управления памятью
+ *
+ * Небольшие объекты (до HEAP_MAG_MAX байт) округляются до класса
+ * размера и проходят через магазины процессоров: освобожденный блок
+ * класса остается в магазине своего процессора помеченным
+ * HEAP_BLOCK_CACHED, и следующий kmalloc() того же класса на этом
+ * процессоре берет его без блокировки кучи. Магазин пополняется и
+ * сливается в список блоков порциями по HEAP_MAG_BATCH.
+ *
+ * kmalloc_aligned() ищет свободный блок, в котором есть адрес с нужным
+ * выравниванием, и отрезает от него спереди отдельный свободный блок;
+ * выравнивание запоминается в заголовке, и krealloc() сохраняет его при
+ * переносе данных.
+ *
+ * Публичные функции выделения передают профилировщику кучи
+ * (heapprof.h) свой адрес возврата и метку подсистемы.
  */
 
 #include "memory.h"
+#include "vmm.h"
+#include "heapprof.h"
+#include "../cpu/cpu.h"
 #include "../video/video.h"
+#include "../sync/mcs.h"
+#include "../lib/compiler.h"
 
 /* Глобальный экземпляр кучи ядра */
 heap_t kernel_heap;
 
+/* Блокировка списка блоков: куча общая для всех процессоров и самая
+ * нагруженная блокировка ядра, поэтому очередная (MCS) */
+static lockstat_t heap_lockstat = LOCKSTAT_INIT("heap");
+static mcs_lock_t heap_lock = MCS_LOCK_INIT_STAT(&heap_lockstat);
+
 /* Минимальный размер блока (включая заголовок) */
 #define MIN_BLOCK_SIZE (sizeof(heap_block_t) + 8)
 
+/* Классы размеров магазинов */
+static const uint32_t heap_class_size[HEAP_MAG_CLASSES] = { 16, 32, 48, 64, 96, 128, 192, HEAP_MAG_MAX };
+
+/**
+ * @brief Магазин объектов процессора
+ *
+ * Трогает только свой процессор с запрещенными прерываниями.
+ */
+typedef struct {
+    uint32_t count[HEAP_MAG_CLASSES];
+    heap_block_t *blocks[HEAP_MAG_CLASSES][HEAP_MAG_SIZE];
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t drains;
+} __attribute__((aligned(64))) heap_magazine_t;
+
+static heap_magazine_t heap_magazines[MAX_CPUS];
+
 /**
  * @brief Инициализация кучи ядра
  * @param start_addr Начальный адрес кучи
  * @param size Размер кучи в байтах
  */
-void heap_init(uint32_t start_addr, uint32_t size) {
+__cold void heap_init(uint32_t start_addr, uint32_t size) {
     print_string("Heap Initialization... ");
     
     /* Выравниваем адрес и размер */
@@ -42,6 +85,14 @@ void heap_init(uint32_t start_addr, uint32_t size) {
     
     kernel_heap.first_block = first_block;
     
+    /* Куча в прямом отображении не должна достаться PMM; ленивая
+     * область в окне ядра получает кадры в обработчике Page Fault */
+    if (start_addr >= KERNEL_VIRT_BASE && start_addr + size <= KERNEL_VIRT_BASE + VMM_DIRECT_SIZE) {
+        for (uint32_t addr = align_down(start_addr, PAGE_SIZE); addr < start_addr + size; addr += PAGE_SIZE) {
+            pmm_mark_page_used(virt_to_phys((void*)addr));
+        }
+    }
+    
     print_string_color("OK\n", COLOR_GREEN, COLOR_BLACK);
     print_string("  - Start: 0x");
     print_hex(start_addr);
@@ -68,6 +119,41 @@ static heap_block_t* find_free_block(size_t size) {
     return NULL;
 }
 
+/**
+ * @brief Отступ до выровненных данных внутри блока
+ * @return Отступ: 0 или не меньше MIN_BLOCK_SIZE, чтобы отрезанное
+ *         спереди стало свободным блоком
+ */
+static uint32_t block_align_pad(heap_block_t *block, uint32_t align) {
+    uint32_t data = (uint32_t)block + sizeof(heap_block_t);
+    uint32_t pad = align_up(data, align) - data;
+    if (pad && pad < MIN_BLOCK_SIZE) {
+        pad = align_up(data + MIN_BLOCK_SIZE, align) - data;
+    }
+    return pad;
+}
+
+/**
+ * @brief Поиск блока, вмещающего size байт с выравниванием align
+ * @param pad Отступ до выровненных данных
+ * @return Указатель на подходящий блок или NULL
+ */
+static heap_block_t* find_free_block_aligned(size_t size, uint32_t align, uint32_t *pad) {
+    heap_block_t *current = kernel_heap.first_block;
+    
+    while (current != NULL) {
+        if (!current->used && current->size >= size) {
+            *pad = block_align_pad(current, align);
+            if (current->size >= size + *pad) {
+                return current;
+            }
+        }
+        current = current->next;
+    }
+    
+    return NULL;
+}
+
 /**
  * @brief Разделение блока на два части
  * @param block Блок для разделения
@@ -118,21 +204,127 @@ static void merge_blocks(heap_block_t *block) {
 }
 
 /**
- * @brief Выделение памяти в куче ядра
- * @param size Размер для выделения
- * @return Указатель на выделенную память или NULL при ошибке
+ * @brief Класс размера для магазинов
+ * @return Номер класса или -1, если объект больше HEAP_MAG_MAX
+ */
+static int heap_size_class(size_t size) {
+    for (int i = 0; i < HEAP_MAG_CLASSES; i++) {
+        if (size <= heap_class_size[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Пополнение магазина класса из списка блоков (прерывания запрещены)
+ */
+static void heap_mag_refill(heap_magazine_t *mag, int cls) {
+    uint32_t size = heap_class_size[cls];
+    
+    mcs_node_t node;
+    uint32_t flags = mcs_lock_irqsave(&heap_lock, &node);
+    while (mag->count[cls] < HEAP_MAG_BATCH) {
+        heap_block_t *block = find_free_block(size);
+        if (!block) {
+            break;
+        }
+        split_block(block, size);
+        block->used = HEAP_BLOCK_CACHED;
+        kernel_heap.used_size += block->size;
+        mag->blocks[cls][mag->count[cls]++] = block;
+    }
+    mcs_unlock_irqrestore(&heap_lock, &node, flags);
+}
+
+/**
+ * @brief Слив HEAP_MAG_BATCH самых давних блоков в список (прерывания запрещены)
+ */
+static void heap_mag_drain(heap_magazine_t *mag, int cls) {
+    heap_block_t **blocks = mag->blocks[cls];
+    
+    mcs_node_t node;
+    uint32_t flags = mcs_lock_irqsave(&heap_lock, &node);
+    for (uint32_t i = 0; i < HEAP_MAG_BATCH; i++) {
+        blocks[i]->used = HEAP_BLOCK_FREE;
+        kernel_heap.used_size -= blocks[i]->size;
+        merge_blocks(blocks[i]);
+    }
+    mcs_unlock_irqrestore(&heap_lock, &node, flags);
+    
+    mag->count[cls] -= HEAP_MAG_BATCH;
+    for (uint32_t i = 0; i < mag->count[cls]; i++) {
+        blocks[i] = blocks[i + HEAP_MAG_BATCH];
+    }
+    mag->drains++;
+}
+
+/**
+ * @brief Выделение объекта класса из магазина текущего процессора
+ * @return Указатель на данные или NULL, если куча исчерпана
+ */
+static void* heap_mag_alloc(int cls) {
+    uint32_t irq_flags = cpu_irq_save();
+    heap_magazine_t *mag = &heap_magazines[cpu_current()];
+    
+    if (mag->count[cls]) {
+        mag->hits++;
+    } else {
+        mag->misses++;
+        heap_mag_refill(mag, cls);
+    }
+    heap_block_t *block = mag->count[cls] ? mag->blocks[cls][--mag->count[cls]] : NULL;
+    cpu_irq_restore(irq_flags);
+    
+    if (!block) {
+        return NULL;
+    }
+    block->used = HEAP_BLOCK_USED;
+    block->align_shift = 0;
+    block->prof_site = 0;
+    return (void*)((uint8_t*)block + sizeof(heap_block_t));
+}
+
+/**
+ * @brief Возврат блока класса в магазин текущего процессора
  */
-void* kmalloc(size_t size) {
+static void heap_mag_free(heap_block_t *block, int cls) {
+    block->used = HEAP_BLOCK_CACHED;
+    
+    uint32_t irq_flags = cpu_irq_save();
+    heap_magazine_t *mag = &heap_magazines[cpu_current()];
+    mag->blocks[cls][mag->count[cls]++] = block;
+    if (mag->count[cls] > HEAP_MAG_HIGH) {
+        heap_mag_drain(mag, cls);
+    }
+    cpu_irq_restore(irq_flags);
+}
+
+/**
+ * @brief Выделение блока без учета профилировщиком
+ */
+static void* heap_alloc(size_t size) {
     if (size == 0) {
         return NULL;
     }
     
+    /* Небольшие объекты - через магазин процессора */
+    int cls = heap_size_class(size);
+    if (cls >= 0) {
+        return heap_mag_alloc(cls);
+    }
+    
     /* Выравниваем размер */
     size = align_up(size, 8);
     
+    /* Список блоков меняется под блокировкой */
+    mcs_node_t node;
+    uint32_t flags = mcs_lock_irqsave(&heap_lock, &node);
+    
     /* Ищем подходящий блок */
     heap_block_t *block = find_free_block(size);
     if (!block) {
+        mcs_unlock_irqrestore(&heap_lock, &node, flags);
         return NULL; /* Нет свободного места */
     }
     
@@ -140,18 +332,123 @@ void* kmalloc(size_t size) {
     split_block(block, size);
     
     /* Помечаем блок как занятый */
-    block->used = 1;
+    block->used = HEAP_BLOCK_USED;
+    block->align_shift = 0;
+    block->prof_site = 0;
     kernel_heap.used_size += block->size;
+    mcs_unlock_irqrestore(&heap_lock, &node, flags);
     
     /* Возвращаем указатель на данные блока */
     return (void*)((uint8_t*)block + sizeof(heap_block_t));
 }
 
+/**
+ * @brief Выделение выровненного блока без учета профилировщиком
+ */
+static void* heap_alloc_aligned(size_t size, uint32_t align) {
+    if (align & (align - 1)) {
+        return NULL;
+    }
+    if (align <= HEAP_MIN_ALIGN) {
+        return heap_alloc(size);
+    }
+    if (size == 0) {
+        return NULL;
+    }
+    
+    size = align_up(size, HEAP_MIN_ALIGN);
+    
+    mcs_node_t node;
+    uint32_t flags = mcs_lock_irqsave(&heap_lock, &node);
+    
+    uint32_t pad;
+    heap_block_t *block = find_free_block_aligned(size, align, &pad);
+    if (!block) {
+        mcs_unlock_irqrestore(&heap_lock, &node, flags);
+        return NULL;
+    }
+    
+    /* Отступ спереди остается свободным блоком */
+    if (pad) {
+        heap_block_t *aligned = (heap_block_t*)((uint8_t*)block + pad);
+        aligned->size = block->size - pad;
+        aligned->used = HEAP_BLOCK_FREE;
+        aligned->next = block->next;
+        aligned->prev = block;
+        if (block->next) {
+            block->next->prev = aligned;
+        }
+        block->next = aligned;
+        block->size = pad - sizeof(heap_block_t);
+        block = aligned;
+    }
+    
+    split_block(block, size);
+    block->used = HEAP_BLOCK_USED;
+    block->align_shift = (uint8_t)__builtin_ctz(align);
+    block->prof_site = 0;
+    kernel_heap.used_size += block->size;
+    mcs_unlock_irqrestore(&heap_lock, &node, flags);
+    
+    return (void*)((uint8_t*)block + sizeof(heap_block_t));
+}
+
+/**
+ * @brief Передача выделенного блока профилировщику, если он включен
+ * @param site Адрес возврата из публичной функции выделения
+ */
+static inline void* heap_track(void *ptr, uint32_t tag, void *site) {
+    if (ptr) {
+        heap_block_t *block = (heap_block_t*)((uint8_t*)ptr - sizeof(heap_block_t));
+        block->tag = tag < HEAP_TAG_COUNT ? tag : HEAP_TAG_NONE;
+        if (heapprof_rate) {
+            heapprof_alloc(block, block->tag, site);
+        }
+    }
+    return ptr;
+}
+
+/**
+ * @brief Выделение памяти в куче ядра
+ * @param size Размер для выделения
+ * @return Указатель на выделенную память или NULL при ошибке
+ */
+__hot void* kmalloc(size_t size) {
+    return heap_track(heap_alloc(size), HEAP_TAG_NONE, __builtin_return_address(0));
+}
+
+/**
+ * @brief Выделение памяти с выравниванием данных
+ * @param size Размер для выделения
+ * @param align Выравнивание (степень двойки)
+ * @return Указатель на выделенную память или NULL при ошибке
+ */
+void* kmalloc_aligned(size_t size, uint32_t align) {
+    return heap_track(heap_alloc_aligned(size, align), HEAP_TAG_NONE, __builtin_return_address(0));
+}
+
+/**
+ * @brief Выделение памяти с флагами KMALLOC_*
+ * @param size Размер для выделения
+ * @param flags KMALLOC_CACHELINE - объект не делит строки кэша с соседями;
+ *              KMALLOC_TAG(HEAP_TAG_*) - подсистема для профилировщика
+ * @return Указатель на выделенную память или NULL при ошибке
+ */
+void* kmalloc_flags(size_t size, uint32_t flags) {
+    void *ptr;
+    if (flags & KMALLOC_CACHELINE) {
+        ptr = heap_alloc_aligned(align_up(size, HEAP_CACHE_LINE), HEAP_CACHE_LINE);
+    } else {
+        ptr = heap_alloc(size);
+    }
+    return heap_track(ptr, KMALLOC_TAG_OF(flags), __builtin_return_address(0));
+}
+
 /**
  * @brief Освобождение памяти в куче ядра
  * @param ptr Указатель на память для освобождения
  */
-void kfree(void* ptr) {
+__hot void kfree(void* ptr) {
     if (!ptr) {
         return;
     }
@@ -165,13 +462,29 @@ void kfree(void* ptr) {
         return;
     }
     
+    if (block->used == HEAP_BLOCK_USED && block->prof_site) {
+        heapprof_free(block, block->size);
+    }
+    
+    /* Блок ровно по классу возвращается в магазин уже очищенным */
+    int cls = heap_size_class(block->size);
+    if (cls >= 0 && block->size == heap_class_size[cls] && block->used == HEAP_BLOCK_USED) {
+        memory_set(ptr, 0, block->size);
+        heap_mag_free(block, cls);
+        return;
+    }
+    
+    mcs_node_t node;
+    uint32_t flags = mcs_lock_irqsave(&heap_lock, &node);
+    
     /* Проверяем, что блок был занят */
-    if (!block->used) {
+    if (block->used != HEAP_BLOCK_USED) {
+        mcs_unlock_irqrestore(&heap_lock, &node, flags);
         return;
     }
     
     /* Освобождаем блок */
-    block->used = 0;
+    block->used = HEAP_BLOCK_FREE;
     kernel_heap.used_size -= block->size;
     
     /* Очищаем содержимое блока */
@@ -179,6 +492,7 @@ void kfree(void* ptr) {
     
     /* Объединяем с соседними свободными блоками */
     merge_blocks(block);
+    mcs_unlock_irqrestore(&heap_lock, &node, flags);
 }
 
 /**
@@ -189,7 +503,7 @@ void kfree(void* ptr) {
  */
 void* krealloc(void* ptr, size_t new_size) {
     if (!ptr) {
-        return kmalloc(new_size);
+        return heap_track(heap_alloc(new_size), HEAP_TAG_NONE, __builtin_return_address(0));
     }
     
     if (new_size == 0) {
@@ -200,8 +514,9 @@ void* krealloc(void* ptr, size_t new_size) {
     /* Получаем текущий блок */
     heap_block_t *block = (heap_block_t*)((uint8_t*)ptr - sizeof(heap_block_t));
     
-    /* Выравниваем новый размер */
-    new_size = align_up(new_size, 8);
+    /* Выравниваем новый размер; объект в строках кэша занимает их целиком */
+    uint32_t align = 1u << block->align_shift;
+    new_size = align_up(new_size, align == HEAP_CACHE_LINE ? HEAP_CACHE_LINE : 8);
     
     /* Если новый размер меньше или равен текущему */
     if (new_size <= block->size) {
@@ -209,12 +524,14 @@ void* krealloc(void* ptr, size_t new_size) {
     }
     
     /* Пытаемся расширить блок */
+    size_t old_size = block->size;
+    mcs_node_t node;
+    uint32_t flags = mcs_lock_irqsave(&heap_lock, &node);
     if (block->next && !block->next->used) {
         size_t total_size = block->size + sizeof(heap_block_t) + block->next->size;
         if (total_size >= new_size) {
             /* Можем расширить блок */
             block->size = new_size;
-            kernel_heap.used_size += (new_size - block->size);
             
             /* Обновляем следующий блок */
             if (total_size - new_size >= MIN_BLOCK_SIZE) {
@@ -236,12 +553,21 @@ void* krealloc(void* ptr, size_t new_size) {
                     block->next->prev = block;
                 }
             }
-            return ptr;
+            kernel_heap.used_size += block->size - old_size;
+            mcs_unlock_irqrestore(&heap_lock, &node, flags);
+            
+            /* Профилировщик учитывает рост как новое выделение */
+            if (block->prof_site) {
+                heapprof_free(block, old_size);
+            }
+            return heap_track(ptr, block->tag, __builtin_return_address(0));
         }
     }
+    mcs_unlock_irqrestore(&heap_lock, &node, flags);
     
-    /* Не можем расширить, выделяем новый блок */
-    void* new_ptr = kmalloc(new_size);
+    /* Не можем расширить, выделяем новый блок с тем же выравниванием */
+    void* new_ptr = heap_track(heap_alloc_aligned(new_size, align), block->tag,
+                               __builtin_return_address(0));
     if (new_ptr) {
         memory_copy(new_ptr, ptr, block->size);
         kfree(ptr);
@@ -272,12 +598,15 @@ void heap_dump_info(void) {
     /* Подсчитываем количество блоков */
     uint32_t total_blocks = 0;
     uint32_t used_blocks = 0;
+    uint32_t cached_blocks = 0;
     heap_block_t *current = kernel_heap.first_block;
     
     while (current != NULL) {
         total_blocks++;
-        if (current->used) {
+        if (current->used == HEAP_BLOCK_USED) {
             used_blocks++;
+        } else if (current->used == HEAP_BLOCK_CACHED) {
+            cached_blocks++;
         }
         current = current->next;
     }
@@ -286,7 +615,47 @@ void heap_dump_info(void) {
     print_hex(total_blocks);
     print_string("\n  - Used blocks: ");
     print_hex(used_blocks);
+    print_string("\n  - Cached blocks: ");
+    print_hex(cached_blocks);
     print_string("\n  - Free blocks: ");
-    print_hex(total_blocks - used_blocks);
+    print_hex(total_blocks - used_blocks - cached_blocks);
     print_string("\n");
+    
+    mag_stats_t stats;
+    heap_mag_stats(&stats);
+    print_string("  - Per-CPU magazines: ");
+    print_dec(stats.hits);
+    print_string(" hits, ");
+    print_dec(stats.misses);
+    print_string(" misses, ");
+    print_dec(stats.drains);
+    print_string(" drains\n");
+}
+
+/**
+ * @brief Сброс записей профилировщика во всех блоках (heapprof_enable())
+ */
+void heap_clear_prof(void) {
+    mcs_node_t node;
+    uint32_t flags = mcs_lock_irqsave(&heap_lock, &node);
+    for (heap_block_t *block = kernel_heap.first_block; block; block = block->next) {
+        block->prof_site = 0;
+    }
+    mcs_unlock_irqrestore(&heap_lock, &node, flags);
+}
+
+/**
+ * @brief Сводная статистика магазинов объектов по всем процессорам
+ */
+void heap_mag_stats(mag_stats_t *stats) {
+    memory_set(stats, 0, sizeof(*stats));
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        heap_magazine_t *mag = &heap_magazines[cpu];
+        stats->hits += mag->hits;
+        stats->misses += mag->misses;
+        stats->drains += mag->drains;
+        for (int cls = 0; cls < HEAP_MAG_CLASSES; cls++) {
+            stats->cached += mag->count[cls];
+        }
+    }
 } 
\ No newline at end of file
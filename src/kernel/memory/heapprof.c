@@ -0,0 +1,325 @@
+/**
+ * @file heapprof.c
+ * @brief Профилировщик кучи по местам выделения и подсистемам
+ *
+ * Места хранятся в хэш-таблице с открытой адресацией по паре
+ * (адрес вызова, метка); записи не удаляются до следующего включения.
+ * Таблицы меняются под heapprof_lock только для учтенных выделений,
+ * неучтенные трогают лишь счетчик байт своего процессора. Отчет
+ * сортирует снимок таблицы по живым байтам; адреса вызовов
+ * переводятся в строки исходников через addr2line -e kernel.
+ */
+
+#include "heapprof.h"
+#include "../cpu/cpu.h"
+#include "../drivers/serial.h"
+#include "../sync/spinlock.h"
+#include "../video/video.h"
+
+/**
+ * @brief Счетчик байт до следующего учтенного выделения
+ */
+typedef struct {
+    int32_t countdown;
+} __attribute__((aligned(64))) heapprof_cpu_t;
+
+volatile uint32_t heapprof_rate = 0;
+
+/* Шаг выборки текущего включения: по нему kfree() пересчитывает вес */
+static uint32_t heapprof_session_rate = 1;
+static int heapprof_started = 0;
+
+static heapprof_site_t heapprof_sites[HEAPPROF_MAX_SITES];
+static heapprof_counts_t heapprof_tags[HEAP_TAG_COUNT];
+static uint32_t heapprof_lost = 0;    /* Не хватило места в таблице */
+static heapprof_cpu_t heapprof_cpus[MAX_CPUS];
+static spinlock_t heapprof_lock = SPINLOCK_INIT;
+
+/* Снимок таблицы для отчета (вывод в COM1 идет без блокировки) */
+static heapprof_site_t heapprof_snapshot[HEAPPROF_MAX_SITES];
+
+static const char *heapprof_tag_names[HEAP_TAG_COUNT] = {
+    "none", "memory", "sched", "video", "drivers", "async", "test"
+};
+
+/**
+ * @brief Включение профилировщика с очисткой таблиц
+ */
+void heapprof_enable(uint32_t rate) {
+    if (!rate) {
+        rate = 1;
+    }
+    
+    /* Блоки прошлого включения указывают на записи, которые сейчас
+     * будут стерты */
+    heapprof_rate = 0;
+    heap_clear_prof();
+    
+    uint32_t flags = spin_lock_irqsave(&heapprof_lock);
+    memory_set(heapprof_sites, 0, sizeof(heapprof_sites));
+    memory_set(heapprof_tags, 0, sizeof(heapprof_tags));
+    heapprof_lost = 0;
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        heapprof_cpus[cpu].countdown = (int32_t)rate;
+    }
+    heapprof_started = 1;
+    heapprof_session_rate = rate;
+    heapprof_rate = rate;
+    spin_unlock_irqrestore(&heapprof_lock, flags);
+}
+
+/**
+ * @brief Выключение учета новых выделений
+ */
+void heapprof_disable(void) {
+    heapprof_rate = 0;
+}
+
+/**
+ * @brief Вес учтенного блока: он представляет rate байт выборки
+ */
+static uint32_t heapprof_weight(uint32_t size) {
+    return size >= heapprof_session_rate ? size : heapprof_session_rate;
+}
+
+/**
+ * @brief Вычитание без перехода через ноль
+ *
+ * Блок, освобождаемый во время heapprof_enable(), может вычесть свой
+ * вес из уже очищенной записи.
+ */
+static void heapprof_sub(uint32_t *value, uint32_t amount) {
+    *value = *value > amount ? *value - amount : 0;
+}
+
+/**
+ * @brief Поиск или добавление места (под heapprof_lock)
+ * @return Номер записи или -1, если таблица заполнена
+ */
+static int heapprof_find_site(void *site, uint32_t tag) {
+    uint32_t hash = (((uint32_t)site >> 2) ^ (tag * 0x9E3779B1)) * 0x9E3779B1;
+    uint32_t index = (hash >> 16) & (HEAPPROF_MAX_SITES - 1);
+    
+    for (uint32_t probe = 0; probe < HEAPPROF_MAX_SITES; probe++) {
+        heapprof_site_t *entry = &heapprof_sites[index];
+        if (entry->site == site && entry->tag == tag) {
+            return (int)index;
+        }
+        if (!entry->site) {
+            entry->site = site;
+            entry->tag = tag;
+            return (int)index;
+        }
+        index = (index + 1) & (HEAPPROF_MAX_SITES - 1);
+    }
+    return -1;
+}
+
+/**
+ * @brief Учет выделенного блока
+ */
+void heapprof_alloc(heap_block_t *block, uint32_t tag, void *site) {
+    uint32_t rate = heapprof_rate;
+    block->prof_site = 0;
+    if (!rate) {
+        return;
+    }
+    
+    /* Выборка: учитывается выделение, переходящее через rate байт */
+    uint32_t irq_flags = cpu_irq_save();
+    heapprof_cpu_t *cpu = &heapprof_cpus[cpu_current()];
+    cpu->countdown -= (int32_t)block->size;
+    if (cpu->countdown > 0) {
+        cpu_irq_restore(irq_flags);
+        return;
+    }
+    cpu->countdown += (int32_t)rate;
+    if (cpu->countdown <= 0) {
+        cpu->countdown = (int32_t)rate;
+    }
+    cpu_irq_restore(irq_flags);
+    
+    uint32_t flags = spin_lock_irqsave(&heapprof_lock);
+    int index = heapprof_find_site(site, tag);
+    if (index < 0) {
+        heapprof_lost++;
+        spin_unlock_irqrestore(&heapprof_lock, flags);
+        return;
+    }
+    
+    uint32_t weight = heapprof_weight(block->size);
+    uint32_t objects = weight / block->size;
+    heapprof_counts_t *counts[2] = { &heapprof_sites[index].counts, &heapprof_tags[tag] };
+    for (int i = 0; i < 2; i++) {
+        counts[i]->live_bytes += weight;
+        counts[i]->live_objects += objects;
+        counts[i]->allocs += objects;
+        counts[i]->bytes += weight;
+    }
+    block->prof_site = index + 1;
+    spin_unlock_irqrestore(&heapprof_lock, flags);
+}
+
+/**
+ * @brief Учет освобождения блока с ненулевым полем prof_site
+ */
+void heapprof_free(heap_block_t *block, uint32_t size) {
+    /* heap_clear_prof() мог стереть запись после проверки в куче */
+    uint32_t site = block->prof_site;
+    block->prof_site = 0;
+    if (!site) {
+        return;
+    }
+    heapprof_site_t *entry = &heapprof_sites[site - 1];
+    
+    uint32_t flags = spin_lock_irqsave(&heapprof_lock);
+    uint32_t weight = heapprof_weight(size);
+    uint32_t objects = weight / size;
+    heapprof_counts_t *counts[2] = { &entry->counts, &heapprof_tags[entry->tag] };
+    for (int i = 0; i < 2; i++) {
+        heapprof_sub(&counts[i]->live_bytes, weight);
+        heapprof_sub(&counts[i]->live_objects, objects);
+    }
+    spin_unlock_irqrestore(&heapprof_lock, flags);
+}
+
+/**
+ * @brief Вывод числа в COM1
+ */
+static void heapprof_put_dec(uint32_t value) {
+    char buffer[11];
+    int i = 10;
+    buffer[i] = '\0';
+    do {
+        buffer[--i] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+    serial_write_string(&buffer[i]);
+}
+
+/**
+ * @brief Вывод адреса в COM1
+ */
+static void heapprof_put_hex(uint32_t value) {
+    char buffer[11] = "0x";
+    for (int i = 0; i < 8; i++) {
+        uint32_t digit = (value >> (28 - i * 4)) & 0xF;
+        buffer[2 + i] = digit < 10 ? '0' + digit : 'a' + digit - 10;
+    }
+    buffer[10] = '\0';
+    serial_write_string(buffer);
+}
+
+/**
+ * @brief Вывод счетчиков в COM1
+ */
+static void heapprof_put_counts(const heapprof_counts_t *counts) {
+    heapprof_put_dec(counts->live_bytes);
+    serial_write_string(", ");
+    heapprof_put_dec(counts->live_objects);
+    serial_write_string(", ");
+    heapprof_put_dec(counts->allocs);
+    serial_write_string(", ");
+    heapprof_put_dec(counts->bytes);
+    serial_write_string("\n");
+}
+
+/**
+ * @brief Счетчики подсистемы
+ */
+void heapprof_tag_counts(uint32_t tag, heapprof_counts_t *counts) {
+    memory_set(counts, 0, sizeof(*counts));
+    if (tag >= HEAP_TAG_COUNT) {
+        return;
+    }
+    
+    uint32_t flags = spin_lock_irqsave(&heapprof_lock);
+    *counts = heapprof_tags[tag];
+    spin_unlock_irqrestore(&heapprof_lock, flags);
+}
+
+/**
+ * @brief Места выделения по убыванию живых байт
+ */
+const heapprof_site_t* heapprof_sorted_sites(uint32_t *count) {
+    /* Снимок записей под блокировкой */
+    uint32_t flags = spin_lock_irqsave(&heapprof_lock);
+    uint32_t sites = 0;
+    for (uint32_t i = 0; i < HEAPPROF_MAX_SITES; i++) {
+        if (heapprof_sites[i].site) {
+            heapprof_snapshot[sites++] = heapprof_sites[i];
+        }
+    }
+    spin_unlock_irqrestore(&heapprof_lock, flags);
+    
+    /* Сортировка вставками по убыванию живых байт */
+    for (uint32_t i = 1; i < sites; i++) {
+        heapprof_site_t entry = heapprof_snapshot[i];
+        uint32_t j = i;
+        while (j > 0 && heapprof_snapshot[j - 1].counts.live_bytes < entry.counts.live_bytes) {
+            heapprof_snapshot[j] = heapprof_snapshot[j - 1];
+            j--;
+        }
+        heapprof_snapshot[j] = entry;
+    }
+    
+    *count = sites;
+    return heapprof_snapshot;
+}
+
+/**
+ * @brief Сводка по подсистемам на экран, отчет по местам - в COM1
+ */
+void heapprof_dump(void) {
+    if (!heapprof_started) {
+        print_string("Heap profiler was never enabled\n");
+        return;
+    }
+    
+    uint32_t count;
+    const heapprof_site_t *sites = heapprof_sorted_sites(&count);
+    heapprof_counts_t tags[HEAP_TAG_COUNT];
+    for (uint32_t tag = 0; tag < HEAP_TAG_COUNT; tag++) {
+        heapprof_tag_counts(tag, &tags[tag]);
+    }
+    uint32_t lost = heapprof_lost;
+    uint32_t rate = heapprof_session_rate;
+    
+    print_string("Heap profile (");
+    print_string(heapprof_rate ? "on" : "off");
+    print_string(", sampling every ");
+    print_dec(rate);
+    print_string(" bytes, ");
+    print_dec(count);
+    print_string(" sites):\n");
+    for (uint32_t tag = 0; tag < HEAP_TAG_COUNT; tag++) {
+        if (!tags[tag].allocs) {
+            continue;
+        }
+        print_string("  - ");
+        print_string(heapprof_tag_names[tag]);
+        print_string(": ");
+        print_dec(tags[tag].live_bytes);
+        print_string(" bytes in ");
+        print_dec(tags[tag].live_objects);
+        print_string(" objects live, ");
+        print_dec(tags[tag].allocs);
+        print_string(" allocations\n");
+    }
+    if (lost) {
+        print_string("  - ");
+        print_dec(lost);
+        print_string(" samples lost: site table full\n");
+    }
+    
+    serial_write_string("Allocation sites (caller tag: live bytes, live objects, allocations, bytes):\n");
+    for (uint32_t i = 0; i < count; i++) {
+        serial_write_string("  ");
+        heapprof_put_hex((uint32_t)sites[i].site);
+        serial_write_string(" ");
+        serial_write_string(heapprof_tag_names[sites[i].tag]);
+        serial_write_string(": ");
+        heapprof_put_counts(&sites[i].counts);
+    }
+    print_string("Allocation sites written to COM1\n");
+}
@@ -0,0 +1,100 @@
+/**
+ * @file heapprof.h
+ * @brief Профилировщик кучи по местам выделения и подсистемам
+ *
+ * Включенный профилировщик отмечает выделения kmalloc*() по выборке:
+ * на каждом процессоре ведется счетчик байт, и выделение, на котором
+ * он переходит через rate, учитывается с весом max(размер, rate) байт.
+ * При rate = 1 учитывается каждое выделение. Учтенное выделение
+ * записывается в таблицу мест (адрес вызова и метка подсистемы
+ * KMALLOC_TAG()) и в таблицу меток: живые байты и объекты, всего
+ * выделений и байт. Номер записи хранится в заголовке блока, и
+ * kfree() вычитает вес из тех же записей. Метку заголовок хранит для
+ * любого блока: krealloc() передает ее перенесенной копии.
+ *
+ * Пока профилировщик выключен, kmalloc() платит одной проверкой
+ * heapprof_rate, а kfree() - проверкой поля заголовка.
+ */
+
+#ifndef KERNEL_HEAPPROF_H
+#define KERNEL_HEAPPROF_H
+
+#include <stdint.h>
+#include "memory.h"
+
+/* Мест выделения в таблице (степень двойки, не больше 2047) */
+#define HEAPPROF_MAX_SITES 1024
+
+/* Шаг выборки для постоянной работы (команда heapprof sample) */
+#define HEAPPROF_SAMPLE_RATE 4096
+
+/**
+ * @brief Счетчики места выделения или подсистемы (веса в байтах)
+ */
+typedef struct {
+    uint32_t live_bytes;      /* Выделено и не освобождено */
+    uint32_t live_objects;
+    uint32_t allocs;          /* Всего выделений */
+    uint32_t bytes;           /* Всего байт */
+} heapprof_counts_t;
+
+/**
+ * @brief Место выделения
+ */
+typedef struct {
+    void *site;               /* Адрес возврата (NULL - запись свободна) */
+    uint32_t tag;
+    heapprof_counts_t counts;
+} heapprof_site_t;
+
+/* Шаг выборки в байтах (0 - профилировщик выключен) */
+extern volatile uint32_t heapprof_rate;
+
+/**
+ * @brief Включение профилировщика с очисткой таблиц
+ * @param rate Учитывать выделение на каждом rate-м байте (1 - все)
+ *
+ * Записи в блоках, учтенных до включения, стираются (heap_clear_prof()).
+ */
+void heapprof_enable(uint32_t rate);
+
+/**
+ * @brief Выключение учета новых выделений
+ *
+ * Освобождение уже учтенных блоков продолжает уменьшать живые байты.
+ */
+void heapprof_disable(void);
+
+/**
+ * @brief Учет выделенного блока (вызывается кучей при heapprof_rate != 0)
+ * @param block Занятый блок
+ * @param tag Метка подсистемы HEAP_TAG_*
+ * @param site Адрес возврата в вызвавший kmalloc*() код
+ */
+void heapprof_alloc(heap_block_t *block, uint32_t tag, void *site);
+
+/**
+ * @brief Учет освобождения блока с ненулевым полем prof_site
+ * @param size Размер блока при выделении
+ */
+void heapprof_free(heap_block_t *block, uint32_t size);
+
+/**
+ * @brief Счетчики подсистемы (копия)
+ * @param tag HEAP_TAG_*
+ */
+void heapprof_tag_counts(uint32_t tag, heapprof_counts_t *counts);
+
+/**
+ * @brief Места выделения по убыванию живых байт
+ * @param count Выход: количество мест
+ * @return Снимок таблицы; действует до следующего вызова или heapprof_dump()
+ */
+const heapprof_site_t* heapprof_sorted_sites(uint32_t *count);
+
+/**
+ * @brief Сводка по подсистемам на экран, отчет по местам - в COM1
+ */
+void heapprof_dump(void);
+
+#endif /* KERNEL_HEAPPROF_H */
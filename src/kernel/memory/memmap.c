@@ -0,0 +1,89 @@
+/**
+ * @file memmap.c
+ * @brief Карта физической памяти от загрузчика Multiboot
+ */
+
+#include "memmap.h"
+#include "../video/video.h"
+#include "../lib/compiler.h"
+
+memmap_entry_t memmap[MEMMAP_MAX_ENTRIES];
+uint32_t memmap_count = 0;
+
+/**
+ * @brief Добавление диапазона в карту
+ */
+static void memmap_add(phys_addr_t base, uint64_t length, uint32_t type) {
+    if (memmap_count < MEMMAP_MAX_ENTRIES && length) {
+        memmap[memmap_count].base = base;
+        memmap[memmap_count].length = length;
+        memmap[memmap_count].type = type;
+        memmap_count++;
+    }
+}
+
+/**
+ * @brief Разбор карты памяти загрузчика
+ */
+__cold void memmap_init(uint32_t magic, uint32_t info_addr) {
+    print_string("Memory Map... ");
+    
+    /* Загрузочные таблицы отображают нижний гигабайт и в верхнюю половину */
+    multiboot_info_t *info = (multiboot_info_t*)phys_to_virt(info_addr);
+    const char *source;
+    
+    if (magic == MULTIBOOT_BOOTLOADER_MAGIC && (info->flags & MULTIBOOT_INFO_MEM_MAP)) {
+        uint32_t addr = info->mmap_addr;
+        uint32_t end = info->mmap_addr + info->mmap_length;
+        while (addr < end) {
+            multiboot_mmap_entry_t *entry = (multiboot_mmap_entry_t*)phys_to_virt(addr);
+            memmap_add(entry->base, entry->length, entry->type);
+            addr += entry->size + sizeof(entry->size);
+        }
+        source = "BIOS E820";
+    } else if (magic == MULTIBOOT_BOOTLOADER_MAGIC && (info->flags & MULTIBOOT_INFO_MEMORY)) {
+        memmap_add(0, (uint64_t)info->mem_lower * 1024, MEMMAP_USABLE);
+        memmap_add(0x100000, (uint64_t)info->mem_upper * 1024, MEMMAP_USABLE);
+        source = "mem_upper";
+    } else {
+        memmap_add(0x100000, 0x100000000ULL - 0x100000, MEMMAP_USABLE);
+        source = "none, assuming 4 GB";
+    }
+    
+    uint64_t usable = 0;
+    uint64_t high = 0;
+    for (uint32_t i = 0; i < memmap_count; i++) {
+        if (memmap[i].type != MEMMAP_USABLE) {
+            continue;
+        }
+        usable += memmap[i].length;
+        phys_addr_t end = memmap[i].base + memmap[i].length;
+        if (end > 0x100000000ULL) {
+            high += end - (memmap[i].base > 0x100000000ULL ? memmap[i].base : 0x100000000ULL);
+        }
+    }
+    
+    print_string_color("OK\n", COLOR_GREEN, COLOR_BLACK);
+    print_string("  - Source: ");
+    print_string(source);
+    print_string("\n  - Usable: ");
+    print_dec((uint32_t)(usable >> 20));
+    print_string(" MB (above 4 GB: ");
+    print_dec((uint32_t)(high >> 20));
+    print_string(" MB), ranges: ");
+    print_dec(memmap_count);
+    print_string("\n");
+}
+
+/**
+ * @brief Конец последнего доступного диапазона
+ */
+phys_addr_t memmap_usable_end(void) {
+    phys_addr_t end = 0;
+    for (uint32_t i = 0; i < memmap_count; i++) {
+        if (memmap[i].type == MEMMAP_USABLE && memmap[i].base + memmap[i].length > end) {
+            end = memmap[i].base + memmap[i].length;
+        }
+    }
+    return end;
+}
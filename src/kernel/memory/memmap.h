@@ -0,0 +1,90 @@
+/**
+ * @file memmap.h
+ * @brief Карта физической памяти от загрузчика Multiboot
+ *
+ * Загрузчик сообщает диапазоны физической памяти и их тип (BIOS E820).
+ * PMM считает свободными только доступные диапазоны, в том числе
+ * лежащие выше 4 ГБ.
+ */
+
+#ifndef KERNEL_MEMMAP_H
+#define KERNEL_MEMMAP_H
+
+#include <stdint.h>
+#include "memory.h"
+
+/* Значение eax при входе от загрузчика Multiboot */
+#define MULTIBOOT_BOOTLOADER_MAGIC 0x2BADB002
+
+/* Флаги структуры Multiboot */
+#define MULTIBOOT_INFO_MEMORY  0x001   /* Поля mem_lower/mem_upper */
+#define MULTIBOOT_INFO_MEM_MAP 0x040   /* Поля mmap_length/mmap_addr */
+
+/* Типы диапазонов */
+#define MEMMAP_USABLE   1
+#define MEMMAP_RESERVED 2
+#define MEMMAP_ACPI     3
+#define MEMMAP_NVS      4
+#define MEMMAP_BAD      5
+
+/* Запоминаемых диапазонов */
+#define MEMMAP_MAX_ENTRIES 32
+
+/**
+ * @brief Структура, передаваемая загрузчиком Multiboot (начало)
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t flags;
+    uint32_t mem_lower;       /* КБ ниже 1 МБ */
+    uint32_t mem_upper;       /* КБ выше 1 МБ до первой дыры */
+    uint32_t boot_device;
+    uint32_t cmdline;
+    uint32_t mods_count;
+    uint32_t mods_addr;
+    uint32_t syms[4];
+    uint32_t mmap_length;     /* Размер карты памяти в байтах */
+    uint32_t mmap_addr;       /* Физический адрес карты памяти */
+} multiboot_info_t;
+
+/**
+ * @brief Элемент карты памяти Multiboot
+ *
+ * Поле size не включает само себя: следующий элемент лежит
+ * через size + 4 байта.
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t size;
+    uint64_t base;
+    uint64_t length;
+    uint32_t type;
+} multiboot_mmap_entry_t;
+
+/**
+ * @brief Диапазон физической памяти
+ */
+typedef struct {
+    phys_addr_t base;
+    uint64_t length;
+    uint32_t type;            /* MEMMAP_* */
+} memmap_entry_t;
+
+/* Карта памяти, скопированная из структуры загрузчика */
+extern memmap_entry_t memmap[MEMMAP_MAX_ENTRIES];
+extern uint32_t memmap_count;
+
+/**
+ * @brief Разбор карты памяти загрузчика
+ * @param magic Значение eax при входе в ядро
+ * @param info_addr Физический адрес структуры Multiboot (ebx)
+ *
+ * Без карты используется mem_upper, без него - прежнее допущение
+ * о свободной памяти до 4 ГБ.
+ */
+void memmap_init(uint32_t magic, uint32_t info_addr);
+
+/**
+ * @brief Конец последнего доступного диапазона
+ */
+phys_addr_t memmap_usable_end(void);
+
+#endif /* KERNEL_MEMMAP_H */
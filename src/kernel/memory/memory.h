@@ -5,6 +5,11 @@
  * Реализация двухуровневой системы управления памятью:
  * 1. Physical Memory Manager (PMM) - управление физическими страницами
  * 2. Kernel Heap Allocator - динамическое выделение памяти для ядра
+ *
+ * Физические адреса 64-битные (PAE). Ядро работает в верхней
+ * половине адресного пространства: нижняя память (до PMM_LOWMEM_END)
+ * отображена с KERNEL_VIRT_BASE, и ее кадры доступны через
+ * phys_to_virt(); верхняя - только через kmap_atomic().
  */
 
 #ifndef MEMORY_H
@@ -18,14 +23,71 @@
 #define PAGE_SHIFT 12
 #define PAGE_MASK 0xFFFFF000
 
-/* Максимальное количество страниц (4GB / 4KB = 1M страниц) */
-#define MAX_PAGES 1048576
-#define BITMAP_SIZE (MAX_PAGES / 32)
+/* Физический адрес */
+typedef uint64_t phys_addr_t;
+
+/* Максимальное количество страниц (64GB / 4KB - 36-битный адрес PAE) */
+#define MAX_PAGES 16777216
+
+/* Граница нижней памяти (совпадает с прямым отображением) */
+#define PMM_LOWMEM_END 0x20000000
+
+/* Наибольшее число цветов кадров (степень двойки) */
+#define PMM_MAX_COLOURS 256
+
+/* Магазины кадров процессоров (по зонам): емкость, кадров за одно
+ * пополнение или слив, и порог, выше которого освобождение сливает
+ * самые давние кадры обратно в битовую карту */
+#define PMM_MAG_SIZE  64
+#define PMM_MAG_BATCH 16
+#define PMM_MAG_HIGH  48
+
+/* Магазины объектов кучи: классы размеров и те же параметры */
+#define HEAP_MAG_CLASSES 8
+#define HEAP_MAG_MAX     256
+#define HEAP_MAG_SIZE    16
+#define HEAP_MAG_BATCH   8
+#define HEAP_MAG_HIGH    12
+
+/* Начало верхней половины: образ ядра и прямое отображение нижней памяти */
+#define KERNEL_VIRT_BASE 0xC0000000
+
+/**
+ * @brief Адрес кадра нижней памяти в прямом отображении
+ */
+static inline void* phys_to_virt(phys_addr_t phys) {
+    return (void*)((uint32_t)phys + KERNEL_VIRT_BASE);
+}
+
+/**
+ * @brief Физический адрес для адреса ядра или прямого отображения
+ */
+static inline uint32_t virt_to_phys(const void *virt) {
+    return (uint32_t)virt - KERNEL_VIRT_BASE;
+}
 
 /* Состояния страницы */
 #define PAGE_FREE 0
 #define PAGE_USED 1
 
+/* Флаги кадра */
+#define PAGE_FLAG_RESERVED 0x01  /* Вне подсчета ссылок */
+#define PAGE_FLAG_ZERO     0x02  /* Общая нулевая страница */
+#define PAGE_FLAG_CACHED   0x04  /* Свободен, лежит в магазине процессора */
+
+/**
+ * @brief Описатель физического кадра
+ *
+ * Кадр, выданный pmm_alloc_page(), получает одну ссылку. Кадры,
+ * помеченные занятыми напрямую (ядро, первый мегабайт), имеют
+ * нулевой счетчик и в подсчете не участвуют.
+ */
+typedef struct {
+    uint32_t refcount;       /* Владельцев кадра (0 - свободен или вне учета) */
+    uint16_t mapcount;       /* Отображений в таблицах страниц */
+    uint16_t flags;          /* PAGE_FLAG_* */
+} page_t;
+
 /* Типы выделения памяти */
 typedef enum {
     HEAP_SMALL,   /* 1-64 байта */
@@ -33,10 +95,37 @@ typedef enum {
     HEAP_LARGE    /* 513+ байт */
 } heap_type_t;
 
+/* Состояния блока кучи */
+#define HEAP_BLOCK_FREE   0
+#define HEAP_BLOCK_USED   1
+#define HEAP_BLOCK_CACHED 2  /* Свободен, лежит в магазине процессора */
+
+/* Выравнивание данных кучи: обычное и строка кэша */
+#define HEAP_MIN_ALIGN  8
+#define HEAP_CACHE_LINE 64
+
+/* Флаги kmalloc_flags() */
+#define KMALLOC_CACHELINE 0x01  /* Данные с начала строки кэша, размер кратен строке */
+#define KMALLOC_TAG(tag)  ((uint32_t)(tag) << 8)  /* Подсистема для профилировщика кучи */
+#define KMALLOC_TAG_OF(flags) (((flags) >> 8) & 0xFF)
+
+/* Метки подсистем для профилировщика кучи (memory/heapprof.h, не больше 32) */
+#define HEAP_TAG_NONE    0
+#define HEAP_TAG_MEMORY  1
+#define HEAP_TAG_SCHED   2
+#define HEAP_TAG_VIDEO   3
+#define HEAP_TAG_DRIVERS 4
+#define HEAP_TAG_ASYNC   5
+#define HEAP_TAG_TEST    6
+#define HEAP_TAG_COUNT   7
+
 /* Структура блока кучи */
 typedef struct heap_block {
     uint32_t size;           /* Размер блока */
-    uint8_t used;            /* Флаг использования */
+    uint8_t used;            /* HEAP_BLOCK_* */
+    uint8_t align_shift;     /* log2 выравнивания kmalloc_aligned() (0 - обычное) */
+    uint16_t prof_site : 11; /* Запись профилировщика кучи + 1 (0 - не учтен) */
+    uint16_t tag : 5;        /* HEAP_TAG_* выделения */
     struct heap_block *next; /* Следующий блок */
     struct heap_block *prev; /* Предыдущий блок */
 } heap_block_t;
@@ -50,12 +139,28 @@ typedef struct {
     heap_block_t *first_block; /* Первый блок */
 } heap_t;
 
+/**
+ * @brief Сводная статистика магазинов всех процессоров
+ */
+typedef struct {
+    uint32_t hits;           /* Выделений из магазина */
+    uint32_t misses;         /* Магазин был пуст */
+    uint32_t drains;         /* Сливов выше порога */
+    uint32_t cached;         /* Лежит в магазинах сейчас */
+} mag_stats_t;
+
 /* Структура менеджера физической памяти */
 typedef struct {
-    uint32_t bitmap[BITMAP_SIZE]; /* Битовое поле для отслеживания страниц */
-    uint32_t total_pages;         /* Общее количество страниц */
+    uint32_t *bitmap;             /* Битовое поле (сразу за ядром) */
+    uint32_t total_pages;         /* Кадров до конца доступной памяти */
+    uint32_t lowmem_pages;        /* Из них в нижней памяти */
     uint32_t free_pages;          /* Количество свободных страниц */
-    uint32_t kernel_end;          /* Конец ядра в памяти */
+    uint32_t free_highmem;        /* Из них в верхней памяти */
+    uint32_t kernel_end;          /* Конец образа ядра (физический адрес) */
+    uint32_t colours;             /* Цветов кадров в кэше последнего уровня (1 - нет) */
+    int colouring;                /* Кадры областей VMM раскрашиваются */
+    uint32_t colour_allocs;       /* Выделено кадров заданного цвета */
+    uint32_t colour_fallbacks;    /* Из них выдано кадров другого цвета */
 } pmm_t;
 
 /* Глобальные переменные */
@@ -64,19 +169,42 @@ extern heap_t kernel_heap;
 
 /* Функции Physical Memory Manager */
 void pmm_init(uint32_t kernel_end);
-uint32_t pmm_alloc_page(void);
-void pmm_free_page(uint32_t page_addr);
+uint32_t pmm_alloc_page(void);             /* Кадр нижней памяти */
+uint32_t pmm_alloc_pages(uint32_t count);  /* Непрерывные кадры нижней памяти */
+phys_addr_t pmm_alloc_frame(void);         /* Любой кадр, сначала из верхней памяти */
+phys_addr_t pmm_alloc_frame_colour(uint32_t colour);  /* Кадр цвета colour % colours */
+uint32_t pmm_frame_colour(phys_addr_t page_addr);
+void pmm_set_colouring(int enable);
+uint32_t pmm_alloc_page_node(uint32_t node);      /* Кадр нижней памяти узла NUMA */
+phys_addr_t pmm_alloc_frame_node(uint32_t node);  /* Любой кадр узла, сначала из верхней памяти */
+uint32_t pmm_frame_node(phys_addr_t page_addr);
+void pmm_add_node_range(uint32_t node, phys_addr_t base, uint64_t size);
+void pmm_init_nodes(uint32_t nodes);
+void pmm_hide_node_ranges(int hide);              /* Для теста памяти вне SRAT */
+void pmm_mag_stats(mag_stats_t *stats);
+void pmm_free_page(phys_addr_t page_addr);
+void pmm_free_pages(phys_addr_t page_addr, uint32_t count);
 uint32_t pmm_get_free_pages_count(void);
-void pmm_mark_page_used(uint32_t page_addr);
-void pmm_mark_page_free(uint32_t page_addr);
+void pmm_mark_page_used(phys_addr_t page_addr);
+void pmm_mark_page_free(phys_addr_t page_addr);
 void pmm_dump_info(void);
 
+/* Функции базы кадров */
+page_t* pmm_page(phys_addr_t page_addr);
+void page_get(phys_addr_t page_addr);
+void page_put(phys_addr_t page_addr);
+uint32_t page_refcount(phys_addr_t page_addr);
+
 /* Функции Kernel Heap */
 void heap_init(uint32_t start_addr, uint32_t size);
 void* kmalloc(size_t size);
+void* kmalloc_aligned(size_t size, uint32_t align);  /* align - степень двойки */
+void* kmalloc_flags(size_t size, uint32_t flags);    /* KMALLOC_*, KMALLOC_TAG() */
 void kfree(void* ptr);
 void* krealloc(void* ptr, size_t size);
 void heap_dump_info(void);
+void heap_clear_prof(void);
+void heap_mag_stats(mag_stats_t *stats);
 
 /* Вспомогательные функции */
 uint32_t align_up(uint32_t addr, uint32_t align);
@@ -94,5 +222,6 @@ uint32_t get_page_end(uint32_t addr);
 
 /* Тестовые функции */
 void run_memory_tests(void);
+void run_pmm_bench(void);
 
 #endif /* MEMORY_H */ 
\ No newline at end of file
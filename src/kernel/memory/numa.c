@@ -0,0 +1,352 @@
+/**
+ * @file numa.c
+ * @brief Узлы NUMA по таблицам ACPI SRAT и SLIT
+ *
+ * Записи SRAT о процессорах и памяти разбираются так же, как записи
+ * MADT: тип и длина в первых двух байтах. Отключенные записи и
+ * горячо подключаемая память без адреса пропускаются. Порядок обхода
+ * узлов для каждого узла вычисляется один раз по SLIT.
+ */
+
+#include "numa.h"
+#include "../acpi/acpi.h"
+#include "../cpu/percpu.h"
+#include "../video/video.h"
+#include "../lib/compiler.h"
+
+/* Типы записей SRAT */
+#define SRAT_ENTRY_LAPIC   0
+#define SRAT_ENTRY_MEMORY  1
+#define SRAT_ENTRY_X2APIC  2
+
+/* Флаги записей SRAT */
+#define SRAT_ENABLED 0x01
+
+/**
+ * @brief Заголовок таблицы SRAT
+ */
+typedef struct {
+    acpi_sdt_header_t header;
+    uint32_t table_revision;  /* Всегда 1 */
+    uint64_t reserved;
+} __attribute__((packed)) acpi_srat_t;
+
+/**
+ * @brief Запись SRAT о процессоре (тип 0)
+ */
+typedef struct {
+    uint8_t type;
+    uint8_t length;           /* 16 */
+    uint8_t domain_low;       /* Биты 0-7 домена близости */
+    uint8_t apic_id;
+    uint32_t flags;
+    uint8_t sapic_eid;
+    uint8_t domain_high[3];   /* Биты 8-31 домена */
+    uint32_t clock_domain;
+} __attribute__((packed)) srat_lapic_t;
+
+/**
+ * @brief Запись SRAT о диапазоне памяти (тип 1)
+ */
+typedef struct {
+    uint8_t type;
+    uint8_t length;           /* 40 */
+    uint32_t domain;
+    uint16_t reserved1;
+    uint64_t base;
+    uint64_t size;
+    uint32_t reserved2;
+    uint32_t flags;
+    uint64_t reserved3;
+} __attribute__((packed)) srat_memory_t;
+
+/**
+ * @brief Запись SRAT о процессоре с x2APIC (тип 2)
+ */
+typedef struct {
+    uint8_t type;
+    uint8_t length;           /* 24 */
+    uint16_t reserved1;
+    uint32_t domain;
+    uint32_t x2apic_id;
+    uint32_t flags;
+    uint32_t clock_domain;
+    uint32_t reserved2;
+} __attribute__((packed)) srat_x2apic_t;
+
+/**
+ * @brief Таблица SLIT: матрица расстояний localities x localities
+ */
+typedef struct {
+    acpi_sdt_header_t header;
+    uint64_t localities;
+    uint8_t distance[];
+} __attribute__((packed)) acpi_slit_t;
+
+/**
+ * @brief Процессор SRAT
+ */
+typedef struct {
+    uint32_t apic_id;
+    uint8_t node;
+} numa_cpu_t;
+
+/* Домены близости узлов (номер узла - индекс) */
+static uint32_t numa_domains[NUMA_MAX_NODES];
+static uint32_t numa_nodes = 1;
+
+/* Процессоры и их узлы */
+static numa_cpu_t numa_cpus[ACPI_MAX_CPUS];
+static uint32_t numa_cpu_count = 0;
+
+/* Расстояния и порядок обхода узлов */
+static uint8_t numa_distances[NUMA_MAX_NODES][NUMA_MAX_NODES];
+static uint8_t numa_order[NUMA_MAX_NODES][NUMA_MAX_NODES];
+
+/* Диапазонов памяти, переданных PMM */
+static uint32_t numa_range_count = 0;
+
+/**
+ * @brief Узел домена близости; новый домен получает следующий номер
+ * @return Номер узла или -1, если узлов больше NUMA_MAX_NODES
+ */
+static int numa_domain_node(uint32_t domain) {
+    for (uint32_t i = 0; i < numa_nodes; i++) {
+        if (numa_domains[i] == domain) {
+            return i;
+        }
+    }
+    if (numa_nodes == NUMA_MAX_NODES) {
+        return -1;
+    }
+    numa_domains[numa_nodes] = domain;
+    return numa_nodes++;
+}
+
+/**
+ * @brief Запоминание узла процессора
+ */
+static void numa_add_cpu(uint32_t apic_id, uint32_t domain) {
+    int node = numa_domain_node(domain);
+    if (node >= 0 && numa_cpu_count < ACPI_MAX_CPUS) {
+        numa_cpus[numa_cpu_count].apic_id = apic_id;
+        numa_cpus[numa_cpu_count].node = (uint8_t)node;
+        numa_cpu_count++;
+    }
+}
+
+/**
+ * @brief Разбор записей SRAT
+ *
+ * Узлы создаются только для доменов, в которых есть процессор или
+ * память; до разбора numa_nodes равен 0.
+ */
+static void numa_parse_srat(acpi_srat_t *srat) {
+    uint8_t *entry = (uint8_t*)srat + sizeof(acpi_srat_t);
+    uint8_t *end = (uint8_t*)srat + srat->header.length;
+    
+    while (entry + 2 <= end && entry[1] >= 2) {
+        switch (entry[0]) {
+        case SRAT_ENTRY_LAPIC: {
+            srat_lapic_t *cpu = (srat_lapic_t*)entry;
+            if (cpu->flags & SRAT_ENABLED) {
+                uint32_t domain = cpu->domain_low | (cpu->domain_high[0] << 8) |
+                                  (cpu->domain_high[1] << 16) | ((uint32_t)cpu->domain_high[2] << 24);
+                numa_add_cpu(cpu->apic_id, domain);
+            }
+            break;
+        }
+        case SRAT_ENTRY_X2APIC: {
+            /* Ядро адресует процессоры 8-битным APIC ID */
+            srat_x2apic_t *cpu = (srat_x2apic_t*)entry;
+            if ((cpu->flags & SRAT_ENABLED) && cpu->x2apic_id < 256) {
+                numa_add_cpu(cpu->x2apic_id, cpu->domain);
+            }
+            break;
+        }
+        case SRAT_ENTRY_MEMORY: {
+            srat_memory_t *memory = (srat_memory_t*)entry;
+            if (!(memory->flags & SRAT_ENABLED) || !memory->size) {
+                break;
+            }
+            int node = numa_domain_node(memory->domain);
+            if (node >= 0 && numa_range_count < NUMA_MAX_RANGES) {
+                pmm_add_node_range(node, memory->base, memory->size);
+                numa_range_count++;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+        
+        entry += entry[1];
+    }
+}
+
+/**
+ * @brief Матрица расстояний по SLIT (или 10/20 без нее)
+ */
+static void numa_parse_slit(acpi_slit_t *slit) {
+    uint32_t localities = 0;
+    if (slit && (slit->localities >> 32) == 0) {
+        localities = (uint32_t)slit->localities;
+        if (sizeof(acpi_slit_t) + localities * localities > slit->header.length) {
+            localities = 0;
+        }
+    }
+    
+    for (uint32_t from = 0; from < numa_nodes; from++) {
+        for (uint32_t to = 0; to < numa_nodes; to++) {
+            uint32_t a = numa_domains[from];
+            uint32_t b = numa_domains[to];
+            if (a < localities && b < localities) {
+                numa_distances[from][to] = slit->distance[a * localities + b];
+            } else {
+                numa_distances[from][to] = from == to ? NUMA_DISTANCE_LOCAL : NUMA_DISTANCE_REMOTE;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Ключ сортировки узлов: свой узел первым, даже если SLIT считает иначе
+ */
+static uint32_t numa_order_key(uint32_t node, uint32_t other) {
+    return other == node ? 0 : numa_distances[node][other];
+}
+
+/**
+ * @brief Порядок обхода узлов: по возрастанию расстояния, при равенстве - по номеру
+ */
+static void numa_build_order(void) {
+    for (uint32_t node = 0; node < numa_nodes; node++) {
+        uint8_t *order = numa_order[node];
+        for (uint32_t i = 0; i < numa_nodes; i++) {
+            order[i] = (uint8_t)i;
+        }
+        
+        /* Вставками: узлов не больше восьми */
+        for (uint32_t i = 1; i < numa_nodes; i++) {
+            uint8_t current = order[i];
+            uint32_t j = i;
+            while (j > 0 && numa_order_key(node, order[j - 1]) > numa_order_key(node, current)) {
+                order[j] = order[j - 1];
+                j--;
+            }
+            order[j] = current;
+        }
+    }
+}
+
+/**
+ * @brief Разбор SRAT и SLIT, передача диапазонов узлов в PMM
+ */
+__cold void numa_init(void) {
+    print_string("NUMA Initialization... ");
+    
+    numa_distances[0][0] = NUMA_DISTANCE_LOCAL;
+    numa_order[0][0] = 0;
+    
+    acpi_srat_t *srat = (acpi_srat_t*)acpi_find_table("SRAT");
+    if (!srat) {
+        print_string_color("NOT AVAILABLE", COLOR_BROWN, COLOR_BLACK);
+        print_string(" (single node)\n");
+        return;
+    }
+    
+    numa_nodes = 0;
+    numa_parse_srat(srat);
+    if (numa_nodes == 0) {
+        numa_nodes = 1;
+        numa_distances[0][0] = NUMA_DISTANCE_LOCAL;
+    } else {
+        numa_parse_slit((acpi_slit_t*)acpi_find_table("SLIT"));
+    }
+    numa_build_order();
+    pmm_init_nodes(numa_nodes);
+    
+    print_string_color("OK\n", COLOR_GREEN, COLOR_BLACK);
+    print_string("  - Nodes: ");
+    print_dec(numa_nodes);
+    print_string(", memory ranges: ");
+    print_dec(numa_range_count);
+    print_string(", CPUs: ");
+    print_dec(numa_cpu_count);
+    print_string(acpi_find_table("SLIT") ? " (SLIT)\n" : " (no SLIT)\n");
+}
+
+/**
+ * @brief Количество узлов (не меньше 1)
+ */
+uint32_t numa_node_count(void) {
+    return numa_nodes;
+}
+
+/**
+ * @brief Узел процессора по APIC ID (0, если SRAT его не описывает)
+ */
+uint32_t numa_node_of_apic(uint32_t apic_id) {
+    for (uint32_t i = 0; i < numa_cpu_count; i++) {
+        if (numa_cpus[i].apic_id == apic_id) {
+            return numa_cpus[i].node;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Узел текущего процессора
+ *
+ * Записывается в данные процессора в smp_init(); до этого все
+ * процессоры считаются узлом 0.
+ */
+uint32_t numa_local_node(void) {
+    return this_cpu_read(node);
+}
+
+/**
+ * @brief Расстояние между узлами по SLIT
+ */
+uint8_t numa_distance(uint32_t from, uint32_t to) {
+    if (from >= numa_nodes || to >= numa_nodes) {
+        return 0xFF;
+    }
+    return numa_distances[from][to];
+}
+
+/**
+ * @brief Узлы в порядке удаления от заданного (первый - он сам)
+ */
+const uint8_t* numa_fallback(uint32_t node) {
+    return numa_order[node < numa_nodes ? node : 0];
+}
+
+/**
+ * @brief Вывод узлов, процессоров и матрицы расстояний
+ */
+void numa_dump_info(void) {
+    print_string("NUMA nodes: ");
+    print_dec(numa_nodes);
+    print_string("\n");
+    
+    for (uint32_t node = 0; node < numa_nodes; node++) {
+        print_string("  - Node ");
+        print_dec(node);
+        print_string(" (domain ");
+        print_dec(numa_domains[node]);
+        print_string("): distances");
+        for (uint32_t to = 0; to < numa_nodes; to++) {
+            print_string(" ");
+            print_dec(numa_distances[node][to]);
+        }
+        print_string(", APIC IDs");
+        for (uint32_t i = 0; i < numa_cpu_count; i++) {
+            if (numa_cpus[i].node == node) {
+                print_string(" ");
+                print_dec(numa_cpus[i].apic_id);
+            }
+        }
+        print_string("\n");
+    }
+}
@@ -0,0 +1,69 @@
+/**
+ * @file numa.h
+ * @brief Узлы NUMA по таблицам ACPI SRAT и SLIT
+ *
+ * SRAT сопоставляет процессорам (по APIC ID) и диапазонам физической
+ * памяти домены близости; домены нумеруются узлами 0..NUMA_MAX_NODES-1
+ * в порядке появления. SLIT задает относительные расстояния между
+ * узлами (10 - свой узел). Без SRAT вся память и все процессоры
+ * принадлежат узлу 0.
+ *
+ * Диапазоны памяти узлов передаются PMM (pmm_add_node_range()), и
+ * pmm_alloc_page_node() / pmm_alloc_frame_node() берут кадры сначала
+ * на заданном узле, затем на остальных в порядке расстояния.
+ */
+
+#ifndef KERNEL_NUMA_H
+#define KERNEL_NUMA_H
+
+#include <stdint.h>
+#include "memory.h"
+
+/* Ограничения */
+#define NUMA_MAX_NODES  8
+#define NUMA_MAX_RANGES 16
+
+/* Расстояния SLIT: до своего узла и по умолчанию до чужого */
+#define NUMA_DISTANCE_LOCAL  10
+#define NUMA_DISTANCE_REMOTE 20
+
+/**
+ * @brief Разбор SRAT и SLIT, передача диапазонов узлов в PMM
+ *
+ * Вызывается после acpi_init() и до smp_init(): узел процессора
+ * записывается в его данные при запуске.
+ */
+void numa_init(void);
+
+/**
+ * @brief Количество узлов (не меньше 1)
+ */
+uint32_t numa_node_count(void);
+
+/**
+ * @brief Узел процессора по APIC ID (0, если SRAT его не описывает)
+ */
+uint32_t numa_node_of_apic(uint32_t apic_id);
+
+/**
+ * @brief Узел текущего процессора
+ */
+uint32_t numa_local_node(void);
+
+/**
+ * @brief Расстояние между узлами по SLIT
+ */
+uint8_t numa_distance(uint32_t from, uint32_t to);
+
+/**
+ * @brief Узлы в порядке удаления от заданного (первый - он сам)
+ * @return Массив из numa_node_count() номеров
+ */
+const uint8_t* numa_fallback(uint32_t node);
+
+/**
+ * @brief Вывод узлов, процессоров и матрицы расстояний
+ */
+void numa_dump_info(void);
+
+#endif /* KERNEL_NUMA_H */
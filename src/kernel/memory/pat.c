@@ -0,0 +1,261 @@
+/**
+ * @file pat.c
+ * @brief Типы кэширования страниц (PAT) и регистры MTRR
+ *
+ * MTRR только читаются: их программирует BIOS одинаково на всех
+ * процессорах. Переменные диапазоны запоминаются при загрузке, чтобы
+ * тип памяти устройства можно было узнать без чтения MSR.
+ */
+
+#include "pat.h"
+#include "vmm.h"
+#include "../cpu/cpu.h"
+#include "../video/video.h"
+#include "../lib/compiler.h"
+
+/* Состояние */
+static int pat_available = 0;
+static int mtrr_available = 0;
+
+/* Копия MTRR загрузочного процессора */
+static uint64_t mtrr_cap = 0;
+static uint64_t mtrr_def = 0;
+static uint8_t mtrr_fixed[88];
+static mtrr_range_t mtrr_ranges[MTRR_MAX_VAR];
+static uint32_t mtrr_count = 0;
+
+/**
+ * @brief Чтение фиксированных диапазонов: 8 типов в каждом MSR
+ */
+static void mtrr_read_fixed(void) {
+    uint32_t msrs[11] = { MSR_MTRR_FIX64K_00000, MSR_MTRR_FIX16K_80000, MSR_MTRR_FIX16K_A0000 };
+    for (uint32_t i = 0; i < 8; i++) {
+        msrs[3 + i] = MSR_MTRR_FIX4K_C0000 + i;
+    }
+    
+    for (uint32_t i = 0; i < 11; i++) {
+        uint64_t value = rdmsr(msrs[i]);
+        for (uint32_t j = 0; j < 8; j++) {
+            mtrr_fixed[i * 8 + j] = (uint8_t)(value >> (j * 8));
+        }
+    }
+}
+
+/**
+ * @brief Тип адреса первого мегабайта по фиксированным диапазонам
+ */
+static uint8_t mtrr_fixed_type(uint32_t addr) {
+    if (addr < 0x80000) {
+        return mtrr_fixed[addr >> 16];
+    }
+    if (addr < 0xC0000) {
+        return mtrr_fixed[8 + ((addr - 0x80000) >> 14)];
+    }
+    return mtrr_fixed[24 + ((addr - 0xC0000) >> 12)];
+}
+
+/**
+ * @brief Сочетание типов пересекающихся переменных диапазонов
+ *
+ * UC побеждает все, WT побеждает WB; остальные сочетания
+ * не определены и считаются UC.
+ */
+static uint8_t mtrr_combine(uint8_t a, uint8_t b) {
+    if (a == b) {
+        return a;
+    }
+    if (a == MEM_TYPE_UC || b == MEM_TYPE_UC) {
+        return MEM_TYPE_UC;
+    }
+    if ((a == MEM_TYPE_WT && b == MEM_TYPE_WB) || (a == MEM_TYPE_WB && b == MEM_TYPE_WT)) {
+        return MEM_TYPE_WT;
+    }
+    return MEM_TYPE_UC;
+}
+
+/**
+ * @brief Тип одного адреса по MTRR
+ */
+static uint8_t mtrr_type_at(phys_addr_t phys) {
+    if (phys < 0x100000 && (mtrr_def & MTRR_DEF_FE) && (mtrr_cap & MTRR_CAP_FIX)) {
+        return mtrr_fixed_type((uint32_t)phys);
+    }
+    
+    uint8_t type = MEM_TYPE_MIXED;
+    for (uint32_t i = 0; i < mtrr_count; i++) {
+        if ((phys & mtrr_ranges[i].mask) == mtrr_ranges[i].base) {
+            type = (type == MEM_TYPE_MIXED) ? mtrr_ranges[i].type
+                                            : mtrr_combine(type, mtrr_ranges[i].type);
+        }
+    }
+    return (type == MEM_TYPE_MIXED) ? (uint8_t)(mtrr_def & MTRR_DEF_TYPE) : type;
+}
+
+/**
+ * @brief Поиск PAT и чтение MTRR загрузочного процессора
+ */
+__cold void pat_init(void) {
+    print_string("Cache Attributes... ");
+    
+    int msr = cpu_has_edx(CPUID_EDX_MSR);
+    pat_available = msr && cpu_has_edx(CPUID_EDX_PAT);
+    mtrr_available = msr && cpu_has_edx(CPUID_EDX_MTRR);
+    
+    if (mtrr_available) {
+        mtrr_cap = rdmsr(MSR_MTRR_CAP);
+        mtrr_def = rdmsr(MSR_MTRR_DEF);
+        if (mtrr_cap & MTRR_CAP_FIX) {
+            mtrr_read_fixed();
+        }
+        
+        /* Маска без старших бит адреса: достаточно сравнения (a & mask) == base */
+        uint32_t count = mtrr_cap & MTRR_CAP_VCNT;
+        for (uint32_t i = 0; i < count && mtrr_count < MTRR_MAX_VAR; i++) {
+            uint64_t mask = rdmsr(MSR_MTRR_MASK(i));
+            if (!(mask & MTRR_MASK_VALID)) {
+                continue;
+            }
+            uint64_t base = rdmsr(MSR_MTRR_BASE(i));
+            mtrr_ranges[mtrr_count].mask = mask & PG_ADDR_MASK;
+            mtrr_ranges[mtrr_count].base = base & PG_ADDR_MASK & mask;
+            mtrr_ranges[mtrr_count].type = (uint8_t)(base & 0xFF);
+            mtrr_count++;
+        }
+    }
+    
+    if (!pat_available && !mtrr_available) {
+        print_string_color("NOT AVAILABLE\n", COLOR_BROWN, COLOR_BLACK);
+        return;
+    }
+    
+    print_string_color("OK\n", COLOR_GREEN, COLOR_BLACK);
+    print_string("  - PAT: ");
+    print_string(pat_available ? "WB WT UC- UC WC WT UC- UC\n" : "not supported, no WC pages\n");
+    print_string("  - MTRR: ");
+    if (!mtrr_available || !(mtrr_def & MTRR_DEF_E)) {
+        print_string("disabled\n");
+        return;
+    }
+    print_string("default ");
+    print_string(mem_type_name(mtrr_def & MTRR_DEF_TYPE));
+    print_string(", ");
+    print_dec(mtrr_count);
+    print_string(" of ");
+    print_dec(mtrr_cap & MTRR_CAP_VCNT);
+    print_string(" variable ranges");
+    if (mtrr_cap & MTRR_CAP_WC) {
+        print_string(", WC");
+    }
+    print_string("\n");
+}
+
+/**
+ * @brief Запись PAT на текущем процессоре
+ *
+ * Записи 0-3 совпадают со значением после сброса, а записи 4-7
+ * до этого не использовались, поэтому кэши и TLB сбрасывать не нужно.
+ */
+void pat_init_cpu(void) {
+    if (pat_available) {
+        wrmsr(MSR_PAT, PAT_VALUE);
+    }
+}
+
+/**
+ * @brief Доступен ли тип WC в элементах таблиц страниц
+ */
+int pat_enabled(void) {
+    return pat_available;
+}
+
+/**
+ * @brief Тип памяти диапазона по MTRR
+ *
+ * Тип может меняться внутри диапазона только на границах переменных
+ * диапазонов MTRR и страниц первого мегабайта: они и проверяются.
+ */
+uint8_t mtrr_type(phys_addr_t phys, uint64_t size) {
+    if (!mtrr_available || !(mtrr_def & MTRR_DEF_E)) {
+        return MEM_TYPE_UC;
+    }
+    if (!size) {
+        return mtrr_type_at(phys);
+    }
+    
+    phys_addr_t end = phys + size;
+    uint8_t type = mtrr_type_at(phys);
+    
+    for (phys_addr_t addr = phys & ~(phys_addr_t)(PAGE_SIZE - 1); addr < end && addr < 0x100000;
+         addr += PAGE_SIZE) {
+        if (mtrr_type_at(addr) != type) {
+            return MEM_TYPE_MIXED;
+        }
+    }
+    
+    /* Диапазон MTRR, покрывающий только часть [phys, end), меняет тип */
+    for (uint32_t i = 0; i < mtrr_count; i++) {
+        phys_addr_t base = mtrr_ranges[i].base;
+        phys_addr_t length = mtrr_ranges[i].mask & -mtrr_ranges[i].mask;
+        if (base < end && base + length > phys && (base > phys || base + length < end)) {
+            return MEM_TYPE_MIXED;
+        }
+    }
+    return type;
+}
+
+/**
+ * @brief Название типа памяти
+ */
+const char* mem_type_name(uint8_t type) {
+    switch (type) {
+        case MEM_TYPE_UC:       return "UC";
+        case MEM_TYPE_WC:       return "WC";
+        case MEM_TYPE_WT:       return "WT";
+        case MEM_TYPE_WP:       return "WP";
+        case MEM_TYPE_WB:       return "WB";
+        case MEM_TYPE_UC_MINUS: return "UC-";
+        case MEM_TYPE_MIXED:    return "mixed";
+        default:                return "?";
+    }
+}
+
+/**
+ * @brief Вывод PAT и диапазонов MTRR
+ */
+void pat_dump_info(void) {
+    print_string("PAT: ");
+    if (pat_available) {
+        uint64_t pat = rdmsr(MSR_PAT);
+        for (uint32_t i = 0; i < 8; i++) {
+            print_string(mem_type_name((uint8_t)(pat >> (i * 8)) & 0x07));
+            print_string(i < 7 ? " " : "\n");
+        }
+    } else {
+        print_string("not supported\n");
+    }
+    
+    if (!mtrr_available || !(mtrr_def & MTRR_DEF_E)) {
+        print_string("MTRR: disabled\n");
+        return;
+    }
+    print_string("MTRR default: ");
+    print_string(mem_type_name(mtrr_def & MTRR_DEF_TYPE));
+    print_string(", fixed ranges: ");
+    print_string((mtrr_def & MTRR_DEF_FE) ? "on" : "off");
+    print_string(", VGA window: ");
+    print_string(mem_type_name(mtrr_type(0xA0000, 0x20000)));
+    print_string("\n");
+    
+    for (uint32_t i = 0; i < mtrr_count; i++) {
+        phys_addr_t length = mtrr_ranges[i].mask & -mtrr_ranges[i].mask;
+        print_string("  ");
+        print_hex((uint32_t)(mtrr_ranges[i].base >> 32));
+        print_string(":");
+        print_hex((uint32_t)mtrr_ranges[i].base);
+        print_string(" ");
+        print_dec((uint32_t)(length >> 20));
+        print_string(" MB ");
+        print_string(mem_type_name(mtrr_ranges[i].type));
+        print_string("\n");
+    }
+}
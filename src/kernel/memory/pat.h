@@ -0,0 +1,110 @@
+/**
+ * @file pat.h
+ * @brief Типы кэширования страниц (PAT) и регистры MTRR
+ *
+ * Тип кэширования страницы складывается из типа диапазона в MTRR,
+ * который задает BIOS, и типа из элемента таблицы страниц. Элемент
+ * выбирает одну из восьми записей регистра PAT битами PAT, PCD и PWT.
+ * Ядро оставляет первые четыре записи такими же, как после сброса
+ * (WB, WT, UC-, UC), так что старые комбинации PCD/PWT сохраняют
+ * смысл, а в запись 4 (бит PAT) ставит Write-Combining.
+ *
+ * WC подходит памяти, в которую пишут длинными последовательными
+ * потоками (кадровый буфер): процессор собирает записи в буфере
+ * и отправляет устройству целыми строками вместо отдельных
+ * некэшируемых транзакций.
+ */
+
+#ifndef KERNEL_PAT_H
+#define KERNEL_PAT_H
+
+#include <stdint.h>
+#include "memory.h"
+
+/* Типы памяти (кодировка PAT и MTRR) */
+#define MEM_TYPE_UC       0x00   /* Без кэширования */
+#define MEM_TYPE_WC       0x01   /* Объединение записей */
+#define MEM_TYPE_WT       0x04   /* Сквозная запись */
+#define MEM_TYPE_WP       0x05   /* Защищенная запись */
+#define MEM_TYPE_WB       0x06   /* Обратная запись */
+#define MEM_TYPE_UC_MINUS 0x07   /* UC, но MTRR WC побеждает (только PAT) */
+#define MEM_TYPE_MIXED    0xFF   /* Диапазон пересекает разные MTRR */
+
+/* Регистры */
+#define MSR_PAT          0x277
+#define MSR_MTRR_CAP     0xFE
+#define MSR_MTRR_DEF     0x2FF
+#define MSR_MTRR_BASE(n) (0x200 + 2 * (n))
+#define MSR_MTRR_MASK(n) (0x201 + 2 * (n))
+
+/* Биты MTRRcap и MTRRdefType */
+#define MTRR_CAP_VCNT   0xFF          /* Число переменных диапазонов */
+#define MTRR_CAP_FIX    (1 << 8)      /* Есть фиксированные диапазоны */
+#define MTRR_CAP_WC     (1 << 10)     /* Тип WC поддерживается */
+#define MTRR_DEF_TYPE   0xFF
+#define MTRR_DEF_FE     (1 << 10)     /* Фиксированные диапазоны включены */
+#define MTRR_DEF_E      (1 << 11)     /* MTRR включены */
+#define MTRR_MASK_VALID (1 << 11)
+
+/* Фиксированные диапазоны первого мегабайта */
+#define MSR_MTRR_FIX64K_00000 0x250
+#define MSR_MTRR_FIX16K_80000 0x258
+#define MSR_MTRR_FIX16K_A0000 0x259
+#define MSR_MTRR_FIX4K_C0000  0x268
+
+/* Запоминаемых переменных диапазонов */
+#define MTRR_MAX_VAR 16
+
+/* Значение PAT: WB, WT, UC-, UC, WC, WT, UC-, UC */
+#define PAT_VALUE 0x0007040100070406ULL
+
+/**
+ * @brief Переменный диапазон MTRR
+ */
+typedef struct {
+    phys_addr_t base;
+    phys_addr_t mask;         /* Адрес попадает в диапазон, если (a & mask) == base */
+    uint8_t type;             /* MEM_TYPE_* */
+} mtrr_range_t;
+
+/**
+ * @brief Поиск PAT и чтение MTRR загрузочного процессора
+ *
+ * Вызывается из kmain() непосредственно перед vmm_init(): таблицы
+ * ядра строятся уже с известной раскладкой PAT.
+ */
+void pat_init(void);
+
+/**
+ * @brief Запись PAT на текущем процессоре
+ *
+ * Все процессоры должны иметь одинаковый PAT; вызывается
+ * из vmm_init() и vmm_init_ap() до загрузки CR3.
+ */
+void pat_init_cpu(void);
+
+/**
+ * @brief Доступен ли тип WC в элементах таблиц страниц
+ */
+int pat_enabled(void);
+
+/**
+ * @brief Тип памяти диапазона по MTRR
+ * @param phys Физический адрес
+ * @param size Размер в байтах
+ * @return MEM_TYPE_*, MEM_TYPE_MIXED если типы внутри различаются,
+ *         MEM_TYPE_UC если MTRR выключены
+ */
+uint8_t mtrr_type(phys_addr_t phys, uint64_t size);
+
+/**
+ * @brief Название типа памяти
+ */
+const char* mem_type_name(uint8_t type);
+
+/**
+ * @brief Вывод PAT и диапазонов MTRR
+ */
+void pat_dump_info(void);
+
+#endif /* KERNEL_PAT_H */
@@ -1,120 +1,858 @@
 /**
  * @file pmm.c
  * @brief Physical Memory Manager - управление физическими страницами
- * 
+ *
  * Реализация менеджера физической памяти с использованием битовой карты
  * для отслеживания свободных и занятых страниц размером 4KB
+ *
+ * Свободными считаются только доступные диапазоны карты памяти
+ * загрузчика, включая лежащие выше 4 ГБ. Кадры делятся на две зоны:
+ * нижняя память (доступна ядру через прямое отображение) и верхняя.
+ * pmm_alloc_page() выдает только нижнюю память, pmm_alloc_frame()
+ * сначала берет верхнюю, оставляя нижнюю для таблиц страниц и стеков.
+ *
+ * Цвет кадра - группа наборов кэша последнего уровня, в которую
+ * попадает кадр: кэш индексируется физическим адресом, и кадры с
+ * номерами, равными по модулю числа цветов, вытесняют друг друга.
+ * pmm_alloc_frame_colour() ищет кадр нужного цвета, шагая по битовой
+ * карте через число цветов; для каждого цвета хранится свой счетчик
+ * свободных кадров и свое место начала поиска.
+ *
+ * На машинах NUMA память делится на узлы по диапазонам SRAT
+ * (memory/numa.c). Каждый диапазон хранит свое место начала поиска
+ * в каждой зоне, каждый узел - счетчик свободных кадров; битовая
+ * карта остается общей.
  */
 
 #include "memory.h"
+#include "memmap.h"
+#include "numa.h"
+#include "../cpu/cpu.h"
 #include "../video/video.h"
+#include "../sync/spinlock.h"
+#include "../lib/compiler.h"
 
 /* Глобальный экземпляр менеджера физической памяти */
 pmm_t physical_memory_manager;
 
+/* База кадров: описатель на каждый учитываемый кадр */
+static page_t *pmm_pages = NULL;
+
+/* Зоны и слово битовой карты, с которого начинается поиск в зоне */
+#define PMM_ZONE_LOW  0
+#define PMM_ZONE_HIGH 1
+static uint32_t pmm_hint[2];
+
+/* Свободные кадры каждого цвета и кадр, с которого начинается поиск цвета в зоне */
+static uint32_t pmm_colour_free[PMM_MAX_COLOURS];
+static uint32_t pmm_colour_hint[2][PMM_MAX_COLOURS];
+
+/**
+ * @brief Диапазон памяти узла NUMA
+ */
+typedef struct {
+    uint32_t first;           /* Первый кадр */
+    uint32_t last;            /* Конец (не включая) */
+    uint32_t node;
+    uint32_t hint[2];         /* Слово битовой карты, с которого начинается поиск в зоне */
+} pmm_range_t;
+
+/**
+ * @brief Пул кадров узла NUMA
+ */
+typedef struct {
+    uint32_t pages;           /* Кадров в диапазонах узла */
+    uint32_t free_pages;      /* Из них свободных */
+    uint32_t local_allocs;    /* Запросов к узлу, выполненных на нем */
+    uint32_t remote_allocs;   /* Запросов к узлу, выполненных на другом */
+} pmm_node_t;
+
+/* Узлы появляются после разбора SRAT; до этого весь PMM - узел 0 */
+static pmm_range_t pmm_ranges[NUMA_MAX_RANGES];
+static uint32_t pmm_range_count = 0;
+static uint32_t pmm_hidden_ranges = 0;  /* pmm_hide_node_ranges() */
+static pmm_node_t pmm_nodes[NUMA_MAX_NODES];
+static uint32_t pmm_node_count = 1;
+
+/**
+ * @brief Магазин кадров процессора
+ *
+ * Номера свободных кадров, помеченных занятыми в битовой карте.
+ * Вершина стека - кадры, освобожденные последними (еще в кэше).
+ * Магазин трогает только свой процессор с запрещенными прерываниями.
+ */
+typedef struct {
+    uint32_t count[2];
+    uint32_t frames[2][PMM_MAG_SIZE];
+    uint32_t high_skip;       /* Выделений до новой попытки пополнить верхнюю зону */
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t drains;
+} __attribute__((aligned(64))) pmm_magazine_t;
+
+static pmm_magazine_t pmm_magazines[MAX_CPUS];
+
+/* Блокировка битовой карты (PMM общий для всех процессоров) */
+static lockstat_t pmm_lockstat = LOCKSTAT_INIT("pmm");
+static spinlock_t pmm_lock = SPINLOCK_INIT_STAT(&pmm_lockstat);
+
+/**
+ * @brief Начальный индекс кадра зоны
+ */
+static uint32_t pmm_zone_first(int zone) {
+    return zone == PMM_ZONE_LOW ? 0 : physical_memory_manager.lowmem_pages;
+}
+
+/**
+ * @brief Конечный индекс кадра зоны (не включая)
+ */
+static uint32_t pmm_zone_last(int zone) {
+    return zone == PMM_ZONE_LOW ? physical_memory_manager.lowmem_pages : physical_memory_manager.total_pages;
+}
+
+/**
+ * @brief Диапазон узла, которому принадлежит кадр
+ * @return Диапазон или NULL, если узлов нет или кадр вне SRAT
+ */
+static pmm_range_t* pmm_frame_range(uint32_t index) {
+    if (pmm_node_count == 1) {
+        return NULL;
+    }
+    for (uint32_t i = 0; i < pmm_range_count; i++) {
+        if (index >= pmm_ranges[i].first && index < pmm_ranges[i].last) {
+            return &pmm_ranges[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Число цветов кадров по параметрам кэша последнего уровня
+ *
+ * Кадры одного цвета делят наборы кэша размером
+ * cache_size / ways: столько байт кэш отводит одному пути. Без
+ * известного числа путей (и для полностью ассоциативного кэша)
+ * цвет один.
+ */
+static uint32_t pmm_detect_colours(void) {
+    if (!cpu_info.llc_ways || cpu_info.llc_ways == CPU_LLC_FULLY_ASSOC ||
+        cpu_info.llc_size / PAGE_SIZE < cpu_info.llc_ways) {
+        return 1;
+    }
+    
+    uint32_t colours = cpu_info.llc_size / cpu_info.llc_ways / PAGE_SIZE;
+    uint32_t result = 1;
+    while (result * 2 <= colours && result * 2 <= PMM_MAX_COLOURS) {
+        result *= 2;
+    }
+    return result;
+}
+
 /**
  * @brief Инициализация менеджера физической памяти
- * @param kernel_end Адрес конца ядра в памяти
+ * @param kernel_end Конец образа ядра (адрес в верхней половине)
  */
-void pmm_init(uint32_t kernel_end) {
+__cold void pmm_init(uint32_t kernel_end) {
     print_string("PMM Initialization... ");
     
+    pmm_t *pmm = &physical_memory_manager;
+    phys_addr_t end = memmap_usable_end();
+    if (end > (phys_addr_t)MAX_PAGES << PAGE_SHIFT) {
+        end = (phys_addr_t)MAX_PAGES << PAGE_SHIFT;
+    }
+    
     /* Инициализация структуры */
-    physical_memory_manager.kernel_end = kernel_end;
-    physical_memory_manager.total_pages = MAX_PAGES;
-    physical_memory_manager.free_pages = MAX_PAGES;
+    pmm->kernel_end = virt_to_phys((void*)kernel_end);
+    pmm->total_pages = (uint32_t)(end >> PAGE_SHIFT);
+    pmm->lowmem_pages = pmm->total_pages < (PMM_LOWMEM_END >> PAGE_SHIFT) ?
+                        pmm->total_pages : (PMM_LOWMEM_END >> PAGE_SHIFT);
+    pmm->free_pages = 0;
+    pmm->free_highmem = 0;
+    pmm_hint[PMM_ZONE_LOW] = pmm_zone_first(PMM_ZONE_LOW) / 32;
+    pmm_hint[PMM_ZONE_HIGH] = pmm_zone_first(PMM_ZONE_HIGH) / 32;
+    pmm->colours = pmm_detect_colours();
+    pmm->colouring = 0;
+    for (uint32_t i = 0; i < pmm->colours; i++) {
+        pmm_colour_hint[PMM_ZONE_LOW][i] = pmm_zone_first(PMM_ZONE_LOW) + i;
+        pmm_colour_hint[PMM_ZONE_HIGH][i] = pmm_zone_first(PMM_ZONE_HIGH) + i;
+    }
     
-    /* Очистка битовой карты */
-    memory_set(physical_memory_manager.bitmap, 0, sizeof(physical_memory_manager.bitmap));
+    /* Битовая карта - сразу за ядром; сначала все кадры заняты */
+    uint32_t bitmap_bytes = align_up((pmm->total_pages + 31) / 32 * 4, PAGE_SIZE);
+    pmm->bitmap = (uint32_t*)align_up(kernel_end, PAGE_SIZE);
+    memory_set(pmm->bitmap, 0xFF, bitmap_bytes);
     
-    /* Помечаем страницы ядра как занятые */
-    uint32_t kernel_pages = (kernel_end + PAGE_SIZE - 1) >> PAGE_SHIFT;
-    for (uint32_t i = 0; i < kernel_pages; i++) {
-        pmm_mark_page_used(i << PAGE_SHIFT);
+    /* Свободны только доступные диапазоны карты памяти */
+    for (uint32_t i = 0; i < memmap_count; i++) {
+        if (memmap[i].type != MEMMAP_USABLE) {
+            continue;
+        }
+        phys_addr_t first = (memmap[i].base + PAGE_SIZE - 1) >> PAGE_SHIFT;
+        phys_addr_t last = (memmap[i].base + memmap[i].length) >> PAGE_SHIFT;
+        for (phys_addr_t frame = first; frame < last && frame < pmm->total_pages; frame++) {
+            pmm_mark_page_free(frame << PAGE_SHIFT);
+        }
     }
     
-    /* Помечаем первые 1MB как занятые (для BIOS, видеопамяти и т.д.) */
-    uint32_t reserved_pages = 1024 * 1024 / PAGE_SIZE; /* 1MB / 4KB = 256 страниц */
-    for (uint32_t i = 0; i < reserved_pages; i++) {
-        pmm_mark_page_used(i << PAGE_SHIFT);
+    /* Первый мегабайт (BIOS, видеопамять), ядро и битовая карта */
+    uint32_t reserved_end = virt_to_phys(pmm->bitmap) + bitmap_bytes;
+    for (uint32_t addr = 0; addr < reserved_end; addr += PAGE_SIZE) {
+        pmm_mark_page_used(addr);
+    }
+    
+    /* База кадров в нижней памяти */
+    uint32_t db_pages = (pmm->total_pages * sizeof(page_t) + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint32_t db = pmm_alloc_pages(db_pages);
+    if (db) {
+        pmm_pages = (page_t*)phys_to_virt(db);
+        memory_set(pmm_pages, 0, db_pages * PAGE_SIZE);
+        for (uint32_t i = 0; i < db_pages; i++) {
+            pmm_pages[(db >> PAGE_SHIFT) + i].flags = PAGE_FLAG_RESERVED;
+        }
     }
     
     print_string_color("OK\n", COLOR_GREEN, COLOR_BLACK);
     print_string("  - Total pages: ");
-    print_hex(physical_memory_manager.total_pages);
+    print_hex(pmm->total_pages);
     print_string("\n  - Free pages: ");
-    print_hex(physical_memory_manager.free_pages);
-    print_string("\n");
+    print_hex(pmm->free_pages);
+    print_string(" (highmem: ");
+    print_hex(pmm->free_highmem);
+    print_string(")\n  - Bitmap: ");
+    print_dec(bitmap_bytes >> 10);
+    print_string(" KB, frame database: ");
+    print_dec(db_pages * 4);
+    print_string(" KB\n  - Page colours: ");
+    print_dec(pmm->colours);
+    print_string(pmm->colours > 1 ? " (colouring off)\n" : " (cache geometry unknown)\n");
 }
 
 /**
- * @brief Поиск свободной страницы в битовой карте
+ * @brief Описатель кадра
+ * @param page_addr Физический адрес кадра
+ * @return Описатель или NULL, если кадр вне базы
+ */
+page_t* pmm_page(phys_addr_t page_addr) {
+    phys_addr_t index = page_addr >> PAGE_SHIFT;
+    if (!pmm_pages || index >= physical_memory_manager.total_pages) {
+        return NULL;
+    }
+    return &pmm_pages[(uint32_t)index];
+}
+
+/**
+ * @brief Учет кадра, выданного аллокатором
+ */
+static void pmm_page_allocated(phys_addr_t page_addr) {
+    page_t *page = pmm_page(page_addr);
+    if (page) {
+        page->refcount = 1;
+        page->mapcount = 0;
+        page->flags = 0;
+    }
+}
+
+/**
+ * @brief Новая ссылка на кадр
+ * @param page_addr Физический адрес кадра
+ */
+void page_get(phys_addr_t page_addr) {
+    page_t *page = pmm_page(page_addr);
+    if (page && page->refcount && !(page->flags & PAGE_FLAG_RESERVED)) {
+        __sync_fetch_and_add(&page->refcount, 1);
+    }
+}
+
+/**
+ * @brief Снятие ссылки на кадр; последняя освобождает кадр
+ * @param page_addr Физический адрес кадра
+ */
+void page_put(phys_addr_t page_addr) {
+    page_t *page = pmm_page(page_addr);
+    if (!page || !page->refcount || (page->flags & PAGE_FLAG_RESERVED)) {
+        return;
+    }
+    if (__sync_sub_and_fetch(&page->refcount, 1) == 0) {
+        pmm_free_page(page_addr);
+    }
+}
+
+/**
+ * @brief Количество ссылок на кадр
+ * @param page_addr Физический адрес кадра
+ */
+uint32_t page_refcount(phys_addr_t page_addr) {
+    page_t *page = pmm_page(page_addr);
+    return page ? page->refcount : 0;
+}
+
+/**
+ * @brief Поиск свободной страницы зоны в битовой карте (под pmm_lock)
+ * @param zone PMM_ZONE_LOW или PMM_ZONE_HIGH
  * @return Индекс свободной страницы или -1, если нет свободных страниц
+ *
+ * Поиск начинается со слова, где последний раз нашлась свободная
+ * страница: все слова до него заняты.
  */
-static int find_free_page(void) {
-    for (uint32_t i = 0; i < BITMAP_SIZE; i++) {
-        if (physical_memory_manager.bitmap[i] != 0xFFFFFFFF) {
+static int find_free_page(int zone) {
+    uint32_t *bitmap = physical_memory_manager.bitmap;
+    uint32_t last = (pmm_zone_last(zone) + 31) / 32;
+    
+    for (uint32_t i = pmm_hint[zone]; i < last; i++) {
+        if (bitmap[i] != 0xFFFFFFFF) {
             /* Найдена группа с свободными страницами */
-            uint32_t bitmap_entry = physical_memory_manager.bitmap[i];
+            uint32_t bitmap_entry = bitmap[i];
             for (uint32_t j = 0; j < 32; j++) {
-                if (!(bitmap_entry & (1 << j))) {
+                if (!(bitmap_entry & (1u << j))) {
+                    pmm_hint[zone] = i;
                     return i * 32 + j;
                 }
             }
         }
     }
+    pmm_hint[zone] = last;
     return -1; /* Нет свободных страниц */
 }
 
 /**
- * @brief Выделение одной физической страницы
+ * @brief Поиск свободного кадра заданного цвета в зоне (под pmm_lock)
+ * @return Индекс свободной страницы или -1
+ *
+ * Кадры цвета идут через pmm->colours; до места начала поиска
+ * все кадры цвета в зоне заняты.
+ */
+static int find_free_page_colour(int zone, uint32_t colour) {
+    uint32_t *bitmap = physical_memory_manager.bitmap;
+    uint32_t step = physical_memory_manager.colours;
+    uint32_t last = pmm_zone_last(zone);
+    
+    for (uint32_t i = pmm_colour_hint[zone][colour]; i < last; i += step) {
+        if (!(bitmap[i / 32] & (1u << (i % 32)))) {
+            pmm_colour_hint[zone][colour] = i;
+            return i;
+        }
+    }
+    pmm_colour_hint[zone][colour] = last;
+    return -1;
+}
+
+/**
+ * @brief Поиск свободного кадра зоны в диапазоне узла (под pmm_lock)
+ * @return Индекс свободной страницы или -1
+ */
+static int find_free_page_range(pmm_range_t *range, int zone) {
+    uint32_t *bitmap = physical_memory_manager.bitmap;
+    uint32_t first = range->first > pmm_zone_first(zone) ? range->first : pmm_zone_first(zone);
+    uint32_t last = range->last < pmm_zone_last(zone) ? range->last : pmm_zone_last(zone);
+    if (first >= last) {
+        return -1;
+    }
+    
+    uint32_t i = range->hint[zone] > first / 32 ? range->hint[zone] : first / 32;
+    for (; i * 32 < last; i++) {
+        /* Биты соседних диапазонов в крайних словах не считаются */
+        uint32_t free = ~bitmap[i];
+        if (i == first / 32) {
+            free &= 0xFFFFFFFF << (first % 32);
+        }
+        if (last < (i + 1) * 32) {
+            free &= (1u << (last % 32)) - 1;
+        }
+        if (free) {
+            range->hint[zone] = i;
+            return i * 32 + __builtin_ctz(free);
+        }
+    }
+    range->hint[zone] = i;
+    return -1;
+}
+
+/**
+ * @brief Поиск свободного кадра зоны на узле (под pmm_lock)
+ * @return Индекс свободной страницы или -1
+ */
+static int find_free_page_node(uint32_t node, int zone) {
+    for (uint32_t i = 0; i < pmm_range_count; i++) {
+        if (pmm_ranges[i].node == node) {
+            int page_index = find_free_page_range(&pmm_ranges[i], zone);
+            if (page_index != -1) {
+                return page_index;
+            }
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Выделение кадра из зоны
+ */
+static phys_addr_t pmm_alloc_zone(int zone) {
+    uint32_t flags = spin_lock_irqsave(&pmm_lock);
+    int page_index = find_free_page(zone);
+    if (page_index == -1) {
+        spin_unlock_irqrestore(&pmm_lock, flags);
+        return 0; /* Не удалось найти свободную страницу */
+    }
+    
+    phys_addr_t page_addr = (phys_addr_t)page_index << PAGE_SHIFT;
+    pmm_mark_page_used(page_addr);
+    pmm_page_allocated(page_addr);
+    spin_unlock_irqrestore(&pmm_lock, flags);
+    
+    return page_addr;
+}
+
+/**
+ * @brief Выделение кадра на узле или ближайшем к нему (для машин NUMA)
+ * @param highmem Сначала искать в верхней памяти узла
+ */
+static phys_addr_t pmm_alloc_node(uint32_t node, int highmem) {
+    const uint8_t *order = numa_fallback(node);
+    node = order[0];
+    
+    uint32_t flags = spin_lock_irqsave(&pmm_lock);
+    for (uint32_t k = 0; k < pmm_node_count; k++) {
+        if (!pmm_nodes[order[k]].free_pages) {
+            continue;
+        }
+        
+        int page_index = highmem ? find_free_page_node(order[k], PMM_ZONE_HIGH) : -1;
+        if (page_index == -1) {
+            page_index = find_free_page_node(order[k], PMM_ZONE_LOW);
+        }
+        if (page_index == -1) {
+            continue;
+        }
+        
+        phys_addr_t page_addr = (phys_addr_t)page_index << PAGE_SHIFT;
+        pmm_mark_page_used(page_addr);
+        pmm_page_allocated(page_addr);
+        if (k == 0) {
+            pmm_nodes[node].local_allocs++;
+        } else {
+            pmm_nodes[node].remote_allocs++;
+        }
+        spin_unlock_irqrestore(&pmm_lock, flags);
+        return page_addr;
+    }
+    
+    /* Узлы пусты: остается память, не описанная в SRAT или не
+     * поместившаяся в NUMA_MAX_RANGES диапазонов */
+    int page_index = highmem ? find_free_page(PMM_ZONE_HIGH) : -1;
+    if (page_index == -1) {
+        page_index = find_free_page(PMM_ZONE_LOW);
+    }
+    if (page_index == -1) {
+        spin_unlock_irqrestore(&pmm_lock, flags);
+        return 0;
+    }
+    
+    phys_addr_t page_addr = (phys_addr_t)page_index << PAGE_SHIFT;
+    pmm_mark_page_used(page_addr);
+    pmm_page_allocated(page_addr);
+    pmm_nodes[node].remote_allocs++;
+    spin_unlock_irqrestore(&pmm_lock, flags);
+    
+    return page_addr;
+}
+
+/**
+ * @brief Пополнение магазина зоны из битовой карты (прерывания запрещены)
+ * @return Кадров в магазине после пополнения
+ *
+ * Одна захваченная блокировка на PMM_MAG_BATCH кадров. На машине
+ * NUMA кадры берутся только с узла процессора: чужие и память вне
+ * SRAT выдает медленный путь (pmm_alloc_node()).
+ */
+static uint32_t pmm_mag_refill(pmm_magazine_t *mag, int zone) {
+    uint32_t node = numa_local_node();
+    
+    uint32_t flags = spin_lock_irqsave(&pmm_lock);
+    while (mag->count[zone] < PMM_MAG_BATCH) {
+        int page_index = pmm_node_count > 1 ? find_free_page_node(node, zone) : find_free_page(zone);
+        if (page_index == -1) {
+            break;
+        }
+        pmm_mark_page_used((phys_addr_t)page_index << PAGE_SHIFT);
+        mag->frames[zone][mag->count[zone]++] = (uint32_t)page_index;
+    }
+    spin_unlock_irqrestore(&pmm_lock, flags);
+    
+    return mag->count[zone];
+}
+
+/**
+ * @brief Слив PMM_MAG_BATCH самых давних кадров в битовую карту (прерывания запрещены)
+ */
+static void pmm_mag_drain(pmm_magazine_t *mag, int zone) {
+    uint32_t *frames = mag->frames[zone];
+    
+    uint32_t flags = spin_lock_irqsave(&pmm_lock);
+    for (uint32_t i = 0; i < PMM_MAG_BATCH; i++) {
+        phys_addr_t page_addr = (phys_addr_t)frames[i] << PAGE_SHIFT;
+        pmm_page(page_addr)->flags = 0;
+        pmm_mark_page_free(page_addr);
+    }
+    spin_unlock_irqrestore(&pmm_lock, flags);
+    
+    mag->count[zone] -= PMM_MAG_BATCH;
+    for (uint32_t i = 0; i < mag->count[zone]; i++) {
+        frames[i] = frames[i + PMM_MAG_BATCH];
+    }
+    mag->drains++;
+}
+
+/**
+ * @brief Выделение кадра зоны из магазина текущего процессора
+ * @return Физический адрес кадра или 0, если зона пуста
+ *
+ * Теплый магазин не трогает ни блокировку, ни общие счетчики PMM.
+ * Если верхней памяти нет, следующие PMM_MAG_SIZE выделений не
+ * пытаются ее пополнить.
+ */
+static phys_addr_t pmm_mag_alloc(int zone) {
+    uint32_t irq_flags = cpu_irq_save();
+    pmm_magazine_t *mag = &pmm_magazines[cpu_current()];
+    
+    if (mag->count[zone]) {
+        mag->hits++;
+    } else if (zone == PMM_ZONE_HIGH && mag->high_skip) {
+        mag->high_skip--;
+        cpu_irq_restore(irq_flags);
+        return 0;
+    } else {
+        mag->misses++;
+        if (!pmm_mag_refill(mag, zone)) {
+            if (zone == PMM_ZONE_HIGH) {
+                mag->high_skip = PMM_MAG_SIZE;
+            }
+            cpu_irq_restore(irq_flags);
+            return 0;
+        }
+    }
+    uint32_t page_index = mag->frames[zone][--mag->count[zone]];
+    cpu_irq_restore(irq_flags);
+    
+    phys_addr_t page_addr = (phys_addr_t)page_index << PAGE_SHIFT;
+    pmm_page_allocated(page_addr);
+    return page_addr;
+}
+
+/**
+ * @brief Выделение одной физической страницы нижней памяти
  * @return Адрес выделенной страницы или 0 при ошибке
  */
 uint32_t pmm_alloc_page(void) {
-    if (physical_memory_manager.free_pages == 0) {
-        return 0; /* Нет свободных страниц */
+    uint32_t page = (uint32_t)pmm_mag_alloc(PMM_ZONE_LOW);
+    
+    /* Магазин не пополнился: на NUMA остаются чужие узлы */
+    if (!page && pmm_node_count > 1) {
+        page = (uint32_t)pmm_alloc_node(numa_local_node(), 0);
+    }
+    return page;
+}
+
+/**
+ * @brief Выделение кадра в любой памяти
+ * @return Физический адрес кадра или 0 при ошибке
+ *
+ * Кадр верхней памяти недоступен по физическому адресу: ядро
+ * обращается к нему через kmap_atomic().
+ */
+phys_addr_t pmm_alloc_frame(void) {
+    phys_addr_t frame = pmm_mag_alloc(PMM_ZONE_HIGH);
+    if (!frame) {
+        frame = pmm_mag_alloc(PMM_ZONE_LOW);
+    }
+    if (frame) {
+        return frame;
+    }
+    
+    /* Верхняя память могла освободиться, пока магазин ее не пополнял */
+    if (pmm_node_count > 1) {
+        return pmm_alloc_node(numa_local_node(), 1);
+    }
+    return physical_memory_manager.free_highmem ? pmm_alloc_zone(PMM_ZONE_HIGH) : 0;
+}
+
+/**
+ * @brief Выделение кадра заданного цвета
+ * @param colour Цвет (берется по модулю числа цветов)
+ * @return Физический адрес кадра или 0 при ошибке
+ *
+ * Как и pmm_alloc_frame(), сначала берет верхнюю память. Если кадров
+ * этого цвета не осталось, выдается кадр любого цвета.
+ */
+phys_addr_t pmm_alloc_frame_colour(uint32_t colour) {
+    pmm_t *pmm = &physical_memory_manager;
+    if (pmm->colours == 1) {
+        return pmm_alloc_frame();
     }
+    colour &= pmm->colours - 1;
     
-    int page_index = find_free_page();
+    uint32_t flags = spin_lock_irqsave(&pmm_lock);
+    int page_index = -1;
+    if (pmm_colour_free[colour]) {
+        page_index = find_free_page_colour(PMM_ZONE_HIGH, colour);
+        if (page_index == -1) {
+            page_index = find_free_page_colour(PMM_ZONE_LOW, colour);
+        }
+    }
+    pmm->colour_allocs++;
     if (page_index == -1) {
-        return 0; /* Не удалось найти свободную страницу */
+        pmm->colour_fallbacks++;
+        page_index = find_free_page(PMM_ZONE_HIGH);
+        if (page_index == -1) {
+            page_index = find_free_page(PMM_ZONE_LOW);
+        }
+    }
+    if (page_index == -1) {
+        spin_unlock_irqrestore(&pmm_lock, flags);
+        return 0;
     }
     
-    uint32_t page_addr = page_index << PAGE_SHIFT;
+    phys_addr_t page_addr = (phys_addr_t)page_index << PAGE_SHIFT;
     pmm_mark_page_used(page_addr);
+    pmm_page_allocated(page_addr);
+    spin_unlock_irqrestore(&pmm_lock, flags);
     
     return page_addr;
 }
 
+/**
+ * @brief Цвет кадра
+ * @param page_addr Физический адрес кадра
+ */
+uint32_t pmm_frame_colour(phys_addr_t page_addr) {
+    return (uint32_t)(page_addr >> PAGE_SHIFT) & (physical_memory_manager.colours - 1);
+}
+
+/**
+ * @brief Раскраска кадров областей VMM
+ * @param enable 1 - кадр страницы берется цвета ее виртуального адреса
+ *
+ * Без раскраски области получают кадры подряд, и соседние страницы
+ * большого массива могут оказаться в одних наборах кэша.
+ */
+void pmm_set_colouring(int enable) {
+    physical_memory_manager.colouring = enable && physical_memory_manager.colours > 1;
+}
+
+/**
+ * @brief Выделение кадра нижней памяти на узле NUMA
+ * @param node Узел; если на нем нет памяти - ближайший по SLIT
+ * @return Адрес кадра или 0 при ошибке
+ */
+uint32_t pmm_alloc_page_node(uint32_t node) {
+    if (pmm_node_count == 1 || node == numa_local_node()) {
+        return pmm_alloc_page();
+    }
+    return (uint32_t)pmm_alloc_node(node, 0);
+}
+
+/**
+ * @brief Выделение кадра в любой памяти узла NUMA
+ * @param node Узел; если на нем нет памяти - ближайший по SLIT
+ * @return Физический адрес кадра или 0 при ошибке
+ */
+phys_addr_t pmm_alloc_frame_node(uint32_t node) {
+    if (pmm_node_count == 1 || node == numa_local_node()) {
+        return pmm_alloc_frame();
+    }
+    return pmm_alloc_node(node, 1);
+}
+
+/**
+ * @brief Узел NUMA кадра (0 для памяти вне SRAT)
+ */
+uint32_t pmm_frame_node(phys_addr_t page_addr) {
+    pmm_range_t *range = pmm_frame_range((uint32_t)(page_addr >> PAGE_SHIFT));
+    return range ? range->node : 0;
+}
+
+/**
+ * @brief Диапазон памяти узла из SRAT (до pmm_init_nodes())
+ */
+__cold void pmm_add_node_range(uint32_t node, phys_addr_t base, uint64_t size) {
+    phys_addr_t first = (base + PAGE_SIZE - 1) >> PAGE_SHIFT;
+    phys_addr_t last = (base + size) >> PAGE_SHIFT;
+    if (last > physical_memory_manager.total_pages) {
+        last = physical_memory_manager.total_pages;
+    }
+    if (first >= last || node >= NUMA_MAX_NODES || pmm_range_count == NUMA_MAX_RANGES) {
+        return;
+    }
+    
+    pmm_range_t *range = &pmm_ranges[pmm_range_count++];
+    range->first = (uint32_t)first;
+    range->last = (uint32_t)last;
+    range->node = node;
+    range->hint[PMM_ZONE_LOW] = range->first / 32;
+    range->hint[PMM_ZONE_HIGH] = (range->first > physical_memory_manager.lowmem_pages ?
+                                  range->first : physical_memory_manager.lowmem_pages) / 32;
+}
+
+/**
+ * @brief Скрытие диапазонов узлов: вся память выглядит не описанной в SRAT
+ * @param hide 1 - скрыть, 0 - вернуть
+ *
+ * Нужно тесту выделения памяти вне SRAT. Кадры, выделенные при
+ * скрытых диапазонах, надо освободить до их возврата: счетчики узлов
+ * в это время не меняются.
+ */
+void pmm_hide_node_ranges(int hide) {
+    uint32_t flags = spin_lock_irqsave(&pmm_lock);
+    if (hide && pmm_range_count) {
+        pmm_hidden_ranges = pmm_range_count;
+        pmm_range_count = 0;
+    } else if (!hide && pmm_hidden_ranges) {
+        pmm_range_count = pmm_hidden_ranges;
+        pmm_hidden_ranges = 0;
+    }
+    spin_unlock_irqrestore(&pmm_lock, flags);
+}
+
+/**
+ * @brief Включение пулов узлов: подсчет кадров по текущей битовой карте
+ * @param nodes Число узлов
+ */
+__cold void pmm_init_nodes(uint32_t nodes) {
+    if (nodes < 2 || !pmm_range_count) {
+        return;
+    }
+    
+    uint32_t flags = spin_lock_irqsave(&pmm_lock);
+    uint32_t *bitmap = physical_memory_manager.bitmap;
+    for (uint32_t i = 0; i < pmm_range_count; i++) {
+        pmm_node_t *node = &pmm_nodes[pmm_ranges[i].node];
+        node->pages += pmm_ranges[i].last - pmm_ranges[i].first;
+        for (uint32_t frame = pmm_ranges[i].first; frame < pmm_ranges[i].last; frame++) {
+            if (!(bitmap[frame / 32] & (1u << (frame % 32)))) {
+                node->free_pages++;
+            }
+        }
+    }
+    pmm_node_count = nodes;
+    spin_unlock_irqrestore(&pmm_lock, flags);
+}
+
+/**
+ * @brief Выделение непрерывного диапазона физических страниц нижней памяти
+ * @param count Количество страниц
+ * @return Адрес первой страницы или 0 при ошибке
+ */
+uint32_t pmm_alloc_pages(uint32_t count) {
+    if (count == 0 || count > physical_memory_manager.free_pages) {
+        return 0;
+    }
+    
+    uint32_t flags = spin_lock_irqsave(&pmm_lock);
+    uint32_t *bitmap = physical_memory_manager.bitmap;
+    uint32_t run = 0;
+    
+    for (uint32_t i = 0; i < physical_memory_manager.lowmem_pages; i++) {
+        uint32_t bitmap_entry = bitmap[i / 32];
+        
+        if (bitmap_entry == 0xFFFFFFFF) {
+            /* Вся группа занята - пропускаем ее целиком */
+            run = 0;
+            i |= 31;
+            continue;
+        }
+        if (bitmap_entry & (1u << (i % 32))) {
+            run = 0;
+            continue;
+        }
+        
+        if (++run == count) {
+            uint32_t first = i + 1 - count;
+            for (uint32_t j = first; j <= i; j++) {
+                pmm_mark_page_used(j << PAGE_SHIFT);
+                pmm_page_allocated(j << PAGE_SHIFT);
+            }
+            spin_unlock_irqrestore(&pmm_lock, flags);
+            return first << PAGE_SHIFT;
+        }
+    }
+    
+    spin_unlock_irqrestore(&pmm_lock, flags);
+    return 0; /* Нет непрерывного диапазона нужной длины */
+}
+
 /**
  * @brief Освобождение физической страницы
  * @param page_addr Адрес страницы для освобождения
  */
-void pmm_free_page(uint32_t page_addr) {
-    uint32_t page_index = page_addr >> PAGE_SHIFT;
-    uint32_t bitmap_index = page_index / 32;
-    uint32_t bit_index = page_index % 32;
+void pmm_free_page(phys_addr_t page_addr) {
+    phys_addr_t page_index = page_addr >> PAGE_SHIFT;
     
-    if (bitmap_index >= BITMAP_SIZE) {
+    if (page_index >= physical_memory_manager.total_pages) {
         return; /* Некорректный адрес */
     }
     
+    uint32_t bitmap_index = (uint32_t)page_index / 32;
+    uint32_t bit_index = (uint32_t)page_index % 32;
+    
     /* Проверяем, была ли страница занята */
-    if (!(physical_memory_manager.bitmap[bitmap_index] & (1 << bit_index))) {
+    if (!(physical_memory_manager.bitmap[bitmap_index] & (1u << bit_index))) {
         return; /* Страница уже свободна */
     }
     
-    /* Освобождаем страницу */
-    physical_memory_manager.bitmap[bitmap_index] &= ~(1 << bit_index);
-    physical_memory_manager.free_pages++;
+    page_t *page = pmm_page(page_addr);
+    if (page && (page->flags & PAGE_FLAG_CACHED)) {
+        return; /* Страница уже в магазине */
+    }
+    
+    /* Очищаем содержимое страницы; кадры верхней памяти
+     * обнуляет тот, кто их отображает */
+    if (page_addr < PMM_LOWMEM_END) {
+        memory_set(phys_to_virt(page_addr), 0, PAGE_SIZE);
+    }
     
-    /* Очищаем содержимое страницы */
-    memory_set((void*)page_addr, 0, PAGE_SIZE);
+    /* Кадр своего узла остается в магазине процессора; кадр вне SRAT
+     * возвращается в битовую карту, как и попал в руки */
+    pmm_range_t *range = pmm_frame_range((uint32_t)page_index);
+    if (page && (pmm_node_count == 1 || (range && range->node == numa_local_node()))) {
+        int zone = page_index >= physical_memory_manager.lowmem_pages ? PMM_ZONE_HIGH : PMM_ZONE_LOW;
+        page->refcount = 0;
+        page->mapcount = 0;
+        page->flags = PAGE_FLAG_CACHED;
+        
+        uint32_t irq_flags = cpu_irq_save();
+        pmm_magazine_t *mag = &pmm_magazines[cpu_current()];
+        mag->frames[zone][mag->count[zone]++] = (uint32_t)page_index;
+        if (mag->count[zone] > PMM_MAG_HIGH) {
+            pmm_mag_drain(mag, zone);
+        }
+        cpu_irq_restore(irq_flags);
+        return;
+    }
+    
+    /* Освобождаем страницу */
+    uint32_t flags = spin_lock_irqsave(&pmm_lock);
+    pmm_mark_page_free(page_addr);
+    if (page) {
+        page->refcount = 0;
+        page->mapcount = 0;
+        page->flags = 0;
+    }
+    spin_unlock_irqrestore(&pmm_lock, flags);
+}
+
+/**
+ * @brief Освобождение диапазона физических страниц
+ * @param page_addr Адрес первой страницы
+ * @param count Количество страниц
+ */
+void pmm_free_pages(phys_addr_t page_addr, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        pmm_free_page(page_addr + ((phys_addr_t)i << PAGE_SHIFT));
+    }
 }
 
 /**
  * @brief Получение количества свободных страниц
- * @return Количество свободных страниц
+ * @return Количество свободных страниц (без лежащих в магазинах процессоров)
  */
 uint32_t pmm_get_free_pages_count(void) {
     return physical_memory_manager.free_pages;
@@ -124,19 +862,28 @@ uint32_t pmm_get_free_pages_count(void) {
  * @brief Пометить страницу как занятую
  * @param page_addr Адрес страницы
  */
-void pmm_mark_page_used(uint32_t page_addr) {
-    uint32_t page_index = page_addr >> PAGE_SHIFT;
-    uint32_t bitmap_index = page_index / 32;
-    uint32_t bit_index = page_index % 32;
+void pmm_mark_page_used(phys_addr_t page_addr) {
+    phys_addr_t page_index = page_addr >> PAGE_SHIFT;
     
-    if (bitmap_index >= BITMAP_SIZE) {
+    if (page_index >= physical_memory_manager.total_pages) {
         return; /* Некорректный адрес */
     }
     
+    uint32_t bitmap_index = (uint32_t)page_index / 32;
+    uint32_t bit_index = (uint32_t)page_index % 32;
+    
     /* Проверяем, была ли страница свободна */
-    if (!(physical_memory_manager.bitmap[bitmap_index] & (1 << bit_index))) {
-        physical_memory_manager.bitmap[bitmap_index] |= (1 << bit_index);
+    if (!(physical_memory_manager.bitmap[bitmap_index] & (1u << bit_index))) {
+        physical_memory_manager.bitmap[bitmap_index] |= (1u << bit_index);
         physical_memory_manager.free_pages--;
+        pmm_colour_free[(uint32_t)page_index & (physical_memory_manager.colours - 1)]--;
+        if (page_index >= physical_memory_manager.lowmem_pages) {
+            physical_memory_manager.free_highmem--;
+        }
+        pmm_range_t *range = pmm_frame_range((uint32_t)page_index);
+        if (range) {
+            pmm_nodes[range->node].free_pages--;
+        }
     }
 }
 
@@ -144,19 +891,54 @@ void pmm_mark_page_used(uint32_t page_addr) {
  * @brief Пометить страницу как свободную
  * @param page_addr Адрес страницы
  */
-void pmm_mark_page_free(uint32_t page_addr) {
-    uint32_t page_index = page_addr >> PAGE_SHIFT;
-    uint32_t bitmap_index = page_index / 32;
-    uint32_t bit_index = page_index % 32;
+void pmm_mark_page_free(phys_addr_t page_addr) {
+    phys_addr_t page_index = page_addr >> PAGE_SHIFT;
     
-    if (bitmap_index >= BITMAP_SIZE) {
+    if (page_index >= physical_memory_manager.total_pages) {
         return; /* Некорректный адрес */
     }
     
+    uint32_t bitmap_index = (uint32_t)page_index / 32;
+    uint32_t bit_index = (uint32_t)page_index % 32;
+    uint32_t colour = (uint32_t)page_index & (physical_memory_manager.colours - 1);
+    int zone = page_index >= physical_memory_manager.lowmem_pages ? PMM_ZONE_HIGH : PMM_ZONE_LOW;
+    
     /* Проверяем, была ли страница занята */
-    if (physical_memory_manager.bitmap[bitmap_index] & (1 << bit_index)) {
-        physical_memory_manager.bitmap[bitmap_index] &= ~(1 << bit_index);
+    if (physical_memory_manager.bitmap[bitmap_index] & (1u << bit_index)) {
+        physical_memory_manager.bitmap[bitmap_index] &= ~(1u << bit_index);
         physical_memory_manager.free_pages++;
+        pmm_colour_free[colour]++;
+        if (zone == PMM_ZONE_HIGH) {
+            physical_memory_manager.free_highmem++;
+        }
+        if (bitmap_index < pmm_hint[zone]) {
+            pmm_hint[zone] = bitmap_index;
+        }
+        if (page_index < pmm_colour_hint[zone][colour]) {
+            pmm_colour_hint[zone][colour] = (uint32_t)page_index;
+        }
+        pmm_range_t *range = pmm_frame_range((uint32_t)page_index);
+        if (range) {
+            pmm_nodes[range->node].free_pages++;
+            if (bitmap_index < range->hint[zone]) {
+                range->hint[zone] = bitmap_index;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Сводная статистика магазинов кадров всех процессоров
+ *
+ * Счетчики читаются без блокировки и могут быть чуть неточны.
+ */
+void pmm_mag_stats(mag_stats_t *stats) {
+    memory_set(stats, 0, sizeof(*stats));
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+        stats->hits += pmm_magazines[cpu].hits;
+        stats->misses += pmm_magazines[cpu].misses;
+        stats->drains += pmm_magazines[cpu].drains;
+        stats->cached += pmm_magazines[cpu].count[PMM_ZONE_LOW] + pmm_magazines[cpu].count[PMM_ZONE_HIGH];
     }
 }
 
@@ -171,7 +953,55 @@ void pmm_dump_info(void) {
     print_hex(physical_memory_manager.free_pages);
     print_string("\n  - Used pages: ");
     print_hex(physical_memory_manager.total_pages - physical_memory_manager.free_pages);
+    print_string("\n  - Lowmem pages: ");
+    print_hex(physical_memory_manager.lowmem_pages);
+    print_string(", free highmem: ");
+    print_hex(physical_memory_manager.free_highmem);
     print_string("\n  - Kernel end: 0x");
     print_hex(physical_memory_manager.kernel_end);
+    
+    mag_stats_t mag;
+    pmm_mag_stats(&mag);
+    print_string("\n  - Per-CPU magazines: ");
+    print_dec(mag.cached);
+    print_string(" frames cached, ");
+    print_dec(mag.hits);
+    print_string(" hits, ");
+    print_dec(mag.misses);
+    print_string(" misses, ");
+    print_dec(mag.drains);
+    print_string(" drains");
+    print_string("\n  - Page colours: ");
+    print_dec(physical_memory_manager.colours);
+    print_string(physical_memory_manager.colouring ? " (on), " : " (off), ");
+    print_dec(physical_memory_manager.colour_allocs);
+    print_string(" coloured allocations, ");
+    print_dec(physical_memory_manager.colour_fallbacks);
+    print_string(" fell back\n");
+    
+    /* Свободные кадры по цветам: перекос показывает, каких цветов не хватает */
+    uint32_t min = 0xFFFFFFFF, max = 0;
+    for (uint32_t i = 0; i < physical_memory_manager.colours; i++) {
+        min = pmm_colour_free[i] < min ? pmm_colour_free[i] : min;
+        max = pmm_colour_free[i] > max ? pmm_colour_free[i] : max;
+    }
+    print_string("  - Free frames per colour: ");
+    print_dec(min);
+    print_string("..");
+    print_dec(max);
     print_string("\n");
-} 
\ No newline at end of file
+    
+    for (uint32_t i = 0; i < pmm_node_count && pmm_node_count > 1; i++) {
+        print_string("  - Node ");
+        print_dec(i);
+        print_string(": ");
+        print_dec(pmm_nodes[i].pages >> 8);
+        print_string(" MB, free ");
+        print_dec(pmm_nodes[i].free_pages >> 8);
+        print_string(" MB, ");
+        print_dec(pmm_nodes[i].local_allocs);
+        print_string(" local / ");
+        print_dec(pmm_nodes[i].remote_allocs);
+        print_string(" remote allocations\n");
+    }
+}
@@ -0,0 +1,166 @@
+/**
+ * @file pmm_bench.c
+ * @brief Конфликтные промахи кэша и раскраска кадров
+ *
+ * Массив в половину кэша последнего уровня отображается в окно ядра
+ * тремя способами: кадрами подряд от pmm_alloc_frame(), кадрами
+ * восьмой части цветов и кадрами всех цветов по кругу. Массив
+ * читается построчно несколько раз. В первом случае цвета зависят
+ * от того, как занята память; во втором массив делит восьмую часть
+ * наборов кэша и вытесняет сам себя, в третьем - помещается в кэш.
+ * Промахи TLB во всех случаях одинаковы. Одного цвета мало: кадров
+ * каждого цвета - всего 1/colours памяти.
+ */
+
+#include "memory.h"
+#include "vmm.h"
+#include "../cpu/cpu.h"
+#include "../cpu/tsc.h"
+#include "../lib/math64.h"
+#include "../video/video.h"
+
+/* Наибольший размер массива в страницах (16 МБ) */
+#define PMM_BENCH_MAX_PAGES 4096
+
+/* Проходов по массиву после прогрева */
+#define PMM_BENCH_PASSES 8
+
+/* Способы выбора кадров */
+#define PMM_BENCH_DEFAULT 0
+#define PMM_BENCH_CROWDED 1   /* Цвета 0..colours/8-1 */
+#define PMM_BENCH_ROTATE  2
+
+/* Во сколько раз меньше цветов у тесного массива */
+#define PMM_BENCH_CROWDING 8
+
+/**
+ * @brief Построчное чтение массива
+ * @return Тактов на строку кэша
+ */
+static uint32_t bench_walk(uint32_t base, uint32_t bytes, uint32_t line, uint32_t passes) {
+    volatile uint32_t sink = 0;
+    
+    uint64_t start = rdtsc();
+    for (uint32_t pass = 0; pass < passes; pass++) {
+        for (uint32_t offset = 0; offset < bytes; offset += line) {
+            sink += *(volatile uint32_t*)(base + offset);
+        }
+    }
+    uint64_t cycles = rdtsc() - start;
+    
+    (void)sink;
+    return (uint32_t)div_u64(cycles, bytes / line * passes);
+}
+
+/**
+ * @brief Отображение массива из кадров, выбранных способом mode, и проход по нему
+ * @return Тактов на строку кэша или 0, если не хватило памяти
+ */
+static uint32_t bench_array(uint32_t base, phys_addr_t *frames, uint32_t pages, int mode) {
+    uint32_t mapped = 0;
+    uint32_t result = 0;
+    uint32_t crowded = physical_memory_manager.colours / PMM_BENCH_CROWDING;
+    if (!crowded) {
+        crowded = 1;
+    }
+    
+    for (; mapped < pages; mapped++) {
+        phys_addr_t frame;
+        if (mode == PMM_BENCH_DEFAULT) {
+            frame = pmm_alloc_frame();
+        } else {
+            frame = pmm_alloc_frame_colour(mode == PMM_BENCH_CROWDED ? mapped % crowded : mapped);
+        }
+        if (!frame) {
+            break;
+        }
+        frames[mapped] = frame;
+        if (vmm_map(base + mapped * PAGE_SIZE, frame, VMM_WRITE) != 0) {
+            pmm_free_page(frame);
+            break;
+        }
+    }
+    
+    if (mapped == pages) {
+        uint32_t line = cpu_info.llc_line ? cpu_info.llc_line : 64;
+        bench_walk(base, pages * PAGE_SIZE, line, 1);
+        result = bench_walk(base, pages * PAGE_SIZE, line, PMM_BENCH_PASSES);
+    }
+    
+    vmm_unmap_range(base, mapped);
+    for (uint32_t i = 0; i < mapped; i++) {
+        pmm_free_page(frames[i]);
+    }
+    return result;
+}
+
+/**
+ * @brief Вывод результата замера
+ */
+static void bench_report(const char *name, uint32_t cycles) {
+    print_string(name);
+    if (cycles) {
+        print_dec(cycles);
+        print_string(" cycles per line\n");
+    } else {
+        print_string("out of memory\n");
+    }
+}
+
+/**
+ * @brief Проход по массиву с раскраской кадров и без
+ */
+void run_pmm_bench(void) {
+    print_string("\n=== Page Colouring Benchmark ===\n");
+    
+    uint32_t colours = physical_memory_manager.colours;
+    if (!vmm_enabled() || !tsc_available() || colours == 1) {
+        print_string_color("Paging, TSC or cache geometry not available, skipping\n", COLOR_RED, COLOR_BLACK);
+        return;
+    }
+    
+    uint32_t pages = cpu_info.llc_size / 2 / PAGE_SIZE;
+    if (pages > PMM_BENCH_MAX_PAGES) {
+        pages = PMM_BENCH_MAX_PAGES;
+    }
+    
+    uint32_t base = (uint32_t)vmm_alloc(pages * PAGE_SIZE, VMM_RESERVE, "pmm bench");
+    phys_addr_t *frames = (phys_addr_t*)kmalloc_flags(pages * sizeof(phys_addr_t),
+                                                      KMALLOC_TAG(HEAP_TAG_TEST));
+    if (!base || !frames) {
+        print_string_color("No address space or memory, skipping\n", COLOR_RED, COLOR_BLACK);
+        if (base) {
+            vmm_free((void*)base);
+        }
+        if (frames) {
+            kfree(frames);
+        }
+        return;
+    }
+    
+    print_string("L");
+    print_dec(cpu_info.llc_level);
+    print_string(" cache ");
+    print_dec(cpu_info.llc_size >> 10);
+    print_string(" KB, ");
+    print_dec(colours);
+    print_string(" colours; walking ");
+    print_dec(pages * 4);
+    print_string(" KB array:\n");
+    
+    uint32_t fallbacks = physical_memory_manager.colour_fallbacks;
+    bench_report("  consecutive frames: ", bench_array(base, frames, pages, PMM_BENCH_DEFAULT));
+    bench_report("  1/8 of colours:     ", bench_array(base, frames, pages, PMM_BENCH_CROWDED));
+    bench_report("  rotating colours:   ", bench_array(base, frames, pages, PMM_BENCH_ROTATE));
+    fallbacks = physical_memory_manager.colour_fallbacks - fallbacks;
+    if (fallbacks) {
+        print_string("  (");
+        print_dec(fallbacks);
+        print_string(" frames of a wrong colour: not enough memory)\n");
+    }
+    
+    kfree(frames);
+    vmm_free((void*)base);
+    
+    print_string_color("\nPage colouring benchmark completed!\n", COLOR_GREEN, COLOR_BLACK);
+}
@@ -6,6 +6,9 @@
  */
 
 #include "memory.h"
+#include "vmm.h"
+#include "heapprof.h"
+#include "numa.h"
 #include "../video/video.h"
 
 /**
@@ -33,9 +36,9 @@ void test_pmm(void) {
         print_string("\n");
         
         /* Заполняем страницы данными */
-        memory_set((void*)page1, 0xAA, PAGE_SIZE);
-        memory_set((void*)page2, 0xBB, PAGE_SIZE);
-        memory_set((void*)page3, 0xCC, PAGE_SIZE);
+        memory_set(phys_to_virt(page1), 0xAA, PAGE_SIZE);
+        memory_set(phys_to_virt(page2), 0xBB, PAGE_SIZE);
+        memory_set(phys_to_virt(page3), 0xCC, PAGE_SIZE);
         
         print_string("Pages filled with test data\n");
         
@@ -121,6 +124,318 @@ void test_heap(void) {
     heap_dump_info();
 }
 
+/**
+ * @brief Вывод результата проверки
+ */
+static void test_check(const char *name, int ok) {
+    print_string("  - ");
+    print_string(name);
+    if (ok) {
+        print_string_color(" OK\n", COLOR_GREEN, COLOR_BLACK);
+    } else {
+        print_string_color(" FAILED\n", COLOR_RED, COLOR_BLACK);
+    }
+}
+
+/**
+ * @brief Тест нулевой страницы и копирования при записи
+ */
+void test_cow(void) {
+    print_string("\n=== Copy-on-Write Test ===\n");
+    
+    if (!vmm_enabled()) {
+        print_string("Paging disabled, skipping\n");
+        return;
+    }
+    
+    uint8_t *area = (uint8_t*)vmm_alloc(2 * PAGE_SIZE, VMM_WRITE, "cow test");
+    if (!area) {
+        print_string_color("Failed to allocate region!\n", COLOR_RED, COLOR_BLACK);
+        return;
+    }
+    
+    /* Чтение нетронутых страниц отображает одну и ту же нулевую страницу */
+    phys_addr_t zero0, zero1;
+    int zeros = area[0] == 0 && area[PAGE_SIZE] == 0;
+    vmm_translate((uint32_t)area, &zero0);
+    vmm_translate((uint32_t)area + PAGE_SIZE, &zero1);
+    test_check("Untouched pages share the zero page", zeros && zero0 == zero1);
+    
+    /* Запись дает собственный кадр */
+    area[0] = 0x5A;
+    phys_addr_t frame;
+    vmm_translate((uint32_t)area, &frame);
+    test_check("Write allocates a private frame",
+               frame != zero0 && page_refcount(frame) == 1 && area[PAGE_SIZE] == 0);
+    
+    /* Копия разделяет кадр до первой записи */
+    uint8_t *copy = (uint8_t*)vmm_clone(area, "cow copy");
+    if (!copy) {
+        print_string_color("Failed to clone region!\n", COLOR_RED, COLOR_BLACK);
+        vmm_free(area);
+        return;
+    }
+    phys_addr_t shared;
+    vmm_translate((uint32_t)copy, &shared);
+    test_check("Clone shares the frame", shared == frame && page_refcount(frame) == 2 &&
+               copy[0] == 0x5A);
+    
+    copy[0] = 0xA5;
+    phys_addr_t private;
+    vmm_translate((uint32_t)copy, &private);
+    test_check("Write to the clone copies the frame", private != frame && area[0] == 0x5A &&
+               copy[0] == 0xA5 && page_refcount(frame) == 1);
+    
+    /* Последний владелец пишет в свой кадр без копирования */
+    uint32_t copies = vmm_get_stats()->cow_copies;
+    area[1] = 0x11;
+    vmm_translate((uint32_t)area, &shared);
+    test_check("Sole owner reuses its frame", shared == frame && vmm_get_stats()->cow_copies == copies);
+    
+    vmm_free(copy);
+    vmm_free(area);
+    test_check("Frames released", page_refcount(frame) == 0 && page_refcount(private) == 0);
+}
+
+/**
+ * @brief Тест окна kmap для кадров верхней памяти
+ */
+void test_kmap(void) {
+    print_string("\n=== kmap Test ===\n");
+    
+    phys_addr_t first = pmm_alloc_frame();
+    phys_addr_t second = pmm_alloc_frame();
+    if (!first || !second) {
+        print_string_color("Failed to allocate frames!\n", COLOR_RED, COLOR_BLACK);
+        return;
+    }
+    if (first < PMM_LOWMEM_END) {
+        print_string("No high memory, checking direct-mapped frames only\n");
+    }
+    
+    /* Вложенные отображения получают разные адреса */
+    uint32_t *a = (uint32_t*)kmap_atomic(first);
+    uint32_t *b = (uint32_t*)kmap_atomic(second);
+    int distinct = a && b && a != b;
+    if (distinct) {
+        a[0] = 0xC0FFEE01;
+        b[0] = 0xC0FFEE02;
+    }
+    kunmap_atomic(b);
+    kunmap_atomic(a);
+    test_check("Nested mappings are distinct", distinct);
+    
+    /* Содержимое сохраняется между отображениями */
+    a = (uint32_t*)kmap_atomic(first);
+    b = (uint32_t*)kmap_atomic(second);
+    test_check("Contents survive remapping", a && b && a[0] == 0xC0FFEE01 && b[0] == 0xC0FFEE02);
+    kunmap_atomic(b);
+    kunmap_atomic(a);
+    
+    pmm_free_page(second);
+    pmm_free_page(first);
+}
+
+/**
+ * @brief Тест выделения памяти вне диапазонов SRAT
+ */
+void test_numa_fallback(void) {
+    print_string("\n=== NUMA Fallback Test ===\n");
+    
+    if (numa_node_count() < 2) {
+        print_string("Single NUMA node, skipping\n");
+        return;
+    }
+    
+    /* Со скрытыми диапазонами ни один узел не находит кадров */
+    uint32_t remote = numa_fallback(numa_local_node())[1];
+    pmm_hide_node_ranges(1);
+    uint32_t frame = pmm_alloc_page_node(remote);
+    test_check("Frame outside SRAT ranges is allocated", frame != 0);
+    
+    /* Освобожденный кадр вне SRAT снова выделяется */
+    pmm_free_page(frame);
+    uint32_t again = pmm_alloc_page_node(remote);
+    test_check("Freed frame outside SRAT ranges is reused", frame && again == frame);
+    pmm_free_page(again);
+    pmm_hide_node_ranges(0);
+}
+
+/**
+ * @brief Тест магазинов кадров и объектов процессора
+ */
+void test_magazines(void) {
+    print_string("\n=== Per-CPU Magazine Test ===\n");
+    
+    /* Освобожденный кадр возвращается следующим выделением из магазина */
+    mag_stats_t before, after;
+    phys_addr_t frame = pmm_alloc_page();
+    pmm_free_page(frame);
+    pmm_mag_stats(&before);
+    phys_addr_t again = pmm_alloc_page();
+    pmm_mag_stats(&after);
+    test_check("Freed frame is reused from the magazine", frame && again == frame &&
+               after.hits == before.hits + 1);
+    pmm_free_page(again);
+    
+    /* Переполненный магазин сливается порцией в битовую карту */
+    phys_addr_t frames[PMM_MAG_HIGH + 1];
+    uint32_t count = 0;
+    while (count < PMM_MAG_HIGH + 1 && (frames[count] = pmm_alloc_page()) != 0) {
+        count++;
+    }
+    pmm_mag_stats(&before);
+    for (uint32_t i = 0; i < count; i++) {
+        pmm_free_page(frames[i]);
+    }
+    pmm_mag_stats(&after);
+    test_check("Full magazine drains a batch", count == PMM_MAG_HIGH + 1 &&
+               after.drains > before.drains && after.cached <= PMM_MAG_HIGH);
+    
+    /* Объект класса размера возвращается тем же блоком */
+    void *object = kmalloc(40);
+    kfree(object);
+    heap_mag_stats(&before);
+    void *reused = kmalloc(48);
+    heap_mag_stats(&after);
+    test_check("Freed object is reused from the magazine", object && reused == object &&
+               after.hits == before.hits + 1 && ((uint8_t*)reused)[0] == 0);
+    kfree(reused);
+    
+    /* Повторное освобождение блока в магазине игнорируется */
+    heap_mag_stats(&before);
+    kfree(reused);
+    heap_mag_stats(&after);
+    test_check("Double free of a cached object is ignored", after.cached == before.cached);
+}
+
+/**
+ * @brief Тест выровненного выделения
+ */
+void test_heap_align(void) {
+    print_string("\n=== Aligned kmalloc Test ===\n");
+    
+    uint8_t *filler = (uint8_t*)kmalloc(24);
+    uint8_t *page = (uint8_t*)kmalloc_aligned(300, PAGE_SIZE);
+    test_check("Page-aligned allocation", page && ((uint32_t)page & (PAGE_SIZE - 1)) == 0);
+    
+    /* Объект в строках кэша начинается и кончается на их границе */
+    uint8_t *line = (uint8_t*)kmalloc_flags(40, KMALLOC_CACHELINE);
+    uint8_t *next = (uint8_t*)kmalloc(16);
+    test_check("Cache-line allocation", line && ((uint32_t)line & (HEAP_CACHE_LINE - 1)) == 0 &&
+               (next < line || next >= line + HEAP_CACHE_LINE));
+    
+    /* Перенос при росте сохраняет выравнивание и данные */
+    if (line) {
+        line[0] = 0x3C;
+    }
+    uint8_t *grown = (uint8_t*)krealloc(line, 2000);
+    test_check("krealloc keeps alignment", grown && ((uint32_t)grown & (HEAP_CACHE_LINE - 1)) == 0 &&
+               grown[0] == 0x3C);
+    test_check("Invalid alignment rejected", kmalloc_aligned(64, 48) == NULL);
+    
+    kfree(next);
+    kfree(grown ? grown : line);
+    kfree(page);
+    kfree(filler);
+}
+
+/**
+ * @brief Заголовок блока кучи по указателю на данные
+ */
+static heap_block_t* test_block(void *ptr) {
+    return (heap_block_t*)((uint8_t*)ptr - sizeof(heap_block_t));
+}
+
+/**
+ * @brief Самое крупное место метки HEAP_TAG_TEST и порядок отчета
+ * @param sorted Выход: места идут по убыванию живых байт
+ */
+static const heapprof_site_t* test_heapprof_top(int *sorted) {
+    uint32_t count;
+    const heapprof_site_t *sites = heapprof_sorted_sites(&count);
+    const heapprof_site_t *top = NULL;
+    
+    *sorted = 1;
+    for (uint32_t i = 0; i < count; i++) {
+        if (i && sites[i - 1].counts.live_bytes < sites[i].counts.live_bytes) {
+            *sorted = 0;
+        }
+        if (!top && sites[i].tag == HEAP_TAG_TEST) {
+            top = &sites[i];
+        }
+    }
+    return top;
+}
+
+/**
+ * @brief Тест профилировщика кучи
+ */
+void test_heapprof(void) {
+    print_string("\n=== Heap Profiler Test ===\n");
+    
+    /* Без выборки учитывается каждое выделение со своей меткой */
+    heapprof_enable(1);
+    uint8_t *small = (uint8_t*)kmalloc_flags(100, KMALLOC_TAG(HEAP_TAG_TEST));
+    uint8_t *big[2];
+    for (int i = 0; i < 2; i++) {
+        big[i] = (uint8_t*)kmalloc_flags(300, KMALLOC_TAG(HEAP_TAG_TEST));
+    }
+    if (!small || !big[0] || !big[1]) {
+        print_string_color("Failed to allocate memory!\n", COLOR_RED, COLOR_BLACK);
+        heapprof_disable();
+        return;
+    }
+    uint32_t big_bytes = test_block(big[0])->size + test_block(big[1])->size;
+    
+    heapprof_counts_t counts;
+    heapprof_tag_counts(HEAP_TAG_TEST, &counts);
+    test_check("Tag counts live bytes", counts.live_bytes == test_block(small)->size + big_bytes &&
+               counts.live_objects == 3 && counts.allocs == 3);
+    
+    int sorted;
+    const heapprof_site_t *top = test_heapprof_top(&sorted);
+    test_check("Site counts live bytes", top && top->counts.live_bytes == big_bytes &&
+               top->counts.live_objects == 2);
+    test_check("Sites sorted by live bytes", sorted);
+    
+    /* Перенесенная копия остается за той же меткой */
+    small = (uint8_t*)krealloc(small, 1000);
+    heapprof_tag_counts(HEAP_TAG_TEST, &counts);
+    test_check("krealloc keeps the tag", small && test_block(small)->tag == HEAP_TAG_TEST &&
+               counts.live_bytes == test_block(small)->size + big_bytes);
+    
+    kfree(small);
+    kfree(big[0]);
+    kfree(big[1]);
+    heapprof_tag_counts(HEAP_TAG_TEST, &counts);
+    top = test_heapprof_top(&sorted);
+    test_check("Free returns live bytes to zero", counts.live_bytes == 0 && counts.live_objects == 0 &&
+               top && top->counts.live_bytes == 0);
+    
+    /* С шагом выборки учитывается одно выделение на шаг байт */
+    heapprof_enable(HEAPPROF_SAMPLE_RATE);
+    void *objects[HEAPPROF_SAMPLE_RATE / 64];
+    uint32_t sampled = 0;
+    for (uint32_t i = 0; i < HEAPPROF_SAMPLE_RATE / 64; i++) {
+        objects[i] = kmalloc(64);
+        if (objects[i] && test_block(objects[i])->prof_site) {
+            sampled++;
+        }
+    }
+    for (uint32_t i = 0; i < HEAPPROF_SAMPLE_RATE / 64; i++) {
+        kfree(objects[i]);
+    }
+    test_check("Sampling every 4096 bytes", sampled >= 1 && sampled <= 2);
+    
+    /* Метка неучтенного блока тоже переходит к копии */
+    uint8_t *moved = (uint8_t*)kmalloc_flags(40, KMALLOC_TAG(HEAP_TAG_TEST));
+    moved = (uint8_t*)krealloc(moved, 2000);
+    test_check("krealloc keeps the tag of an unsampled block", moved && test_block(moved)->tag == HEAP_TAG_TEST);
+    kfree(moved);
+    heapprof_disable();
+}
+
 /**
  * @brief Запуск всех тестов менеджера памяти
  */
@@ -129,6 +444,12 @@ void run_memory_tests(void) {
     
     test_pmm();
     test_heap();
+    test_cow();
+    test_kmap();
+    test_numa_fallback();
+    test_magazines();
+    test_heap_align();
+    test_heapprof();
     
     print_string("\nMemory Manager Tests Completed!\n");
 } 
\ No newline at end of file
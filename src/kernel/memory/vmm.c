@@ -0,0 +1,1094 @@
+/**
+ * @file vmm.c
+ * @brief Страничная адресация и отображение виртуальной памяти
+ *
+ * Таблица указателей на каталоги (PDPT) и четыре каталога PAE общие
+ * для всех процессоров. Элементы PDPT процессор читает при загрузке
+ * CR3, поэтому все четыре каталога существуют с самого начала и не
+ * меняются. Таблицы страниц выделяются из нижней памяти PMM и видны
+ * ядру через прямое отображение (phys_to_virt()). Кадры данных
+ * берутся из любой памяти и заполняются через kmap_atomic().
+ *
+ * Загрузочный код (boot.asm) включает страничную адресацию на
+ * временных таблицах, где нижний гигабайт отображен и тождественно,
+ * и в верхнюю половину. vmm_init() строит постоянные таблицы без
+ * тождественного отображения; временные остаются для трамплина
+ * прикладных процессоров.
+ *
+ * Сброс TLB на других процессорах: инициатор публикует диапазон,
+ * маску адресатов и посылает им IPI, затем ждет, пока каждый сбросит
+ * свои элементы и снимет бит. Пока процессор ждет блокировку запроса
+ * или ответы, он сам обслуживает адресованный ему запрос - иначе два
+ * инициатора с запрещенными прерываниями ждали бы друг друга вечно.
+ *
+ * Окно ядра делится на области (vmm_alloc()). Кадр для страницы
+ * области выделяется обработчиком Page Fault при первом обращении,
+ * поэтому большая резервация стоит памяти только за тронутые страницы.
+ * Чтение нетронутой страницы отображает общую нулевую страницу только
+ * для чтения с PG_COW; запись в такую страницу (или в кадр, общий
+ * с копией области после vmm_clone()) получает собственный кадр.
+ */
+
+#include "vmm.h"
+#include "memory.h"
+#include "numa.h"
+#include "pat.h"
+#include "../apic/apic.h"
+#include "../cpu/cpu.h"
+#include "../cpu/percpu.h"
+#include "../idt/irq.h"
+#include "../sync/spinlock.h"
+#include "../video/video.h"
+#include "../lib/compiler.h"
+
+/* Границы секций образа ядра (linker.ld) */
+extern uint8_t _text_start[], _text_end[];
+extern uint8_t _rodata_start[], _rodata_end[];
+extern uint8_t _data_start[], _kernel_end[];
+
+/* Таблица указателей на каталоги и каталоги страниц (подряд) */
+static pte_t vmm_pdpt[VMM_PDPT_ENTRIES] __attribute__((aligned(32)));
+static pte_t vmm_page_dirs[VMM_PDPT_ENTRIES * VMM_PT_ENTRIES] __attribute__((aligned(PAGE_SIZE)));
+
+/* Состояние */
+static int paging_enabled = 0;
+static int directory_built = 0;
+static int global_pages = 0;
+static int nx_enabled = 0;
+
+/* Блокировка каталога и таблиц */
+static spinlock_t vmm_lock = SPINLOCK_INIT;
+
+/* Процессоры с включенной страничной адресацией */
+static volatile uint32_t vmm_cpu_mask = 0;
+
+/* Текущий запрос сброса TLB */
+static spinlock_t shootdown_lock = SPINLOCK_INIT;
+static volatile uint32_t shootdown_start;
+static volatile uint32_t shootdown_pages;
+static volatile uint32_t shootdown_pending;
+
+/* Области окна ядра по возрастанию адреса и запас свободных описателей */
+static vmm_region_t vmm_region_pool[VMM_REGIONS];
+static vmm_region_t *vmm_regions = NULL;
+static vmm_region_t *vmm_region_free = NULL;
+
+/* Общая нулевая страница */
+static phys_addr_t zero_frame = 0;
+
+/* Таблица окна kmap и занятые слоты каждого процессора */
+static pte_t *kmap_ptes = NULL;
+static uint32_t kmap_depth[MAX_CPUS];
+static uint32_t kmap_irq_flags[MAX_CPUS][VMM_KMAP_SLOTS];
+
+static vmm_stats_t vmm_stats;
+
+/**
+ * @brief Полный сброс TLB текущего процессора, включая глобальные страницы
+ */
+static void vmm_flush_all_local(void) {
+    if (global_pages) {
+        uint32_t cr4 = read_cr4();
+        write_cr4(cr4 & ~CR4_PGE);
+        write_cr4(cr4);
+    } else {
+        write_cr3(read_cr3());
+    }
+}
+
+/**
+ * @brief Сброс TLB диапазона на текущем процессоре
+ */
+static void vmm_flush_local(uint32_t virt, uint32_t pages) {
+    if (pages >= VMM_FLUSH_ALL_PAGES) {
+        vmm_flush_all_local();
+        return;
+    }
+    for (uint32_t i = 0; i < pages; i++) {
+        invlpg(virt + i * PAGE_SIZE);
+    }
+}
+
+/**
+ * @brief Выполнение запроса сброса, адресованного текущему процессору
+ */
+static void vmm_shootdown_ack(void) {
+    uint32_t bit = 1u << cpu_current();
+    
+    if (shootdown_pending & bit) {
+        vmm_flush_local(shootdown_start, shootdown_pages);
+        __sync_fetch_and_and(&shootdown_pending, ~bit);
+    }
+}
+
+/**
+ * @brief Обработчик IPI сброса TLB
+ */
+static irq_return_t vmm_shootdown_handler(void *ctx) {
+    (void)ctx;
+    vmm_shootdown_ack();
+    return IRQ_HANDLED;
+}
+
+/**
+ * @brief Сброс TLB для диапазона на всех процессорах
+ */
+void vmm_flush_range(uint32_t virt, uint32_t pages) {
+    if (!paging_enabled || !pages) {
+        return;
+    }
+    
+    uint32_t flags = cpu_irq_save();
+    uint32_t me = cpu_current();
+    
+    vmm_flush_local(virt, pages);
+    if (pages >= VMM_FLUSH_ALL_PAGES) {
+        vmm_stats.full_flushes++;
+    }
+    
+    uint32_t targets = vmm_cpu_mask & ~(1u << me);
+    if (targets && apic_enabled()) {
+        while (!spin_trylock(&shootdown_lock)) {
+            vmm_shootdown_ack();
+            __asm__ volatile("pause");
+        }
+        
+        shootdown_start = virt;
+        shootdown_pages = pages;
+        __asm__ volatile("" : : : "memory");
+        shootdown_pending = targets;
+        vmm_stats.shootdowns++;
+        
+        for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++) {
+            if (targets & (1u << cpu)) {
+                lapic_send_ipi(cpu_locals[cpu].apic_id, LAPIC_ICR_FIXED | VMM_SHOOTDOWN_VECTOR);
+                vmm_stats.shootdown_ipis++;
+            }
+        }
+        
+        while (shootdown_pending) {
+            __asm__ volatile("pause");
+        }
+        spin_unlock(&shootdown_lock);
+    }
+    
+    cpu_irq_restore(flags);
+}
+
+/**
+ * @brief Запись элемента таблицы
+ *
+ * Элемент PAE пишется двумя 32-битными половинами. Младшая половина
+ * с битом присутствия обнуляется первой и записывается последней,
+ * так что обход таблиц на другом процессоре не соберет адрес из
+ * старой и новой половин.
+ */
+static void vmm_set_pte(pte_t *pte, pte_t value) {
+    volatile uint32_t *half = (volatile uint32_t*)pte;
+    half[0] = 0;
+    half[1] = (uint32_t)(value >> 32);
+    half[0] = (uint32_t)value;
+}
+
+/**
+ * @brief Элемент таблицы для кадра
+ * @param flags VMM_* флаги: без VMM_EXEC страница получает NX
+ *
+ * VMM_CACHE_WC выбирает запись 4 PAT битом PG_PAT, поэтому годится
+ * только для страниц 4 КБ (в каталоге этот бит - PG_LARGE).
+ */
+static pte_t vmm_make_pte(phys_addr_t phys, uint32_t flags) {
+    pte_t pte = (phys & PG_ADDR_MASK) | (flags & PG_FLAGS & ~PG_LARGE) | PG_PRESENT;
+    if (flags & VMM_CACHE_WC) {
+        pte &= ~(pte_t)(PG_PCD | PG_PWT);
+        pte |= pat_enabled() ? PG_PAT : PG_PCD;
+    }
+    if (nx_enabled && !(flags & VMM_EXEC)) {
+        pte |= PG_NX;
+    }
+    return pte;
+}
+
+/**
+ * @brief Временное отображение кадра
+ */
+__hot void* kmap_atomic(phys_addr_t phys) {
+    if (phys < VMM_DIRECT_SIZE) {
+        return phys_to_virt(phys);
+    }
+    if (!paging_enabled) {
+        return NULL;
+    }
+    
+    uint32_t flags = cpu_irq_save();
+    uint32_t cpu = cpu_current();
+    uint32_t slot = kmap_depth[cpu];
+    if (slot >= VMM_KMAP_SLOTS) {
+        cpu_irq_restore(flags);
+        return NULL;
+    }
+    kmap_depth[cpu] = slot + 1;
+    kmap_irq_flags[cpu][slot] = flags;
+    
+    /* Слот принадлежит только этому процессору: ни блокировки,
+     * ни сброса TLB на остальных не нужно */
+    uint32_t virt = VMM_KMAP_BASE + (cpu * VMM_KMAP_SLOTS + slot) * PAGE_SIZE;
+    vmm_set_pte(&kmap_ptes[VMM_PTE_INDEX(virt)], vmm_make_pte(phys, VMM_WRITE));
+    invlpg(virt);
+    vmm_stats.kmaps++;
+    
+    return (void*)(virt + (uint32_t)(phys & ~PAGE_MASK));
+}
+
+/**
+ * @brief Снятие временного отображения
+ */
+__hot void kunmap_atomic(void *addr) {
+    uint32_t virt = (uint32_t)addr & PAGE_MASK;
+    
+    if (virt < VMM_KMAP_BASE || virt >= VMM_KMAP_BASE + MAX_CPUS * VMM_KMAP_SLOTS * PAGE_SIZE) {
+        return;
+    }
+    
+    uint32_t cpu = cpu_current();
+    uint32_t slot = --kmap_depth[cpu];
+    vmm_set_pte(&kmap_ptes[VMM_PTE_INDEX(virt)], 0);
+    invlpg(virt);
+    cpu_irq_restore(kmap_irq_flags[cpu][slot]);
+}
+
+/**
+ * @brief Выделение кадра с копией другого кадра или обнуленного
+ * @param virt Страница, на которую будет отображен кадр
+ * @param src Копируемый кадр или 0
+ * @return Физический адрес или 0
+ *
+ * Кадр берется на узле NUMA текущего процессора: так куча и стеки
+ * потоков оказываются в памяти того процессора, который их тронул или
+ * создал. С раскраской кадр берется цвета виртуальной страницы
+ * (соседние страницы области попадают в разные наборы кэша) без
+ * учета узла.
+ */
+static phys_addr_t vmm_alloc_frame(uint32_t virt, phys_addr_t src) {
+    phys_addr_t frame = physical_memory_manager.colouring ?
+                        pmm_alloc_frame_colour(virt >> PAGE_SHIFT) : pmm_alloc_frame_node(numa_local_node());
+    if (!frame) {
+        return 0;
+    }
+    
+    /* Кадр верхней памяти заполняется через окно kmap */
+    void *dst = kmap_atomic(frame);
+    if (!dst) {
+        pmm_free_page(frame);
+        return 0;
+    }
+    if (src) {
+        void *from = kmap_atomic(src);
+        memory_copy(dst, from, PAGE_SIZE);
+        kunmap_atomic(from);
+    } else {
+        memory_set(dst, 0, PAGE_SIZE);
+    }
+    kunmap_atomic(dst);
+    return frame;
+}
+
+/**
+ * @brief Учет нового отображения кадра области (под vmm_lock)
+ */
+static void vmm_frame_mapped(phys_addr_t frame) {
+    page_t *page = pmm_page(frame);
+    if (page) {
+        page->mapcount++;
+    }
+}
+
+/**
+ * @brief Учет снятого отображения кадра области (под vmm_lock)
+ */
+static void vmm_frame_unmapped(phys_addr_t frame) {
+    page_t *page = pmm_page(frame);
+    if (page && page->mapcount) {
+        page->mapcount--;
+    }
+}
+
+/**
+ * @brief Выделение обнуленной таблицы страниц в нижней памяти
+ * @return Физический адрес или 0
+ */
+static uint32_t vmm_alloc_table(void) {
+    uint32_t table = pmm_alloc_page();
+    if (table) {
+        memory_set(phys_to_virt(table), 0, PAGE_SIZE);
+        vmm_stats.page_tables++;
+    }
+    return table;
+}
+
+/**
+ * @brief Разбиение страницы 2 МБ на таблицу из страниц 4 КБ
+ * @param pde Элемент каталога с PG_LARGE
+ * @return 0 при успехе, -1 если нет памяти
+ *
+ * Отображение не меняется, атрибуты переходят в каждый элемент таблицы.
+ */
+static int vmm_split_large(pte_t *pde) {
+    uint32_t table = vmm_alloc_table();
+    if (!table) {
+        return -1;
+    }
+    
+    phys_addr_t base = *pde & PG_ADDR_MASK & ~(phys_addr_t)(VMM_LARGE_PAGE_SIZE - 1);
+    pte_t attrs = *pde & (PG_PRESENT | PG_WRITE | PG_USER | PG_PWT | PG_PCD | PG_GLOBAL | PG_NX);
+    if (*pde & PG_LARGE_PAT) {
+        attrs |= PG_PAT;
+    }
+    pte_t *entries = (pte_t*)phys_to_virt(table);
+    for (uint32_t i = 0; i < VMM_PT_ENTRIES; i++) {
+        entries[i] = (base + i * PAGE_SIZE) | attrs;
+    }
+    
+    vmm_set_pte(pde, table | PG_PRESENT | PG_WRITE | (attrs & PG_USER));
+    vmm_stats.large_splits++;
+    return 0;
+}
+
+/**
+ * @brief Элемент таблицы для адреса (под vmm_lock)
+ * @param virt Виртуальный адрес
+ * @param create Создать таблицу или разбить большую страницу
+ * @param split Выставляется в 1, если пришлось разбить страницу 2 МБ
+ * @return Указатель на элемент или NULL
+ */
+static pte_t* vmm_get_pte(uint32_t virt, int create, int *split) {
+    pte_t *pde = &vmm_page_dirs[VMM_PDE_INDEX(virt)];
+    
+    if (!(*pde & PG_PRESENT)) {
+        if (!create) {
+            return NULL;
+        }
+        uint32_t table = vmm_alloc_table();
+        if (!table) {
+            return NULL;
+        }
+        vmm_set_pte(pde, table | PG_PRESENT | PG_WRITE);
+    } else if (*pde & PG_LARGE) {
+        if (!create || vmm_split_large(pde) != 0) {
+            return NULL;
+        }
+        *split = 1;
+    }
+    
+    return &((pte_t*)phys_to_virt(*pde & PG_ADDR_MASK))[VMM_PTE_INDEX(virt)];
+}
+
+/**
+ * @brief Отображение непрерывного диапазона с одним сбросом TLB
+ */
+int vmm_map_range(uint32_t virt, phys_addr_t phys, uint32_t pages, uint32_t flags) {
+    int result = 0;
+    int replaced = 0;
+    int split = 0;
+    
+    virt &= PAGE_MASK;
+    phys &= PG_ADDR_MASK;
+    
+    uint32_t irq_flags = spin_lock_irqsave(&vmm_lock);
+    for (uint32_t i = 0; i < pages; i++) {
+        uint32_t addr = virt + i * PAGE_SIZE;
+        pte_t *pte = vmm_get_pte(addr, 1, &split);
+        if (!pte) {
+            result = -1;
+            break;
+        }
+        if (flags & PG_USER) {
+            vmm_page_dirs[VMM_PDE_INDEX(addr)] |= PG_USER;
+        }
+        
+        replaced |= (*pte & PG_PRESENT) != 0;
+        vmm_set_pte(pte, vmm_make_pte(phys + (phys_addr_t)i * PAGE_SIZE, flags));
+        vmm_stats.mapped++;
+    }
+    spin_unlock_irqrestore(&vmm_lock, irq_flags);
+    
+    /* Отсутствующие элементы в TLB не кэшируются: новое
+     * отображение сброса не требует, замена и разбиение - требуют */
+    if (split) {
+        vmm_flush_range(virt, VMM_FLUSH_ALL_PAGES);
+    } else if (replaced) {
+        vmm_flush_range(virt, pages);
+    }
+    return result;
+}
+
+/**
+ * @brief Отображение страницы 4 КБ
+ */
+int vmm_map(uint32_t virt, phys_addr_t phys, uint32_t flags) {
+    return vmm_map_range(virt, phys, 1, flags);
+}
+
+/**
+ * @brief Удаление отображений диапазона
+ * @return Количество удаленных отображений
+ */
+static uint32_t vmm_unmap_pages(uint32_t virt, uint32_t pages) {
+    uint32_t removed = 0;
+    int split = 0;
+    
+    virt &= PAGE_MASK;
+    
+    uint32_t irq_flags = spin_lock_irqsave(&vmm_lock);
+    for (uint32_t i = 0; i < pages; i++) {
+        uint32_t addr = virt + i * PAGE_SIZE;
+        pte_t pde = vmm_page_dirs[VMM_PDE_INDEX(addr)];
+        
+        /* Пустую таблицу пропускаем целиком */
+        if (!(pde & PG_PRESENT)) {
+            uint32_t next = (addr & ~(VMM_LARGE_PAGE_SIZE - 1)) + VMM_LARGE_PAGE_SIZE;
+            i += (next - addr) / PAGE_SIZE - 1;
+            continue;
+        }
+        
+        pte_t *pte = vmm_get_pte(addr, (pde & PG_LARGE) != 0, &split);
+        if (pte && (*pte & PG_PRESENT)) {
+            vmm_set_pte(pte, 0);
+            removed++;
+        }
+    }
+    vmm_stats.unmapped += removed;
+    spin_unlock_irqrestore(&vmm_lock, irq_flags);
+    
+    if (split) {
+        vmm_flush_range(virt, VMM_FLUSH_ALL_PAGES);
+    } else if (removed) {
+        vmm_flush_range(virt, pages);
+    }
+    return removed;
+}
+
+/**
+ * @brief Удаление отображения страницы 4 КБ
+ */
+int vmm_unmap(uint32_t virt) {
+    return vmm_unmap_pages(virt, 1) ? 0 : -1;
+}
+
+/**
+ * @brief Удаление отображений диапазона с одним сбросом TLB
+ */
+void vmm_unmap_range(uint32_t virt, uint32_t pages) {
+    vmm_unmap_pages(virt, pages);
+}
+
+/**
+ * @brief Перевод виртуального адреса в физический
+ */
+int vmm_translate(uint32_t virt, phys_addr_t *phys) {
+    if (!directory_built) {
+        *phys = virt_to_phys((void*)virt);
+        return 0;
+    }
+    
+    pte_t pde = vmm_page_dirs[VMM_PDE_INDEX(virt)];
+    if (!(pde & PG_PRESENT)) {
+        return -1;
+    }
+    if (pde & PG_LARGE) {
+        *phys = (pde & PG_ADDR_MASK & ~(phys_addr_t)(VMM_LARGE_PAGE_SIZE - 1)) |
+                (virt & (VMM_LARGE_PAGE_SIZE - 1));
+        return 0;
+    }
+    
+    pte_t pte = ((pte_t*)phys_to_virt(pde & PG_ADDR_MASK))[VMM_PTE_INDEX(virt)];
+    if (!(pte & PG_PRESENT)) {
+        return -1;
+    }
+    *phys = (pte & PG_ADDR_MASK) | (virt & ~PAGE_MASK);
+    return 0;
+}
+
+/**
+ * @brief Отображение памяти устройства в собственную область окна ядра
+ * @param cache VMM_CACHE_*
+ */
+static void* vmm_map_io(phys_addr_t phys, uint32_t size, uint32_t cache) {
+    phys_addr_t start = phys & ~(phys_addr_t)(PAGE_SIZE - 1);
+    uint32_t offset = (uint32_t)(phys - start);
+    uint32_t pages = (offset + size + PAGE_SIZE - 1) / PAGE_SIZE;
+    
+    if (!size) {
+        return NULL;
+    }
+    
+    uint32_t virt = (uint32_t)vmm_alloc(pages * PAGE_SIZE, VMM_RESERVE, "mmio");
+    if (!virt) {
+        return NULL;
+    }
+    if (vmm_map_range(virt, start, pages, VMM_WRITE | VMM_GLOBAL | cache) != 0) {
+        vmm_free((void*)virt);
+        return NULL;
+    }
+    return (void*)(virt + offset);
+}
+
+/**
+ * @brief Отображение регистров устройства в окно ядра
+ *
+ * Тип UC в PAT отменил бы WC из MTRR, поэтому такие диапазоны
+ * получают UC-.
+ */
+void* vmm_map_mmio(phys_addr_t phys, uint32_t size) {
+    uint32_t cache = (mtrr_type(phys, size) == MEM_TYPE_WC) ? VMM_CACHE_UC_MINUS : VMM_CACHE_UC;
+    return vmm_map_io(phys, size, cache);
+}
+
+/**
+ * @brief Отображение кадрового буфера или другой памяти устройства
+ */
+void* vmm_map_framebuffer(phys_addr_t phys, uint32_t size) {
+    return vmm_map_io(phys, size, VMM_CACHE_WC);
+}
+
+/**
+ * @brief Поиск области, содержащей адрес (под vmm_lock)
+ */
+static vmm_region_t* vmm_find_region(uint32_t virt) {
+    for (vmm_region_t *region = vmm_regions; region && region->start <= virt; region = region->next) {
+        if (virt < region->end) {
+            return region;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Отображение страницы области при первом обращении (под vmm_lock)
+ * @param write Обращение на запись: нужен собственный кадр
+ * @return 0 если страница отображена, -1 если нет памяти
+ */
+static int vmm_populate(vmm_region_t *region, uint32_t page, int write) {
+    int split = 0;
+    pte_t *pte = vmm_get_pte(page, 1, &split);
+    if (!pte) {
+        return -1;
+    }
+    
+    /* Другой процессор мог разрешить тот же промах раньше */
+    if (*pte & PG_PRESENT) {
+        return 0;
+    }
+    
+    if (!write && zero_frame) {
+        uint32_t cow = (region->flags & VMM_WRITE) ? PG_COW : 0;
+        vmm_set_pte(pte, vmm_make_pte(zero_frame, region->flags & ~PG_WRITE) | cow);
+        vmm_stats.zero_maps++;
+        return 0;
+    }
+    
+    phys_addr_t frame = vmm_alloc_frame(page, 0);
+    if (!frame) {
+        return -1;
+    }
+    vmm_set_pte(pte, vmm_make_pte(frame, region->flags));
+    vmm_frame_mapped(frame);
+    region->committed++;
+    return 0;
+}
+
+/**
+ * @brief Запись в страницу с PG_COW (под vmm_lock)
+ * @param old Выход: кадр, с которого снята ссылка области (0 - нет)
+ * @return 0 если страница доступна на запись, -1 если нет памяти
+ *
+ * Единственный владелец кадра просто получает право записи. Иначе
+ * содержимое копируется в новый кадр; нулевая страница не копируется.
+ */
+static int vmm_break_cow(vmm_region_t *region, uint32_t page, pte_t *pte, phys_addr_t *old) {
+    phys_addr_t frame = *pte & PG_ADDR_MASK;
+    
+    if (frame != zero_frame && page_refcount(frame) == 1) {
+        vmm_set_pte(pte, (*pte | PG_WRITE) & ~(pte_t)PG_COW);
+        invlpg(page);
+        vmm_stats.cow_reused++;
+        return 0;
+    }
+    
+    phys_addr_t copy = vmm_alloc_frame(page, frame == zero_frame ? 0 : frame);
+    if (!copy) {
+        return -1;
+    }
+    vmm_set_pte(pte, vmm_make_pte(copy, region->flags));
+    invlpg(page);
+    vmm_frame_mapped(copy);
+    
+    if (frame == zero_frame) {
+        region->committed++;
+    } else {
+        vmm_frame_unmapped(frame);
+        *old = frame;
+        vmm_stats.cow_copies++;
+    }
+    return 0;
+}
+
+/**
+ * @brief Резервирование области в окне ядра
+ */
+void* vmm_alloc(uint32_t size, uint32_t flags, const char *name) {
+    uint32_t pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint32_t guard = (flags & VMM_GUARD) ? 1 : 0;
+    uint32_t bytes = (pages + guard) * PAGE_SIZE;
+    
+    if (!paging_enabled || !pages || pages > VMM_KVA_SIZE / PAGE_SIZE) {
+        return NULL;
+    }
+    
+    uint32_t irq_flags = spin_lock_irqsave(&vmm_lock);
+    
+    /* Первый подходящий промежуток между областями */
+    uint32_t base = VMM_KVA_BASE;
+    vmm_region_t **link = &vmm_regions;
+    for (; *link; link = &(*link)->next) {
+        if ((*link)->start - (*link)->guard * PAGE_SIZE - base >= bytes) {
+            break;
+        }
+        base = (*link)->end;
+    }
+    
+    vmm_region_t *region = vmm_region_free;
+    if (!region || (!*link && VMM_KVA_BASE + VMM_KVA_SIZE - base < bytes)) {
+        spin_unlock_irqrestore(&vmm_lock, irq_flags);
+        return NULL;
+    }
+    vmm_region_free = region->next;
+    
+    region->start = base + guard * PAGE_SIZE;
+    region->end = base + bytes;
+    region->guard = guard;
+    region->flags = flags;
+    region->committed = 0;
+    region->name = name;
+    region->next = *link;
+    *link = region;
+    
+    int result = 0;
+    if ((flags & VMM_COMMIT) && !(flags & VMM_RESERVE)) {
+        for (uint32_t page = region->start; page < region->end && result == 0; page += PAGE_SIZE) {
+            result = vmm_populate(region, page, 1);
+        }
+    }
+    spin_unlock_irqrestore(&vmm_lock, irq_flags);
+    
+    if (result != 0) {
+        vmm_free((void*)region->start);
+        return NULL;
+    }
+    return (void*)region->start;
+}
+
+/**
+ * @brief Освобождение области вместе с ее кадрами
+ *
+ * Отображения снимаются порциями: ссылки на кадры порции снимаются
+ * только после сброса TLB на всех процессорах.
+ */
+void vmm_free(void *addr) {
+    uint32_t virt = (uint32_t)addr;
+    phys_addr_t frames[VMM_FLUSH_ALL_PAGES];
+    
+    uint32_t irq_flags = spin_lock_irqsave(&vmm_lock);
+    vmm_region_t *region = vmm_find_region(virt);
+    spin_unlock_irqrestore(&vmm_lock, irq_flags);
+    if (!region || region->start != virt) {
+        return;
+    }
+    
+    uint32_t page = region->start;
+    while (page < region->end) {
+        uint32_t batch = page;
+        uint32_t count = 0;
+        uint32_t removed = 0;
+        int split = 0;
+        
+        irq_flags = spin_lock_irqsave(&vmm_lock);
+        for (; page < region->end && count < VMM_FLUSH_ALL_PAGES; page += PAGE_SIZE) {
+            pte_t *pte = vmm_get_pte(page, 0, &split);
+            if (!pte || !(*pte & PG_PRESENT)) {
+                continue;
+            }
+            phys_addr_t frame = *pte & PG_ADDR_MASK;
+            if (!(region->flags & VMM_RESERVE) && frame != zero_frame) {
+                vmm_frame_unmapped(frame);
+                frames[count++] = frame;
+                region->committed--;
+            }
+            vmm_set_pte(pte, 0);
+            removed++;
+        }
+        spin_unlock_irqrestore(&vmm_lock, irq_flags);
+        
+        if (removed) {
+            vmm_flush_range(batch, (page - batch) / PAGE_SIZE);
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            page_put(frames[i]);
+        }
+    }
+    
+    irq_flags = spin_lock_irqsave(&vmm_lock);
+    for (vmm_region_t **link = &vmm_regions; *link; link = &(*link)->next) {
+        if (*link == region) {
+            *link = region->next;
+            break;
+        }
+    }
+    region->next = vmm_region_free;
+    vmm_region_free = region;
+    spin_unlock_irqrestore(&vmm_lock, irq_flags);
+}
+
+/**
+ * @brief Копия области с общими кадрами
+ */
+void* vmm_clone(void *addr, const char *name) {
+    uint32_t irq_flags = spin_lock_irqsave(&vmm_lock);
+    vmm_region_t *src = vmm_find_region((uint32_t)addr);
+    if (!src || src->start != (uint32_t)addr || (src->flags & VMM_RESERVE)) {
+        spin_unlock_irqrestore(&vmm_lock, irq_flags);
+        return NULL;
+    }
+    uint32_t size = src->end - src->start;
+    uint32_t flags = src->flags & ~VMM_COMMIT;
+    spin_unlock_irqrestore(&vmm_lock, irq_flags);
+    
+    vmm_region_t *dst_region = NULL;
+    uint32_t dst = (uint32_t)vmm_alloc(size, flags, name);
+    if (!dst) {
+        return NULL;
+    }
+    
+    /* Доступные на запись кадры становятся PG_COW в обеих областях */
+    int result = 0;
+    int split = 0;
+    uint32_t cow = (flags & VMM_WRITE) ? PG_COW : 0;
+    irq_flags = spin_lock_irqsave(&vmm_lock);
+    dst_region = vmm_find_region(dst);
+    for (uint32_t offset = 0; offset < size && result == 0; offset += PAGE_SIZE) {
+        pte_t *src_pte = vmm_get_pte((uint32_t)addr + offset, 0, &split);
+        if (!src_pte || !(*src_pte & PG_PRESENT)) {
+            continue;
+        }
+        pte_t *dst_pte = vmm_get_pte(dst + offset, 1, &split);
+        if (!dst_pte) {
+            result = -1;
+            break;
+        }
+        
+        phys_addr_t frame = *src_pte & PG_ADDR_MASK;
+        vmm_set_pte(src_pte, (*src_pte & ~(pte_t)PG_WRITE) | cow);
+        vmm_set_pte(dst_pte, *src_pte);
+        if (frame != zero_frame) {
+            page_get(frame);
+            vmm_frame_mapped(frame);
+            dst_region->committed++;
+        }
+    }
+    spin_unlock_irqrestore(&vmm_lock, irq_flags);
+    
+    /* Исходная область потеряла право записи */
+    vmm_flush_range((uint32_t)addr, size / PAGE_SIZE);
+    
+    if (result != 0) {
+        vmm_free((void*)dst);
+        return NULL;
+    }
+    return (void*)dst;
+}
+
+/**
+ * @brief Обработка Page Fault
+ */
+__hot int vmm_handle_fault(uint32_t addr, uint32_t err_code) {
+    if (!paging_enabled) {
+        return -1;
+    }
+    
+    int result = -1;
+    int split = 0;
+    phys_addr_t old = 0;
+    uint32_t page = addr & PAGE_MASK;
+    uint32_t irq_flags = spin_lock_irqsave(&vmm_lock);
+    
+    /* Выборка инструкции из области без VMM_EXEC - нарушение NX */
+    vmm_region_t *region = vmm_find_region(addr);
+    if (region && !(region->flags & VMM_RESERVE) &&
+        (!(err_code & PF_WRITE) || (region->flags & VMM_WRITE)) &&
+        (!(err_code & PF_FETCH) || (region->flags & VMM_EXEC))) {
+        pte_t *pte = vmm_get_pte(page, 0, &split);
+        
+        if (!(err_code & PF_PRESENT)) {
+            result = vmm_populate(region, page, err_code & PF_WRITE);
+            vmm_stats.demand_faults += result == 0;
+        } else if (pte && (*pte & PG_WRITE)) {
+            /* Право записи уже выдано на другом процессоре */
+            invlpg(page);
+            result = 0;
+        } else if (pte && (*pte & PG_COW) && (err_code & PF_WRITE)) {
+            result = vmm_break_cow(region, page, pte, &old);
+            vmm_stats.cow_faults += result == 0;
+        }
+    }
+    if (result != 0) {
+        vmm_stats.bad_faults++;
+    }
+    
+    spin_unlock_irqrestore(&vmm_lock, irq_flags);
+    
+    /* Старый кадр мог остаться в TLB других процессоров */
+    if (old) {
+        vmm_flush_range(page, 1);
+        page_put(old);
+    }
+    return result;
+}
+
+/**
+ * @brief Включение страничной адресации на текущем процессоре
+ *
+ * Процессор отмечается в маске до загрузки CR3: запрос сброса,
+ * отправленный раньше, он выполнит уже с новым каталогом.
+ */
+static void vmm_enable_cpu(void) {
+    __sync_fetch_and_or(&vmm_cpu_mask, 1u << cpu_current());
+    
+    if (nx_enabled) {
+        wrmsr(MSR_EFER, rdmsr(MSR_EFER) | EFER_NXE);
+    }
+    
+    uint32_t cr4 = read_cr4() | CR4_PAE;
+    if (global_pages) {
+        cr4 |= CR4_PGE;
+    }
+    write_cr4(cr4);
+    
+    /* PAT - до первого отображения с WC */
+    pat_init_cpu();
+    write_cr3(virt_to_phys(vmm_pdpt));
+    write_cr0(read_cr0() | CR0_PG | CR0_WP);
+}
+
+/**
+ * @brief Отображение секции образа ядра страницами 4 КБ
+ * @return Размер секции в страницах или 0 при ошибке
+ */
+static uint32_t vmm_map_section(uint8_t *start, uint8_t *end, uint32_t flags) {
+    uint32_t virt = (uint32_t)start & PAGE_MASK;
+    uint32_t pages = (align_up((uint32_t)end, PAGE_SIZE) - virt) / PAGE_SIZE;
+    
+    if (vmm_map_range(virt, virt_to_phys((void*)virt), pages, flags) != 0) {
+        return 0;
+    }
+    return pages;
+}
+
+/**
+ * @brief Построение таблиц PAE и переход на них с загрузочных таблиц
+ */
+__cold void vmm_init(void) {
+    print_string("Paging Initialization... ");
+    
+    global_pages = cpu_has_edx(CPUID_EDX_PGE);
+    nx_enabled = (cpu_info.ext_edx & CPUID_EXT_EDX_NX) && cpu_has_edx(CPUID_EDX_MSR);
+    uint32_t global = global_pages ? PG_GLOBAL : 0;
+    
+    /* Элементы PDPT не имеют битов прав: только присутствие. Каталоги
+     * нижних 3 ГБ остаются пустыми */
+    memory_set(vmm_page_dirs, 0, sizeof(vmm_page_dirs));
+    for (uint32_t i = 0; i < VMM_PDPT_ENTRIES; i++) {
+        vmm_pdpt[i] = virt_to_phys(&vmm_page_dirs[i * VMM_PT_ENTRIES]) | PG_PRESENT;
+    }
+    directory_built = 1;
+    
+    for (uint32_t i = 0; i < VMM_REGIONS; i++) {
+        vmm_region_pool[i].next = vmm_region_free;
+        vmm_region_free = &vmm_region_pool[i];
+    }
+    
+    /* Прямое отображение нижней памяти - страницами 2 МБ без исполнения */
+    for (uint32_t addr = 0; addr < VMM_DIRECT_SIZE; addr += VMM_LARGE_PAGE_SIZE) {
+        vmm_page_dirs[VMM_PDE_INDEX(KERNEL_VIRT_BASE + addr)] =
+            vmm_make_pte(addr, VMM_WRITE | global) | PG_LARGE;
+    }
+    
+    /* Секции ядра получают свои права; большие страницы под ними
+     * разбиваются, остаток прямого отображения не меняется */
+    uint32_t text = vmm_map_section(_text_start, _text_end, VMM_EXEC | global);
+    uint32_t rodata = vmm_map_section(_rodata_start, _rodata_end, global);
+    uint32_t data = vmm_map_section(_data_start, _kernel_end, VMM_WRITE | global);
+    
+    /* Таблица окна kmap создается заранее: kmap_atomic() не выделяет память */
+    int split = 0;
+    if (!text || !rodata || !data || !vmm_get_pte(VMM_KMAP_BASE, 1, &split)) {
+        directory_built = 0;
+        print_string_color("FAILED\n", COLOR_RED, COLOR_BLACK);
+        return;
+    }
+    kmap_ptes = (pte_t*)phys_to_virt(vmm_page_dirs[VMM_PDE_INDEX(VMM_KMAP_BASE)] & PG_ADDR_MASK);
+    
+    vmm_enable_cpu();
+    paging_enabled = 1;
+    
+    /* Нулевая страница не считается: ее ссылки никогда не снимаются */
+    zero_frame = vmm_alloc_frame(0, 0);
+    page_t *zero_page = pmm_page(zero_frame);
+    if (zero_page) {
+        zero_page->flags = PAGE_FLAG_RESERVED | PAGE_FLAG_ZERO;
+    }
+    
+    /* IPI сброса придут только после перехода на APIC */
+    request_vector(VMM_SHOOTDOWN_VECTOR, vmm_shootdown_handler, NULL);
+    
+    print_string_color("OK\n", COLOR_GREEN, COLOR_BLACK);
+    print_string("  - PAE, direct map: ");
+    print_dec(VMM_DIRECT_SIZE >> 20);
+    print_string(" MB at ");
+    print_hex(KERNEL_VIRT_BASE);
+    print_string(" in 2 MB pages\n");
+    print_string("  - Kernel: text ");
+    print_dec(text * 4);
+    print_string(" KB (RX), rodata ");
+    print_dec(rodata * 4);
+    print_string(" KB (R), data ");
+    print_dec(data * 4);
+    print_string(" KB (RW)\n");
+    print_string("  - No-execute (NX): ");
+    print_string(nx_enabled ? "yes\n" : "no\n");
+    print_string("  - Global kernel pages: ");
+    print_string(global_pages ? "yes\n" : "no\n");
+    print_string("  - kmap window: ");
+    print_hex(VMM_KMAP_BASE);
+    print_string(", ");
+    print_dec(VMM_KMAP_SLOTS);
+    print_string(" slots per CPU\n");
+}
+
+/**
+ * @brief Включение страничной адресации на прикладном процессоре
+ */
+void vmm_init_ap(void) {
+    if (paging_enabled) {
+        vmm_enable_cpu();
+    }
+}
+
+/**
+ * @brief Включена ли страничная адресация
+ */
+int vmm_enabled(void) {
+    return paging_enabled;
+}
+
+/**
+ * @brief Статистика страничной адресации
+ */
+const vmm_stats_t* vmm_get_stats(void) {
+    return &vmm_stats;
+}
+
+/**
+ * @brief Вывод информации о страничной адресации
+ */
+void vmm_dump_info(void) {
+    print_string("\n=== Paging ===\n");
+    if (!paging_enabled) {
+        print_string("Paging disabled\n");
+        return;
+    }
+    
+    uint32_t large = 0;
+    uint32_t tables = 0;
+    for (uint32_t i = 0; i < VMM_PDPT_ENTRIES * VMM_PT_ENTRIES; i++) {
+        pte_t pde = vmm_page_dirs[i];
+        if (pde & PG_PRESENT) {
+            if (pde & PG_LARGE) {
+                large++;
+            } else {
+                tables++;
+            }
+        }
+    }
+    
+    print_string("PDPT: ");
+    print_hex(virt_to_phys(vmm_pdpt));
+    print_string(nx_enabled ? " (PAE, NX)" : " (PAE)");
+    print_string(", 2 MB pages: ");
+    print_dec(large);
+    print_string(", page tables: ");
+    print_dec(tables);
+    print_string("\nMapped 4 KB: ");
+    print_dec(vmm_stats.mapped);
+    print_string(", unmapped: ");
+    print_dec(vmm_stats.unmapped);
+    print_string(", large splits: ");
+    print_dec(vmm_stats.large_splits);
+    print_string("\nShootdowns: ");
+    print_dec(vmm_stats.shootdowns);
+    print_string(" (");
+    print_dec(vmm_stats.shootdown_ipis);
+    print_string(" IPIs), full flushes: ");
+    print_dec(vmm_stats.full_flushes);
+    print_string("\nDemand faults: ");
+    print_dec(vmm_stats.demand_faults);
+    print_string(", invalid faults: ");
+    print_dec(vmm_stats.bad_faults);
+    print_string(", zero page maps: ");
+    print_dec(vmm_stats.zero_maps);
+    print_string("\nCOW faults: ");
+    print_dec(vmm_stats.cow_faults);
+    print_string(" (copied ");
+    print_dec(vmm_stats.cow_copies);
+    print_string(", reused ");
+    print_dec(vmm_stats.cow_reused);
+    print_string(")\nkmap_atomic: ");
+    print_dec(vmm_stats.kmaps);
+    print_string("\n");
+    pat_dump_info();
+    
+    /* Крупнейшая область копируется: после снятия блокировки
+     * ее описатель может быть освобожден */
+    vmm_region_t largest = { 0 };
+    uint32_t regions = 0;
+    uint32_t reserved = 0;
+    uint32_t committed = 0;
+    uint32_t irq_flags = spin_lock_irqsave(&vmm_lock);
+    for (vmm_region_t *region = vmm_regions; region; region = region->next) {
+        regions++;
+        reserved += (region->end - region->start) / PAGE_SIZE;
+        committed += region->committed;
+        if (region->end - region->start > largest.end - largest.start) {
+            largest = *region;
+        }
+    }
+    spin_unlock_irqrestore(&vmm_lock, irq_flags);
+    
+    print_string("Regions: ");
+    print_dec(regions);
+    print_string(", reserved: ");
+    print_dec(reserved * 4);
+    print_string(" KB, committed: ");
+    print_dec(committed * 4);
+    print_string(" KB\n");
+    if (regions) {
+        print_string("Largest: '");
+        print_string(largest.name);
+        print_string("' at ");
+        print_hex(largest.start);
+        print_string(", ");
+        print_dec((largest.end - largest.start) >> 10);
+        print_string(" KB reserved, ");
+        print_dec(largest.committed * 4);
+        print_string(" KB committed\n");
+    }
+}
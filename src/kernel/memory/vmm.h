@@ -0,0 +1,318 @@
+/**
+ * @file vmm.h
+ * @brief Страничная адресация и отображение виртуальной памяти
+ *
+ * Таблицы трехуровневые (PAE) с 64-битными элементами: физический
+ * адрес кадра может лежать выше 4 ГБ, а бит 63 (NX) запрещает
+ * исполнение. Ядро работает в верхней половине: с KERNEL_VIRT_BASE
+ * страницами 2 МБ отображена нижняя память PMM (прямое отображение),
+ * так что таблицы страниц и данные ядра занимают в TLB считанные
+ * элементы. Секции образа ядра отображены страницами 4 КБ со своими
+ * правами: код - только чтение и исполнение, константы - только
+ * чтение, данные - чтение и запись без исполнения. Отображения ядра
+ * глобальные (PGE) и не сбрасываются при перезагрузке CR3. Нижние
+ * 3 ГБ не отображены и оставлены будущим адресным пространствам
+ * процессов. Регистры устройств отображаются в окно ядра страницами
+ * 4 КБ без кэширования, кадровые буферы - с объединением записей (WC).
+ *
+ * Кадры верхней памяти не имеют постоянного адреса. Ядро обращается
+ * к ним через окно kmap_atomic(): у каждого процессора несколько
+ * своих слотов, отображение живет до kunmap_atomic() с запрещенными
+ * прерываниями и сбрасывается только в локальном TLB.
+ *
+ * vmm_map()/vmm_unmap() работают со страницами 4 КБ; попадание
+ * в большую страницу разбивает ее на таблицу. Изменение или удаление
+ * отображения сбрасывает TLB только для затронутых страниц - локально
+ * инструкцией invlpg и на остальных процессорах через IPI.
+ *
+ * Окно ядра раздается областями vmm_alloc(). Память области
+ * выделяется лениво: первое обращение к странице вызывает Page Fault,
+ * и обработчик отображает на нее обнуленный кадр. Чтение отображает
+ * общую нулевую страницу, и кадр появляется только при записи.
+ * Кадры считаются в базе кадров (page_t), поэтому копия области
+ * (vmm_clone()) разделяет их с оригиналом до первой записи.
+ * Обращение вне областей и нарушение прав останавливают систему.
+ */
+
+#ifndef KERNEL_VMM_H
+#define KERNEL_VMM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "memory.h"
+
+/* Элемент каталога или таблицы страниц PAE */
+typedef uint64_t pte_t;
+
+/* Размер большой страницы (PAE) */
+#define VMM_LARGE_PAGE_SIZE 0x200000
+
+/* Элементов в таблице указателей на каталоги, каталоге и таблице */
+#define VMM_PDPT_ENTRIES 4
+#define VMM_PT_ENTRIES   512
+
+/* Индексы: четыре каталога лежат подряд и индексируются как один */
+#define VMM_PDE_INDEX(virt) ((uint32_t)(virt) >> 21)
+#define VMM_PTE_INDEX(virt) (((uint32_t)(virt) >> 12) & 0x1FF)
+
+/* Биты элементов каталога и таблиц страниц */
+#define PG_PRESENT  0x001
+#define PG_WRITE    0x002
+#define PG_USER     0x004
+#define PG_PWT      0x008   /* Сквозная запись */
+#define PG_PCD      0x010   /* Кэширование запрещено */
+#define PG_ACCESSED 0x020
+#define PG_DIRTY    0x040
+#define PG_LARGE    0x080   /* В каталоге: страница 2 МБ */
+#define PG_PAT      0x080   /* В таблице: старший бит индекса PAT */
+#define PG_GLOBAL   0x100   /* Не сбрасывается при смене CR3 */
+#define PG_COW      0x200   /* Программный бит: копирование при записи */
+#define PG_FLAGS    0xFFF
+#define PG_LARGE_PAT 0x1000  /* Бит PAT страницы 2 МБ */
+#define PG_NX       (1ULL << 63)  /* Исполнение запрещено (EFER.NXE) */
+
+/* Физический адрес в элементе (до 52 бит) */
+#define PG_ADDR_MASK 0x000FFFFFFFFFF000ULL
+
+/* Флаги vmm_map() */
+#define VMM_WRITE   PG_WRITE
+#define VMM_USER    PG_USER
+#define VMM_GLOBAL  PG_GLOBAL
+
+/* Тип кэширования (pat.h): по умолчанию WB */
+#define VMM_CACHE_WB       0
+#define VMM_CACHE_WT       PG_PWT
+#define VMM_CACHE_UC_MINUS PG_PCD              /* UC, но MTRR WC сохраняется */
+#define VMM_CACHE_UC       (PG_PCD | PG_PWT)
+#define VMM_CACHE_WC       0x10000             /* Запись 4 PAT; без PAT - UC- */
+#define VMM_CACHE_MASK     (PG_PCD | PG_PWT | VMM_CACHE_WC)
+#define VMM_NOCACHE        VMM_CACHE_UC
+
+/* Флаги vmm_alloc() (вне битов элемента таблицы) */
+#define VMM_COMMIT  0x1000  /* Выделить кадры сразу */
+#define VMM_GUARD   0x2000  /* Неотображенная страница под областью */
+#define VMM_RESERVE 0x4000  /* Только адреса: отображает владелец */
+#define VMM_EXEC    0x8000  /* Разрешить исполнение (иначе NX) */
+
+/* Биты кода ошибки Page Fault */
+#define PF_PRESENT 0x01  /* Страница отображена, нарушены права */
+#define PF_WRITE   0x02  /* Запись */
+#define PF_USER    0x04  /* Обращение из кольца 3 */
+#define PF_FETCH   0x10  /* Выборка инструкции (NX) */
+
+/* Физическая память в прямом отображении (с KERNEL_VIRT_BASE) */
+#define VMM_DIRECT_SIZE PMM_LOWMEM_END
+
+/* Окно ядра для отображений страницами 4 КБ */
+#define VMM_KVA_BASE 0xE0000000
+#define VMM_KVA_SIZE 0x10000000
+
+/* Окно временных отображений верхней памяти: слоты каждого процессора */
+#define VMM_KMAP_BASE  0xF0000000
+#define VMM_KMAP_SLOTS 4
+
+/* Описателей областей окна ядра */
+#define VMM_REGIONS 256
+
+/* Вектор IPI сброса TLB */
+#define VMM_SHOOTDOWN_VECTOR 0xF2
+
+/* Начиная с этого числа страниц TLB сбрасывается целиком */
+#define VMM_FLUSH_ALL_PAGES 32
+
+/**
+ * @brief Статистика страничной адресации
+ */
+typedef struct {
+    uint32_t page_tables;     /* Выделено таблиц страниц */
+    uint32_t large_splits;    /* Разбито страниц 2 МБ */
+    uint32_t mapped;          /* Установлено отображений 4 КБ */
+    uint32_t unmapped;        /* Удалено отображений 4 КБ */
+    uint32_t shootdowns;      /* Запросов сброса TLB на других процессорах */
+    uint32_t shootdown_ipis;  /* Отправлено IPI сброса */
+    uint32_t full_flushes;    /* Полных сбросов TLB */
+    uint32_t demand_faults;   /* Страниц, выделенных по первому обращению */
+    uint32_t bad_faults;      /* Неразрешенных Page Fault */
+    uint32_t zero_maps;       /* Отображений нулевой страницы */
+    uint32_t cow_faults;      /* Записей в страницы с PG_COW */
+    uint32_t cow_copies;      /* Из них с копированием кадра */
+    uint32_t cow_reused;      /* Из них у единственного владельца */
+    uint32_t kmaps;           /* Временных отображений верхней памяти */
+} vmm_stats_t;
+
+/**
+ * @brief Область окна ядра
+ */
+typedef struct vmm_region {
+    uint32_t start;           /* Первый адрес области */
+    uint32_t end;             /* Конец области (не включая) */
+    uint32_t guard;           /* Страниц защиты под областью */
+    uint32_t flags;           /* VMM_* флаги */
+    uint32_t committed;       /* Страниц с выделенными кадрами */
+    const char *name;
+    struct vmm_region *next;
+} vmm_region_t;
+
+/**
+ * @brief Построение таблиц ядра и переход на них с загрузочных таблиц
+ *
+ * Вызывается на загрузочном процессоре после инициализации PMM,
+ * до драйверов с регистрами MMIO.
+ */
+void vmm_init(void);
+
+/**
+ * @brief Включение страничной адресации на прикладном процессоре
+ */
+void vmm_init_ap(void);
+
+/**
+ * @brief Включена ли страничная адресация
+ */
+int vmm_enabled(void);
+
+/**
+ * @brief Отображение регистров устройства в окно ядра
+ * @param phys Физический адрес
+ * @param size Размер области в байтах
+ * @return Адрес того же смещения в окне ядра или NULL
+ *
+ * Область занимает в окне ядра собственную область VMM_RESERVE
+ * и отображается без кэширования - кроме диапазонов, которым MTRR
+ * назначают WC: в них сохраняется объединение записей.
+ */
+void* vmm_map_mmio(phys_addr_t phys, uint32_t size);
+
+/**
+ * @brief Отображение кадрового буфера или другой памяти устройства
+ * @param phys Физический адрес
+ * @param size Размер области в байтах
+ * @return Адрес того же смещения в окне ядра или NULL
+ *
+ * Память отображается с WC, если есть PAT; иначе с UC-, чтобы
+ * действовал тип WC, назначенный диапазону в MTRR.
+ */
+void* vmm_map_framebuffer(phys_addr_t phys, uint32_t size);
+
+/**
+ * @brief Отображение страницы 4 КБ
+ * @param virt Виртуальный адрес (выровнен на страницу)
+ * @param phys Физический адрес (выровнен на страницу)
+ * @param flags VMM_* флаги
+ * @return 0 при успехе, -1 если не хватило памяти под таблицу
+ *
+ * Существующее отображение заменяется. Не вызывать под
+ * спин-блокировками, которые берутся с запрещенными прерываниями:
+ * сброс TLB ждет ответа остальных процессоров.
+ */
+int vmm_map(uint32_t virt, phys_addr_t phys, uint32_t flags);
+
+/**
+ * @brief Отображение непрерывного диапазона с одним сбросом TLB
+ * @param pages Количество страниц
+ */
+int vmm_map_range(uint32_t virt, phys_addr_t phys, uint32_t pages, uint32_t flags);
+
+/**
+ * @brief Удаление отображения страницы 4 КБ
+ * @param virt Виртуальный адрес
+ * @return 0 при успехе, -1 если страница не была отображена
+ */
+int vmm_unmap(uint32_t virt);
+
+/**
+ * @brief Удаление отображений диапазона с одним сбросом TLB
+ */
+void vmm_unmap_range(uint32_t virt, uint32_t pages);
+
+/**
+ * @brief Перевод виртуального адреса в физический
+ * @param virt Виртуальный адрес
+ * @param phys Физический адрес (выход)
+ * @return 0 при успехе, -1 если адрес не отображен
+ */
+int vmm_translate(uint32_t virt, phys_addr_t *phys);
+
+/**
+ * @brief Временное отображение кадра
+ * @param phys Физический адрес
+ * @return Виртуальный адрес того же смещения внутри страницы
+ *
+ * Кадр нижней памяти возвращается по адресу в прямом отображении. Кадр
+ * верхней памяти отображается в свободный слот текущего процессора;
+ * до kunmap_atomic() прерывания запрещены, и засыпать нельзя.
+ * Вложенные отображения снимаются в обратном порядке.
+ */
+void* kmap_atomic(phys_addr_t phys);
+
+/**
+ * @brief Снятие временного отображения
+ * @param addr Адрес, полученный от kmap_atomic()
+ */
+void kunmap_atomic(void *addr);
+
+/**
+ * @brief Резервирование области в окне ядра
+ * @param size Размер в байтах (округляется до страницы)
+ * @param flags VMM_WRITE, VMM_GLOBAL, VMM_EXEC, VMM_CACHE_*, VMM_COMMIT,
+ *              VMM_GUARD, VMM_RESERVE
+ * @param name Имя области для диагностики
+ * @return Начало области или NULL
+ *
+ * Без VMM_COMMIT кадры выделяются по первому обращению. Стеки ядра
+ * нужно выделять с VMM_COMMIT: процессор сохраняет кадр исключения
+ * на тот же стек, и промах на нем нельзя обработать.
+ */
+void* vmm_alloc(uint32_t size, uint32_t flags, const char *name);
+
+/**
+ * @brief Освобождение области и выделенных ей кадров
+ * @param addr Начало области, полученное от vmm_alloc()
+ *
+ * Кадры области с VMM_RESERVE принадлежат владельцу и не освобождаются.
+ */
+void vmm_free(void *addr);
+
+/**
+ * @brief Копия области с общими кадрами (копирование при записи)
+ * @param addr Начало области, полученное от vmm_alloc()
+ * @param name Имя новой области
+ * @return Начало копии или NULL
+ *
+ * Выделенные страницы отображаются в обе области только для чтения
+ * с PG_COW, первая запись с любой стороны копирует кадр. Область
+ * не должна изменяться во время копирования.
+ */
+void* vmm_clone(void *addr, const char *name);
+
+/**
+ * @brief Обработка Page Fault
+ * @param addr Адрес обращения (CR2)
+ * @param err_code Код ошибки (PF_*)
+ * @return 0 если страница отображена и обращение можно повторить
+ */
+int vmm_handle_fault(uint32_t addr, uint32_t err_code);
+
+/**
+ * @brief Сброс TLB для диапазона на всех процессорах
+ * @param virt Начало диапазона
+ * @param pages Количество страниц
+ */
+void vmm_flush_range(uint32_t virt, uint32_t pages);
+
+/**
+ * @brief Статистика страничной адресации
+ */
+const vmm_stats_t* vmm_get_stats(void);
+
+/**
+ * @brief Вывод информации о страничной адресации
+ */
+void vmm_dump_info(void);
+
+/**
+ * @brief Стоимость промахов TLB и сброса (vmm_bench.c)
+ */
+void run_vmm_bench(void);
+
+#endif /* KERNEL_VMM_H */
@@ -0,0 +1,319 @@
+/**
+ * @file vmm_bench.c
+ * @brief Стоимость промахов TLB и сброса отображений
+ *
+ * Одна и та же физическая память читается через окно ядра страницами
+ * 4 КБ и через прямое отображение страницами 2 МБ. Каждое
+ * чтение попадает на свою страницу и свою строку кэша, так что при
+ * одинаковом поведении кэшей разница - это промахи TLB. Все замеры
+ * в тактах TSC на одно обращение или одну операцию. Отдельно
+ * измеряются первое обращение к страницам ленивой области, пара
+ * kmap_atomic()/kunmap_atomic() для кадра верхней памяти и копирование
+ * экрана в видеопамять через отображения UC и WC.
+ */
+
+#include "vmm.h"
+#include "memory.h"
+#include "pat.h"
+#include "../cpu/cpu.h"
+#include "../cpu/tsc.h"
+#include "../lib/math64.h"
+#include "../sched/sched.h"
+#include "../video/video.h"
+
+/* Физическая память для замеров: выше ядра и кучи */
+#define VMM_BENCH_PHYS 0x400000
+
+/* Проходов по набору страниц */
+#define VMM_BENCH_PASSES 16
+
+/* Повторов для invlpg, перезагрузки CR3 и сброса на всех процессорах */
+#define VMM_BENCH_REPEAT 1000
+
+/* Страниц для сравнения глобальных и обычных отображений */
+#define VMM_BENCH_GLOBAL_PAGES 64
+
+/* Страниц ленивой области для замера промахов */
+#define VMM_BENCH_FAULT_PAGES 256
+
+/* Скрытая страница текстовой видеопамяти: экран показывает первую */
+#define VMM_BENCH_VGA_PAGE (VGA_TEXT_PHYS + PAGE_SIZE)
+
+/* Копий экрана на замер */
+#define VMM_BENCH_BLITS 64
+
+static const uint32_t bench_sizes[] = { 8, 64, 512, 2048 };
+
+/* Адреса для отображений замера (по числу страниц наибольшего набора) */
+static uint32_t bench_base;
+
+/**
+ * @brief Проход по набору страниц, по одному чтению на страницу
+ * @return Тактов на обращение
+ */
+static uint32_t bench_touch(uint32_t base, uint32_t pages, uint32_t passes) {
+    volatile uint32_t sink = 0;
+    
+    uint64_t start = rdtsc();
+    for (uint32_t pass = 0; pass < passes; pass++) {
+        for (uint32_t i = 0; i < pages; i++) {
+            /* Смещение внутри страницы разводит обращения по наборам кэша */
+            sink += *(volatile uint32_t*)(base + i * PAGE_SIZE + (i * 64) % PAGE_SIZE);
+        }
+    }
+    uint64_t cycles = rdtsc() - start;
+    
+    (void)sink;
+    return (uint32_t)div_u64(cycles, pages * passes);
+}
+
+/**
+ * @brief Чтение через страницы 4 КБ и через страницы 2 МБ
+ */
+static void bench_tlb_miss(void) {
+    print_string("\nCycles per access, 4 KB pages vs 2 MB pages:\n");
+    
+    for (uint32_t s = 0; s < sizeof(bench_sizes) / sizeof(bench_sizes[0]); s++) {
+        uint32_t pages = bench_sizes[s];
+        
+        if (vmm_map_range(bench_base, VMM_BENCH_PHYS, pages, 0) != 0) {
+            print_string_color("  Out of memory for page tables\n", COLOR_RED, COLOR_BLACK);
+            return;
+        }
+        
+        /* Первый проход прогревает кэши, второй измеряется */
+        bench_touch(bench_base, pages, 1);
+        uint32_t small = bench_touch(bench_base, pages, VMM_BENCH_PASSES);
+        bench_touch((uint32_t)phys_to_virt(VMM_BENCH_PHYS), pages, 1);
+        uint32_t large = bench_touch((uint32_t)phys_to_virt(VMM_BENCH_PHYS), pages, VMM_BENCH_PASSES);
+        
+        vmm_unmap_range(bench_base, pages);
+        
+        print_string("  ");
+        print_dec(pages);
+        print_string(" pages (");
+        print_dec(pages * 4);
+        print_string(" KB): ");
+        print_dec(small);
+        print_string(" vs ");
+        print_dec(large);
+        print_string("\n");
+    }
+}
+
+/**
+ * @brief Обращения после перезагрузки CR3: глобальные и обычные страницы
+ */
+static uint32_t bench_after_cr3(uint32_t flags) {
+    uint64_t total = 0;
+    
+    vmm_map_range(bench_base, VMM_BENCH_PHYS, VMM_BENCH_GLOBAL_PAGES, flags);
+    bench_touch(bench_base, VMM_BENCH_GLOBAL_PAGES, 1);
+    
+    for (uint32_t i = 0; i < VMM_BENCH_PASSES; i++) {
+        write_cr3(read_cr3());
+        total += bench_touch(bench_base, VMM_BENCH_GLOBAL_PAGES, 1);
+    }
+    
+    vmm_unmap_range(bench_base, VMM_BENCH_GLOBAL_PAGES);
+    return (uint32_t)div_u64(total, VMM_BENCH_PASSES);
+}
+
+/**
+ * @brief Первое обращение к страницам ленивой области
+ */
+static void bench_demand_fault(void) {
+    uint8_t *area = (uint8_t*)vmm_alloc(VMM_BENCH_FAULT_PAGES * PAGE_SIZE, VMM_WRITE, "vmm bench");
+    if (!area) {
+        print_string_color("  No address space for demand faults\n", COLOR_RED, COLOR_BLACK);
+        return;
+    }
+    
+    uint32_t faults = vmm_get_stats()->demand_faults;
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < VMM_BENCH_FAULT_PAGES; i++) {
+        area[i * PAGE_SIZE] = 1;
+    }
+    uint64_t cycles = rdtsc() - start;
+    faults = vmm_get_stats()->demand_faults - faults;
+    
+    /* Повторный проход по уже выделенным страницам */
+    start = rdtsc();
+    for (uint32_t i = 0; i < VMM_BENCH_FAULT_PAGES; i++) {
+        area[i * PAGE_SIZE] = 2;
+    }
+    uint64_t warm = rdtsc() - start;
+    
+    vmm_free(area);
+    
+    print_string("\nDemand fault (");
+    print_dec(faults);
+    print_string(" pages): ");
+    print_dec((uint32_t)div_u64(cycles, VMM_BENCH_FAULT_PAGES));
+    print_string(" cycles per first touch, ");
+    print_dec((uint32_t)div_u64(warm, VMM_BENCH_FAULT_PAGES));
+    print_string(" after\n");
+}
+
+/**
+ * @brief Временное отображение кадра верхней памяти
+ */
+static void bench_kmap(void) {
+    phys_addr_t frame = pmm_alloc_frame();
+    if (frame < PMM_LOWMEM_END) {
+        print_string("\nkmap_atomic: no high memory\n");
+        if (frame) {
+            pmm_free_page(frame);
+        }
+        return;
+    }
+    
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < VMM_BENCH_REPEAT; i++) {
+        volatile uint32_t *addr = (volatile uint32_t*)kmap_atomic(frame);
+        (void)*addr;
+        kunmap_atomic((void*)addr);
+    }
+    uint64_t cycles = rdtsc() - start;
+    pmm_free_page(frame);
+    
+    print_string("\nkmap_atomic + read + kunmap_atomic: ");
+    print_dec((uint32_t)div_u64(cycles, VMM_BENCH_REPEAT));
+    print_string(" cycles\n");
+}
+
+/**
+ * @brief Копирование двойными словами, как копирует экран драйвер
+ */
+static void bench_copy(uint32_t dst, const void *src, uint32_t bytes) {
+    uint32_t ecx, edi, esi;
+    __asm__ volatile("rep movsl"
+                     : "=&c"(ecx), "=&D"(edi), "=&S"(esi)
+                     : "0"(bytes / 4), "1"(dst), "2"(src)
+                     : "memory");
+}
+
+/**
+ * @brief Копирование экрана в видеопамять с заданным типом кэширования
+ * @param cache VMM_CACHE_*
+ * @return Скорость в МБ/с или 0
+ */
+static uint32_t bench_blit(const void *screen, uint32_t cache) {
+    if (vmm_map(bench_base, VMM_BENCH_VGA_PAGE, VMM_WRITE | cache) != 0) {
+        return 0;
+    }
+    
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < VMM_BENCH_BLITS; i++) {
+        bench_copy(bench_base, screen, SCREEN_SIZE);
+    }
+    /* Буферы объединения записей выталкиваются до конца замера */
+    __asm__ volatile("sfence" : : : "memory");
+    uint64_t cycles = rdtsc() - start;
+    
+    vmm_unmap(bench_base);
+    
+    uint32_t us = (uint32_t)div_u64(tsc_cycles_to_ns(cycles), 1000);
+    return us ? (uint32_t)div_u64((uint64_t)SCREEN_SIZE * VMM_BENCH_BLITS, us) : 0;
+}
+
+/**
+ * @brief Запись в видеопамять: UC против WC
+ */
+static void bench_write_combining(void) {
+    uint8_t *screen = (uint8_t*)kmalloc_flags(SCREEN_SIZE, KMALLOC_TAG(HEAP_TAG_TEST));
+    if (!screen) {
+        print_string_color("\nNo memory for screen blit\n", COLOR_RED, COLOR_BLACK);
+        return;
+    }
+    for (uint32_t i = 0; i < SCREEN_SIZE; i += 2) {
+        screen[i] = 'A' + (i / 2) % 26;
+        screen[i + 1] = 0x07;
+    }
+    
+    print_string("\nScreen blit to VGA memory (");
+    print_dec(SCREEN_SIZE);
+    print_string(" bytes, MTRR ");
+    print_string(mem_type_name(mtrr_type(VMM_BENCH_VGA_PAGE, SCREEN_SIZE)));
+    print_string("):\n  UC: ");
+    print_dec(bench_blit(screen, VMM_CACHE_UC));
+    print_string(" MB/s, WC: ");
+    print_dec(bench_blit(screen, VMM_CACHE_WC));
+    print_string(pat_enabled() ? " MB/s\n" : " MB/s (no PAT: UC-)\n");
+    
+    kfree(screen);
+}
+
+/**
+ * @brief Стоимость промахов TLB и сброса
+ */
+void run_vmm_bench(void) {
+    print_string("\n=== Paging Benchmark ===\n");
+    
+    if (!vmm_enabled() || !tsc_available()) {
+        print_string_color("Paging or TSC not available, skipping\n", COLOR_RED, COLOR_BLACK);
+        return;
+    }
+    
+    uint32_t max_pages = bench_sizes[sizeof(bench_sizes) / sizeof(bench_sizes[0]) - 1];
+    bench_base = (uint32_t)vmm_alloc(max_pages * PAGE_SIZE, VMM_RESERVE, "vmm bench");
+    if (!bench_base) {
+        print_string_color("No address space, skipping\n", COLOR_RED, COLOR_BLACK);
+        return;
+    }
+    
+    /* invlpg для одной страницы */
+    vmm_map(bench_base, VMM_BENCH_PHYS, 0);
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < VMM_BENCH_REPEAT; i++) {
+        invlpg(bench_base);
+        (void)*(volatile uint32_t*)bench_base;
+    }
+    uint64_t cycles = rdtsc() - start;
+    print_string("invlpg + refill: ");
+    print_dec((uint32_t)div_u64(cycles, VMM_BENCH_REPEAT));
+    print_string(" cycles\n");
+    
+    /* Сброс одной страницы на всех процессорах */
+    if (sched_cpu_count() > 1) {
+        start = rdtsc();
+        for (uint32_t i = 0; i < VMM_BENCH_REPEAT; i++) {
+            vmm_flush_range(bench_base, 1);
+        }
+        cycles = rdtsc() - start;
+        print_string("Shootdown on ");
+        print_dec(sched_cpu_count());
+        print_string(" CPUs: ");
+        print_dec((uint32_t)div_u64(cycles, VMM_BENCH_REPEAT));
+        print_string(" cycles\n");
+    }
+    vmm_unmap(bench_base);
+    
+    /* Перезагрузка CR3 */
+    start = rdtsc();
+    for (uint32_t i = 0; i < VMM_BENCH_REPEAT; i++) {
+        write_cr3(read_cr3());
+    }
+    cycles = rdtsc() - start;
+    print_string("CR3 reload: ");
+    print_dec((uint32_t)div_u64(cycles, VMM_BENCH_REPEAT));
+    print_string(" cycles\n");
+    
+    bench_tlb_miss();
+    
+    print_string("\nCycles per access after CR3 reload (");
+    print_dec(VMM_BENCH_GLOBAL_PAGES);
+    print_string(" pages):\n  global: ");
+    print_dec(bench_after_cr3(VMM_GLOBAL));
+    print_string(", non-global: ");
+    print_dec(bench_after_cr3(0));
+    print_string("\n");
+    
+    bench_write_combining();
+    
+    vmm_free((void*)bench_base);
+    bench_demand_fault();
+    bench_kmap();
+    
+    print_string_color("\nPaging benchmark completed!\n", COLOR_GREEN, COLOR_BLACK);
+}
@@ -0,0 +1,1029 @@
+/**
+ * @file sched.c
+ * @brief Потоки ядра и вытесняющий планировщик
+ *
+ * У каждого процессора три источника готовых потоков:
+ * - дек Chase-Lev: владелец кладет потоки в нижний конец, а забирает,
+ *   как и воры, из верхнего - так сохраняется круговой порядок;
+ * - локальная очередь (FIFO) для потоков, которые могут выполняться
+ *   только здесь, и для уже перехваченных;
+ * - входящий список (стек Трайбера) для потоков, которые передают
+ *   этому процессору другие.
+ * Дек и локальная очередь меняются владельцем только с запрещенными
+ * прерываниями. Список спящих тоже принадлежит процессору: поток
+ * засыпает и просыпается на одном и том же процессоре.
+ *
+ * Переключение контекста всегда происходит при IF=0: поток, вытесненный
+ * из прерывания, продолжит выход из него через iret, а поток,
+ * уступивший процессор сам, восстановит флаги через cpu_irq_restore().
+ * Предыдущий поток ставится в очередь только после переключения
+ * (sched_finish_switch), когда его стек уже сохранен: раньше другой
+ * процессор не должен иметь возможности его перехватить.
+ *
+ * Поток простоя никогда не стоит в очереди: он выбирается,
+ * только когда готовых потоков нет.
+ */
+
+#include "sched.h"
+#include "wsdeque.h"
+#include "../async/async.h"
+#include "../apic/apic.h"
+#include "../cpu/cpu.h"
+#include "../cpu/percpu.h"
+#include "../drivers/pit.h"
+#include "../idt/irq.h"
+#include "../lib/math64.h"
+#include "../memory/memory.h"
+#include "../memory/vmm.h"
+#include "../sync/spinlock.h"
+#include "../time/hrtimer.h"
+#include "../video/video.h"
+#include "../lib/compiler.h"
+#include <stddef.h>
+
+/* Попыток перехвата у одного процессора при гонке за элемент */
+#define SCHED_STEAL_ATTEMPTS 4
+
+/**
+ * @brief Состояние планировщика процессора
+ */
+typedef struct {
+    wsdeque_t deque;            /* Потоки, которые можно перехватить */
+    kthread_t *current;         /* Выполняющийся поток */
+    kthread_t *idle;            /* Поток простоя */
+    kthread_t *prev;            /* Поток, с которого только что переключились */
+    spinlock_t *prev_lock;      /* Освободить после переключения (sched_block) */
+    kthread_t *local_head;      /* Локальная очередь */
+    kthread_t *local_tail;
+    kthread_t * volatile inbox; /* Потоки от других процессоров */
+    kthread_t *sleepers;        /* Спящие потоки по возрастанию wake_ns */
+    volatile uint32_t need_resched;
+    volatile uint32_t active;   /* Процессор участвует в планировании */
+    uint32_t preempt_count;     /* Вложенность sched_preempt_disable() */
+    uint32_t local_first;       /* Чередование локальной очереди и дека */
+    uint32_t balance_ticks;     /* Тики с последней балансировки */
+    uint32_t switches;          /* Переключения контекста */
+    uint32_t preemptions;       /* Из них - вытеснения из прерывания */
+    uint32_t steals;            /* Перехваченные потоки */
+    uint32_t ipis;              /* Отправленные IPI */
+    hrtimer_t sleep_timer;      /* Пробуждение ближайшего спящего */
+    hrtimer_t tick_timer;       /* Тик прикладного процессора */
+} __attribute__((aligned(64))) sched_cpu_t;
+
+/* Переключение стеков (switch.asm) */
+extern void switch_context(uint32_t *prev_esp, uint32_t next_esp);
+
+static sched_cpu_t sched_cpus[MAX_CPUS];
+static volatile uint32_t active_mask = 0;
+static int sched_started = 0;
+
+/* Список всех потоков */
+static kthread_t *all_threads = NULL;
+static uint32_t next_thread_id = 0;
+static spinlock_t threads_lock = SPINLOCK_INIT;
+
+/**
+ * @brief Планировщик текущего процессора
+ */
+static inline sched_cpu_t* sched_this_cpu(void) {
+    return &sched_cpus[cpu_current()];
+}
+
+/**
+ * @brief Номер процессора по его планировщику
+ */
+static inline uint32_t sched_cpu_id(sched_cpu_t *cpu) {
+    return (uint32_t)(cpu - sched_cpus);
+}
+
+/**
+ * @brief Постановка потока в конец локальной очереди
+ */
+static void sched_local_push(sched_cpu_t *cpu, kthread_t *thread) {
+    thread->state = KTHREAD_READY;
+    thread->next = NULL;
+    if (cpu->local_tail) {
+        cpu->local_tail->next = thread;
+    } else {
+        cpu->local_head = thread;
+    }
+    cpu->local_tail = thread;
+}
+
+/**
+ * @brief Извлечение потока из начала локальной очереди
+ */
+static kthread_t* sched_local_pop(sched_cpu_t *cpu) {
+    kthread_t *thread = cpu->local_head;
+    if (thread) {
+        cpu->local_head = thread->next;
+        if (!cpu->local_head) {
+            cpu->local_tail = NULL;
+        }
+        thread->next = NULL;
+    }
+    return thread;
+}
+
+/**
+ * @brief Есть ли у процессора готовые потоки
+ */
+static int sched_has_ready(sched_cpu_t *cpu) {
+    return cpu->local_head || cpu->inbox || wsdeque_size(&cpu->deque);
+}
+
+/**
+ * @brief IPI процессору, если он простаивает
+ * @param id Номер процессора
+ */
+static void sched_kick(uint32_t id) {
+    sched_cpu_t *target = &sched_cpus[id];
+    
+    if (id == cpu_current() || !apic_enabled() || target->current != target->idle) {
+        return;
+    }
+    sched_this_cpu()->ipis++;
+    lapic_send_ipi(cpu_locals[id].apic_id, LAPIC_ICR_FIXED | SCHED_IPI_VECTOR);
+}
+
+/**
+ * @brief Пробуждение одного простаивающего процессора для перехвата
+ */
+static void sched_kick_idle(sched_cpu_t *cpu) {
+    uint32_t me = sched_cpu_id(cpu);
+    
+    for (uint32_t i = 1; i < MAX_CPUS; i++) {
+        uint32_t id = (me + i) % MAX_CPUS;
+        sched_cpu_t *target = &sched_cpus[id];
+        if ((active_mask & (1u << id)) && target->current == target->idle) {
+            sched_kick(id);
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Постановка потока в очередь текущего процессора
+ *
+ * Поток, который может выполняться только здесь, идет в локальную
+ * очередь, остальные - в дек, откуда их могут перехватить.
+ */
+static void sched_enqueue_local(sched_cpu_t *cpu, kthread_t *thread) {
+    uint32_t allowed = thread->affinity & active_mask;
+    
+    /* Состояние - до публикации в деке: вор может сразу запустить поток */
+    thread->state = KTHREAD_READY;
+    if (allowed == (1u << sched_cpu_id(cpu)) || wsdeque_push(&cpu->deque, thread) != 0) {
+        sched_local_push(cpu, thread);
+    }
+}
+
+/**
+ * @brief Передача потока другому процессору через входящий список
+ * @param id Номер процессора-получателя
+ * @param thread Поток
+ */
+static void sched_enqueue_remote(uint32_t id, kthread_t *thread) {
+    sched_cpu_t *target = &sched_cpus[id];
+    kthread_t *head;
+    
+    thread->state = KTHREAD_READY;
+    do {
+        head = target->inbox;
+        thread->next = head;
+    } while (!__sync_bool_compare_and_swap(&target->inbox, head, thread));
+    
+    sched_kick(id);
+}
+
+/**
+ * @brief Постановка потока в очередь с учетом привязки
+ * @param cpu Планировщик текущего процессора
+ * @param thread Поток
+ * @param kick 1 - разбудить простаивающий процессор для перехвата
+ */
+static void sched_enqueue(sched_cpu_t *cpu, kthread_t *thread, int kick) {
+    uint32_t me = sched_cpu_id(cpu);
+    uint32_t allowed = thread->affinity & active_mask;
+    
+    if (!allowed || (allowed & (1u << me))) {
+        sched_enqueue_local(cpu, thread);
+        if (kick && allowed != (1u << me)) {
+            sched_kick_idle(cpu);
+        }
+        return;
+    }
+    
+    /* Здесь поток выполняться не может - передаем первому допустимому */
+    uint32_t id = 0;
+    while (!(allowed & (1u << id))) {
+        id++;
+    }
+    sched_enqueue_remote(id, thread);
+}
+
+/**
+ * @brief Перенос входящего списка в очереди процессора
+ *
+ * Список забирается целиком одним xchg и разворачивается,
+ * чтобы потоки шли в порядке поступления.
+ */
+static void sched_drain_inbox(sched_cpu_t *cpu) {
+    if (!cpu->inbox) {
+        return;
+    }
+    
+    kthread_t *list = __sync_lock_test_and_set(&cpu->inbox, NULL);
+    kthread_t *fifo = NULL;
+    while (list) {
+        kthread_t *next = list->next;
+        list->next = fifo;
+        fifo = list;
+        list = next;
+    }
+    while (fifo) {
+        kthread_t *next = fifo->next;
+        sched_enqueue_local(cpu, fifo);
+        fifo = next;
+    }
+}
+
+/**
+ * @brief Перехват потока у другого процессора
+ * @return Поток, который может выполняться здесь, или NULL
+ */
+static kthread_t* sched_steal(sched_cpu_t *cpu) {
+    uint32_t me = sched_cpu_id(cpu);
+    
+    for (uint32_t i = 1; i < MAX_CPUS; i++) {
+        uint32_t id = (me + i) % MAX_CPUS;
+        if (!(active_mask & (1u << id))) {
+            continue;
+        }
+        
+        for (int attempt = 0; attempt < SCHED_STEAL_ATTEMPTS; attempt++) {
+            void *item = wsdeque_steal(&sched_cpus[id].deque);
+            if (item == WSDEQUE_ABORT) {
+                continue;
+            }
+            if (!item) {
+                break;
+            }
+            
+            kthread_t *thread = (kthread_t*)item;
+            if (thread->affinity & (1u << me)) {
+                cpu->steals++;
+                return thread;
+            }
+            
+            /* Привязка изменилась - возвращаем поток владельцу */
+            sched_enqueue_remote(id, thread);
+            break;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Выбор следующего потока
+ * @param cpu Планировщик текущего процессора
+ * @param may_steal 1 - при пустых очередях перехватывать у других
+ */
+__hot static kthread_t* sched_pick(sched_cpu_t *cpu, int may_steal) {
+    kthread_t *next = NULL;
+    
+    sched_drain_inbox(cpu);
+    
+    /* Локальная очередь и дек чередуются, чтобы никто не голодал */
+    cpu->local_first ^= 1;
+    if (cpu->local_first) {
+        next = sched_local_pop(cpu);
+    }
+    if (!next) {
+        void *item;
+        do {
+            item = wsdeque_steal(&cpu->deque);
+        } while (item == WSDEQUE_ABORT);
+        next = (kthread_t*)item;
+    }
+    if (!next) {
+        next = sched_local_pop(cpu);
+    }
+    if (!next && may_steal) {
+        next = sched_steal(cpu);
+    }
+    return next;
+}
+
+/**
+ * @brief Освобождение ресурсов завершенного потока
+ */
+static void kthread_free(kthread_t *thread) {
+    uint32_t flags = spin_lock_irqsave(&threads_lock);
+    for (kthread_t **link = &all_threads; *link; link = &(*link)->all_next) {
+        if (*link == thread) {
+            *link = thread->all_next;
+            break;
+        }
+    }
+    spin_unlock_irqrestore(&threads_lock, flags);
+    
+    if (thread->stack_base) {
+        vmm_free((void*)thread->stack_base);
+    }
+    kfree(thread);
+}
+
+/**
+ * @brief Завершение переключения на стеке нового потока
+ *
+ * Предыдущий поток, если он может работать дальше, ставится
+ * в очередь, а завершенный - освобождается.
+ */
+__hot static void sched_finish_switch(sched_cpu_t *cpu) {
+    kthread_t *prev = cpu->prev;
+    spinlock_t *prev_lock = cpu->prev_lock;
+    cpu->prev = NULL;
+    cpu->prev_lock = NULL;
+    
+    /* Стек заблокированного потока сохранен - его можно будить */
+    if (prev_lock) {
+        spin_unlock(prev_lock);
+    }
+    
+    if (!prev) {
+        return;
+    }
+    if (prev == cpu->idle) {
+        prev->state = KTHREAD_READY;
+    } else if (prev->state == KTHREAD_RUNNING) {
+        sched_enqueue(cpu, prev, 0);
+    } else if (prev->state == KTHREAD_DEAD) {
+        kthread_free(prev);
+    }
+}
+
+/**
+ * @brief Выбор следующего потока и переключение на него
+ * @param cpu Планировщик текущего процессора
+ *
+ * Вызывается с запрещенными прерываниями. Если текущий поток может
+ * продолжать работу и других готовых нет, переключения не происходит.
+ */
+__hot static void sched_switch(sched_cpu_t *cpu) {
+    uint32_t me = sched_cpu_id(cpu);
+    kthread_t *prev = cpu->current;
+    int prev_can_stay = prev != cpu->idle && prev->state == KTHREAD_RUNNING &&
+                        (prev->affinity & (1u << me));
+    
+    cpu->need_resched = 0;
+    kthread_t *next = sched_pick(cpu, !prev_can_stay);
+    if (!next) {
+        if (prev_can_stay || prev == cpu->idle) {
+            prev->slice = SCHED_SLICE_TICKS;
+            return;
+        }
+        next = cpu->idle;
+    }
+    
+    if (next->cpu != me) {
+        next->migrations++;
+        next->cpu = me;
+    }
+    next->state = KTHREAD_RUNNING;
+    next->slice = SCHED_SLICE_TICKS;
+    next->switches++;
+    cpu->current = next;
+    cpu->prev = prev;
+    cpu->switches++;
+    
+    switch_context(&prev->esp, next->esp);
+    
+    /* Сюда поток возвращается, когда снова получает процессор -
+     * возможно, уже другой */
+    sched_finish_switch(sched_this_cpu());
+}
+
+/**
+ * @brief Перевод истекших спящих потоков в очередь готовых
+ */
+static void sched_wake_sleepers(sched_cpu_t *cpu) {
+    uint64_t now = hrtimer_now_ns();
+    
+    while (cpu->sleepers && cpu->sleepers->wake_ns <= now) {
+        kthread_t *thread = cpu->sleepers;
+        cpu->sleepers = thread->next;
+        sched_enqueue(cpu, thread, 1);
+        cpu->need_resched = 1;
+    }
+    
+    if (cpu->sleepers && hrtimer_available()) {
+        hrtimer_start_abs(&cpu->sleep_timer, cpu->sleepers->wake_ns);
+    }
+}
+
+/**
+ * @brief Обработчик таймера пробуждения спящих потоков
+ */
+static void sched_sleep_timer_fn(hrtimer_t *timer, void *ctx) {
+    (void)timer;
+    sched_wake_sleepers((sched_cpu_t*)ctx);
+}
+
+/**
+ * @brief Тик прикладного процессора с периодом тика PIT
+ */
+static void sched_tick_timer_fn(hrtimer_t *timer, void *ctx) {
+    (void)ctx;
+    sched_tick();
+    
+    uint64_t period = PIT_TICK_NS(pit_get_frequency());
+    uint64_t next = timer->expires_ns + period;
+    uint64_t now = hrtimer_now_ns();
+    hrtimer_start_abs(timer, next > now ? next : now + period);
+}
+
+/**
+ * @brief Обработчик IPI перепланирования
+ *
+ * Само переключение выполнит sched_irq_exit() на выходе из прерывания.
+ */
+static irq_return_t sched_ipi_handler(void *ctx) {
+    (void)ctx;
+    sched_this_cpu()->need_resched = 1;
+    return IRQ_HANDLED;
+}
+
+/**
+ * @brief Точка входа нового потока
+ *
+ * Сюда возвращается switch_context() при первом переключении
+ * на поток. Прерывания запрещены до вызова функции потока.
+ */
+static void kthread_entry(void) {
+    sched_cpu_t *cpu = sched_this_cpu();
+    kthread_t *self = cpu->current;
+    
+    sched_finish_switch(cpu);
+    cpu_irq_restore(EFLAGS_IF);
+    
+    self->fn(self->arg);
+    kthread_exit();
+}
+
+/**
+ * @brief Поток простоя
+ *
+ * pit_idle() сама уступает процессор, если появились готовые потоки
+ * (на прикладных процессорах - через sched_idle_cpu()).
+ */
+static void sched_idle_thread(void *arg) {
+    (void)arg;
+    
+    while (1) {
+        pit_idle();
+    }
+}
+
+/**
+ * @brief Копирование имени потока
+ */
+static void kthread_set_name(kthread_t *thread, const char *name) {
+    uint32_t i = 0;
+    for (; name[i] && i < KTHREAD_NAME_LEN - 1; i++) {
+        thread->name[i] = name[i];
+    }
+    thread->name[i] = '\0';
+}
+
+/**
+ * @brief Выделение и заполнение структуры потока
+ * @param name Имя потока
+ * @param fn Точка входа (NULL для контекста запуска процессора)
+ * @param arg Аргумент
+ * @return Поток или NULL при нехватке памяти
+ */
+static kthread_t* kthread_alloc(const char *name, kthread_fn_t fn, void *arg) {
+    /* Поток меняют планировщики разных процессоров: не делим с ним строки кэша */
+    kthread_t *thread = (kthread_t*)kmalloc_flags(sizeof(kthread_t),
+                                                    KMALLOC_CACHELINE | KMALLOC_TAG(HEAP_TAG_SCHED));
+    if (!thread) {
+        return NULL;
+    }
+    memory_set(thread, 0, sizeof(kthread_t));
+    kthread_set_name(thread, name);
+    thread->fn = fn;
+    thread->arg = arg;
+    thread->affinity = SCHED_AFFINITY_ALL;
+    thread->cpu = cpu_current();
+    
+    if (fn) {
+        /* Страница защиты под стеком ловит переполнение */
+        thread->stack_base = (uint32_t)vmm_alloc(KTHREAD_STACK_SIZE,
+                                                 VMM_WRITE | VMM_GLOBAL | VMM_COMMIT | VMM_GUARD, "stack");
+        if (!thread->stack_base) {
+            kfree(thread);
+            return NULL;
+        }
+        
+        /* Начальный кадр для switch_context(): edi, esi, ebx, ebp,
+         * адрес возврата в kthread_entry и фиктивный адрес возврата
+         * из самой kthread_entry */
+        uint32_t *sp = (uint32_t*)(thread->stack_base + KTHREAD_STACK_SIZE);
+        *--sp = 0;
+        *--sp = (uint32_t)kthread_entry;
+        *--sp = 0;  /* ebp */
+        *--sp = 0;  /* ebx */
+        *--sp = 0;  /* esi */
+        *--sp = 0;  /* edi */
+        thread->esp = (uint32_t)sp;
+    }
+    
+    uint32_t flags = spin_lock_irqsave(&threads_lock);
+    thread->id = next_thread_id++;
+    thread->all_next = all_threads;
+    all_threads = thread;
+    spin_unlock_irqrestore(&threads_lock, flags);
+    
+    return thread;
+}
+
+/**
+ * @brief Подключение текущего процессора к планированию
+ * @param current Выполняющийся контекст
+ * @param idle Поток простоя (на AP совпадает с current)
+ */
+static void sched_cpu_setup(sched_cpu_t *cpu, kthread_t *current, kthread_t *idle) {
+    uint32_t me = sched_cpu_id(cpu);
+    
+    wsdeque_init(&cpu->deque);
+    idle->affinity = 1u << me;
+    idle->state = KTHREAD_READY;
+    current->state = KTHREAD_RUNNING;
+    current->slice = SCHED_SLICE_TICKS;
+    
+    cpu->current = current;
+    cpu->idle = idle;
+    hrtimer_setup(&cpu->sleep_timer, sched_sleep_timer_fn, cpu);
+    hrtimer_setup(&cpu->tick_timer, sched_tick_timer_fn, cpu);
+    cpu->active = 1;
+    __sync_fetch_and_or(&active_mask, 1u << me);
+}
+
+/**
+ * @brief Инициализация планировщика
+ */
+__cold void sched_init(void) {
+    print_string("Scheduler Initialization... ");
+    
+    sched_cpu_t *cpu = sched_this_cpu();
+    kthread_t *main_thread = kthread_alloc("main", NULL, NULL);
+    kthread_t *idle_thread = kthread_alloc("idle", sched_idle_thread, NULL);
+    
+    if (!main_thread || !idle_thread) {
+        print_string_color("FAILED\n", COLOR_RED, COLOR_BLACK);
+        return;
+    }
+    
+    /* Оболочка и драйверы рассчитаны на загрузочный процессор */
+    main_thread->affinity = 1u << cpu_current();
+    
+    uint32_t flags = cpu_irq_save();
+    sched_cpu_setup(cpu, main_thread, idle_thread);
+    sched_started = 1;
+    cpu_irq_restore(flags);
+    
+    if (apic_enabled()) {
+        request_vector(SCHED_IPI_VECTOR, sched_ipi_handler, NULL);
+    }
+    
+    print_string_color("OK\n", COLOR_GREEN, COLOR_BLACK);
+    print_string("  - Time slice: ");
+    print_dec(SCHED_SLICE_TICKS);
+    print_string(" ticks\n");
+    print_string("  - Stack size: ");
+    print_dec(KTHREAD_STACK_SIZE / 1024);
+    print_string(" KB\n");
+}
+
+/**
+ * @brief Подключение прикладного процессора к планировщику
+ */
+void sched_ap_start(void) {
+    sched_cpu_t *cpu = sched_this_cpu();
+    
+    /* Контекст запуска AP со своим стеком становится потоком простоя */
+    kthread_t *idle = kthread_alloc("idle", NULL, NULL);
+    if (idle) {
+        sched_cpu_setup(cpu, idle, idle);
+        hrtimer_start(&cpu->tick_timer, PIT_TICK_NS(pit_get_frequency()));
+    }
+    
+    __asm__ volatile("sti");
+    sched_idle_thread(NULL);
+    __builtin_unreachable();
+}
+
+/**
+ * @brief Проверка, запущен ли планировщик
+ */
+int sched_running(void) {
+    return sched_started;
+}
+
+/**
+ * @brief Количество процессоров, участвующих в планировании
+ */
+uint32_t sched_cpu_count(void) {
+    uint32_t count = 0;
+    for (uint32_t mask = active_mask; mask; mask &= mask - 1) {
+        count++;
+    }
+    return count;
+}
+
+/**
+ * @brief Создание потока ядра
+ */
+kthread_t* kthread_create(kthread_fn_t fn, void *arg) {
+    if (!sched_started || !fn) {
+        return NULL;
+    }
+    
+    kthread_t *thread = kthread_alloc("kthread", fn, arg);
+    if (!thread) {
+        return NULL;
+    }
+    
+    /* Поток встает в свой дек; простаивающий процессор его перехватит */
+    uint32_t flags = cpu_irq_save();
+    sched_enqueue(sched_this_cpu(), thread, 1);
+    cpu_irq_restore(flags);
+    
+    return thread;
+}
+
+/**
+ * @brief Привязка потока к процессорам
+ */
+int kthread_set_affinity(kthread_t *thread, uint32_t mask) {
+    if (!thread || !(mask & active_mask)) {
+        return -1;
+    }
+    
+    thread->affinity = mask;
+    if (thread == kthread_current() && !(mask & (1u << cpu_current()))) {
+        sched_yield();
+    }
+    return 0;
+}
+
+/**
+ * @brief Завершение текущего потока
+ */
+void kthread_exit(void) {
+    cpu_irq_save();
+    sched_cpu_t *cpu = sched_this_cpu();
+    
+    cpu->current->state = KTHREAD_DEAD;
+    sched_switch(cpu);
+    
+    /* Завершенный поток больше не получает процессор */
+    __builtin_unreachable();
+}
+
+/**
+ * @brief Текущий поток процессора
+ */
+kthread_t* kthread_current(void) {
+    return sched_started ? sched_this_cpu()->current : NULL;
+}
+
+/**
+ * @brief Добровольная передача процессора следующему готовому потоку
+ */
+void sched_yield(void) {
+    if (!sched_started) {
+        return;
+    }
+    
+    uint32_t flags = cpu_irq_save();
+    sched_cpu_t *cpu = sched_this_cpu();
+    if (cpu->active && !cpu->preempt_count) {
+        sched_switch(cpu);
+    }
+    cpu_irq_restore(flags);
+}
+
+/**
+ * @brief Сон текущего потока до указанного момента
+ */
+void sched_sleep_until(uint64_t deadline_ns) {
+    if (!sched_started) {
+        while (hrtimer_now_ns() < deadline_ns) {
+            pit_idle();
+        }
+        return;
+    }
+    
+    uint32_t flags = cpu_irq_save();
+    sched_cpu_t *cpu = sched_this_cpu();
+    kthread_t *self = cpu->current;
+    
+    /* Поток простоя и код с запрещенным вытеснением не спят */
+    if (self == cpu->idle || cpu->preempt_count || deadline_ns <= hrtimer_now_ns()) {
+        cpu_irq_restore(flags);
+        return;
+    }
+    
+    /* Вставка в список спящих по возрастанию момента пробуждения */
+    kthread_t **link = &cpu->sleepers;
+    while (*link && (*link)->wake_ns <= deadline_ns) {
+        link = &(*link)->next;
+    }
+    self->wake_ns = deadline_ns;
+    self->state = KTHREAD_SLEEPING;
+    self->next = *link;
+    *link = self;
+    
+    if (cpu->sleepers == self && hrtimer_available()) {
+        hrtimer_start_abs(&cpu->sleep_timer, deadline_ns);
+    }
+    
+    sched_switch(cpu);
+    cpu_irq_restore(flags);
+}
+
+/**
+ * @brief Сон текущего потока на заданный интервал
+ */
+void sched_sleep_ns(uint64_t delay_ns) {
+    sched_sleep_until(hrtimer_now_ns() + delay_ns);
+}
+
+/**
+ * @brief Можно ли заблокировать текущий контекст
+ */
+int sched_can_block(void) {
+    if (!sched_started) {
+        return 0;
+    }
+    
+    uint32_t flags = cpu_irq_save();
+    sched_cpu_t *cpu = sched_this_cpu();
+    int can_block = cpu->active && cpu->current != cpu->idle && !cpu->preempt_count;
+    cpu_irq_restore(flags);
+    return can_block;
+}
+
+/**
+ * @brief Блокировка текущего потока до sched_wake()
+ */
+void sched_block(spinlock_t *lock) {
+    sched_cpu_t *cpu = sched_this_cpu();
+    
+    cpu->current->state = KTHREAD_BLOCKED;
+    cpu->prev_lock = lock;
+    sched_switch(cpu);
+}
+
+/**
+ * @brief Пробуждение заблокированного потока
+ */
+void sched_wake(kthread_t *thread) {
+    if (thread->state != KTHREAD_BLOCKED) {
+        return;
+    }
+    
+    sched_cpu_t *cpu = sched_this_cpu();
+    sched_enqueue(cpu, thread, 1);
+    cpu->need_resched = 1;
+}
+
+/**
+ * @brief Запрет вытеснения текущего потока
+ */
+void sched_preempt_disable(void) {
+    uint32_t flags = cpu_irq_save();
+    sched_this_cpu()->preempt_count++;
+    cpu_irq_restore(flags);
+}
+
+/**
+ * @brief Разрешение вытеснения
+ */
+void sched_preempt_enable(void) {
+    uint32_t flags = cpu_irq_save();
+    sched_cpu_t *cpu = sched_this_cpu();
+    
+    if (cpu->preempt_count && !--cpu->preempt_count && cpu->need_resched && cpu->active) {
+        sched_switch(cpu);
+    }
+    cpu_irq_restore(flags);
+}
+
+/**
+ * @brief Есть ли потоки, ожидающие процессор
+ *
+ * Простаивающий процессор заодно пытается перехватить поток
+ * у занятых; перехваченный ставится в локальную очередь.
+ */
+int sched_need_resched(void) {
+    if (!sched_started) {
+        return 0;
+    }
+    
+    sched_cpu_t *cpu = sched_this_cpu();
+    if (!cpu->active) {
+        return 0;
+    }
+    
+    sched_drain_inbox(cpu);
+    if (!sched_has_ready(cpu) && cpu->current == cpu->idle) {
+        kthread_t *thread = sched_steal(cpu);
+        if (thread) {
+            sched_local_push(cpu, thread);
+        }
+    }
+    
+    if (sched_has_ready(cpu)) {
+        cpu->need_resched = 1;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Простой прикладного процессора до прерывания
+ */
+void sched_idle_cpu(void) {
+    __asm__ volatile("cli");
+    
+    if (sched_need_resched()) {
+        __asm__ volatile("sti");
+        sched_yield();
+        return;
+    }
+    
+    /* Асинхронные задачи разбираются вместо простоя */
+    if (async_idle_pending()) {
+        __asm__ volatile("sti");
+        async_run(&async_idle_executor, ASYNC_IDLE_BUDGET);
+        return;
+    }
+    
+    /* sti откладывает прерывания на одну инструкцию: IPI,
+     * пришедший после проверки, разбудит hlt */
+    __asm__ volatile("sti; hlt");
+}
+
+/**
+ * @brief Пробуждение простаивающего процессора
+ */
+void sched_wake_idle(void) {
+    if (!sched_started) {
+        return;
+    }
+    
+    uint32_t flags = cpu_irq_save();
+    sched_kick_idle(sched_this_cpu());
+    cpu_irq_restore(flags);
+}
+
+/**
+ * @brief Ближайший тик, к которому нужно разбудить спящий поток
+ */
+uint32_t sched_next_wakeup_tick(void) {
+    if (!sched_started || hrtimer_available()) {
+        return PIT_IDLE_NO_DEADLINE;
+    }
+    
+    sched_cpu_t *cpu = sched_this_cpu();
+    if (!cpu->sleepers) {
+        return PIT_IDLE_NO_DEADLINE;
+    }
+    
+    uint64_t now = hrtimer_now_ns();
+    uint64_t wake = cpu->sleepers->wake_ns;
+    if (wake <= now) {
+        return pit_get_ticks();
+    }
+    
+    /* Округляем вверх до целого тика */
+    uint32_t tick_ns = PIT_TICK_NS(pit_get_frequency());
+    return pit_get_ticks() + (uint32_t)div_u64(wake - now + tick_ns - 1, tick_ns);
+}
+
+/**
+ * @brief Учет тика
+ */
+__hot void sched_tick(void) {
+    if (!sched_started) {
+        return;
+    }
+    
+    sched_cpu_t *cpu = sched_this_cpu();
+    if (!cpu->active) {
+        return;
+    }
+    
+    /* Без hrtimer спящие потоки будит тик */
+    if (!hrtimer_available()) {
+        sched_wake_sleepers(cpu);
+    }
+    
+    kthread_t *current = cpu->current;
+    if (current->slice) {
+        current->slice--;
+    }
+    if (!current->slice && sched_has_ready(cpu)) {
+        cpu->need_resched = 1;
+    }
+    
+    /* Балансировка: лишняя работа в деке - будим простаивающий процессор */
+    if (++cpu->balance_ticks >= SCHED_BALANCE_TICKS) {
+        cpu->balance_ticks = 0;
+        if (wsdeque_size(&cpu->deque)) {
+            sched_kick_idle(cpu);
+        }
+    }
+}
+
+/**
+ * @brief Вытеснение на выходе из прерывания
+ *
+ * Переключение откладывается, если прерывание пришло в секцию
+ * с запрещенным вытеснением (отложенная работа, простой).
+ */
+__hot void sched_irq_exit(void) {
+    if (!sched_started) {
+        return;
+    }
+    
+    sched_cpu_t *cpu = sched_this_cpu();
+    if (cpu->active && cpu->need_resched && !cpu->preempt_count) {
+        cpu->preemptions++;
+        cpu->current->preemptions++;
+        sched_switch(cpu);
+    }
+}
+
+/**
+ * @brief Название состояния потока
+ */
+static const char* kthread_state_name(kthread_state_t state) {
+    switch (state) {
+        case KTHREAD_RUNNING:  return "running";
+        case KTHREAD_READY:    return "ready";
+        case KTHREAD_SLEEPING: return "sleeping";
+        case KTHREAD_BLOCKED:  return "blocked";
+        case KTHREAD_DEAD:     return "dead";
+    }
+    return "?";
+}
+
+/**
+ * @brief Вывод списка потоков
+ */
+void sched_dump_info(void) {
+    print_string("Threads (id name: state, cpu, switches, preemptions, migrations):\n");
+    
+    uint32_t flags = spin_lock_irqsave(&threads_lock);
+    for (kthread_t *thread = all_threads; thread; thread = thread->all_next) {
+        print_string("  - ");
+        print_dec(thread->id);
+        print_string(" ");
+        print_string(thread->name);
+        print_string(": ");
+        print_string(kthread_state_name(thread->state));
+        print_string(", ");
+        print_dec(thread->cpu);
+        print_string(", ");
+        print_dec(thread->switches);
+        print_string(", ");
+        print_dec(thread->preemptions);
+        print_string(", ");
+        print_dec(thread->migrations);
+        print_string("\n");
+    }
+    spin_unlock_irqrestore(&threads_lock, flags);
+    
+    print_string("CPUs (switches, preempted, steals, IPIs sent):\n");
+    for (uint32_t id = 0; id < MAX_CPUS; id++) {
+        sched_cpu_t *cpu = &sched_cpus[id];
+        if (!cpu->active) {
+            continue;
+        }
+        print_string("  - CPU ");
+        print_dec(id);
+        print_string(": ");
+        print_dec(cpu->switches);
+        print_string(", ");
+        print_dec(cpu->preemptions);
+        print_string(", ");
+        print_dec(cpu->steals);
+        print_string(", ");
+        print_dec(cpu->ipis);
+        print_string("\n");
+    }
+}
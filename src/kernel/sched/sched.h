@@ -0,0 +1,256 @@
+/**
+ * @file sched.h
+ * @brief Потоки ядра и вытесняющий планировщик
+ *
+ * Круговой планировщик с квантом в несколько тиков. Каждый поток
+ * имеет собственный стек из PMM; переключение выполняет switch_context()
+ * (switch.asm). Вытеснение происходит на выходе из прерывания,
+ * если квант истек или проснулся другой поток. Когда готовых потоков
+ * нет, выполняется поток простоя (hlt через pit_idle()).
+ *
+ * У каждого процессора своя очередь - дек Chase-Lev (wsdeque.h):
+ * простаивающие процессоры перехватывают потоки у занятых. Потоки,
+ * привязанные к одному процессору, стоят в его локальной очереди,
+ * а потоки для другого процессора передаются через его входящий
+ * список (MPSC) с IPI, если тот простаивает.
+ */
+
+#ifndef KERNEL_SCHED_H
+#define KERNEL_SCHED_H
+
+#include <stdint.h>
+#include "../sync/spinlock.h"
+
+/* Размер стека потока */
+#define KTHREAD_STACK_PAGES 4
+#define KTHREAD_STACK_SIZE  (KTHREAD_STACK_PAGES * 4096)
+
+/* Квант времени в тиках (20 мс при 100 Гц) */
+#define SCHED_SLICE_TICKS 2
+
+/* Период балансировки в тиках */
+#define SCHED_BALANCE_TICKS 4
+
+/* Вектор IPI перепланирования */
+#define SCHED_IPI_VECTOR 0xF1
+
+/* Маска привязки: любой процессор */
+#define SCHED_AFFINITY_ALL 0xFFFFFFFF
+
+/* Максимальная длина имени потока */
+#define KTHREAD_NAME_LEN 16
+
+/**
+ * @brief Состояние потока
+ */
+typedef enum {
+    KTHREAD_RUNNING,   /* Выполняется на процессоре */
+    KTHREAD_READY,     /* В очереди готовых */
+    KTHREAD_SLEEPING,  /* Ждет момента пробуждения */
+    KTHREAD_BLOCKED,   /* Ждет события в очереди ожидания */
+    KTHREAD_DEAD       /* Завершен, ресурсы освобождаются */
+} kthread_state_t;
+
+/**
+ * @brief Функция потока
+ */
+typedef void (*kthread_fn_t)(void *arg);
+
+/**
+ * @brief Поток ядра
+ */
+typedef struct kthread {
+    uint32_t esp;               /* Сохраненный указатель стека */
+    uint32_t id;                /* Номер потока */
+    char name[KTHREAD_NAME_LEN];
+    kthread_state_t state;
+    kthread_fn_t fn;            /* Точка входа */
+    void *arg;                  /* Аргумент точки входа */
+    uint32_t stack_base;        /* Начало стека (0 - загрузочный стек) */
+    uint64_t wake_ns;           /* Момент пробуждения (шкала hrtimer_now_ns) */
+    uint32_t slice;             /* Оставшиеся тики кванта */
+    uint32_t affinity;          /* Маска допустимых процессоров */
+    uint32_t cpu;               /* Процессор, на котором поток выполнялся */
+    uint32_t switches;          /* Сколько раз поток получал процессор */
+    uint32_t preemptions;       /* Сколько раз поток был вытеснен */
+    uint32_t migrations;        /* Сколько раз поток сменил процессор */
+    struct kthread *next;       /* Очередь готовых, входящий список или спящие */
+    struct kthread *all_next;   /* Список всех потоков */
+} kthread_t;
+
+/**
+ * @brief Инициализация планировщика
+ *
+ * Текущий контекст kmain() становится потоком "main", создается
+ * поток простоя. Вызывается после heap_init().
+ */
+void sched_init(void);
+
+/**
+ * @brief Подключение прикладного процессора к планировщику
+ *
+ * Вызывается на AP после включения его локального APIC: контекст
+ * запуска становится потоком простоя процессора. Тик AP отсчитывает
+ * hrtimer на LAPIC-таймере.
+ */
+void sched_ap_start(void) __attribute__((noreturn));
+
+/**
+ * @brief Проверка, запущен ли планировщик
+ */
+int sched_running(void);
+
+/**
+ * @brief Количество процессоров, участвующих в планировании
+ */
+uint32_t sched_cpu_count(void);
+
+/**
+ * @brief Создание потока ядра
+ * @param fn Точка входа (при возврате поток завершается)
+ * @param arg Аргумент точки входа
+ * @return Поток или NULL при нехватке памяти
+ */
+kthread_t* kthread_create(kthread_fn_t fn, void *arg);
+
+/**
+ * @brief Привязка потока к процессорам
+ * @param thread Поток
+ * @param mask Маска процессоров (бит N - процессор N)
+ * @return 0 при успехе, -1 если маска не содержит работающих процессоров
+ *
+ * Поток переносится на допустимый процессор при следующей постановке
+ * в очередь; текущий поток сразу уступает процессор.
+ */
+int kthread_set_affinity(kthread_t *thread, uint32_t mask);
+
+/**
+ * @brief Завершение текущего потока
+ */
+void kthread_exit(void) __attribute__((noreturn));
+
+/**
+ * @brief Текущий поток процессора
+ */
+kthread_t* kthread_current(void);
+
+/**
+ * @brief Добровольная передача процессора следующему готовому потоку
+ */
+void sched_yield(void);
+
+/**
+ * @brief Сон текущего потока до указанного момента
+ * @param deadline_ns Момент пробуждения (шкала hrtimer_now_ns)
+ */
+void sched_sleep_until(uint64_t deadline_ns);
+
+/**
+ * @brief Сон текущего потока на заданный интервал
+ * @param delay_ns Интервал в наносекундах
+ */
+void sched_sleep_ns(uint64_t delay_ns);
+
+/**
+ * @brief Можно ли заблокировать текущий контекст
+ * @return 1 для обычного потока с разрешенным вытеснением
+ *
+ * Поток простоя, код до запуска планировщика и секции с запрещенным
+ * вытеснением должны ждать событий опросом.
+ */
+int sched_can_block(void);
+
+/**
+ * @brief Блокировка текущего потока до sched_wake()
+ * @param lock Блокировка, под которой поток поставил себя в очередь
+ *
+ * Вызывается с захваченной lock и запрещенными прерываниями.
+ * lock освобождается уже после переключения, когда стек потока
+ * сохранен, поэтому разбудивший (он берет ту же lock) не может
+ * запустить поток раньше времени. Возвращается с освобожденной lock
+ * и запрещенными прерываниями.
+ */
+void sched_block(spinlock_t *lock);
+
+/**
+ * @brief Пробуждение заблокированного потока
+ * @param thread Поток в состоянии KTHREAD_BLOCKED
+ *
+ * Вызывается под той же блокировкой, что передавалась в sched_block(),
+ * и с запрещенными прерываниями.
+ */
+void sched_wake(kthread_t *thread);
+
+/**
+ * @brief Запрет вытеснения текущего потока (вложенный)
+ */
+void sched_preempt_disable(void);
+
+/**
+ * @brief Разрешение вытеснения; выполняет отложенное переключение
+ */
+void sched_preempt_enable(void);
+
+/**
+ * @brief Есть ли потоки, ожидающие процессор
+ * @return 1 если очередь готовых не пуста (переключение запрошено)
+ *
+ * Вызывается с запрещенными прерываниями перед простоем.
+ */
+int sched_need_resched(void);
+
+/**
+ * @brief Простой прикладного процессора до прерывания
+ *
+ * PIT принадлежит загрузочному процессору, поэтому остальные
+ * простаивают на hlt до тика hrtimer или IPI.
+ */
+void sched_idle_cpu(void);
+
+/**
+ * @brief Пробуждение простаивающего процессора
+ *
+ * Посылает IPI одному простаивающему процессору (кроме текущего),
+ * чтобы он заметил работу, которую выполняет цикл простоя.
+ */
+void sched_wake_idle(void);
+
+/**
+ * @brief Ближайший тик, к которому нужно разбудить спящий поток
+ * @return Значение pit_get_ticks() или PIT_IDLE_NO_DEADLINE
+ *
+ * Нужен только без hrtimer: тогда спящие потоки будит тик PIT.
+ */
+uint32_t sched_next_wakeup_tick(void);
+
+/**
+ * @brief Учет тика: квант, пробуждение спящих и балансировка
+ *
+ * Вызывается из обработчика прерывания PIT на загрузочном
+ * процессоре и из тика hrtimer на остальных.
+ */
+void sched_tick(void);
+
+/**
+ * @brief Вытеснение на выходе из прерывания
+ *
+ * Вызывается диспетчером прерываний после отложенной работы.
+ */
+void sched_irq_exit(void);
+
+/**
+ * @brief Вывод списка потоков
+ */
+void sched_dump_info(void);
+
+/**
+ * @brief Измерение стоимости переключения контекста
+ */
+void run_sched_bench(void);
+
+/**
+ * @brief Масштабирование по процессорам: счетные и уступающие потоки
+ */
+void run_sched_scaling_bench(void);
+
+#endif /* KERNEL_SCHED_H */
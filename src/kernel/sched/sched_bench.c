@@ -0,0 +1,194 @@
+/**
+ * @file sched_bench.c
+ * @brief Измерение стоимости переключения контекста
+ *
+ * Все замеры - в тактах TSC. Переключение измеряется "пинг-понгом"
+ * двух потоков через sched_yield(): каждый вызов передает процессор
+ * другому потоку. Тик таймера может добавить вытеснение, поэтому
+ * результат - среднее по большому числу переключений.
+ */
+
+#include "sched.h"
+#include "../cpu/cpu.h"
+#include "../cpu/tsc.h"
+#include "../lib/math64.h"
+#include "../time/hrtimer.h"
+#include "../video/video.h"
+#include <stddef.h>
+
+/* Количество уступок в каждом потоке пинг-понга */
+#define BENCH_YIELDS 10000
+
+/* Количество создаваемых и завершаемых потоков */
+#define BENCH_THREADS 64
+
+/* Количество и длительность замеров сна */
+#define BENCH_SLEEPS 10
+#define BENCH_SLEEP_NS (1 * NSEC_PER_MSEC)
+
+static volatile int bench_go;
+static volatile int bench_done;
+static volatile uint32_t bench_exited;
+
+/**
+ * @brief Вывод количества тактов и наносекунд
+ */
+static void bench_print_cycles(uint64_t cycles) {
+    print_dec((uint32_t)cycles);
+    print_string(" cycles (");
+    print_dec((uint32_t)tsc_cycles_to_ns(cycles));
+    print_string(" ns)\n");
+}
+
+/**
+ * @brief Второй участник пинг-понга
+ */
+static void bench_yield_thread(void *arg) {
+    (void)arg;
+    
+    while (!bench_go) {
+        sched_yield();
+    }
+    for (int i = 0; i < BENCH_YIELDS; i++) {
+        sched_yield();
+    }
+    bench_done = 1;
+}
+
+/**
+ * @brief Поток, который сразу завершается
+ */
+static void bench_exit_thread(void *arg) {
+    (void)arg;
+    bench_exited++;
+}
+
+/**
+ * @brief Стоимость sched_yield() без готовых потоков (без переключения)
+ */
+static void test_sched_yield_noop(void) {
+    print_string("\n=== Yield Without Switch ===\n");
+    
+    uint64_t start = rdtsc();
+    for (int i = 0; i < BENCH_YIELDS; i++) {
+        sched_yield();
+    }
+    uint64_t cycles = rdtsc() - start;
+    
+    print_string("  sched_yield: ");
+    bench_print_cycles(div_u64(cycles, BENCH_YIELDS));
+}
+
+/**
+ * @brief Стоимость переключения между двумя потоками
+ */
+static void test_sched_switch_cost(void) {
+    print_string("\n=== Context Switch (yield ping-pong) ===\n");
+    
+    bench_go = 0;
+    bench_done = 0;
+    kthread_t *thread = kthread_create(bench_yield_thread, NULL);
+    if (!thread) {
+        print_string_color("  Failed to create thread\n", COLOR_RED, COLOR_BLACK);
+        return;
+    }
+    
+    /* Пинг-понг имеет смысл только на одном процессоре */
+    kthread_set_affinity(thread, 1u << cpu_current());
+    
+    /* Даем потоку стартовать, чтобы не мерить kthread_entry */
+    sched_yield();
+    
+    uint32_t main_yields = 0;
+    bench_go = 1;
+    uint64_t start = rdtsc();
+    while (!bench_done) {
+        sched_yield();
+        main_yields++;
+    }
+    uint64_t cycles = rdtsc() - start;
+    
+    /* Каждая уступка любого из потоков - одно переключение */
+    uint32_t switches = main_yields + BENCH_YIELDS;
+    print_string("  Switches: ");
+    print_dec(switches);
+    print_string("\n  Per switch: ");
+    bench_print_cycles(div_u64(cycles, switches));
+}
+
+/**
+ * @brief Стоимость создания и завершения потока
+ */
+static void test_sched_thread_lifecycle(void) {
+    print_string("\n=== Thread Create/Exit ===\n");
+    
+    uint32_t created = 0;
+    bench_exited = 0;
+    
+    uint64_t start = rdtsc();
+    for (int i = 0; i < BENCH_THREADS; i++) {
+        if (kthread_create(bench_exit_thread, NULL)) {
+            created++;
+        }
+    }
+    while (bench_exited < created) {
+        sched_yield();
+    }
+    uint64_t cycles = rdtsc() - start;
+    
+    print_string("  Threads: ");
+    print_dec(created);
+    print_string("\n  Per thread: ");
+    bench_print_cycles(created ? div_u64(cycles, created) : 0);
+}
+
+/**
+ * @brief Точность пробуждения sched_sleep_ns()
+ */
+static void test_sched_sleep_accuracy(void) {
+    print_string("\n=== Sleep Accuracy (1 ms) ===\n");
+    
+    uint64_t total_late = 0;
+    uint64_t worst_late = 0;
+    
+    for (int i = 0; i < BENCH_SLEEPS; i++) {
+        uint64_t deadline = hrtimer_now_ns() + BENCH_SLEEP_NS;
+        sched_sleep_until(deadline);
+        uint64_t late = hrtimer_now_ns() - deadline;
+        
+        total_late += late;
+        if (late > worst_late) {
+            worst_late = late;
+        }
+    }
+    
+    print_string("  Average lateness: ");
+    print_dec((uint32_t)div_u64(total_late, BENCH_SLEEPS * NSEC_PER_USEC));
+    print_string(" us, worst: ");
+    print_dec((uint32_t)div_u64(worst_late, NSEC_PER_USEC));
+    print_string(" us\n");
+}
+
+/**
+ * @brief Измерение стоимости переключения контекста
+ */
+void run_sched_bench(void) {
+    print_string("\n=== Scheduler Benchmark ===\n");
+    
+    if (!sched_running()) {
+        print_string_color("Scheduler is not running\n", COLOR_RED, COLOR_BLACK);
+        return;
+    }
+    if (!tsc_available()) {
+        print_string_color("TSC not available, skipping\n", COLOR_RED, COLOR_BLACK);
+        return;
+    }
+    
+    test_sched_yield_noop();
+    test_sched_switch_cost();
+    test_sched_thread_lifecycle();
+    test_sched_sleep_accuracy();
+    
+    sched_dump_info();
+    print_string_color("\nScheduler benchmark completed!\n", COLOR_GREEN, COLOR_BLACK);
+}
@@ -0,0 +1,148 @@
+/**
+ * @file sched_scaling_bench.c
+ * @brief Масштабирование планировщика по процессорам
+ *
+ * На N процессорах одновременно работают N счетных потоков
+ * (только вычисления, вытесняются по кванту) и N уступающих
+ * (короткая порция работы и sched_yield()). Каждый поток считает
+ * выполненные порции в собственной строке кэша. Результат -
+ * порции в секунду всего и на процессор для каждого класса;
+ * запуск под make run SMP=1..8 показывает масштабирование.
+ */
+
+#include "sched.h"
+#include "../cpu/cpu.h"
+#include "../lib/math64.h"
+#include "../time/hrtimer.h"
+#include "../video/video.h"
+#include <stddef.h>
+
+/* Длительность замера */
+#define SCALING_DURATION_NS (1 * NSEC_PER_SEC)
+
+/* Итераций в порции работы счетного и уступающего потока */
+#define SCALING_CPU_WORK   4096
+#define SCALING_YIELD_WORK 256
+
+/**
+ * @brief Счетчик порций потока в отдельной строке кэша
+ */
+typedef struct {
+    volatile uint32_t units;
+} __attribute__((aligned(64))) scaling_counter_t;
+
+static scaling_counter_t cpu_counters[MAX_CPUS];
+static scaling_counter_t yield_counters[MAX_CPUS];
+static volatile int scaling_stop;
+static volatile uint32_t scaling_exited;
+
+/**
+ * @brief Порция работы (xorshift, чтобы компилятор не свернул цикл)
+ */
+static uint32_t scaling_work(uint32_t seed, uint32_t iterations) {
+    for (uint32_t i = 0; i < iterations; i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+    }
+    return seed;
+}
+
+/**
+ * @brief Счетный поток: вытесняется только по кванту
+ */
+static void scaling_cpu_thread(void *arg) {
+    scaling_counter_t *counter = (scaling_counter_t*)arg;
+    uint32_t seed = (uint32_t)arg | 1;
+    
+    while (!scaling_stop) {
+        seed = scaling_work(seed, SCALING_CPU_WORK);
+        counter->units++;
+    }
+    __sync_fetch_and_add(&scaling_exited, 1);
+}
+
+/**
+ * @brief Уступающий поток: отдает процессор после каждой порции
+ */
+static void scaling_yield_thread(void *arg) {
+    scaling_counter_t *counter = (scaling_counter_t*)arg;
+    uint32_t seed = (uint32_t)arg | 1;
+    
+    while (!scaling_stop) {
+        seed = scaling_work(seed, SCALING_YIELD_WORK);
+        counter->units++;
+        sched_yield();
+    }
+    __sync_fetch_and_add(&scaling_exited, 1);
+}
+
+/**
+ * @brief Вывод пропускной способности класса потоков
+ */
+static void scaling_report(const char *name, scaling_counter_t *counters,
+                           uint32_t threads, uint32_t cpus, uint32_t elapsed_us) {
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < threads; i++) {
+        total += counters[i].units;
+    }
+    
+    uint64_t per_sec = mul_div_u64(total, 1000000, elapsed_us);
+    print_string("  ");
+    print_string(name);
+    print_string(": ");
+    print_dec((uint32_t)per_sec);
+    print_string(" units/s, per CPU: ");
+    print_dec((uint32_t)div_u64(per_sec, cpus));
+    print_string("\n");
+}
+
+/**
+ * @brief Масштабирование по процессорам: счетные и уступающие потоки
+ */
+void run_sched_scaling_bench(void) {
+    print_string("\n=== Scheduler Scaling Benchmark ===\n");
+    
+    if (!sched_running()) {
+        print_string_color("Scheduler is not running\n", COLOR_RED, COLOR_BLACK);
+        return;
+    }
+    
+    uint32_t cpus = sched_cpu_count();
+    print_string("  CPUs: ");
+    print_dec(cpus);
+    print_string(", threads: ");
+    print_dec(cpus);
+    print_string(" CPU-bound + ");
+    print_dec(cpus);
+    print_string(" yield-heavy\n");
+    
+    scaling_stop = 0;
+    scaling_exited = 0;
+    uint32_t created = 0;
+    for (uint32_t i = 0; i < cpus; i++) {
+        cpu_counters[i].units = 0;
+        yield_counters[i].units = 0;
+        created += kthread_create(scaling_cpu_thread, &cpu_counters[i]) != NULL;
+        created += kthread_create(scaling_yield_thread, &yield_counters[i]) != NULL;
+    }
+    if (created < 2 * cpus) {
+        print_string_color("  Failed to create all threads\n", COLOR_RED, COLOR_BLACK);
+    }
+    
+    /* Основной поток спит и не отнимает процессор у замера */
+    uint64_t start = hrtimer_now_ns();
+    sched_sleep_ns(SCALING_DURATION_NS);
+    scaling_stop = 1;
+    uint32_t elapsed_us = (uint32_t)div_u64(hrtimer_now_ns() - start, NSEC_PER_USEC);
+    
+    while (scaling_exited < created) {
+        sched_sleep_ns(NSEC_PER_MSEC);
+    }
+    
+    scaling_report("CPU-bound", cpu_counters, cpus, cpus, elapsed_us);
+    scaling_report("Yield-heavy", yield_counters, cpus, cpus, elapsed_us);
+    
+    sched_dump_info();
+    print_string_color("\nScheduler scaling benchmark completed!\n", COLOR_GREEN, COLOR_BLACK);
+}
@@ -0,0 +1,40 @@
+;;
+;; @file switch.asm
+;; @brief Переключение контекста между потоками ядра
+;;
+;; Сохраняет callee-saved регистры (соглашение cdecl) на стеке
+;; текущего потока, запоминает его ESP и переходит на стек
+;; следующего потока. Остальные регистры уже сохранены вызывающим
+;; C-кодом или заглушкой прерывания.
+;;
+
+[bits 32]
+
+global switch_context   ; Переключение стеков потоков
+
+;;
+;; @brief void switch_context(uint32_t *prev_esp, uint32_t next_esp)
+;; @param [esp + 4] Куда сохранить ESP текущего потока
+;; @param [esp + 8] Сохраненный ESP следующего потока
+;;
+;; Вызывается с запрещенными прерываниями. Стек нового потока
+;; подготовлен kthread_create() так, что ret передает управление
+;; в точку входа потока.
+;;
+switch_context:
+    mov eax, [esp + 4]  ; prev_esp
+    mov edx, [esp + 8]  ; next_esp
+
+    push ebp
+    push ebx
+    push esi
+    push edi
+
+    mov [eax], esp      ; Запоминаем стек текущего потока
+    mov esp, edx        ; Переходим на стек следующего
+
+    pop edi
+    pop esi
+    pop ebx
+    pop ebp
+    ret                 ; Возврат в контекст следующего потока
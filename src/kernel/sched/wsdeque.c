@@ -0,0 +1,89 @@
+/**
+ * @file wsdeque.c
+ * @brief Дек для перехвата работы (Chase-Lev)
+ *
+ * Реализация по Lê et al. "Correct and Efficient Work-Stealing for
+ * Weak Memory Models" для модели памяти x86 (TSO): барьер нужен
+ * только в pop() между записью bottom и чтением top, остальное
+ * упорядочивают барьеры компилятора.
+ */
+
+#include "wsdeque.h"
+#include <stddef.h>
+
+/* Барьер компилятора */
+#define compiler_barrier() __asm__ volatile("" : : : "memory")
+
+/**
+ * @brief Инициализация пустого дека
+ */
+void wsdeque_init(wsdeque_t *dq) {
+    dq->top = 0;
+    dq->bottom = 0;
+}
+
+/**
+ * @brief Добавление элемента в нижний конец
+ */
+int wsdeque_push(wsdeque_t *dq, void *item) {
+    int32_t b = dq->bottom;
+    int32_t t = dq->top;
+    
+    if (b - t >= WSDEQUE_SIZE) {
+        return -1;
+    }
+    
+    dq->slots[b & (WSDEQUE_SIZE - 1)] = item;
+    
+    /* Элемент должен быть записан раньше, чем его увидят воры */
+    compiler_barrier();
+    dq->bottom = b + 1;
+    return 0;
+}
+
+/**
+ * @brief Извлечение элемента из нижнего конца
+ */
+void* wsdeque_pop(wsdeque_t *dq) {
+    int32_t b = dq->bottom - 1;
+    dq->bottom = b;
+    
+    /* Запись bottom должна стать видимой до чтения top */
+    __sync_synchronize();
+    int32_t t = dq->top;
+    
+    if (t > b) {
+        /* Дек пуст */
+        dq->bottom = b + 1;
+        return NULL;
+    }
+    
+    void *item = dq->slots[b & (WSDEQUE_SIZE - 1)];
+    if (t == b) {
+        /* Последний элемент: соревнуемся с ворами за top */
+        if (!__sync_bool_compare_and_swap(&dq->top, t, t + 1)) {
+            item = NULL;
+        }
+        dq->bottom = b + 1;
+    }
+    return item;
+}
+
+/**
+ * @brief Извлечение элемента из верхнего конца
+ */
+void* wsdeque_steal(wsdeque_t *dq) {
+    int32_t t = dq->top;
+    compiler_barrier();
+    int32_t b = dq->bottom;
+    
+    if (t >= b) {
+        return NULL;
+    }
+    
+    void *item = dq->slots[t & (WSDEQUE_SIZE - 1)];
+    if (!__sync_bool_compare_and_swap(&dq->top, t, t + 1)) {
+        return WSDEQUE_ABORT;
+    }
+    return item;
+}
@@ -0,0 +1,66 @@
+/**
+ * @file wsdeque.h
+ * @brief Дек для перехвата работы (Chase-Lev)
+ *
+ * Владелец кладет элементы в нижний конец (push) и может забирать
+ * их оттуда же (pop); остальные процессоры забирают элементы
+ * из верхнего конца (steal) без блокировок - единственная
+ * атомарная операция - CAS над top. Емкость фиксирована.
+ */
+
+#ifndef KERNEL_WSDEQUE_H
+#define KERNEL_WSDEQUE_H
+
+#include <stdint.h>
+
+/* Емкость дека (степень двойки) */
+#define WSDEQUE_SIZE 256
+
+/* steal() проиграл гонку за элемент - можно повторить */
+#define WSDEQUE_ABORT ((void*)1)
+
+/**
+ * @brief Дек Chase-Lev
+ *
+ * top и bottom разнесены по разным строкам кэша: top меняют
+ * воры, bottom - только владелец.
+ */
+typedef struct {
+    volatile int32_t top;
+    uint8_t pad[60];
+    volatile int32_t bottom;
+    void * volatile slots[WSDEQUE_SIZE];
+} __attribute__((aligned(64))) wsdeque_t;
+
+/**
+ * @brief Инициализация пустого дека
+ */
+void wsdeque_init(wsdeque_t *dq);
+
+/**
+ * @brief Добавление элемента в нижний конец (только владелец)
+ * @return 0 при успехе, -1 если дек заполнен
+ */
+int wsdeque_push(wsdeque_t *dq, void *item);
+
+/**
+ * @brief Извлечение элемента из нижнего конца (только владелец)
+ * @return Элемент или NULL, если дек пуст
+ */
+void* wsdeque_pop(wsdeque_t *dq);
+
+/**
+ * @brief Извлечение элемента из верхнего конца (любой процессор)
+ * @return Элемент, NULL если дек пуст, WSDEQUE_ABORT при гонке
+ */
+void* wsdeque_steal(wsdeque_t *dq);
+
+/**
+ * @brief Приблизительное количество элементов
+ */
+static inline uint32_t wsdeque_size(wsdeque_t *dq) {
+    int32_t size = dq->bottom - dq->top;
+    return size > 0 ? (uint32_t)size : 0;
+}
+
+#endif /* KERNEL_WSDEQUE_H */
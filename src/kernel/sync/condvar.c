@@ -0,0 +1,42 @@
+/**
+ * @file condvar.c
+ * @brief Условные переменные
+ */
+
+#include "condvar.h"
+
+/**
+ * @brief Инициализация условной переменной
+ */
+void condvar_init(condvar_t *cv) {
+    wait_queue_init(&cv->waiters);
+}
+
+/**
+ * @brief Ожидание сигнала
+ *
+ * Очередь захватывается до освобождения мьютекса: сигнал,
+ * отправленный после изменения условия, застанет поток уже в очереди.
+ */
+void condvar_wait(condvar_t *cv, mutex_t *mutex) {
+    uint32_t flags = spin_lock_irqsave(&cv->waiters.lock);
+    mutex_unlock(mutex);
+    wait_queue_sleep(&cv->waiters, NULL);
+    spin_unlock_irqrestore(&cv->waiters.lock, flags);
+    
+    mutex_lock(mutex);
+}
+
+/**
+ * @brief Пробуждение одного ожидающего
+ */
+void condvar_signal(condvar_t *cv) {
+    wake_up_one(&cv->waiters);
+}
+
+/**
+ * @brief Пробуждение всех ожидающих
+ */
+void condvar_broadcast(condvar_t *cv) {
+    wake_up_all(&cv->waiters);
+}
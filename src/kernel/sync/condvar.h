@@ -0,0 +1,55 @@
+/**
+ * @file condvar.h
+ * @brief Условные переменные
+ *
+ * Ожидание условия, защищенного мьютексом. condvar_wait() атомарно
+ * относительно condvar_signal() освобождает мьютекс и засыпает, а после
+ * пробуждения снова захватывает мьютекс. Пробуждение может быть ложным,
+ * поэтому условие проверяется в цикле:
+ *
+ *     mutex_lock(&m);
+ *     while (!ready) condvar_wait(&cv, &m);
+ *     mutex_unlock(&m);
+ */
+
+#ifndef KERNEL_CONDVAR_H
+#define KERNEL_CONDVAR_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "mutex.h"
+#include "waitqueue.h"
+
+/**
+ * @brief Условная переменная
+ */
+typedef struct {
+    wait_queue_t waiters;
+} condvar_t;
+
+/* Статический инициализатор */
+#define CONDVAR_INIT { WAIT_QUEUE_INIT }
+
+/**
+ * @brief Инициализация условной переменной
+ */
+void condvar_init(condvar_t *cv);
+
+/**
+ * @brief Ожидание сигнала
+ * @param cv Условная переменная
+ * @param mutex Захваченный вызывающим мьютекс, защищающий условие
+ */
+void condvar_wait(condvar_t *cv, mutex_t *mutex);
+
+/**
+ * @brief Пробуждение одного ожидающего
+ */
+void condvar_signal(condvar_t *cv);
+
+/**
+ * @brief Пробуждение всех ожидающих
+ */
+void condvar_broadcast(condvar_t *cv);
+
+#endif /* KERNEL_CONDVAR_H */
@@ -0,0 +1,66 @@
+/**
+ * @file futex.c
+ * @brief Ожидание и пробуждение по адресу
+ *
+ * Значение слова проверяется под блокировкой очереди: futex_wake()
+ * берет ту же блокировку, поэтому изменение слова с последующим
+ * пробуждением не может проскочить между проверкой и засыпанием.
+ */
+
+#include "futex.h"
+#include "waitqueue.h"
+
+static wait_queue_t futex_queues[FUTEX_BUCKETS];
+static volatile int futex_ready = 0;
+static spinlock_t futex_init_lock = SPINLOCK_INIT;
+
+/**
+ * @brief Очередь для адреса
+ *
+ * Слова выровнены на 4 байта - младшие биты адреса не несут
+ * информации. Таблица инициализируется при первом обращении.
+ */
+static wait_queue_t* futex_queue(volatile uint32_t *addr) {
+    if (!futex_ready) {
+        uint32_t flags = spin_lock_irqsave(&futex_init_lock);
+        if (!futex_ready) {
+            for (uint32_t i = 0; i < FUTEX_BUCKETS; i++) {
+                wait_queue_init(&futex_queues[i]);
+            }
+            __asm__ volatile("" : : : "memory");
+            futex_ready = 1;
+        }
+        spin_unlock_irqrestore(&futex_init_lock, flags);
+    }
+    
+    uint32_t hash = ((uint32_t)addr >> 2) * 0x9E3779B1u;
+    return &futex_queues[hash >> (32 - FUTEX_HASH_BITS)];
+}
+
+/**
+ * @brief Ожидание на адресе
+ */
+int futex_wait(volatile uint32_t *addr, uint32_t expected) {
+    wait_queue_t *wq = futex_queue(addr);
+    uint32_t flags = spin_lock_irqsave(&wq->lock);
+    
+    if (*addr != expected) {
+        spin_unlock_irqrestore(&wq->lock, flags);
+        return -1;
+    }
+    wait_queue_sleep(wq, addr);
+    
+    spin_unlock_irqrestore(&wq->lock, flags);
+    return 0;
+}
+
+/**
+ * @brief Пробуждение ожидающих на адресе
+ */
+uint32_t futex_wake(volatile uint32_t *addr, uint32_t count) {
+    wait_queue_t *wq = futex_queue(addr);
+    uint32_t flags = spin_lock_irqsave(&wq->lock);
+    uint32_t woken = wake_up_locked(wq, addr, count);
+    spin_unlock_irqrestore(&wq->lock, flags);
+    return woken;
+}
@@ -0,0 +1,40 @@
+/**
+ * @file futex.h
+ * @brief Ожидание и пробуждение по адресу
+ *
+ * Примитив в духе futex: поток засыпает на адресе слова, если слово
+ * все еще имеет ожидаемое значение, а другой поток, изменив слово,
+ * будит ожидающих на этом адресе. Очереди не привязаны к объектам:
+ * адрес хэшируется в одну из FUTEX_BUCKETS общих очередей, так что
+ * любое 32-битное слово может служить точкой синхронизации.
+ */
+
+#ifndef KERNEL_FUTEX_H
+#define KERNEL_FUTEX_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Количество очередей хэш-таблицы */
+#define FUTEX_HASH_BITS 6
+#define FUTEX_BUCKETS   (1u << FUTEX_HASH_BITS)
+
+/**
+ * @brief Ожидание на адресе
+ * @param addr Адрес слова
+ * @param expected Значение, при котором нужно засыпать
+ * @return 0 после пробуждения, -1 если слово уже не равно expected
+ *
+ * Пробуждение может быть ложным - вызывающий перечитывает слово.
+ */
+int futex_wait(volatile uint32_t *addr, uint32_t expected);
+
+/**
+ * @brief Пробуждение ожидающих на адресе
+ * @param addr Адрес слова
+ * @param count Сколько будить (WAKE_ALL - всех)
+ * @return Количество разбуженных
+ */
+uint32_t futex_wake(volatile uint32_t *addr, uint32_t count);
+
+#endif /* KERNEL_FUTEX_H */
@@ -0,0 +1,158 @@
+/**
+ * @file lockstat.c
+ * @brief Статистика блокировок
+ *
+ * Статистика попадает в общий список при первом захвате после
+ * включения сбора; список только растет и меняется через CAS,
+ * поэтому вывод обходит его без блокировки.
+ */
+
+#include "lockstat.h"
+#include "../cpu/cpu.h"
+#include "../cpu/tsc.h"
+#include "../lib/math64.h"
+#include "../video/video.h"
+#include <stddef.h>
+
+volatile int lockstat_active = 0;
+
+/* Все блокировки, захватывавшиеся при включенном сборе */
+static lockstat_t * volatile lockstat_list = NULL;
+
+/**
+ * @brief Включение сбора статистики (если есть TSC)
+ */
+int lockstat_enable(void) {
+    if (!cpu_has_edx(CPUID_EDX_TSC)) {
+        return -1;
+    }
+    lockstat_active = 1;
+    return 0;
+}
+
+/**
+ * @brief Выключение сбора статистики
+ */
+void lockstat_disable(void) {
+    lockstat_active = 0;
+}
+
+/**
+ * @brief Добавление статистики в общий список
+ */
+static void lockstat_register(lockstat_t *stat) {
+    if (stat->registered || !__sync_bool_compare_and_swap(&stat->registered, 0, 1)) {
+        return;
+    }
+    
+    lockstat_t *head;
+    do {
+        head = lockstat_list;
+        stat->next = head;
+    } while (!__sync_bool_compare_and_swap(&lockstat_list, head, stat));
+}
+
+/**
+ * @brief Начало ожидания блокировки
+ */
+uint64_t lockstat_wait_begin(lockstat_t *stat) {
+    return (stat && lockstat_active) ? rdtsc() : 0;
+}
+
+/**
+ * @brief Учет захвата и ожидания
+ * @return TSC момента захвата
+ */
+static uint64_t lockstat_count(lockstat_t *stat, uint64_t wait_start) {
+    lockstat_register(stat);
+    
+    uint64_t now = rdtsc();
+    __sync_fetch_and_add(&stat->acquisitions, 1);
+    if (wait_start) {
+        uint32_t waited = (uint32_t)(now - wait_start);
+        __sync_fetch_and_add(&stat->contended, 1);
+        stat->wait_cycles += waited;
+        if (waited > stat->max_wait) {
+            stat->max_wait = waited;
+        }
+    }
+    return now;
+}
+
+/**
+ * @brief Захват блокировки
+ */
+void lockstat_acquired(lockstat_t *stat, uint64_t wait_start) {
+    stat->hold_start = lockstat_count(stat, wait_start);
+}
+
+/**
+ * @brief Захват без исключительного владения (читатель rwlock)
+ */
+void lockstat_acquired_shared(lockstat_t *stat, uint64_t wait_start) {
+    lockstat_count(stat, wait_start);
+}
+
+/**
+ * @brief Освобождение блокировки (учет времени удержания)
+ */
+void lockstat_released(lockstat_t *stat) {
+    /* Сбор могли включить, пока блокировка была захвачена */
+    if (!stat->hold_start) {
+        return;
+    }
+    
+    uint32_t held = (uint32_t)(rdtsc() - stat->hold_start);
+    stat->hold_start = 0;
+    if (held > stat->max_hold) {
+        stat->max_hold = held;
+    }
+}
+
+/**
+ * @brief Сброс счетчиков всех блокировок
+ */
+void lockstat_reset(void) {
+    for (lockstat_t *stat = lockstat_list; stat; stat = stat->next) {
+        stat->acquisitions = 0;
+        stat->contended = 0;
+        stat->wait_cycles = 0;
+        stat->max_wait = 0;
+        stat->max_hold = 0;
+    }
+}
+
+/**
+ * @brief Вывод тактов в наносекундах
+ */
+static void lockstat_print_ns(uint64_t cycles) {
+    print_dec((uint32_t)tsc_cycles_to_ns(cycles));
+    print_string(" ns");
+}
+
+/**
+ * @brief Вывод статистики блокировок
+ */
+void lockstat_dump(void) {
+    if (!lockstat_active) {
+        print_string("Lock statistics are disabled\n");
+        return;
+    }
+    
+    print_string("Locks (name: acquired, contended, avg wait, max wait, max hold):\n");
+    for (lockstat_t *stat = lockstat_list; stat; stat = stat->next) {
+        print_string("  - ");
+        print_string(stat->name);
+        print_string(": ");
+        print_dec(stat->acquisitions);
+        print_string(", ");
+        print_dec(stat->contended);
+        print_string(", ");
+        lockstat_print_ns(stat->contended ? div_u64(stat->wait_cycles, stat->contended) : 0);
+        print_string(", ");
+        lockstat_print_ns(stat->max_wait);
+        print_string(", ");
+        lockstat_print_ns(stat->max_hold);
+        print_string("\n");
+    }
+}
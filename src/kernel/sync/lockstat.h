@@ -0,0 +1,85 @@
+/**
+ * @file lockstat.h
+ * @brief Статистика блокировок
+ *
+ * Блокировка, созданная с указателем на lockstat_t, считает захваты,
+ * захваты с ожиданием, суммарное время ожидания и максимальное время
+ * удержания (в тактах TSC). Сбор включается lockstat_enable(); пока
+ * он выключен, каждый захват платит одной проверкой флага.
+ */
+
+#ifndef KERNEL_LOCKSTAT_H
+#define KERNEL_LOCKSTAT_H
+
+#include <stdint.h>
+
+/**
+ * @brief Статистика одной блокировки
+ *
+ * Счетчики меняются под самой блокировкой; исключение - читатели
+ * rwlock: для них время удержания не учитывается, а время ожидания
+ * приблизительно.
+ */
+typedef struct lockstat {
+    const char *name;             /* Имя для вывода */
+    volatile uint32_t acquisitions;
+    volatile uint32_t contended;  /* Захваты, которым пришлось ждать */
+    uint64_t wait_cycles;         /* Суммарное время ожидания */
+    uint32_t max_wait;            /* Самое долгое ожидание */
+    uint32_t max_hold;            /* Самое долгое удержание */
+    uint64_t hold_start;          /* TSC последнего захвата (0 - не учтен) */
+    volatile uint32_t registered; /* Уже в общем списке */
+    struct lockstat *next;        /* Общий список статистики */
+} lockstat_t;
+
+/* Статический инициализатор */
+#define LOCKSTAT_INIT(lock_name) { lock_name, 0, 0, 0, 0, 0, 0, 0, 0 }
+
+/* Сбор включен (читается в быстром пути блокировок) */
+extern volatile int lockstat_active;
+
+/**
+ * @brief Включение сбора статистики (если есть TSC)
+ * @return 0 при успехе, -1 без TSC
+ */
+int lockstat_enable(void);
+
+/**
+ * @brief Выключение сбора статистики
+ */
+void lockstat_disable(void);
+
+/**
+ * @brief Начало ожидания блокировки
+ * @return TSC начала или 0, если сбор выключен
+ */
+uint64_t lockstat_wait_begin(lockstat_t *stat);
+
+/**
+ * @brief Захват блокировки
+ * @param stat Статистика блокировки
+ * @param wait_start Результат lockstat_wait_begin() или 0 без ожидания
+ */
+void lockstat_acquired(lockstat_t *stat, uint64_t wait_start);
+
+/**
+ * @brief Захват без исключительного владения (читатель rwlock)
+ */
+void lockstat_acquired_shared(lockstat_t *stat, uint64_t wait_start);
+
+/**
+ * @brief Освобождение блокировки (учет времени удержания)
+ */
+void lockstat_released(lockstat_t *stat);
+
+/**
+ * @brief Сброс счетчиков всех блокировок
+ */
+void lockstat_reset(void);
+
+/**
+ * @brief Вывод статистики блокировок
+ */
+void lockstat_dump(void);
+
+#endif /* KERNEL_LOCKSTAT_H */
@@ -0,0 +1,72 @@
+/**
+ * @file mcs.c
+ * @brief Очередная блокировка MCS
+ */
+
+#include "mcs.h"
+
+/**
+ * @brief Захват блокировки
+ */
+void mcs_lock(mcs_lock_t *lock, mcs_node_t *node) {
+    node->next = NULL;
+    node->locked = 1;
+    
+    mcs_node_t *prev = __sync_lock_test_and_set(&lock->tail, node);
+    if (!prev) {
+        if (lock->stat && lockstat_active) {
+            lockstat_acquired(lock->stat, 0);
+        }
+        return;
+    }
+    
+    /* Встаем за предыдущим и ждем, пока он передаст блокировку */
+    uint64_t wait_start = lockstat_wait_begin(lock->stat);
+    prev->next = node;
+    while (node->locked) {
+        __asm__ volatile("pause" : : : "memory");
+    }
+    
+    if (wait_start) {
+        lockstat_acquired(lock->stat, wait_start);
+    }
+}
+
+/**
+ * @brief Попытка захвата без ожидания
+ */
+int mcs_trylock(mcs_lock_t *lock, mcs_node_t *node) {
+    node->next = NULL;
+    node->locked = 0;
+    
+    if (!__sync_bool_compare_and_swap(&lock->tail, NULL, node)) {
+        return 0;
+    }
+    if (lock->stat && lockstat_active) {
+        lockstat_acquired(lock->stat, 0);
+    }
+    return 1;
+}
+
+/**
+ * @brief Освобождение блокировки
+ */
+void mcs_unlock(mcs_lock_t *lock, mcs_node_t *node) {
+    if (lock->stat && lockstat_active) {
+        lockstat_released(lock->stat);
+    }
+    
+    if (!node->next) {
+        /* Очереди нет - освобождаем блокировку */
+        if (__sync_bool_compare_and_swap(&lock->tail, node, NULL)) {
+            return;
+        }
+        
+        /* Следующий уже встал в хвост, но еще не связал узлы */
+        while (!node->next) {
+            __asm__ volatile("pause" : : : "memory");
+        }
+    }
+    
+    node->next->locked = 0;
+}
@@ -0,0 +1,84 @@
+/**
+ * @file mcs.h
+ * @brief Очередная блокировка MCS
+ *
+ * Каждый ожидающий процессор крутится на флаге в собственном узле
+ * очереди, а не на общем слове блокировки, поэтому при высокой
+ * конкуренции строка кэша блокировки не мечется между процессорами:
+ * освобождение трогает только узел следующего. Узел живет на стеке
+ * вызывающего от захвата до освобождения.
+ */
+
+#ifndef KERNEL_MCS_H
+#define KERNEL_MCS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "lockstat.h"
+#include "../cpu/cpu.h"
+
+/**
+ * @brief Узел очереди MCS
+ */
+typedef struct mcs_node {
+    struct mcs_node * volatile next;  /* Следующий ожидающий */
+    volatile uint32_t locked;         /* 1 - ждать, 0 - блокировка передана */
+} mcs_node_t;
+
+/**
+ * @brief Блокировка MCS
+ */
+typedef struct {
+    mcs_node_t * volatile tail;       /* Последний в очереди (NULL - свободна) */
+    lockstat_t *stat;                 /* Статистика (NULL - без нее) */
+} mcs_lock_t;
+
+/* Статические инициализаторы */
+#define MCS_LOCK_INIT { NULL, NULL }
+#define MCS_LOCK_INIT_STAT(lock_stat) { NULL, lock_stat }
+
+/**
+ * @brief Захват блокировки
+ * @param lock Блокировка
+ * @param node Узел очереди вызывающего
+ */
+void mcs_lock(mcs_lock_t *lock, mcs_node_t *node);
+
+/**
+ * @brief Попытка захвата без ожидания
+ * @return 1 если блокировка захвачена
+ */
+int mcs_trylock(mcs_lock_t *lock, mcs_node_t *node);
+
+/**
+ * @brief Освобождение блокировки
+ * @param lock Блокировка
+ * @param node Узел, с которым блокировка захватывалась
+ */
+void mcs_unlock(mcs_lock_t *lock, mcs_node_t *node);
+
+/**
+ * @brief Захват блокировки с запретом прерываний
+ */
+static inline uint32_t mcs_lock_irqsave_at(mcs_lock_t *lock, mcs_node_t *node,
+                                           const char *file, uint32_t line) {
+    uint32_t flags = cpu_irq_save_at(file, line);
+    mcs_lock(lock, node);
+    return flags;
+}
+
+/**
+ * @brief Захват блокировки с запретом прерываний
+ * @return Значение EFLAGS до запрета
+ */
+#define mcs_lock_irqsave(lock, node) mcs_lock_irqsave_at(lock, node, __FILE__, __LINE__)
+
+/**
+ * @brief Освобождение блокировки и восстановление прерываний
+ */
+static inline void mcs_unlock_irqrestore(mcs_lock_t *lock, mcs_node_t *node, uint32_t flags) {
+    mcs_unlock(lock, node);
+    cpu_irq_restore(flags);
+}
+
+#endif /* KERNEL_MCS_H */
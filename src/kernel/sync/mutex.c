@@ -0,0 +1,79 @@
+/**
+ * @file mutex.c
+ * @brief Адаптивный мьютекс
+ *
+ * Слово состояния устроено как у futex-мьютекса: быстрый путь
+ * захвата и освобождения - одна атомарная операция без блокировки
+ * очереди. Спящий ожидающий выставляет MUTEX_CONTENDED, и только
+ * тогда освобождение идет будить очередь.
+ */
+
+#include "mutex.h"
+#include "../sched/sched.h"
+
+/**
+ * @brief Инициализация мьютекса
+ */
+void mutex_init(mutex_t *mutex) {
+    mutex->state = MUTEX_UNLOCKED;
+    mutex->owner = NULL;
+    wait_queue_init(&mutex->waiters);
+}
+
+/**
+ * @brief Выполняется ли владелец мьютекса
+ *
+ * Владелец может завершиться сразу после освобождения; его описатель
+ * при этом лишь читается, поэтому худший исход - лишнее вращение.
+ */
+static int mutex_owner_running(mutex_t *mutex) {
+    kthread_t *owner = mutex->owner;
+    return owner && owner->state == KTHREAD_RUNNING;
+}
+
+/**
+ * @brief Захват мьютекса
+ */
+void mutex_lock(mutex_t *mutex) {
+    if (__sync_bool_compare_and_swap(&mutex->state, MUTEX_UNLOCKED, MUTEX_LOCKED)) {
+        mutex->owner = kthread_current();
+        return;
+    }
+    
+    /* Владелец работает - вероятно, скоро освободит */
+    for (uint32_t spins = 0; spins < MUTEX_SPIN_LIMIT && mutex_owner_running(mutex); spins++) {
+        if (mutex->state == MUTEX_UNLOCKED &&
+            __sync_bool_compare_and_swap(&mutex->state, MUTEX_UNLOCKED, MUTEX_LOCKED)) {
+            mutex->owner = kthread_current();
+            return;
+        }
+        __asm__ volatile("pause" : : : "memory");
+    }
+    
+    /* Захват с пометкой о спящих: освобождение разбудит очередь.
+     * Пометка остается и после захвата - в очереди могут быть другие */
+    wait_event(&mutex->waiters,
+               __sync_lock_test_and_set(&mutex->state, MUTEX_CONTENDED) == MUTEX_UNLOCKED);
+    mutex->owner = kthread_current();
+}
+
+/**
+ * @brief Попытка захвата без ожидания
+ */
+int mutex_trylock(mutex_t *mutex) {
+    if (!__sync_bool_compare_and_swap(&mutex->state, MUTEX_UNLOCKED, MUTEX_LOCKED)) {
+        return 0;
+    }
+    mutex->owner = kthread_current();
+    return 1;
+}
+
+/**
+ * @brief Освобождение мьютекса
+ */
+void mutex_unlock(mutex_t *mutex) {
+    mutex->owner = NULL;
+    if (__sync_lock_test_and_set(&mutex->state, MUTEX_UNLOCKED) == MUTEX_CONTENDED) {
+        wake_up_one(&mutex->waiters);
+    }
+}
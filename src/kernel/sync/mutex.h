@@ -0,0 +1,60 @@
+/**
+ * @file mutex.h
+ * @brief Адаптивный мьютекс
+ *
+ * Мьютекс для потоков: занятый мьютекс сначала ожидается вращением,
+ * пока его владелец выполняется на другом процессоре (обычно он скоро
+ * освободит), а затем поток засыпает в очереди ожидания. Захватывать
+ * можно только там, где разрешено блокироваться, - не в обработчиках
+ * прерываний; освобождает мьютекс тот же поток, что захватил.
+ */
+
+#ifndef KERNEL_MUTEX_H
+#define KERNEL_MUTEX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "waitqueue.h"
+
+/* Состояния слова мьютекса */
+#define MUTEX_UNLOCKED  0
+#define MUTEX_LOCKED    1
+#define MUTEX_CONTENDED 2   /* Захвачен, и в очереди могут быть ожидающие */
+
+/* Предел вращения перед сном, итераций pause */
+#define MUTEX_SPIN_LIMIT 4096
+
+/**
+ * @brief Мьютекс
+ */
+typedef struct {
+    volatile uint32_t state;          /* MUTEX_* */
+    struct kthread * volatile owner;  /* Владелец (для адаптивного вращения) */
+    wait_queue_t waiters;
+} mutex_t;
+
+/* Статический инициализатор */
+#define MUTEX_INIT { MUTEX_UNLOCKED, NULL, WAIT_QUEUE_INIT }
+
+/**
+ * @brief Инициализация мьютекса
+ */
+void mutex_init(mutex_t *mutex);
+
+/**
+ * @brief Захват мьютекса
+ */
+void mutex_lock(mutex_t *mutex);
+
+/**
+ * @brief Попытка захвата без ожидания
+ * @return 1 если мьютекс захвачен
+ */
+int mutex_trylock(mutex_t *mutex);
+
+/**
+ * @brief Освобождение мьютекса
+ */
+void mutex_unlock(mutex_t *mutex);
+
+#endif /* KERNEL_MUTEX_H */
@@ -0,0 +1,78 @@
+/**
+ * @file rwlock.c
+ * @brief Спин-блокировка читателей-писателей
+ */
+
+#include "rwlock.h"
+
+/**
+ * @brief Захват на чтение
+ */
+void read_lock(rwlock_t *lock) {
+    uint64_t wait_start = 0;
+    
+    while (1) {
+        uint32_t value = lock->value;
+        if (!(value & (RWLOCK_WRITER | RWLOCK_WAITING)) &&
+            __sync_bool_compare_and_swap(&lock->value, value, value + 1)) {
+            break;
+        }
+        if (!wait_start) {
+            wait_start = lockstat_wait_begin(lock->stat);
+        }
+        __asm__ volatile("pause" : : : "memory");
+    }
+    
+    if (lock->stat && lockstat_active) {
+        lockstat_acquired_shared(lock->stat, wait_start);
+    }
+}
+
+/**
+ * @brief Освобождение после чтения
+ */
+void read_unlock(rwlock_t *lock) {
+    __sync_fetch_and_sub(&lock->value, 1);
+}
+
+/**
+ * @brief Захват на запись
+ */
+void write_lock(rwlock_t *lock) {
+    uint64_t wait_start = 0;
+    
+    while (1) {
+        uint32_t value = lock->value;
+        
+        /* Ни читателей, ни писателя: флаг ожидания можно снять */
+        if (!(value & ~RWLOCK_WAITING) &&
+            __sync_bool_compare_and_swap(&lock->value, value, RWLOCK_WRITER)) {
+            break;
+        }
+        
+        /* Закрываем вход новым читателям */
+        if (!(value & RWLOCK_WAITING)) {
+            __sync_fetch_and_or(&lock->value, RWLOCK_WAITING);
+        }
+        if (!wait_start) {
+            wait_start = lockstat_wait_begin(lock->stat);
+        }
+        __asm__ volatile("pause" : : : "memory");
+    }
+    
+    if (lock->stat && lockstat_active) {
+        lockstat_acquired(lock->stat, wait_start);
+    }
+}
+
+/**
+ * @brief Освобождение после записи
+ *
+ * Флаг ожидания, выставленный другим писателем, сохраняется.
+ */
+void write_unlock(rwlock_t *lock) {
+    if (lock->stat && lockstat_active) {
+        lockstat_released(lock->stat);
+    }
+    __sync_fetch_and_and(&lock->value, ~RWLOCK_WRITER);
+}
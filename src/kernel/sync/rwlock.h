@@ -0,0 +1,97 @@
+/**
+ * @file rwlock.h
+ * @brief Спин-блокировка читателей-писателей
+ *
+ * Читатели входят одновременно, писатель - только один и только
+ * когда читателей нет. Ожидающий писатель выставляет флаг, после
+ * которого новые читатели не входят, - поток читателей не может
+ * отложить запись навсегда. Рекурсивный захват на чтение, пока
+ * писатель ждет, приводит к взаимоблокировке.
+ */
+
+#ifndef KERNEL_RWLOCK_H
+#define KERNEL_RWLOCK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "lockstat.h"
+#include "../cpu/cpu.h"
+
+/* Биты слова блокировки; младшие биты - число читателей */
+#define RWLOCK_WRITER  0x80000000
+#define RWLOCK_WAITING 0x40000000
+
+/**
+ * @brief Блокировка читателей-писателей
+ */
+typedef struct {
+    volatile uint32_t value;          /* Читатели и флаги писателя */
+    lockstat_t *stat;                 /* Статистика (NULL - без нее) */
+} rwlock_t;
+
+/* Статические инициализаторы */
+#define RWLOCK_INIT { 0, NULL }
+#define RWLOCK_INIT_STAT(lock_stat) { 0, lock_stat }
+
+/**
+ * @brief Захват на чтение
+ */
+void read_lock(rwlock_t *lock);
+
+/**
+ * @brief Освобождение после чтения
+ */
+void read_unlock(rwlock_t *lock);
+
+/**
+ * @brief Захват на запись
+ */
+void write_lock(rwlock_t *lock);
+
+/**
+ * @brief Освобождение после записи
+ */
+void write_unlock(rwlock_t *lock);
+
+/**
+ * @brief Захват на чтение с запретом прерываний
+ */
+static inline uint32_t read_lock_irqsave_at(rwlock_t *lock, const char *file, uint32_t line) {
+    uint32_t flags = cpu_irq_save_at(file, line);
+    read_lock(lock);
+    return flags;
+}
+
+/**
+ * @brief Захват на запись с запретом прерываний
+ */
+static inline uint32_t write_lock_irqsave_at(rwlock_t *lock, const char *file, uint32_t line) {
+    uint32_t flags = cpu_irq_save_at(file, line);
+    write_lock(lock);
+    return flags;
+}
+
+/**
+ * @brief Захват с запретом прерываний
+ * @return Значение EFLAGS до запрета
+ */
+#define read_lock_irqsave(lock) read_lock_irqsave_at(lock, __FILE__, __LINE__)
+#define write_lock_irqsave(lock) write_lock_irqsave_at(lock, __FILE__, __LINE__)
+
+/**
+ * @brief Освобождение после чтения и восстановление прерываний
+ */
+static inline void read_unlock_irqrestore(rwlock_t *lock, uint32_t flags) {
+    read_unlock(lock);
+    cpu_irq_restore(flags);
+}
+
+/**
+ * @brief Освобождение после записи и восстановление прерываний
+ */
+static inline void write_unlock_irqrestore(rwlock_t *lock, uint32_t flags) {
+    write_unlock(lock);
+    cpu_irq_restore(flags);
+}
+
+#endif /* KERNEL_RWLOCK_H */
@@ -0,0 +1,53 @@
+/**
+ * @file semaphore.c
+ * @brief Считающий семафор
+ *
+ * Счетчик меняется только под блокировкой очереди ожидания:
+ * проверка и засыпание в sem_down() атомарны относительно sem_up().
+ */
+
+#include "semaphore.h"
+
+/**
+ * @brief Инициализация семафора
+ */
+void sem_init(semaphore_t *sem, uint32_t count) {
+    sem->count = count;
+    wait_queue_init(&sem->waiters);
+}
+
+/**
+ * @brief Захват единицы с ожиданием
+ */
+void sem_down(semaphore_t *sem) {
+    uint32_t flags = spin_lock_irqsave(&sem->waiters.lock);
+    while (!sem->count) {
+        wait_queue_sleep(&sem->waiters, NULL);
+    }
+    sem->count--;
+    spin_unlock_irqrestore(&sem->waiters.lock, flags);
+}
+
+/**
+ * @brief Захват единицы без ожидания
+ */
+int sem_trydown(semaphore_t *sem) {
+    int taken = 0;
+    uint32_t flags = spin_lock_irqsave(&sem->waiters.lock);
+    if (sem->count) {
+        sem->count--;
+        taken = 1;
+    }
+    spin_unlock_irqrestore(&sem->waiters.lock, flags);
+    return taken;
+}
+
+/**
+ * @brief Возврат единицы
+ */
+void sem_up(semaphore_t *sem) {
+    uint32_t flags = spin_lock_irqsave(&sem->waiters.lock);
+    sem->count++;
+    wake_up_locked(&sem->waiters, NULL, 1);
+    spin_unlock_irqrestore(&sem->waiters.lock, flags);
+}
@@ -0,0 +1,52 @@
+/**
+ * @file semaphore.h
+ * @brief Считающий семафор
+ *
+ * down() уменьшает счетчик или засыпает, пока он равен нулю;
+ * up() увеличивает счетчик и будит одного ожидающего. up() можно
+ * вызывать из обработчиков прерываний - так драйвер сообщает потоку
+ * о готовности данных.
+ */
+
+#ifndef KERNEL_SEMAPHORE_H
+#define KERNEL_SEMAPHORE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "waitqueue.h"
+
+/**
+ * @brief Семафор
+ */
+typedef struct {
+    volatile uint32_t count;          /* Свободные единицы */
+    wait_queue_t waiters;
+} semaphore_t;
+
+/* Статический инициализатор */
+#define SEMAPHORE_INIT(value) { value, WAIT_QUEUE_INIT }
+
+/**
+ * @brief Инициализация семафора
+ * @param sem Семафор
+ * @param count Начальное значение счетчика
+ */
+void sem_init(semaphore_t *sem, uint32_t count);
+
+/**
+ * @brief Захват единицы с ожиданием
+ */
+void sem_down(semaphore_t *sem);
+
+/**
+ * @brief Захват единицы без ожидания
+ * @return 1 если единица получена
+ */
+int sem_trydown(semaphore_t *sem);
+
+/**
+ * @brief Возврат единицы
+ */
+void sem_up(semaphore_t *sem);
+
+#endif /* KERNEL_SEMAPHORE_H */
@@ -0,0 +1,21 @@
+/**
+ * @file spinlock.c
+ * @brief Медленный путь билетной блокировки
+ */
+
+#include "spinlock.h"
+
+/**
+ * @brief Ожидание своего билета (медленный путь spin_lock)
+ */
+void spin_lock_wait(spinlock_t *lock, uint16_t ticket) {
+    uint64_t wait_start = lockstat_wait_begin(lock->stat);
+    
+    while (lock->tickets.owner != ticket) {
+        __asm__ volatile("pause" : : : "memory");
+    }
+    
+    if (wait_start) {
+        lockstat_acquired(lock->stat, wait_start);
+    }
+}
@@ -0,0 +1,140 @@
+/**
+ * @file spinlock.h
+ * @brief Спин-блокировки для данных, общих для нескольких процессоров
+ *
+ * Билетная блокировка: захват - один xadd, выдающий номер в очереди,
+ * ожидание - чтение номера владельца с pause. Процессоры получают
+ * блокировку строго в порядке обращения, поэтому никто не голодает.
+ * Варианты _irqsave дополнительно запрещают прерывания на текущем
+ * процессоре и годятся для данных, к которым обращаются обработчики
+ * прерываний. Для сильно нагруженных блокировок - mcs.h, для данных,
+ * которые в основном читают, - rwlock.h.
+ */
+
+#ifndef KERNEL_SPINLOCK_H
+#define KERNEL_SPINLOCK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "lockstat.h"
+#include "../cpu/cpu.h"
+
+/**
+ * @brief Билетная спин-блокировка
+ *
+ * Оба номера лежат в одном слове: owner - младшие 16 бит,
+ * next - старшие, так что взятие билета и проверка - один xadd.
+ */
+typedef struct {
+    union {
+        volatile uint32_t value;
+        struct {
+            volatile uint16_t owner;  /* Билет владельца */
+            volatile uint16_t next;   /* Следующий свободный билет */
+        } tickets;
+    };
+    lockstat_t *stat;                 /* Статистика (NULL - без нее) */
+} spinlock_t;
+
+/* Статические инициализаторы */
+#define SPINLOCK_INIT { { 0 }, NULL }
+#define SPINLOCK_INIT_STAT(lock_stat) { { 0 }, lock_stat }
+
+/* Прибавка к value, выдающая следующий билет */
+#define SPINLOCK_TICKET_INC 0x10000
+
+/**
+ * @brief Ожидание своего билета (медленный путь spin_lock)
+ * @param lock Блокировка
+ * @param ticket Полученный билет
+ */
+void spin_lock_wait(spinlock_t *lock, uint16_t ticket);
+
+/**
+ * @brief Захват блокировки
+ * @param lock Блокировка
+ */
+static inline void spin_lock(spinlock_t *lock) {
+    uint32_t old = __sync_fetch_and_add(&lock->value, SPINLOCK_TICKET_INC);
+    uint16_t ticket = (uint16_t)(old >> 16);
+    
+    if ((uint16_t)old != ticket) {
+        spin_lock_wait(lock, ticket);
+    } else if (lock->stat && lockstat_active) {
+        lockstat_acquired(lock->stat, 0);
+    }
+}
+
+/**
+ * @brief Попытка захвата без ожидания
+ * @param lock Блокировка
+ * @return 1 если блокировка захвачена
+ */
+static inline int spin_trylock(spinlock_t *lock) {
+    uint32_t old = lock->value;
+    
+    if ((uint16_t)old != (uint16_t)(old >> 16) ||
+        !__sync_bool_compare_and_swap(&lock->value, old, old + SPINLOCK_TICKET_INC)) {
+        return 0;
+    }
+    if (lock->stat && lockstat_active) {
+        lockstat_acquired(lock->stat, 0);
+    }
+    return 1;
+}
+
+/**
+ * @brief Освобождение блокировки
+ * @param lock Блокировка
+ *
+ * owner меняет только владелец; на x86 запись и так упорядочена
+ * после записей критической секции, нужен лишь барьер компилятора.
+ */
+static inline void spin_unlock(spinlock_t *lock) {
+    if (lock->stat && lockstat_active) {
+        lockstat_released(lock->stat);
+    }
+    __asm__ volatile("" : : : "memory");
+    lock->tickets.owner++;
+}
+
+/**
+ * @brief Проверка, захвачена ли блокировка
+ */
+static inline int spin_is_locked(spinlock_t *lock) {
+    uint32_t value = lock->value;
+    return (uint16_t)value != (uint16_t)(value >> 16);
+}
+
+/**
+ * @brief Захват блокировки с запретом прерываний
+ */
+static inline uint32_t spin_lock_irqsave_at(spinlock_t *lock, const char *file, uint32_t line) {
+    uint32_t flags = cpu_irq_save_at(file, line);
+    spin_lock(lock);
+    return flags;
+}
+
+/**
+ * @brief Захват блокировки с запретом прерываний
+ * @param lock Блокировка
+ * @return Значение EFLAGS до запрета
+ */
+#define spin_lock_irqsave(lock) spin_lock_irqsave_at(lock, __FILE__, __LINE__)
+
+/**
+ * @brief Освобождение блокировки и восстановление прерываний
+ * @param lock Блокировка
+ * @param flags Значение, возвращенное spin_lock_irqsave()
+ */
+static inline void spin_unlock_irqrestore(spinlock_t *lock, uint32_t flags) {
+    spin_unlock(lock);
+    cpu_irq_restore(flags);
+}
+
+/**
+ * @brief Проверка блокировок под конкуренцией (sync_test.c)
+ */
+void run_sync_tests(void);
+
+#endif /* KERNEL_SPINLOCK_H */
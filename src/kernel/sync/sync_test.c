@@ -0,0 +1,421 @@
+/**
+ * @file sync_test.c
+ * @brief Проверка блокировок под конкуренцией
+ *
+ * На каждом процессоре работает поток, который увеличивает общий
+ * счетчик под проверяемой блокировкой. Потерянное увеличение
+ * означает нарушение взаимного исключения. Заодно выводится средняя
+ * стоимость пары захват-освобождение и статистика блокировок.
+ * Спящие примитивы проверяются ограниченным буфером производителей
+ * и потребителей и пинг-понгом двух потоков на futex.
+ */
+
+#include "spinlock.h"
+#include "mcs.h"
+#include "rwlock.h"
+#include "mutex.h"
+#include "semaphore.h"
+#include "condvar.h"
+#include "futex.h"
+#include "../cpu/cpu.h"
+#include "../cpu/tsc.h"
+#include "../lib/math64.h"
+#include "../sched/sched.h"
+#include "../time/hrtimer.h"
+#include "../video/video.h"
+#include <stddef.h>
+
+/* Захватов в каждом потоке */
+#define SYNC_TEST_ITERATIONS 20000
+/* Элементов от каждого производителя */
+#define SYNC_TEST_ITEMS 2000
+/* Емкость ограниченного буфера */
+#define SYNC_TEST_SLOTS 4
+/* Обменов в пинг-понге на futex */
+#define SYNC_TEST_ROUNDS 1000
+
+/**
+ * @brief Проверяемый вид блокировки
+ */
+typedef enum {
+    SYNC_TEST_TICKET,
+    SYNC_TEST_MCS,
+    SYNC_TEST_RWLOCK,
+    SYNC_TEST_MUTEX
+} sync_test_kind_t;
+
+static lockstat_t ticket_stat = LOCKSTAT_INIT("test ticket");
+static lockstat_t mcs_stat = LOCKSTAT_INIT("test mcs");
+static lockstat_t rwlock_stat = LOCKSTAT_INIT("test rwlock");
+
+static spinlock_t test_spinlock = SPINLOCK_INIT_STAT(&ticket_stat);
+static mcs_lock_t test_mcs = MCS_LOCK_INIT_STAT(&mcs_stat);
+static rwlock_t test_rwlock = RWLOCK_INIT_STAT(&rwlock_stat);
+static mutex_t test_mutex = MUTEX_INIT;
+
+static sync_test_kind_t test_kind;
+static volatile uint32_t test_counter;
+static volatile uint32_t test_started;
+static volatile uint32_t test_finished;
+static volatile int test_go;
+
+/**
+ * @brief Один захват проверяемой блокировки
+ *
+ * Увеличение нарочно не атомарное: без исключения
+ * его потеряют соседние процессоры.
+ */
+static void sync_test_increment(uint32_t i) {
+    switch (test_kind) {
+        case SYNC_TEST_TICKET:
+            spin_lock(&test_spinlock);
+            test_counter = test_counter + 1;
+            spin_unlock(&test_spinlock);
+            break;
+        case SYNC_TEST_MCS: {
+            mcs_node_t node;
+            mcs_lock(&test_mcs, &node);
+            test_counter = test_counter + 1;
+            mcs_unlock(&test_mcs, &node);
+            break;
+        }
+        case SYNC_TEST_RWLOCK:
+            /* Каждый восьмой захват - запись, остальные - чтение */
+            if (i % 8 == 0) {
+                write_lock(&test_rwlock);
+                test_counter = test_counter + 1;
+                write_unlock(&test_rwlock);
+            } else {
+                read_lock(&test_rwlock);
+                (void)test_counter;
+                read_unlock(&test_rwlock);
+            }
+            break;
+        case SYNC_TEST_MUTEX:
+            mutex_lock(&test_mutex);
+            test_counter = test_counter + 1;
+            mutex_unlock(&test_mutex);
+            break;
+    }
+}
+
+/**
+ * @brief Поток нагрузки
+ */
+static void sync_test_thread(void *arg) {
+    (void)arg;
+    
+    __sync_fetch_and_add(&test_started, 1);
+    while (!test_go) {
+        sched_yield();
+    }
+    
+    /* Спин-блокировки - без прерываний, чтобы вытеснение владельца
+     * не исказило замер; мьютекс проверяется с вытеснением */
+    int irqs_off = test_kind != SYNC_TEST_MUTEX;
+    uint32_t flags = irqs_off ? cpu_irq_save() : 0;
+    for (uint32_t i = 0; i < SYNC_TEST_ITERATIONS; i++) {
+        sync_test_increment(i);
+    }
+    if (irqs_off) {
+        cpu_irq_restore(flags);
+    }
+    
+    __sync_fetch_and_add(&test_finished, 1);
+}
+
+/**
+ * @brief Прогон одного вида блокировки
+ */
+static void sync_test_run(const char *name, sync_test_kind_t kind, uint32_t expected_per_thread) {
+    uint32_t threads = sched_cpu_count();
+    
+    print_string("\n=== ");
+    print_string(name);
+    print_string(" ===\n");
+    
+    test_kind = kind;
+    test_counter = 0;
+    test_started = 0;
+    test_finished = 0;
+    test_go = 0;
+    
+    /* По потоку на процессор; простаивающие перехватят их */
+    uint32_t created = 0;
+    for (uint32_t i = 0; i < threads; i++) {
+        created += kthread_create(sync_test_thread, NULL) != NULL;
+    }
+    if (!created) {
+        print_string_color("  Failed to create threads\n", COLOR_RED, COLOR_BLACK);
+        return;
+    }
+    while (test_started < created) {
+        sched_yield();
+    }
+    
+    uint64_t start = rdtsc();
+    test_go = 1;
+    while (test_finished < created) {
+        sched_sleep_ns(NSEC_PER_MSEC);
+    }
+    uint64_t cycles = rdtsc() - start;
+    
+    uint32_t expected = created * expected_per_thread;
+    print_string("  Threads: ");
+    print_dec(created);
+    print_string(", counter: ");
+    print_dec(test_counter);
+    print_string(" / ");
+    print_dec(expected);
+    if (test_counter == expected) {
+        print_string_color(" OK\n", COLOR_GREEN, COLOR_BLACK);
+    } else {
+        print_string_color(" LOST UPDATES\n", COLOR_RED, COLOR_BLACK);
+    }
+    
+    /* Время - общее по всем потокам, поэтому это пропускная способность */
+    print_string("  Per acquisition: ");
+    print_dec((uint32_t)div_u64(cycles, created * SYNC_TEST_ITERATIONS));
+    print_string(" cycles\n");
+}
+
+/* Ограниченный буфер: варианты синхронизации */
+typedef enum {
+    SYNC_BUFFER_SEMAPHORE,
+    SYNC_BUFFER_CONDVAR
+} sync_buffer_kind_t;
+
+static sync_buffer_kind_t buffer_kind;
+static uint32_t buffer_slots[SYNC_TEST_SLOTS];
+static uint32_t buffer_head;
+static uint32_t buffer_tail;
+static uint32_t buffer_count;
+static mutex_t buffer_mutex = MUTEX_INIT;
+static semaphore_t buffer_free;
+static semaphore_t buffer_used;
+static condvar_t buffer_not_full = CONDVAR_INIT;
+static condvar_t buffer_not_empty = CONDVAR_INIT;
+static volatile uint32_t buffer_sum;
+
+/**
+ * @brief Помещение элемента в ограниченный буфер
+ */
+static void sync_buffer_put(uint32_t value) {
+    if (buffer_kind == SYNC_BUFFER_SEMAPHORE) {
+        sem_down(&buffer_free);
+        mutex_lock(&buffer_mutex);
+    } else {
+        mutex_lock(&buffer_mutex);
+        while (buffer_count == SYNC_TEST_SLOTS) {
+            condvar_wait(&buffer_not_full, &buffer_mutex);
+        }
+    }
+    
+    buffer_slots[buffer_tail] = value;
+    buffer_tail = (buffer_tail + 1) % SYNC_TEST_SLOTS;
+    buffer_count++;
+    
+    mutex_unlock(&buffer_mutex);
+    if (buffer_kind == SYNC_BUFFER_SEMAPHORE) {
+        sem_up(&buffer_used);
+    } else {
+        condvar_signal(&buffer_not_empty);
+    }
+}
+
+/**
+ * @brief Извлечение элемента из ограниченного буфера
+ */
+static uint32_t sync_buffer_get(void) {
+    if (buffer_kind == SYNC_BUFFER_SEMAPHORE) {
+        sem_down(&buffer_used);
+        mutex_lock(&buffer_mutex);
+    } else {
+        mutex_lock(&buffer_mutex);
+        while (!buffer_count) {
+            condvar_wait(&buffer_not_empty, &buffer_mutex);
+        }
+    }
+    
+    uint32_t value = buffer_slots[buffer_head];
+    buffer_head = (buffer_head + 1) % SYNC_TEST_SLOTS;
+    buffer_count--;
+    
+    mutex_unlock(&buffer_mutex);
+    if (buffer_kind == SYNC_BUFFER_SEMAPHORE) {
+        sem_up(&buffer_free);
+    } else {
+        condvar_signal(&buffer_not_full);
+    }
+    return value;
+}
+
+/**
+ * @brief Производитель: значения 1..SYNC_TEST_ITEMS
+ */
+static void sync_producer_thread(void *arg) {
+    (void)arg;
+    
+    for (uint32_t i = 1; i <= SYNC_TEST_ITEMS; i++) {
+        sync_buffer_put(i);
+    }
+    __sync_fetch_and_add(&test_finished, 1);
+}
+
+/**
+ * @brief Потребитель: суммирует SYNC_TEST_ITEMS значений
+ */
+static void sync_consumer_thread(void *arg) {
+    (void)arg;
+    uint32_t sum = 0;
+    
+    for (uint32_t i = 0; i < SYNC_TEST_ITEMS; i++) {
+        sum += sync_buffer_get();
+    }
+    __sync_fetch_and_add(&buffer_sum, sum);
+    __sync_fetch_and_add(&test_finished, 1);
+}
+
+/**
+ * @brief Прогон ограниченного буфера: два производителя, два потребителя
+ */
+static void sync_buffer_run(const char *name, sync_buffer_kind_t kind) {
+    print_string("\n=== ");
+    print_string(name);
+    print_string(" ===\n");
+    
+    buffer_kind = kind;
+    buffer_head = 0;
+    buffer_tail = 0;
+    buffer_count = 0;
+    buffer_sum = 0;
+    sem_init(&buffer_free, SYNC_TEST_SLOTS);
+    sem_init(&buffer_used, 0);
+    test_finished = 0;
+    
+    uint32_t created = 0;
+    for (uint32_t i = 0; i < 2; i++) {
+        created += kthread_create(sync_producer_thread, NULL) != NULL;
+        created += kthread_create(sync_consumer_thread, NULL) != NULL;
+    }
+    if (created != 4) {
+        /* Без пары недостающий поток никогда не завершится */
+        print_string_color("  Failed to create threads\n", COLOR_RED, COLOR_BLACK);
+        return;
+    }
+    
+    uint64_t start = hrtimer_now_ns();
+    while (test_finished < created) {
+        sched_sleep_ns(NSEC_PER_MSEC);
+    }
+    uint64_t elapsed = hrtimer_now_ns() - start;
+    
+    uint32_t expected = SYNC_TEST_ITEMS * (SYNC_TEST_ITEMS + 1);
+    print_string("  Items: ");
+    print_dec(2 * SYNC_TEST_ITEMS);
+    print_string(", sum: ");
+    print_dec(buffer_sum);
+    print_string(" / ");
+    print_dec(expected);
+    if (buffer_sum == expected) {
+        print_string_color(" OK\n", COLOR_GREEN, COLOR_BLACK);
+    } else {
+        print_string_color(" MISMATCH\n", COLOR_RED, COLOR_BLACK);
+    }
+    print_string("  Per item: ");
+    print_dec((uint32_t)div_u64(elapsed, 2 * SYNC_TEST_ITEMS));
+    print_string(" ns\n");
+}
+
+/* Слово пинг-понга: 0 - ход первого потока, 1 - второго */
+static volatile uint32_t futex_word;
+
+/**
+ * @brief Поток пинг-понга на futex
+ * @param arg Номер потока (0 или 1)
+ */
+static void sync_futex_thread(void *arg) {
+    uint32_t me = (uint32_t)arg;
+    
+    for (uint32_t i = 0; i < SYNC_TEST_ROUNDS; i++) {
+        uint32_t value;
+        while ((value = futex_word) != me) {
+            futex_wait(&futex_word, value);
+        }
+        futex_word = me ^ 1;
+        futex_wake(&futex_word, 1);
+    }
+    __sync_fetch_and_add(&test_finished, 1);
+}
+
+/**
+ * @brief Пинг-понг двух потоков на futex
+ */
+static void sync_futex_run(void) {
+    print_string("\n=== Futex ping-pong ===\n");
+    
+    /* Несовпадающее значение - немедленный отказ без сна */
+    futex_word = 1;
+    int refused = futex_wait(&futex_word, 0) == -1;
+    print_string("  Stale value refused: ");
+    if (refused) {
+        print_string_color("OK\n", COLOR_GREEN, COLOR_BLACK);
+    } else {
+        print_string_color("FAILED\n", COLOR_RED, COLOR_BLACK);
+    }
+    
+    futex_word = 0;
+    test_finished = 0;
+    uint32_t created = 0;
+    created += kthread_create(sync_futex_thread, (void*)0) != NULL;
+    created += kthread_create(sync_futex_thread, (void*)1) != NULL;
+    if (created != 2) {
+        print_string_color("  Failed to create threads\n", COLOR_RED, COLOR_BLACK);
+        return;
+    }
+    
+    uint64_t start = hrtimer_now_ns();
+    while (test_finished < created) {
+        sched_sleep_ns(NSEC_PER_MSEC);
+    }
+    uint64_t elapsed = hrtimer_now_ns() - start;
+    
+    print_string("  Rounds: ");
+    print_dec(SYNC_TEST_ROUNDS);
+    print_string(", per exchange: ");
+    print_dec((uint32_t)div_u64(elapsed, 2 * SYNC_TEST_ROUNDS));
+    print_string(" ns\n");
+}
+
+/**
+ * @brief Проверка блокировок под конкуренцией
+ */
+void run_sync_tests(void) {
+    print_string("\n=== Lock Tests ===\n");
+    
+    if (!sched_running() || !tsc_available()) {
+        print_string_color("Scheduler or TSC not available, skipping\n", COLOR_RED, COLOR_BLACK);
+        return;
+    }
+    
+    int stats_were_active = lockstat_active;
+    lockstat_enable();
+    
+    sync_test_run("Ticket spinlock", SYNC_TEST_TICKET, SYNC_TEST_ITERATIONS);
+    sync_test_run("MCS lock", SYNC_TEST_MCS, SYNC_TEST_ITERATIONS);
+    sync_test_run("Reader-writer lock (1/8 writes)", SYNC_TEST_RWLOCK,
+                  (SYNC_TEST_ITERATIONS + 7) / 8);
+    sync_test_run("Adaptive mutex", SYNC_TEST_MUTEX, SYNC_TEST_ITERATIONS);
+    
+    sync_buffer_run("Bounded buffer (semaphores)", SYNC_BUFFER_SEMAPHORE);
+    sync_buffer_run("Bounded buffer (condition variables)", SYNC_BUFFER_CONDVAR);
+    sync_futex_run();
+    
+    print_string("\n");
+    lockstat_dump();
+    if (!stats_were_active) {
+        lockstat_disable();
+    }
+    
+    print_string_color("\nLock tests completed!\n", COLOR_GREEN, COLOR_BLACK);
+}
@@ -0,0 +1,128 @@
+/**
+ * @file waitqueue.c
+ * @brief Очереди ожидания и завершения
+ */
+
+#include "waitqueue.h"
+#include "../cpu/cpu.h"
+#include "../drivers/pit.h"
+#include "../sched/sched.h"
+
+/**
+ * @brief Инициализация очереди
+ */
+void wait_queue_init(wait_queue_t *wq) {
+    wq->lock = (spinlock_t)SPINLOCK_INIT;
+    wq->head = NULL;
+    wq->tail = NULL;
+}
+
+/**
+ * @brief Ожидание в очереди
+ */
+void wait_queue_sleep(wait_queue_t *wq, const volatile void *key) {
+    if (!sched_can_block()) {
+        /* Блокироваться нельзя: ждем любого прерывания и проверяем снова */
+        spin_unlock(&wq->lock);
+        cpu_irq_restore(EFLAGS_IF);
+        pit_idle();
+        cpu_irq_save();
+        spin_lock(&wq->lock);
+        return;
+    }
+    
+    wait_entry_t entry;
+    entry.thread = kthread_current();
+    entry.key = key;
+    entry.next = NULL;
+    if (wq->tail) {
+        wq->tail->next = &entry;
+    } else {
+        wq->head = &entry;
+    }
+    wq->tail = &entry;
+    
+    /* Запись удаляет будящий; блокировка освобождается после переключения */
+    sched_block(&wq->lock);
+    spin_lock(&wq->lock);
+}
+
+/**
+ * @brief Пробуждение ожидающих под захваченной wq->lock
+ */
+uint32_t wake_up_locked(wait_queue_t *wq, const volatile void *key, uint32_t count) {
+    uint32_t woken = 0;
+    wait_entry_t *prev = NULL;
+    wait_entry_t *entry = wq->head;
+    
+    while (entry && woken < count) {
+        wait_entry_t *next = entry->next;
+        if (!key || entry->key == key) {
+            if (prev) {
+                prev->next = next;
+            } else {
+                wq->head = next;
+            }
+            if (wq->tail == entry) {
+                wq->tail = prev;
+            }
+            sched_wake(entry->thread);
+            woken++;
+        } else {
+            prev = entry;
+        }
+        entry = next;
+    }
+    return woken;
+}
+
+/**
+ * @brief Пробуждение первого ожидающего
+ */
+void wake_up_one(wait_queue_t *wq) {
+    uint32_t flags = spin_lock_irqsave(&wq->lock);
+    wake_up_locked(wq, NULL, 1);
+    spin_unlock_irqrestore(&wq->lock, flags);
+}
+
+/**
+ * @brief Пробуждение всех ожидающих
+ */
+void wake_up_all(wait_queue_t *wq) {
+    uint32_t flags = spin_lock_irqsave(&wq->lock);
+    wake_up_locked(wq, NULL, WAKE_ALL);
+    spin_unlock_irqrestore(&wq->lock, flags);
+}
+
+/**
+ * @brief Инициализация завершения
+ */
+void completion_init(completion_t *comp) {
+    wait_queue_init(&comp->wq);
+    comp->done = 0;
+}
+
+/**
+ * @brief Отметка о завершении и пробуждение одного ожидающего
+ *
+ * done меняется под блокировкой: ожидающий увидит его только
+ * после того, как будящий отпустит очередь.
+ */
+void complete(completion_t *comp) {
+    uint32_t flags = spin_lock_irqsave(&comp->wq.lock);
+    comp->done++;
+    wake_up_locked(&comp->wq, NULL, 1);
+    spin_unlock_irqrestore(&comp->wq.lock, flags);
+}
+
+/**
+ * @brief Ожидание завершения
+ */
+void wait_for_completion(completion_t *comp) {
+    uint32_t flags = spin_lock_irqsave(&comp->wq.lock);
+    while (!comp->done) {
+        wait_queue_sleep(&comp->wq, NULL);
+    }
+    comp->done--;
+    spin_unlock_irqrestore(&comp->wq.lock, flags);
+}
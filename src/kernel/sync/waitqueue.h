@@ -0,0 +1,123 @@
+/**
+ * @file waitqueue.h
+ * @brief Очереди ожидания и завершения
+ *
+ * Основа спящей синхронизации: поток ставит себя в очередь
+ * и блокируется (sched_block), пока другой поток или обработчик
+ * прерывания не разбудит его. Условие ожидания проверяется под
+ * блокировкой очереди, а будящий меняет его до пробуждения, поэтому
+ * пробуждение не теряется. Записи очереди лежат на стеках ожидающих.
+ *
+ * Там, где блокироваться нельзя (поток простоя, до запуска
+ * планировщика), ожидание выполняется опросом через pit_idle().
+ */
+
+#ifndef KERNEL_WAITQUEUE_H
+#define KERNEL_WAITQUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "spinlock.h"
+
+struct kthread;
+
+/* Разбудить всех ожидающих */
+#define WAKE_ALL 0xFFFFFFFF
+
+/**
+ * @brief Запись ожидающего потока
+ */
+typedef struct wait_entry {
+    struct kthread *thread;       /* Ожидающий поток */
+    const volatile void *key;     /* Ключ (адрес futex) или NULL */
+    struct wait_entry *next;
+} wait_entry_t;
+
+/**
+ * @brief Очередь ожидания
+ */
+typedef struct {
+    spinlock_t lock;
+    wait_entry_t *head;           /* Ожидающие в порядке прихода */
+    wait_entry_t *tail;
+} wait_queue_t;
+
+/* Статический инициализатор */
+#define WAIT_QUEUE_INIT { SPINLOCK_INIT, NULL, NULL }
+
+/**
+ * @brief Инициализация очереди
+ */
+void wait_queue_init(wait_queue_t *wq);
+
+/**
+ * @brief Ожидание в очереди
+ * @param wq Очередь
+ * @param key Ключ записи (NULL - без ключа)
+ *
+ * Вызывается с захваченной wq->lock и запрещенными прерываниями
+ * и возвращается так же - после пробуждения (возможно, ложного).
+ */
+void wait_queue_sleep(wait_queue_t *wq, const volatile void *key);
+
+/**
+ * @brief Пробуждение ожидающих под захваченной wq->lock
+ * @param wq Очередь
+ * @param key Будить только записи с этим ключом (NULL - любые)
+ * @param count Сколько будить (WAKE_ALL - всех)
+ * @return Количество разбуженных
+ */
+uint32_t wake_up_locked(wait_queue_t *wq, const volatile void *key, uint32_t count);
+
+/**
+ * @brief Пробуждение первого ожидающего
+ */
+void wake_up_one(wait_queue_t *wq);
+
+/**
+ * @brief Пробуждение всех ожидающих
+ */
+void wake_up_all(wait_queue_t *wq);
+
+/**
+ * @brief Ожидание выполнения условия
+ * @param wq Очередь, в которую будят при изменении условия
+ * @param condition Выражение, проверяемое под блокировкой очереди
+ */
+#define wait_event(wq, condition)                               \
+    do {                                                        \
+        uint32_t __wait_flags = spin_lock_irqsave(&(wq)->lock); \
+        while (!(condition)) {                                  \
+            wait_queue_sleep((wq), NULL);                       \
+        }                                                       \
+        spin_unlock_irqrestore(&(wq)->lock, __wait_flags);      \
+    } while (0)
+
+/**
+ * @brief Завершение: одноразовое событие с ожиданием
+ *
+ * complete() можно вызывать из прерывания. После возврата из
+ * wait_for_completion() завершение больше не используется
+ * будящим, поэтому его можно держать на стеке ожидающего.
+ */
+typedef struct {
+    wait_queue_t wq;
+    volatile uint32_t done;
+} completion_t;
+
+/**
+ * @brief Инициализация завершения
+ */
+void completion_init(completion_t *comp);
+
+/**
+ * @brief Отметка о завершении и пробуждение одного ожидающего
+ */
+void complete(completion_t *comp);
+
+/**
+ * @brief Ожидание завершения
+ */
+void wait_for_completion(completion_t *comp);
+
+#endif /* KERNEL_WAITQUEUE_H */
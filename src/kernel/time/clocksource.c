@@ -0,0 +1,164 @@
+/**
+ * @file clocksource.c
+ * @brief Регистрация и выбор источника времени
+ *
+ * Неинвариантный TSC меняет частоту вместе с частотой процессора
+ * и может останавливаться в глубоких C-состояниях, поэтому при
+ * наличии HPET предпочитается HPET. PIT остается запасным
+ * вариантом: его чтение требует защелкивания через порты.
+ */
+
+#include "clocksource.h"
+#include "../cpu/cpu.h"
+#include "../cpu/tsc.h"
+#include "../drivers/hpet.h"
+#include "../drivers/pit.h"
+#include "../lib/math64.h"
+#include "../video/video.h"
+#include "../lib/compiler.h"
+#include <stddef.h>
+
+/* Зарегистрированные источники */
+static clocksource_t *sources[CLOCKSOURCE_MAX];
+static uint32_t source_count = 0;
+
+/* Выбранный источник и его значение в момент выбора */
+static clocksource_t *current_source = NULL;
+static uint64_t current_base = 0;
+
+/**
+ * @brief Чтение TSC как источника времени
+ */
+static uint64_t clocksource_tsc_read(void) {
+    return rdtsc();
+}
+
+static clocksource_t tsc_clocksource = {
+    .name = "tsc",
+    .read = clocksource_tsc_read,
+    .mult = 1000000,
+};
+
+static clocksource_t hpet_clocksource = {
+    .name = "hpet",
+    .read = hpet_read_counter,
+    .div = 1000000,
+    .rating = CLOCKSOURCE_RATING_HPET,
+};
+
+static clocksource_t pit_clocksource = {
+    .name = "pit",
+    .read = pit_read_counter,
+    .mult = 1000000000,
+    .div = PIT_FREQUENCY,
+    .rating = CLOCKSOURCE_RATING_PIT,
+};
+
+/**
+ * @brief Сравнение строк имен источников
+ */
+static int clocksource_name_equal(const char *a, const char *b) {
+    while (*a && *a == *b) {
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+/**
+ * @brief Регистрация источника времени
+ * @param cs Источник (должен существовать все время работы ядра)
+ */
+void clocksource_register(clocksource_t *cs) {
+    if (source_count >= CLOCKSOURCE_MAX) {
+        return;
+    }
+    sources[source_count++] = cs;
+    
+    if (!current_source || cs->rating > current_source->rating) {
+        current_source = cs;
+        current_base = cs->read();
+    }
+}
+
+/**
+ * @brief Регистрация доступных источников и выбор лучшего
+ */
+__cold void clocksource_init(void) {
+    print_string("Clocksource Selection... ");
+    
+    clocksource_register(&pit_clocksource);
+    
+    if (hpet_available()) {
+        hpet_clocksource.mult = hpet_period_fs();
+        clocksource_register(&hpet_clocksource);
+    }
+    
+    if (tsc_available()) {
+        tsc_clocksource.div = tsc_khz;
+        tsc_clocksource.rating = tsc_is_invariant() ? CLOCKSOURCE_RATING_TSC_INVARIANT
+                                                    : CLOCKSOURCE_RATING_TSC_UNSTABLE;
+        clocksource_register(&tsc_clocksource);
+    }
+    
+    print_string_color("OK\n", COLOR_GREEN, COLOR_BLACK);
+    clocksource_dump_info();
+}
+
+/**
+ * @brief Текущий источник времени
+ */
+clocksource_t* clocksource_current(void) {
+    return current_source;
+}
+
+/**
+ * @brief Поиск зарегистрированного источника по имени
+ * @param name Имя источника ("tsc", "hpet", "pit")
+ * @return Источник или NULL
+ */
+clocksource_t* clocksource_find(const char *name) {
+    for (uint32_t i = 0; i < source_count; i++) {
+        if (clocksource_name_equal(sources[i]->name, name)) {
+            return sources[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Перевод отсчетов источника в наносекунды
+ * @param cs Источник
+ * @param cycles Количество отсчетов
+ */
+uint64_t clocksource_cycles_to_ns(clocksource_t *cs, uint64_t cycles) {
+    return mul_div_u64(cycles, cs->mult, cs->div);
+}
+
+/**
+ * @brief Время в наносекундах с момента выбора источника
+ */
+uint64_t clocksource_now_ns(void) {
+    if (!current_source) {
+        return 0;
+    }
+    return clocksource_cycles_to_ns(current_source, current_source->read() - current_base);
+}
+
+/**
+ * @brief Вывод информации об источниках времени
+ */
+void clocksource_dump_info(void) {
+    print_string("  - Current: ");
+    print_string(current_source ? current_source->name : "none");
+    print_string("\n  - Available:");
+    for (uint32_t i = 0; i < source_count; i++) {
+        print_string(" ");
+        print_string(sources[i]->name);
+        print_string("(");
+        print_dec(sources[i]->rating);
+        print_string(")");
+    }
+    print_string("\n  - Invariant TSC: ");
+    print_string(tsc_is_invariant() ? "yes\n" : "no\n");
+}
@@ -0,0 +1,84 @@
+/**
+ * @file clocksource.h
+ * @brief Источники времени (clocksource)
+ *
+ * Источник времени - монотонный счетчик с известной частотой.
+ * При загрузке регистрируются все найденные источники (TSC, HPET, PIT),
+ * и выбирается лучший по рейтингу: инвариантный TSC, затем HPET,
+ * затем неинвариантный TSC и, в последнюю очередь, PIT.
+ * Шкала hrtimer_now_ns() строится на выбранном источнике.
+ */
+
+#ifndef KERNEL_CLOCKSOURCE_H
+#define KERNEL_CLOCKSOURCE_H
+
+#include <stdint.h>
+
+/* Максимальное количество зарегистрированных источников */
+#define CLOCKSOURCE_MAX 4
+
+/* Рейтинги источников */
+#define CLOCKSOURCE_RATING_PIT           100
+#define CLOCKSOURCE_RATING_TSC_UNSTABLE  200
+#define CLOCKSOURCE_RATING_HPET          250
+#define CLOCKSOURCE_RATING_TSC_INVARIANT 300
+
+/**
+ * @brief Источник времени
+ *
+ * Перевод в наносекунды: ns = cycles * mult / div.
+ */
+typedef struct {
+    const char *name;
+    uint64_t (*read)(void);   /* Чтение счетчика */
+    uint32_t mult;            /* Множитель перевода в наносекунды */
+    uint32_t div;             /* Делитель перевода в наносекунды */
+    int rating;               /* Рейтинг (больше - лучше) */
+} clocksource_t;
+
+/**
+ * @brief Регистрация доступных источников и выбор лучшего
+ *
+ * Вызывается после tsc_init() и hpet_init().
+ */
+void clocksource_init(void);
+
+/**
+ * @brief Регистрация источника времени
+ * @param cs Источник (должен существовать все время работы ядра)
+ */
+void clocksource_register(clocksource_t *cs);
+
+/**
+ * @brief Текущий источник времени
+ */
+clocksource_t* clocksource_current(void);
+
+/**
+ * @brief Поиск зарегистрированного источника по имени
+ * @param name Имя источника ("tsc", "hpet", "pit")
+ * @return Источник или NULL
+ */
+clocksource_t* clocksource_find(const char *name);
+
+/**
+ * @brief Перевод отсчетов источника в наносекунды
+ * @param cs Источник
+ * @param cycles Количество отсчетов
+ */
+uint64_t clocksource_cycles_to_ns(clocksource_t *cs, uint64_t cycles);
+
+/**
+ * @brief Время в наносекундах с момента выбора источника
+ */
+uint64_t clocksource_now_ns(void);
+
+/**
+ * @brief Вывод информации об источниках времени
+ */
+void clocksource_dump_info(void);
+
+/* Тестовые функции */
+void run_clock_bench(void);
+
+#endif /* KERNEL_CLOCKSOURCE_H */
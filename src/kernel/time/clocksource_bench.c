@@ -0,0 +1,152 @@
+/**
+ * @file clocksource_bench.c
+ * @brief Сравнение источников времени: стоимость чтения и дрейф
+ *
+ * Стоимость чтения измеряется в тактах TSC на одно чтение.
+ * Дрейф - расхождение интервала, отмеренного каждым источником,
+ * с интервалом по эталону (HPET, а без него - PIT).
+ */
+
+#include "clocksource.h"
+#include "../cpu/cpu.h"
+#include "../cpu/tsc.h"
+#include "../drivers/pit.h"
+#include "../lib/math64.h"
+#include "../video/video.h"
+#include <stddef.h>
+
+/* Количество чтений при измерении стоимости */
+#define BENCH_READS 1000
+
+/* Интервал измерения дрейфа (мс) */
+#define BENCH_DRIFT_MS 2000
+
+/* Источники в порядке вывода */
+static const char *bench_names[] = { "pit", "hpet", "tsc" };
+#define BENCH_SOURCES 3
+
+/**
+ * @brief Стоимость чтения источника и проверка монотонности
+ * @param cs Источник времени
+ */
+static void bench_read_cost(clocksource_t *cs) {
+    uint32_t backwards = 0;
+    uint64_t prev = cs->read();
+    
+    uint64_t start = rdtsc();
+    for (int i = 0; i < BENCH_READS; i++) {
+        uint64_t value = cs->read();
+        if (value < prev) {
+            backwards++;
+        }
+        prev = value;
+    }
+    uint64_t cycles = rdtsc() - start;
+    
+    print_string("  ");
+    print_string(cs->name);
+    print_string(": ");
+    print_dec((uint32_t)div_u64(cycles, BENCH_READS));
+    print_string(" cycles/read");
+    if (tsc_available()) {
+        print_string(" (");
+        print_dec((uint32_t)div_u64(tsc_cycles_to_ns(cycles), BENCH_READS));
+        print_string(" ns)");
+    }
+    print_string(", backwards steps: ");
+    print_dec(backwards);
+    print_string("\n");
+}
+
+/**
+ * @brief Тест стоимости чтения всех источников
+ */
+static void test_clock_read_cost(void) {
+    print_string("\n=== Clocksource Read Cost ===\n");
+    
+    for (int i = 0; i < BENCH_SOURCES; i++) {
+        clocksource_t *cs = clocksource_find(bench_names[i]);
+        if (cs) {
+            bench_read_cost(cs);
+        }
+    }
+}
+
+/**
+ * @brief Тест дрейфа источников относительно эталона
+ */
+static void test_clock_drift(void) {
+    print_string("\n=== Clocksource Drift ===\n");
+    
+    clocksource_t *sources[BENCH_SOURCES];
+    uint64_t start[BENCH_SOURCES];
+    uint32_t elapsed_ns[BENCH_SOURCES];
+    
+    clocksource_t *reference = clocksource_find("hpet");
+    if (!reference) {
+        reference = clocksource_find("pit");
+    }
+    
+    /* Снимаем начальные значения подряд с запрещенными прерываниями */
+    uint32_t flags = cpu_irq_save();
+    for (int i = 0; i < BENCH_SOURCES; i++) {
+        sources[i] = clocksource_find(bench_names[i]);
+        if (sources[i]) {
+            start[i] = sources[i]->read();
+        }
+    }
+    cpu_irq_restore(flags);
+    
+    pit_sleep_ms(BENCH_DRIFT_MS);
+    
+    flags = cpu_irq_save();
+    for (int i = 0; i < BENCH_SOURCES; i++) {
+        if (sources[i]) {
+            uint64_t cycles = sources[i]->read() - start[i];
+            elapsed_ns[i] = (uint32_t)clocksource_cycles_to_ns(sources[i], cycles);
+        }
+    }
+    cpu_irq_restore(flags);
+    
+    uint32_t reference_ns = 0;
+    for (int i = 0; i < BENCH_SOURCES; i++) {
+        if (sources[i] == reference) {
+            reference_ns = elapsed_ns[i];
+        }
+    }
+    
+    print_string("Reference: ");
+    print_string(reference->name);
+    print_string("\n");
+    
+    for (int i = 0; i < BENCH_SOURCES; i++) {
+        if (!sources[i]) {
+            continue;
+        }
+        
+        uint32_t diff = elapsed_ns[i] > reference_ns ? elapsed_ns[i] - reference_ns
+                                                     : reference_ns - elapsed_ns[i];
+        
+        print_string("  ");
+        print_string(sources[i]->name);
+        print_string(": ");
+        print_dec(elapsed_ns[i] / 1000);
+        print_string(" us, drift ");
+        print_string(elapsed_ns[i] < reference_ns ? "-" : "+");
+        print_dec((uint32_t)div_u64((uint64_t)diff * 1000000, reference_ns ? reference_ns : 1));
+        print_string(" ppm\n");
+    }
+}
+
+/**
+ * @brief Запуск сравнения источников времени
+ */
+void run_clock_bench(void) {
+    print_string("\n🚀 Starting Clocksource Benchmark...\n");
+    
+    clocksource_dump_info();
+    test_clock_read_cost();
+    test_clock_drift();
+    
+    print_string("\n✅ Clocksource Benchmark Completed!\n");
+}
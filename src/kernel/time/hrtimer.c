@@ -0,0 +1,343 @@
+/**
+ * @file hrtimer.c
+ * @brief Таймеры высокого разрешения (hrtimer)
+ *
+ * Очередь каждого процессора - односвязный список, упорядоченный
+ * по времени срабатывания. Вставка O(n), но таймеров в ядре немного,
+ * а выборка ближайшего - O(1). Очередь защищена своей спин-блокировкой:
+ * отменить или перезапустить таймер можно с любого процессора, пока
+ * процессор-владелец обрабатывает ту же очередь в прерывании.
+ *
+ * Источник событий - LAPIC-таймер текущего процессора, а при его
+ * отсутствии компаратор HPET (он один на систему и направлен на
+ * загрузочный процессор). Шкала времени - выбранный clocksource.
+ */
+
+#include "hrtimer.h"
+#include "../apic/apic.h"
+#include "../cpu/cpu.h"
+#include "../drivers/hpet.h"
+#include "../drivers/pit.h"
+#include "../lib/math64.h"
+#include "../sync/spinlock.h"
+#include "../sync/waitqueue.h"
+#include "../video/video.h"
+#include "clocksource.h"
+#include "../lib/compiler.h"
+#include <stddef.h>
+
+/**
+ * @brief Очередь таймеров процессора
+ */
+typedef struct {
+    spinlock_t lock;
+    hrtimer_t *head;          /* Ближайший таймер */
+    uint32_t expired;         /* Сработавших таймеров */
+    uint64_t lateness_max_ns; /* Максимальное опоздание срабатывания */
+} hrtimer_base_t;
+
+/* Очереди таймеров всех процессоров */
+static hrtimer_base_t hrtimer_bases[MAX_CPUS];
+
+/**
+ * @brief Источник событий (однократный таймер)
+ */
+typedef struct {
+    const char *name;
+    void (*arm)(uint64_t expires_ns);   /* Взведение на абсолютный момент */
+    void (*disarm)(void);
+} hrtimer_event_t;
+
+/* Подсистема готова к работе */
+static int hrtimer_ready = 0;
+
+/* Выбранный источник событий */
+static const hrtimer_event_t *event_source = NULL;
+
+static const hrtimer_event_t lapic_event = {
+    .name = "lapic",
+    .arm = lapic_timer_arm,
+    .disarm = lapic_timer_disarm,
+};
+
+/**
+ * @brief Взведение компаратора HPET на абсолютный момент времени
+ * @param expires_ns Момент срабатывания (шкала hrtimer_now_ns)
+ */
+static void hrtimer_hpet_arm(uint64_t expires_ns) {
+    uint64_t now = hrtimer_now_ns();
+    hpet_event_arm(expires_ns > now ? expires_ns - now : 0);
+}
+
+static const hrtimer_event_t hpet_event = {
+    .name = "hpet",
+    .arm = hrtimer_hpet_arm,
+    .disarm = hpet_event_disarm,
+};
+
+/**
+ * @brief Перевзведение источника событий на ближайший таймер очереди
+ * @param base Очередь текущего процессора
+ */
+static void hrtimer_reprogram(hrtimer_base_t *base) {
+    if (base->head) {
+        event_source->arm(base->head->expires_ns);
+    } else {
+        event_source->disarm();
+    }
+}
+
+/**
+ * @brief Удаление таймера из очереди
+ * @param base Очередь
+ * @param timer Таймер
+ * @return 1 если таймер был головой очереди
+ */
+static int hrtimer_unlink(hrtimer_base_t *base, hrtimer_t *timer) {
+    hrtimer_t **link = &base->head;
+    int was_head = (base->head == timer);
+    
+    while (*link) {
+        if (*link == timer) {
+            *link = timer->next;
+            break;
+        }
+        link = &(*link)->next;
+    }
+    timer->next = NULL;
+    timer->queued = 0;
+    return was_head;
+}
+
+/**
+ * @brief Блокировка очереди, в которой стоит таймер
+ * @param timer Таймер
+ * @param flags Выход: сохраненные флаги прерываний
+ * @return Заблокированная очередь или NULL, если таймер не в очереди
+ *
+ * Пока ожидается блокировка, таймер может сработать или переехать
+ * в очередь другого процессора; тогда проверка повторяется.
+ */
+static hrtimer_base_t* hrtimer_lock_queued(hrtimer_t *timer, uint32_t *flags) {
+    for (;;) {
+        if (!timer->queued) {
+            return NULL;
+        }
+        uint32_t cpu = timer->cpu;
+        hrtimer_base_t *base = &hrtimer_bases[cpu];
+        *flags = spin_lock_irqsave(&base->lock);
+        if (timer->queued && timer->cpu == cpu) {
+            return base;
+        }
+        spin_unlock_irqrestore(&base->lock, *flags);
+    }
+}
+
+/**
+ * @brief Инициализация подсистемы (выбор источника событий)
+ */
+__cold void hrtimer_init(void) {
+    if (lapic_timer_init()) {
+        event_source = &lapic_event;
+    } else if (hpet_event_init(hrtimer_interrupt)) {
+        event_source = &hpet_event;
+        print_string("  - Using HPET comparator for hrtimer\n");
+    }
+    hrtimer_ready = (event_source != NULL);
+}
+
+/**
+ * @brief Проверка доступности таймеров высокого разрешения
+ */
+int hrtimer_available(void) {
+    return hrtimer_ready;
+}
+
+/**
+ * @brief Текущее время в наносекундах с момента загрузки
+ */
+uint64_t hrtimer_now_ns(void) {
+    return clocksource_now_ns();
+}
+
+/**
+ * @brief Подготовка структуры таймера
+ * @param timer Таймер
+ * @param fn Обработчик срабатывания
+ * @param ctx Аргумент обработчика
+ */
+void hrtimer_setup(hrtimer_t *timer, hrtimer_fn_t fn, void *ctx) {
+    timer->expires_ns = 0;
+    timer->fn = fn;
+    timer->ctx = ctx;
+    timer->next = NULL;
+    timer->queued = 0;
+    timer->cpu = 0;
+}
+
+/**
+ * @brief Запуск таймера на абсолютный момент времени
+ * @param timer Таймер (если уже запущен - перезапускается)
+ * @param expires_ns Момент срабатывания
+ * @return 0 при успехе, -1 если hrtimer недоступен
+ */
+int hrtimer_start_abs(hrtimer_t *timer, uint64_t expires_ns) {
+    if (!hrtimer_ready) {
+        return -1;
+    }
+    
+    /* Таймер из чужой очереди переезжает к текущему процессору; источник
+     * событий владельца при этом не трогается - лишнее прерывание
+     * только перевзведет его на новую голову */
+    uint32_t flags;
+    hrtimer_base_t *old = hrtimer_lock_queued(timer, &flags);
+    if (old) {
+        hrtimer_unlink(old, timer);
+        spin_unlock_irqrestore(&old->lock, flags);
+    }
+    
+    flags = cpu_irq_save();
+    hrtimer_base_t *base = &hrtimer_bases[cpu_current()];
+    spin_lock(&base->lock);
+    hrtimer_t **link = &base->head;
+    while (*link && (*link)->expires_ns <= expires_ns) {
+        link = &(*link)->next;
+    }
+    
+    timer->expires_ns = expires_ns;
+    timer->next = *link;
+    timer->queued = 1;
+    timer->cpu = cpu_current();
+    *link = timer;
+    
+    if (base->head == timer) {
+        hrtimer_reprogram(base);
+    }
+    
+    spin_unlock(&base->lock);
+    cpu_irq_restore(flags);
+    return 0;
+}
+
+/**
+ * @brief Запуск таймера через заданный интервал
+ * @param timer Таймер
+ * @param delay_ns Интервал в наносекундах
+ * @return 0 при успехе, -1 если hrtimer недоступен
+ */
+int hrtimer_start(hrtimer_t *timer, uint64_t delay_ns) {
+    if (!hrtimer_ready) {
+        return -1;
+    }
+    return hrtimer_start_abs(timer, hrtimer_now_ns() + delay_ns);
+}
+
+/**
+ * @brief Отмена таймера
+ * @param timer Таймер
+ * @return 1 если таймер был в очереди, 0 если уже сработал или не запускался
+ */
+int hrtimer_cancel(hrtimer_t *timer) {
+    uint32_t flags;
+    hrtimer_base_t *base = hrtimer_lock_queued(timer, &flags);
+    if (!base) {
+        return 0;
+    }
+    
+    /* Источник событий чужого процессора перевзведет его прерывание */
+    if (hrtimer_unlink(base, timer) && base == &hrtimer_bases[cpu_current()]) {
+        hrtimer_reprogram(base);
+    }
+    
+    spin_unlock_irqrestore(&base->lock, flags);
+    return 1;
+}
+
+/**
+ * @brief Обработчик таймера задержки: завершает ожидание
+ */
+static void hrtimer_wakeup(hrtimer_t *timer, void *ctx) {
+    (void)timer;
+    complete((completion_t*)ctx);
+}
+
+/**
+ * @brief Задержка с микросекундным разрешением
+ * @param delay_ns Интервал в наносекундах
+ *
+ * Поток засыпает до срабатывания таймера; там, где блокироваться
+ * нельзя, процессор простаивает в ожидании прерывания.
+ */
+void hrtimer_sleep_ns(uint64_t delay_ns) {
+    completion_t done;
+    hrtimer_t timer;
+    
+    completion_init(&done);
+    hrtimer_setup(&timer, hrtimer_wakeup, &done);
+    if (hrtimer_start(&timer, delay_ns) != 0) {
+        return;
+    }
+    
+    wait_for_completion(&done);
+}
+
+/**
+ * @brief Обработка истекших таймеров текущего процессора
+ */
+void hrtimer_interrupt(void) {
+    hrtimer_base_t *base = &hrtimer_bases[cpu_current()];
+    uint64_t now = hrtimer_now_ns();
+    
+    spin_lock(&base->lock);
+    while (base->head && base->head->expires_ns <= now) {
+        hrtimer_t *timer = base->head;
+        
+        hrtimer_unlink(base, timer);
+        base->expired++;
+        if (now - timer->expires_ns > base->lateness_max_ns) {
+            base->lateness_max_ns = now - timer->expires_ns;
+        }
+        
+        /* Обработчик может перевзвести таймер: очередь отпускается */
+        spin_unlock(&base->lock);
+        timer->fn(timer, timer->ctx);
+        now = hrtimer_now_ns();
+        spin_lock(&base->lock);
+    }
+    
+    hrtimer_reprogram(base);
+    spin_unlock(&base->lock);
+}
+
+/**
+ * @brief Вывод статистики таймеров
+ */
+void hrtimer_dump_info(void) {
+    hrtimer_base_t *base = &hrtimer_bases[cpu_current()];
+    uint32_t queued = 0;
+    
+    uint32_t flags = spin_lock_irqsave(&base->lock);
+    for (hrtimer_t *timer = base->head; timer; timer = timer->next) {
+        queued++;
+    }
+    spin_unlock_irqrestore(&base->lock, flags);
+    
+    print_string("HRTimer Info:\n");
+    print_string("  - Available: ");
+    if (hrtimer_ready) {
+        print_string("yes (");
+        print_string(event_source->name);
+        print_string(" events, ");
+        print_string(clocksource_current()->name);
+        print_string(" clock)\n");
+    } else {
+        print_string("no\n");
+    }
+    print_string("  - Queued: ");
+    print_dec(queued);
+    print_string("\n  - Expired: ");
+    print_dec(base->expired);
+    print_string("\n  - Max lateness: ");
+    print_dec((uint32_t)div_u64(base->lateness_max_ns, NSEC_PER_USEC));
+    print_string(" us\n");
+}
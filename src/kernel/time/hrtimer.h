@@ -0,0 +1,113 @@
+/**
+ * @file hrtimer.h
+ * @brief Таймеры высокого разрешения (hrtimer)
+ *
+ * Однократные таймеры с наносекундной шкалой времени (clocksource)
+ * и микросекундной точностью срабатывания на LAPIC-таймере
+ * или компараторе HPET. У каждого процессора своя упорядоченная
+ * очередь таймеров; источник событий всегда взведен на ближайший из них.
+ */
+
+#ifndef KERNEL_HRTIMER_H
+#define KERNEL_HRTIMER_H
+
+#include <stdint.h>
+
+/* Перевод единиц времени в наносекунды */
+#define NSEC_PER_USEC 1000ULL
+#define NSEC_PER_MSEC 1000000ULL
+#define NSEC_PER_SEC  1000000000ULL
+
+typedef struct hrtimer hrtimer_t;
+
+/**
+ * @brief Функция, вызываемая при срабатывании таймера
+ *
+ * Выполняется в контексте прерывания с запрещенными прерываниями
+ * без блокировки очереди; может перевзвести тот же таймер через
+ * hrtimer_start_abs().
+ */
+typedef void (*hrtimer_fn_t)(hrtimer_t *timer, void *ctx);
+
+/**
+ * @brief Таймер высокого разрешения
+ */
+struct hrtimer {
+    uint64_t expires_ns;      /* Момент срабатывания (шкала hrtimer_now_ns) */
+    hrtimer_fn_t fn;          /* Обработчик */
+    void *ctx;                /* Аргумент обработчика */
+    struct hrtimer *next;     /* Следующий таймер в очереди процессора */
+    uint8_t queued;           /* Таймер стоит в очереди */
+    uint8_t cpu;              /* Процессор, в очереди которого стоит таймер */
+};
+
+/**
+ * @brief Инициализация подсистемы (выбор источника событий)
+ *
+ * Вызывается после clocksource_init() и hpet_init().
+ */
+void hrtimer_init(void);
+
+/**
+ * @brief Проверка доступности таймеров высокого разрешения
+ */
+int hrtimer_available(void);
+
+/**
+ * @brief Текущее время в наносекундах с момента загрузки
+ */
+uint64_t hrtimer_now_ns(void);
+
+/**
+ * @brief Подготовка структуры таймера
+ * @param timer Таймер
+ * @param fn Обработчик срабатывания
+ * @param ctx Аргумент обработчика
+ */
+void hrtimer_setup(hrtimer_t *timer, hrtimer_fn_t fn, void *ctx);
+
+/**
+ * @brief Запуск таймера на абсолютный момент времени
+ * @param timer Таймер (если уже запущен - перезапускается)
+ * @param expires_ns Момент срабатывания
+ * @return 0 при успехе, -1 если hrtimer недоступен
+ *
+ * Таймер ставится в очередь текущего процессора, даже если стоял
+ * в очереди другого.
+ */
+int hrtimer_start_abs(hrtimer_t *timer, uint64_t expires_ns);
+
+/**
+ * @brief Запуск таймера через заданный интервал
+ * @param timer Таймер
+ * @param delay_ns Интервал в наносекундах
+ * @return 0 при успехе, -1 если hrtimer недоступен
+ */
+int hrtimer_start(hrtimer_t *timer, uint64_t delay_ns);
+
+/**
+ * @brief Отмена таймера
+ * @param timer Таймер
+ * @return 1 если таймер был в очереди, 0 если уже сработал или не запускался
+ */
+int hrtimer_cancel(hrtimer_t *timer);
+
+/**
+ * @brief Задержка с микросекундным разрешением (процессор простаивает)
+ * @param delay_ns Интервал в наносекундах
+ */
+void hrtimer_sleep_ns(uint64_t delay_ns);
+
+/**
+ * @brief Обработка истекших таймеров текущего процессора
+ *
+ * Вызывается из обработчика прерывания LAPIC-таймера или HPET.
+ */
+void hrtimer_interrupt(void);
+
+/**
+ * @brief Вывод статистики таймеров
+ */
+void hrtimer_dump_info(void);
+
+#endif /* KERNEL_HRTIMER_H */
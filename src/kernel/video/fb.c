@@ -0,0 +1,569 @@
+/**
+ * @file fb.c
+ * @brief Консоль на линейном кадровом буфере (Bochs/QEMU VBE)
+ *
+ * Адрес кадрового буфера - BAR0 адаптера на шине PCI 0. Шрифт
+ * читается из плоскости 2 видеопамяти VGA, куда его загрузил BIOS
+ * для текстового режима: после смены режима он будет затерт.
+ *
+ * Теневой буфер и кэш глифов выделяются сразу (VMM_COMMIT): вывод идет
+ * под спин-блокировкой с запрещенными прерываниями, и Page Fault в нем
+ * мог бы ждать блокировку, которую держит печатающий процессор.
+ * Регистры XMM используются только здесь и только под этой блокировкой,
+ * поэтому их не нужно сохранять при переключении потоков.
+ */
+
+#include "fb.h"
+#include "video.h"
+#include "../cpu/cpu.h"
+#include "../idt/idt.h"
+#include "../memory/memory.h"
+#include "../memory/pat.h"
+#include "../memory/vmm.h"
+#include "../lib/compiler.h"
+#include "../lib/math64.h"
+
+/* Пикселей в глифе и в строке текста */
+#define FB_GLYPH_PIXELS (FB_FONT_WIDTH * FB_FONT_HEIGHT)
+#define FB_ROW_PIXELS   (FB_WIDTH * FB_FONT_HEIGHT)
+
+/* Символов в текстовом экране VGA */
+#define FB_TEXT_CELLS (SCREEN_SIZE / 2)
+
+/* Палитра текстового режима VGA */
+static const uint32_t fb_palette[16] = {
+    0x000000, 0x0000AA, 0x00AA00, 0x00AAAA, 0xAA0000, 0xAA00AA, 0xAA5500, 0xAAAAAA,
+    0x555555, 0x5555FF, 0x55FF55, 0x55FFFF, 0xFF5555, 0xFF55FF, 0xFFFF55, 0xFFFFFF
+};
+
+/* Шрифт 8x16 из плоскости 2 */
+static uint8_t fb_font[256 * FB_FONT_HEIGHT];
+
+/* Состояние */
+static int fb_enabled = 0;
+static int fb_pan_capable = 0;
+static int fb_pan = 0;
+static int fb_sse = 0;
+
+/* Кадровый буфер (WC), теневой буфер и кэш глифов */
+static phys_addr_t fb_phys;
+static uint32_t *fb_vram;
+static uint32_t fb_pitch;         /* Пикселей в строке видеопамяти */
+static uint32_t *fb_back;
+static uint32_t *fb_glyphs;
+static uint32_t fb_glyph_tags[FB_GLYPH_SLOTS];
+
+/* Строка кольца вверху экрана, курсор и текущее смещение Y */
+static uint32_t fb_top = 0;
+static uint32_t fb_col = 0;
+static uint32_t fb_row = 0;
+static uint32_t fb_y_offset = 0;
+
+/* Измененные столбцы [x0, x1) каждой строки кольца; x1 == 0 - чистая */
+static uint8_t fb_dirty_x0[FB_ROWS];
+static uint8_t fb_dirty_x1[FB_ROWS];
+static int fb_all_dirty = 0;
+
+static fb_stats_t fb_stats;
+
+/**
+ * @brief Регистры Bochs VBE
+ */
+static void vbe_write(uint16_t index, uint16_t value) {
+    write_port16(VBE_DISPI_IOPORT_INDEX, index);
+    write_port16(VBE_DISPI_IOPORT_DATA, value);
+}
+
+static uint16_t vbe_read(uint16_t index) {
+    write_port16(VBE_DISPI_IOPORT_INDEX, index);
+    return read_port16(VBE_DISPI_IOPORT_DATA);
+}
+
+/**
+ * @brief Регистр конфигурации PCI на шине 0 (механизм 1)
+ */
+static uint32_t fb_pci_read(uint32_t dev, uint32_t reg) {
+    write_port32(0xCF8, 0x80000000 | (dev << 11) | reg);
+    return read_port32(0xCFC);
+}
+
+/**
+ * @brief Физический адрес кадрового буфера из BAR0 адаптера
+ */
+static phys_addr_t fb_find_lfb(void) {
+    for (uint32_t dev = 0; dev < 32; dev++) {
+        uint32_t id = fb_pci_read(dev, 0x00);
+        if (id == FB_PCI_QEMU_VGA || id == FB_PCI_VBOX_VGA) {
+            return fb_pci_read(dev, 0x10) & ~0xFu;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Чтение шрифта из плоскости 2 видеопамяти VGA
+ * @return 1 если шрифт не пустой
+ *
+ * На время чтения плоскость 2 отображается на 0xA0000 последовательно,
+ * затем регистры возвращаются к текстовому режиму.
+ */
+static int fb_read_font(void) {
+    write_port(0x3C4, 0x02); write_port(0x3C5, 0x04);
+    write_port(0x3C4, 0x04); write_port(0x3C5, 0x07);
+    write_port(0x3CE, 0x04); write_port(0x3CF, 0x02);
+    write_port(0x3CE, 0x05); write_port(0x3CF, 0x00);
+    write_port(0x3CE, 0x06); write_port(0x3CF, 0x04);
+    
+    /* Глиф занимает в плоскости 32 байта, используются первые 16 */
+    const volatile uint8_t *plane = (const volatile uint8_t*)phys_to_virt(0xA0000);
+    uint32_t bits = 0;
+    for (uint32_t c = 0; c < 256; c++) {
+        for (uint32_t y = 0; y < FB_FONT_HEIGHT; y++) {
+            fb_font[c * FB_FONT_HEIGHT + y] = plane[c * 32 + y];
+        }
+    }
+    for (uint32_t y = 0; y < FB_FONT_HEIGHT; y++) {
+        bits |= fb_font['A' * FB_FONT_HEIGHT + y];
+    }
+    
+    write_port(0x3C4, 0x02); write_port(0x3C5, 0x03);
+    write_port(0x3C4, 0x04); write_port(0x3C5, 0x03);
+    write_port(0x3CE, 0x04); write_port(0x3CF, 0x00);
+    write_port(0x3CE, 0x05); write_port(0x3CF, 0x10);
+    write_port(0x3CE, 0x06); write_port(0x3CF, 0x0E);
+    return bits != 0;
+}
+
+/**
+ * @brief Копирование пикселей через XMM, байт кратно 32
+ *
+ * По 64 байта за итерацию через четыре регистра: в память с WC уходят
+ * целые строки буфера объединения записей. Ядро собирается без SSE,
+ * поэтому регистры XMM разрешены только в функциях с target("sse").
+ */
+__attribute__((target("sse")))
+static void fb_copy_sse(uint8_t *d, const uint8_t *s, uint32_t bytes) {
+    for (; bytes >= 64; bytes -= 64, d += 64, s += 64) {
+        __asm__ volatile("movups (%1), %%xmm0\n\t"
+                         "movups 16(%1), %%xmm1\n\t"
+                         "movups 32(%1), %%xmm2\n\t"
+                         "movups 48(%1), %%xmm3\n\t"
+                         "movups %%xmm0, (%0)\n\t"
+                         "movups %%xmm1, 16(%0)\n\t"
+                         "movups %%xmm2, 32(%0)\n\t"
+                         "movups %%xmm3, 48(%0)"
+                         : : "r"(d), "r"(s) : "memory", "xmm0", "xmm1", "xmm2", "xmm3");
+    }
+    if (bytes) {
+        __asm__ volatile("movups (%1), %%xmm0\n\t"
+                         "movups 16(%1), %%xmm1\n\t"
+                         "movups %%xmm0, (%0)\n\t"
+                         "movups %%xmm1, 16(%0)"
+                         : : "r"(d), "r"(s) : "memory", "xmm0", "xmm1");
+    }
+}
+
+/**
+ * @brief Заполнение через XMM, пикселей кратно 8
+ */
+__attribute__((target("sse")))
+static void fb_fill_sse(uint32_t *dst, const uint32_t *pattern, uint32_t pixels) {
+    for (uint32_t i = 0; i < pixels; i += 8) {
+        __asm__ volatile("movups (%1), %%xmm0\n\t"
+                         "movups %%xmm0, (%0)\n\t"
+                         "movups %%xmm0, 16(%0)"
+                         : : "r"(dst + i), "r"(pattern) : "memory", "xmm0");
+    }
+}
+
+/**
+ * @brief Копирование пикселей, байт кратно 32
+ */
+static void fb_copy(void *dst, const void *src, uint32_t bytes) {
+    if (fb_sse) {
+        fb_copy_sse((uint8_t*)dst, (const uint8_t*)src, bytes);
+        return;
+    }
+    
+    uint32_t ecx, edi, esi;
+    __asm__ volatile("rep movsl"
+                     : "=&c"(ecx), "=&D"(edi), "=&S"(esi)
+                     : "0"(bytes / 4), "1"(dst), "2"(src)
+                     : "memory");
+}
+
+/**
+ * @brief Заполнение пикселей цветом, количество кратно 8
+ */
+static void fb_fill(uint32_t *dst, uint32_t color, uint32_t pixels) {
+    if (fb_sse) {
+        uint32_t pattern[4] = { color, color, color, color };
+        fb_fill_sse(dst, pattern, pixels);
+        return;
+    }
+    
+    uint32_t ecx, edi;
+    __asm__ volatile("rep stosl"
+                     : "=&c"(ecx), "=&D"(edi)
+                     : "0"(pixels), "1"(dst), "a"(color)
+                     : "memory");
+}
+
+/**
+ * @brief Глиф для символа и атрибута: из кэша или растрированный
+ */
+static const uint32_t* fb_glyph(uint8_t c, uint8_t attr) {
+    uint32_t key = ((uint32_t)attr << 8) | c;
+    uint32_t slot = ((key * 2654435761u) >> 16) & (FB_GLYPH_SLOTS - 1);
+    uint32_t *pixels = fb_glyphs + slot * FB_GLYPH_PIXELS;
+    
+    if (fb_glyph_tags[slot] == key + 1) {
+        fb_stats.glyph_hits++;
+        return pixels;
+    }
+    
+    fb_stats.glyph_misses++;
+    uint32_t fg = fb_palette[attr & 0x0F];
+    uint32_t bg = fb_palette[attr >> 4];
+    const uint8_t *rows = &fb_font[c * FB_FONT_HEIGHT];
+    for (uint32_t y = 0; y < FB_FONT_HEIGHT; y++) {
+        for (uint32_t x = 0; x < FB_FONT_WIDTH; x++) {
+            pixels[y * FB_FONT_WIDTH + x] = (rows[y] & (0x80 >> x)) ? fg : bg;
+        }
+    }
+    fb_glyph_tags[slot] = key + 1;
+    return pixels;
+}
+
+/**
+ * @brief Отметка измененных столбцов строки кольца
+ */
+static void fb_mark(uint32_t ring, uint32_t x0, uint32_t x1) {
+    if (!fb_dirty_x1[ring]) {
+        fb_dirty_x0[ring] = x0;
+        fb_dirty_x1[ring] = x1;
+        return;
+    }
+    if (x0 < fb_dirty_x0[ring]) {
+        fb_dirty_x0[ring] = x0;
+    }
+    if (x1 > fb_dirty_x1[ring]) {
+        fb_dirty_x1[ring] = x1;
+    }
+}
+
+/**
+ * @brief Символ в знакоместо теневого буфера
+ * @param row Строка экрана (не кольца)
+ */
+static void fb_draw_cell(uint32_t col, uint32_t row, uint8_t c, uint8_t attr) {
+    uint32_t ring = (fb_top + row) % FB_ROWS;
+    const uint32_t *glyph = fb_glyph(c, attr);
+    uint32_t *dst = fb_back + ring * FB_ROW_PIXELS + col * FB_FONT_WIDTH;
+    
+    for (uint32_t y = 0; y < FB_FONT_HEIGHT; y++) {
+        fb_copy(dst + y * FB_WIDTH, glyph + y * FB_FONT_WIDTH, FB_FONT_WIDTH * 4);
+    }
+    fb_mark(ring, col, col + 1);
+}
+
+/**
+ * @brief Прокрутка на строку: верхняя строка кольца становится нижней
+ */
+static void fb_scroll(void) {
+    uint32_t ring = fb_top;
+    fb_top = (fb_top + 1) % FB_ROWS;
+    
+    fb_fill(fb_back + ring * FB_ROW_PIXELS, fb_palette[COLOR_BLACK], FB_ROW_PIXELS);
+    fb_mark(ring, 0, FB_COLS);
+    if (!fb_pan) {
+        fb_all_dirty = 1;
+    }
+    fb_stats.scrolls++;
+}
+
+/**
+ * @brief Курсор на следующую строку с прокруткой на последней
+ */
+static void fb_newline(void) {
+    fb_col = 0;
+    if (fb_row + 1 < FB_ROWS) {
+        fb_row++;
+    } else {
+        fb_scroll();
+    }
+}
+
+/**
+ * @brief Вывод символа в позицию курсора
+ *
+ * Перенос после последнего столбца откладывается до следующего
+ * символа, чтобы строка ровно во всю ширину с '\n' не давала
+ * пустую строку.
+ */
+void fb_putc(char c, uint8_t attr) {
+    if (c == '\n') {
+        fb_newline();
+        return;
+    }
+    if (c == '\b') {
+        if (fb_col > 0) {
+            fb_col--;
+            fb_draw_cell(fb_col, fb_row, ' ', 0x07);
+        }
+        return;
+    }
+    
+    if (fb_col == FB_COLS) {
+        fb_newline();
+    }
+    fb_draw_cell(fb_col, fb_row, (uint8_t)c, attr);
+    fb_col++;
+    fb_stats.chars++;
+}
+
+/**
+ * @brief Очистка экрана и курсор в начало
+ */
+void fb_clear(void) {
+    fb_fill(fb_back, fb_palette[COLOR_BLACK], FB_WIDTH * FB_HEIGHT);
+    fb_top = 0;
+    fb_col = 0;
+    fb_row = 0;
+    fb_all_dirty = 1;
+}
+
+/**
+ * @brief Копирование измененных участков в кадровый буфер
+ *
+ * Со смещением строка кольца ring лежит в видеопамяти на месте ring
+ * и еще раз через высоту экрана; без него - на своем месте на экране.
+ * Смещение Y меняется после записи пикселей.
+ */
+void fb_flush(void) {
+    if (!fb_enabled) {
+        return;
+    }
+    
+    int full = fb_all_dirty;
+    uint32_t bytes = 0;
+    for (uint32_t ring = 0; ring < FB_ROWS; ring++) {
+        uint32_t x0 = full ? 0 : fb_dirty_x0[ring];
+        uint32_t x1 = full ? FB_COLS : fb_dirty_x1[ring];
+        if (!x1) {
+            continue;
+        }
+        
+        uint32_t line = (fb_pan ? ring : (ring + FB_ROWS - fb_top) % FB_ROWS) * FB_FONT_HEIGHT;
+        uint32_t width = (x1 - x0) * FB_FONT_WIDTH * 4;
+        const uint32_t *src = fb_back + ring * FB_ROW_PIXELS + x0 * FB_FONT_WIDTH;
+        uint32_t *dst = fb_vram + line * fb_pitch + x0 * FB_FONT_WIDTH;
+        for (uint32_t y = 0; y < FB_FONT_HEIGHT; y++) {
+            fb_copy(dst + y * fb_pitch, src + y * FB_WIDTH, width);
+            if (fb_pan) {
+                fb_copy(dst + (FB_HEIGHT + y) * fb_pitch, src + y * FB_WIDTH, width);
+            }
+        }
+        bytes += width * FB_FONT_HEIGHT * (fb_pan ? 2 : 1);
+        fb_dirty_x1[ring] = 0;
+    }
+    fb_all_dirty = 0;
+    
+    if (bytes && fb_sse) {
+        __asm__ volatile("sfence" : : : "memory");
+    }
+    
+    uint32_t y_offset = fb_pan ? fb_top * FB_FONT_HEIGHT : 0;
+    if (y_offset != fb_y_offset) {
+        vbe_write(VBE_DISPI_INDEX_Y_OFFSET, y_offset);
+        fb_y_offset = y_offset;
+    }
+    
+    if (bytes) {
+        fb_stats.flushes++;
+        fb_stats.flushed_bytes += bytes;
+        if (full) {
+            fb_stats.full_flushes++;
+        }
+    }
+}
+
+/**
+ * @brief Прокрутка смещением видеопамяти или копированием экрана
+ * @return 1 если прокрутка идет смещением
+ *
+ * Смена способа перерисовывает экран при следующем fb_flush().
+ */
+int fb_set_panning(int enable) {
+    fb_pan = enable && fb_pan_capable;
+    fb_all_dirty = 1;
+    return fb_pan;
+}
+
+/**
+ * @brief Освобождение буферов и отображения после неудачного запуска
+ * @param text Копия текстового экрана (может быть NULL)
+ */
+static void fb_release(uint8_t *text) {
+    if (fb_back) {
+        vmm_free(fb_back);
+        fb_back = NULL;
+    }
+    if (fb_glyphs) {
+        vmm_free(fb_glyphs);
+        fb_glyphs = NULL;
+    }
+    if (fb_vram) {
+        /* Отображение - собственная область окна ядра */
+        vmm_free((void*)align_down((uint32_t)fb_vram, PAGE_SIZE));
+        fb_vram = NULL;
+    }
+    if (text) {
+        kfree(text);
+    }
+}
+
+/**
+ * @brief Переключение в графический режим и перенос текстового экрана
+ */
+__cold int fb_init(void) {
+    print_string("Framebuffer Console... ");
+    
+    uint16_t id = vbe_read(VBE_DISPI_INDEX_ID);
+    fb_phys = (id >= VBE_DISPI_ID_MIN && id <= VBE_DISPI_ID_MAX) ? fb_find_lfb() : 0;
+    if (!fb_phys || !vmm_enabled()) {
+        print_string_color("NOT AVAILABLE\n", COLOR_BROWN, COLOR_BLACK);
+        return -1;
+    }
+    if (!fb_read_font()) {
+        print_string_color("NOT AVAILABLE", COLOR_BROWN, COLOR_BLACK);
+        print_string(" (no VGA font)\n");
+        return -1;
+    }
+    
+    uint32_t flags = VMM_WRITE | VMM_GLOBAL | VMM_COMMIT;
+    fb_back = (uint32_t*)vmm_alloc(FB_WIDTH * FB_HEIGHT * 4, flags, "fb back buffer");
+    fb_glyphs = (uint32_t*)vmm_alloc(FB_GLYPH_SLOTS * FB_GLYPH_PIXELS * 4, flags, "fb glyphs");
+    uint8_t *text = (uint8_t*)kmalloc_flags(SCREEN_SIZE, KMALLOC_TAG(HEAP_TAG_VIDEO));
+    if (!fb_back || !fb_glyphs || !text) {
+        print_string_color("FAILED\n", COLOR_RED, COLOR_BLACK);
+        fb_release(text);
+        return -1;
+    }
+    fb_sse = cpu_has_edx(CPUID_EDX_SSE) && cpu_has_edx(CPUID_EDX_FXSR);
+    
+    print_string_color("OK\n", COLOR_GREEN, COLOR_BLACK);
+    print_string("  - Bochs VBE ");
+    print_hex(id);
+    print_string(", framebuffer at ");
+    print_hex((uint32_t)fb_phys);
+    print_string(pat_enabled() ? " (WC)\n" : " (UC-)\n");
+    
+    /* Текстовый экран переносится на новую консоль вместе с курсором */
+    memory_copy(text, VIDEO_MEMORY, SCREEN_SIZE);
+    uint32_t text_pos = cursor_pos;
+    
+    vbe_write(VBE_DISPI_INDEX_ENABLE, 0);
+    vbe_write(VBE_DISPI_INDEX_XRES, FB_WIDTH);
+    vbe_write(VBE_DISPI_INDEX_YRES, FB_HEIGHT);
+    vbe_write(VBE_DISPI_INDEX_BPP, FB_BPP);
+    vbe_write(VBE_DISPI_INDEX_ENABLE, VBE_DISPI_ENABLED | VBE_DISPI_LFB_ENABLED);
+    vbe_write(VBE_DISPI_INDEX_VIRT_HEIGHT, FB_HEIGHT * 2);
+    fb_pan_capable = vbe_read(VBE_DISPI_INDEX_VIRT_HEIGHT) >= FB_HEIGHT * 2;
+    fb_pitch = vbe_read(VBE_DISPI_INDEX_VIRT_WIDTH);
+    vbe_write(VBE_DISPI_INDEX_Y_OFFSET, 0);
+    
+    fb_vram = (uint32_t*)vmm_map_framebuffer(fb_phys, fb_pitch * 4 * FB_HEIGHT * (fb_pan_capable ? 2 : 1));
+    if (vbe_read(VBE_DISPI_INDEX_XRES) != FB_WIDTH || fb_pitch < FB_WIDTH || !fb_vram) {
+        /* Без графического режима остается текстовый, но шрифт в нем затерт */
+        vbe_write(VBE_DISPI_INDEX_ENABLE, 0);
+        fb_release(text);
+        print_string_color("Framebuffer mode set FAILED\n", COLOR_RED, COLOR_BLACK);
+        return -1;
+    }
+    
+    fb_pan = fb_pan_capable;
+    fb_clear();
+    for (uint32_t i = 0; i < FB_TEXT_CELLS; i++) {
+        fb_draw_cell(i % 80, i / 80, text[i * 2], text[i * 2 + 1]);
+    }
+    fb_row = text_pos / 160;
+    fb_col = (text_pos % 160) / 2;
+    kfree(text);
+    
+    fb_enabled = 1;
+    fb_flush();
+    
+    print_string("  - ");
+    print_dec(FB_WIDTH);
+    print_string("x");
+    print_dec(FB_HEIGHT);
+    print_string("x");
+    print_dec(FB_BPP);
+    print_string(", ");
+    print_dec(FB_COLS);
+    print_string("x");
+    print_dec(FB_ROWS);
+    print_string(" text, copy: ");
+    print_string(fb_sse ? "SSE" : "rep movs");
+    print_string(", scrolling: ");
+    print_string(fb_pan ? "Y panning\n" : "full copy\n");
+    return 0;
+}
+
+/**
+ * @brief Работает ли консоль на кадровом буфере
+ */
+int fb_active(void) {
+    return fb_enabled;
+}
+
+/**
+ * @brief Статистика консоли
+ */
+const fb_stats_t* fb_get_stats(void) {
+    return &fb_stats;
+}
+
+/**
+ * @brief Вывод информации о консоли
+ */
+void fb_dump_info(void) {
+    print_string("\n=== Framebuffer Console ===\n");
+    if (!fb_enabled) {
+        print_string("Text mode (VGA 80x25)\n");
+        return;
+    }
+    
+    /* Счетчики копируются до вывода: он сам их меняет */
+    fb_stats_t stats = fb_stats;
+    uint32_t lookups = stats.glyph_hits + stats.glyph_misses;
+    
+    print_string("Mode: ");
+    print_dec(FB_WIDTH);
+    print_string("x");
+    print_dec(FB_HEIGHT);
+    print_string(" at ");
+    print_hex((uint32_t)fb_phys);
+    print_string(", pitch ");
+    print_dec(fb_pitch * 4);
+    print_string(", scrolling: ");
+    print_string(fb_pan ? "Y panning\n" : "full copy\n");
+    print_string("Chars: ");
+    print_dec(stats.chars);
+    print_string(", scrolls: ");
+    print_dec(stats.scrolls);
+    print_string("\nGlyph cache: ");
+    print_dec(stats.glyph_hits);
+    print_string(" hits, ");
+    print_dec(stats.glyph_misses);
+    print_string(" misses (");
+    print_dec(lookups ? (uint32_t)div_u64((uint64_t)stats.glyph_hits * 100, lookups) : 0);
+    print_string("%)\nFlushes: ");
+    print_dec(stats.flushes);
+    print_string(" (full screen ");
+    print_dec(stats.full_flushes);
+    print_string("), written: ");
+    print_dec((uint32_t)(stats.flushed_bytes >> 10));
+    print_string(" KB\n");
+}
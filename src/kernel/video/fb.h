@@ -0,0 +1,128 @@
+/**
+ * @file fb.h
+ * @brief Консоль на линейном кадровом буфере (Bochs/QEMU VBE)
+ *
+ * Адаптер Bochs VBE (стандартный VGA в QEMU) переключается в режим
+ * 1024x768x32, кадровый буфер отображается с WC. Текст рисуется
+ * шрифтом VGA 8x16, прочитанным из плоскости 2 видеопамяти до смены
+ * режима, в теневой буфер в памяти; в кадровый буфер копируются только
+ * измененные участки строк, инструкциями SSE.
+ *
+ * Глифы растрируются один раз для каждой пары цветов и хранятся в кэше,
+ * так что вывод символа - копирование 16 строк по 32 байта. Строки
+ * текста в теневом буфере образуют кольцо: прокрутка сдвигает начало
+ * кольца и очищает одну строку. Видеопамять вдвое выше экрана, каждая
+ * строка кольца пишется в нее дважды (y и y + высота экрана), и экран
+ * прокручивается регистром смещения Y без копирования пикселей. Если
+ * адаптер не дает удвоенной высоты, после прокрутки копируется весь
+ * экран.
+ *
+ * Функции вывода вызываются из video.c под блокировкой видеовывода.
+ */
+
+#ifndef KERNEL_FB_H
+#define KERNEL_FB_H
+
+#include <stdint.h>
+
+/* Режим экрана */
+#define FB_WIDTH  1024
+#define FB_HEIGHT 768
+#define FB_BPP    32
+
+/* Знакоместо и размер консоли */
+#define FB_FONT_WIDTH  8
+#define FB_FONT_HEIGHT 16
+#define FB_COLS (FB_WIDTH / FB_FONT_WIDTH)
+#define FB_ROWS (FB_HEIGHT / FB_FONT_HEIGHT)
+
+/* Кэш растрированных глифов (степень двойки) */
+#define FB_GLYPH_SLOTS 1024
+
+/* Регистры Bochs VBE (индекс и данные, 16 бит) */
+#define VBE_DISPI_IOPORT_INDEX 0x01CE
+#define VBE_DISPI_IOPORT_DATA  0x01CF
+#define VBE_DISPI_INDEX_ID          0x0
+#define VBE_DISPI_INDEX_XRES        0x1
+#define VBE_DISPI_INDEX_YRES        0x2
+#define VBE_DISPI_INDEX_BPP         0x3
+#define VBE_DISPI_INDEX_ENABLE      0x4
+#define VBE_DISPI_INDEX_VIRT_WIDTH  0x6
+#define VBE_DISPI_INDEX_VIRT_HEIGHT 0x7
+#define VBE_DISPI_INDEX_X_OFFSET    0x8
+#define VBE_DISPI_INDEX_Y_OFFSET    0x9
+#define VBE_DISPI_ID_MIN      0xB0C0
+#define VBE_DISPI_ID_MAX      0xB0CF
+#define VBE_DISPI_ENABLED     0x01
+#define VBE_DISPI_LFB_ENABLED 0x40
+
+/* Адаптеры с интерфейсом Bochs VBE на PCI (производитель, устройство) */
+#define FB_PCI_QEMU_VGA 0x11111234
+#define FB_PCI_VBOX_VGA 0xBEEF80EE
+
+/**
+ * @brief Статистика консоли
+ */
+typedef struct {
+    uint32_t chars;           /* Выведено символов */
+    uint32_t glyph_hits;      /* Глиф найден в кэше */
+    uint32_t glyph_misses;    /* Глиф растрирован */
+    uint32_t scrolls;         /* Прокруток на строку */
+    uint32_t flushes;         /* Копирований в кадровый буфер */
+    uint32_t full_flushes;    /* Из них всего экрана */
+    uint64_t flushed_bytes;   /* Байт записано в кадровый буфер */
+} fb_stats_t;
+
+/**
+ * @brief Переключение в графический режим и перенос текстового экрана
+ * @return 0 если консоль работает, -1 если остался текстовый режим
+ *
+ * Вызывается после vmm_init() и pat_init().
+ */
+int fb_init(void);
+
+/**
+ * @brief Работает ли консоль на кадровом буфере
+ */
+int fb_active(void);
+
+/**
+ * @brief Вывод символа в позицию курсора (под блокировкой видеовывода)
+ * @param c Символ; '\n' и '\b' обрабатываются
+ * @param attr Атрибут VGA: цвет фона в старшей тетраде
+ */
+void fb_putc(char c, uint8_t attr);
+
+/**
+ * @brief Очистка экрана и курсор в начало (под блокировкой)
+ */
+void fb_clear(void);
+
+/**
+ * @brief Копирование измененных участков в кадровый буфер (под блокировкой)
+ */
+void fb_flush(void);
+
+/**
+ * @brief Прокрутка смещением видеопамяти или копированием экрана
+ * @param enable 1 - смещение (если адаптер позволяет), 0 - копирование
+ * @return 1 если прокрутка идет смещением
+ */
+int fb_set_panning(int enable);
+
+/**
+ * @brief Статистика консоли
+ */
+const fb_stats_t* fb_get_stats(void);
+
+/**
+ * @brief Вывод информации о консоли
+ */
+void fb_dump_info(void);
+
+/**
+ * @brief Скорость вывода и прокрутки (fb_bench.c)
+ */
+void run_fb_bench(void);
+
+#endif /* KERNEL_FB_H */
@@ -0,0 +1,106 @@
+/**
+ * @file fb_bench.c
+ * @brief Скорость консоли на кадровом буфере
+ *
+ * Строки во всю ширину экрана выводятся мимо COM1 (console_write()),
+ * и каждая прокручивает экран. Замер повторяется с прокруткой
+ * смещением видеопамяти и с копированием всего экрана; кроме строк
+ * в секунду выводятся байты, записанные в кадровый буфер, на строку.
+ */
+
+#include "fb.h"
+#include "video.h"
+#include "../cpu/cpu.h"
+#include "../cpu/tsc.h"
+#include "../lib/math64.h"
+
+/* Строк на замер: копирование экрана в десятки раз медленнее */
+#define FB_BENCH_LINES_PAN  2000
+#define FB_BENCH_LINES_COPY 100
+
+/**
+ * @brief Результат одного замера
+ */
+typedef struct {
+    uint32_t lines_per_sec;
+    uint32_t cycles_per_line;
+    uint32_t bytes_per_line;
+} fb_bench_result_t;
+
+/**
+ * @brief Вывод строк с прокруткой
+ */
+static void bench_scroll(uint32_t lines, fb_bench_result_t *result) {
+    char line[FB_COLS];
+    const fb_stats_t *stats = fb_get_stats();
+    uint64_t bytes = stats->flushed_bytes;
+    
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < lines; i++) {
+        for (uint32_t j = 0; j < FB_COLS - 1; j++) {
+            line[j] = 'A' + (i + j) % 26;
+        }
+        line[FB_COLS - 1] = '\0';
+        console_write(line, 1 + i % 15);
+        console_write("\n", 0x07);
+    }
+    uint64_t cycles = rdtsc() - start;
+    
+    uint32_t us = (uint32_t)div_u64(tsc_cycles_to_ns(cycles), 1000);
+    result->lines_per_sec = us ? (uint32_t)div_u64((uint64_t)lines * 1000000, us) : 0;
+    result->cycles_per_line = (uint32_t)div_u64(cycles, lines);
+    result->bytes_per_line = (uint32_t)div_u64(stats->flushed_bytes - bytes, lines);
+}
+
+/**
+ * @brief Вывод результата замера
+ */
+static void bench_report(const char *name, const fb_bench_result_t *result) {
+    print_string(name);
+    print_dec(result->lines_per_sec);
+    print_string(" lines/s, ");
+    print_dec(result->cycles_per_line);
+    print_string(" cycles and ");
+    print_dec(result->bytes_per_line >> 10);
+    print_string(" KB written per line\n");
+}
+
+/**
+ * @brief Скорость вывода и прокрутки
+ */
+void run_fb_bench(void) {
+    print_string("\n=== Framebuffer Console Benchmark ===\n");
+    
+    if (!fb_active() || !tsc_available()) {
+        print_string_color("Framebuffer console or TSC not available, skipping\n", COLOR_RED, COLOR_BLACK);
+        return;
+    }
+    
+    fb_bench_result_t pan = { 0 };
+    fb_bench_result_t copy = { 0 };
+    int pan_capable = fb_set_panning(1);
+    if (pan_capable) {
+        bench_scroll(FB_BENCH_LINES_PAN, &pan);
+    }
+    fb_set_panning(0);
+    bench_scroll(FB_BENCH_LINES_COPY, &copy);
+    fb_set_panning(1);
+    
+    const fb_stats_t *stats = fb_get_stats();
+    uint32_t lookups = stats->glyph_hits + stats->glyph_misses;
+    
+    print_string("\nScrolling ");
+    print_dec(FB_COLS - 1);
+    print_string("-column lines:\n");
+    if (pan_capable) {
+        bench_report("  Y panning: ", &pan);
+    } else {
+        print_string("  Y panning: not supported by the adapter\n");
+    }
+    bench_report("  full copy: ", &copy);
+    print_string("Glyph cache hit rate: ");
+    print_dec(lookups ? (uint32_t)div_u64((uint64_t)stats->glyph_hits * 100, lookups) : 0);
+    print_string("%\n");
+    
+    print_string_color("\nFramebuffer benchmark completed!\n", COLOR_GREEN, COLOR_BLACK);
+}
@@ -4,11 +4,16 @@
  * 
  * Этот модуль предоставляет базовые функции для вывода текста на экран
  * в текстовом режиме 80x25 символов. Работает напрямую с видеопамятью
- * по адресу 0xB8000.
+ * по адресу 0xB8000; после fb_init() вывод идет в консоль на кадровом
+ * буфере (fb.c).
  */
 
 #include "video.h"
+#include "fb.h"
 #include "../idt/idt.h"
+#include "../drivers/serial.h"
+#include "../sync/spinlock.h"
+#include "../memory/memory.h"
 #include <stdint.h>
 
 /**
@@ -18,7 +23,7 @@
  * - Младший байт: ASCII-код символа
  * - Старший байт: атрибуты символа (цвета переднего плана и фона)
  */
-char* VIDEO_MEMORY = (char*)0xB8000;
+char* VIDEO_MEMORY = (char*)(KERNEL_VIRT_BASE + VGA_TEXT_PHYS);
 
 /**
  * @brief Размер видеопамяти в текстовом режиме 80x25
@@ -34,6 +39,15 @@ char* VIDEO_MEMORY = (char*)0xB8000;
  * Обновляется после каждого вывода символа.
  */
 unsigned int cursor_pos = 0;
+
+/**
+ * @brief Блокировка видеопамяти и позиции курсора
+ *
+ * Выводить могут все процессоры и обработчики прерываний. Зеркало
+ * в COM1 пишется вне блокировки: вывод в порт медленный.
+ */
+static spinlock_t video_lock = SPINLOCK_INIT;
+
  /**
  * @brief Безопасное обновление позиции курсора с проверкой границ
  * @param new_pos Новая позиция курсора
@@ -110,26 +124,30 @@ void update_cursor(int pos) {
  */
 void clear_screen(void) 
 {
-    for (unsigned i = 0; i < SCREEN_SIZE; i += 2) {
-        VIDEO_MEMORY[i] = ' ';
-        VIDEO_MEMORY[i+1] = 0x07;
+    uint32_t flags = spin_lock_irqsave(&video_lock);
+    if (fb_active()) {
+        fb_clear();
+        fb_flush();
+    } else {
+        for (unsigned i = 0; i < SCREEN_SIZE; i += 2) {
+            VIDEO_MEMORY[i] = ' ';
+            VIDEO_MEMORY[i+1] = 0x07;
+        }
     }
     disable_cursor();
     cursor_pos = 0; // Сбрасываем позицию курсора
+    spin_unlock_irqrestore(&video_lock, flags);
 }
 
 /**
- * @brief Выводит строку на экран в текущей позиции
- * 
- * Функция выводит строку ASCIIZ (завершающуюся нулем) в видеопамять,
- * используя стандартный атрибут 0x07 (светло-серый на черном фоне).
- * 
- * @param str Указатель на строку для вывода (должна завершаться нулем)
- * 
- * @note Обрабатывает символ переноса строки ('\n')
- * @note При достижении конца экрана выполняется сброс позиции в начало
+ * @brief Вывод строки в текстовый буфер VGA (под video_lock)
+ * @param str Строка
+ * @param attribute Атрибут символов
+ *
+ * Обрабатывает перенос строки ('\n') и забой ('\b'); при достижении
+ * конца экрана позиция остается на последнем знакоместе.
  */
-void print_string(const char* str) {
+static void vga_write(const char* str, unsigned char attribute) {
     while (*str && cursor_pos < SCREEN_SIZE) {
         if (*str == '\n') {
             cursor_pos = ((cursor_pos / 160) + 1) * 160;
@@ -150,16 +168,50 @@ void print_string(const char* str) {
         }
         
         VIDEO_MEMORY[cursor_pos] = *str++;
-        VIDEO_MEMORY[cursor_pos + 1] = 0x07;
+        VIDEO_MEMORY[cursor_pos + 1] = attribute;
         cursor_pos += 2;
         
         if (cursor_pos >= SCREEN_SIZE) {
             // Реализуйте скроллинг экрана здесь при необходимости
             cursor_pos = SCREEN_SIZE - 2;
         }
+    }
+    safe_update_cursor_pos(cursor_pos);
+}
 
-        safe_update_cursor_pos(cursor_pos);
+/**
+ * @brief Вывод строки на экран без зеркала в COM1
+ *
+ * В графическом режиме строка рисуется консолью fb.c и копируется
+ * в кадровый буфер одним fb_flush() на всю строку.
+ */
+void console_write(const char* str, unsigned char attribute) {
+    uint32_t flags = spin_lock_irqsave(&video_lock);
+    if (fb_active()) {
+        while (*str) {
+            fb_putc(*str++, attribute);
+        }
+        fb_flush();
+    } else {
+        vga_write(str, attribute);
     }
+    spin_unlock_irqrestore(&video_lock, flags);
+}
+
+/**
+ * @brief Выводит строку на экран в текущей позиции
+ * 
+ * Функция выводит строку ASCIIZ (завершающуюся нулем) в видеопамять,
+ * используя стандартный атрибут 0x07 (светло-серый на черном фоне).
+ * 
+ * @param str Указатель на строку для вывода (должна завершаться нулем)
+ * 
+ * @note Обрабатывает символ переноса строки ('\n')
+ * @note При достижении конца экрана выполняется сброс позиции в начало
+ */
+void print_string(const char* str) {
+    serial_write_string(str);
+    console_write(str, 0x07);
 }
 
 /**
@@ -178,25 +230,8 @@ void print_string_color(const char* str, unsigned char fg_color, unsigned char b
 {
     unsigned char attribute = (bg_color << 4) | (fg_color & 0x0F);
     
-    while (*str && cursor_pos < SCREEN_SIZE) {
-        if (*str == '\n') {
-            cursor_pos = ((cursor_pos / 160) + 1) * 160;
-            if (cursor_pos >= SCREEN_SIZE) {
-                cursor_pos = SCREEN_SIZE - 160;
-            }
-            str++;
-            continue;
-        }
-        
-        VIDEO_MEMORY[cursor_pos] = *str++;
-        VIDEO_MEMORY[cursor_pos + 1] = attribute;
-        cursor_pos += 2;
-        
-        if (cursor_pos >= SCREEN_SIZE) {
-            cursor_pos = SCREEN_SIZE - 2;
-        }
-    }
-    safe_update_cursor_pos(cursor_pos);
+    serial_write_string(str);
+    console_write(str, attribute);
 }
 
 // Статические переменные для хранения текущего цвета
@@ -7,6 +7,7 @@
  * в файле video.c.
  * 
  * @note Все функции работают напрямую с видеопамятью по адресу 0xB8000
+ *       (в верхней половине - через прямое отображение)
  */
 
 #include <stdint.h>
@@ -34,6 +35,9 @@
 
 #define SCREEN_SIZE (80 * 25 * 2)
 
+/* Физический адрес видеопамяти текстового режима */
+#define VGA_TEXT_PHYS 0xB8000
+
 extern unsigned int cursor_pos;
 extern char* VIDEO_MEMORY;
 
@@ -60,6 +64,13 @@ void clear_screen(void);
 void print_string(const char* str);
 
 
+/**
+ * @brief Вывод строки на экран без зеркала в COM1
+ * @param str Строка
+ * @param attribute Атрибут VGA: (bg << 4) | fg
+ */
+void console_write(const char* str, unsigned char attribute);
+
 /**
  * @brief Выводит цветную строку на экран
  * 